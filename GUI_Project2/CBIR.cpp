@@ -6,6 +6,8 @@
     This file is part of a Content-Based Image Retrieval (CBIR) system implementing GUI.
 */
 #include "CBIR.h"
+#include "command_line.h"
+#include "distance_kernels.h"
 using namespace System;
 using namespace System::Windows::Forms;
 [STAThread]
@@ -14,11 +16,26 @@ using namespace System::Windows::Forms;
  * @brief Entry point for the application.
  *
  * This function sets up and runs the graphical user interface (GUI) for the CBIR system.
+ * If command-line arguments are given, the matching command-line command runs instead and the process exits.
  *
  * @param args Command-line arguments passed to the application.
  */
 void main(array<String^>^ args) {
+	if (args->Length > 0) {
+		std::vector<std::string> nativeArgs;
+		for each (String ^ arg in args) {
+			nativeArgs.push_back(msclr::interop::marshal_as<std::string>(arg));
+		}
+		Environment::Exit(runCommandLine(nativeArgs));
+	}
+
 	Application::EnableVisualStyles();
 	Application::SetCompatibleTextRenderingDefault(false);
+
+	// The SIMD distance kernels check themselves against the scalar ones before the first search
+	if (!selectDistanceKernels()) {
+		MessageBox::Show("A SIMD distance kernel set failed its self-check; searches use the slower "
+			+ gcnew String(distanceKernelName()) + " kernels.", "CBIR", MessageBoxButtons::OK, MessageBoxIcon::Warning);
+	}
 	Application::Run(gcnew GUIProject2::CBIR);
 }
@@ -9,6 +9,7 @@
 #include<opencv2/opencv.hpp>
 #include "iostream"
 #include "feature_utils.h"
+#include "dnn_models.h"
 #include <msclr/marshal_cppstd.h>
 
 namespace GUIProject2 {
@@ -121,6 +122,7 @@ namespace GUIProject2 {
 	private: System::Windows::Forms::ToolStripMenuItem^ customDesignWithFaceDetectionToolStripMenuItem;
 	private: System::Windows::Forms::ToolStripMenuItem^ customDesignToolStripMenuItem1;
 	private: System::Windows::Forms::ToolStripMenuItem^ customDesignWithFaceDetectionToolStripMenuItem1;
+	private: System::Windows::Forms::ToolStripMenuItem^ deepNetworkEmbeddingsToolStripMenuItem1;
 
 
 
@@ -196,6 +198,7 @@ namespace GUIProject2 {
 			this->binsTextureChannelNumericUpDown = (gcnew System::Windows::Forms::NumericUpDown());
 			this->NoBinsTextureChannelLabel = (gcnew System::Windows::Forms::Label());
 			this->customDesignWithFaceDetectionToolStripMenuItem1 = (gcnew System::Windows::Forms::ToolStripMenuItem());
+			this->deepNetworkEmbeddingsToolStripMenuItem1 = (gcnew System::Windows::Forms::ToolStripMenuItem());
 			this->menuStrip1->SuspendLayout();
 			(cli::safe_cast<System::ComponentModel::ISupportInitialize^>(this->topMatchesNumericUpDown))->BeginInit();
 			(cli::safe_cast<System::ComponentModel::ISupportInitialize^>(this->targetImagePictureBox))->BeginInit();
@@ -225,10 +228,10 @@ namespace GUIProject2 {
 			// 
 			// generateFeatureVectorToolStripMenuItem
 			// 
-			this->generateFeatureVectorToolStripMenuItem->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(6) {
+			this->generateFeatureVectorToolStripMenuItem->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(7) {
 				this->baselineMatchingToolStripMenuItem,
 					this->histogramMatchingToolStripMenuItem, this->multiHistogramMatchingToolStripMenuItem, this->textureAndColorToolStripMenuItem,
-					this->customDesignToolStripMenuItem1, this->customDesignWithFaceDetectionToolStripMenuItem1
+					this->deepNetworkEmbeddingsToolStripMenuItem1, this->customDesignToolStripMenuItem1, this->customDesignWithFaceDetectionToolStripMenuItem1
 			});
 			this->generateFeatureVectorToolStripMenuItem->Name = L"generateFeatureVectorToolStripMenuItem";
 			this->generateFeatureVectorToolStripMenuItem->Size = System::Drawing::Size(199, 22);
@@ -264,6 +267,12 @@ namespace GUIProject2 {
 			this->customDesignToolStripMenuItem1->Size = System::Drawing::Size(262, 22);
 			this->customDesignToolStripMenuItem1->Text = L"Custom Design";
 			// 
+			// deepNetworkEmbeddingsToolStripMenuItem1
+			// 
+			this->deepNetworkEmbeddingsToolStripMenuItem1->Name = L"deepNetworkEmbeddingsToolStripMenuItem1";
+			this->deepNetworkEmbeddingsToolStripMenuItem1->Size = System::Drawing::Size(262, 22);
+			this->deepNetworkEmbeddingsToolStripMenuItem1->Text = L"Deep Network Embeddings";
+			// 
 			// identifyMatchesToolStripMenuItem
 			// 
 			this->identifyMatchesToolStripMenuItem->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(7) {
@@ -478,7 +487,7 @@ namespace GUIProject2 {
 			// 
 			// openFileDialog2
 			// 
-			this->openFileDialog2->Filter = L"Feature Files|*.csv|All files|*.*";
+			this->openFileDialog2->Filter = L"Feature Files|*.csv;*.cbfs|All files|*.*";
 			// 
 			// saveFileDialog1
 			// 
@@ -610,6 +619,9 @@ namespace GUIProject2 {
 	private: System::Void CBIR_Load(System::Object^ sender, System::EventArgs^ e) {
 		resetAllControls();
 
+		// Load the DNN models in the background so the first DNN query or precompute does not wait for them
+		startDnnWarmUp();
+
 		// Set up event handlers for menu items
 		this->baselineMatchingToolStripMenuItem1->Click += gcnew System::EventHandler(this, &CBIR::baselineMatchingToolStripMenuItem1_Click);
 		this->baselineMatchingToolStripMenuItem->Click += gcnew System::EventHandler(this, &CBIR::baselineMatchingToolStripMenuItem_Click);
@@ -624,6 +636,7 @@ namespace GUIProject2 {
 		this->textureAndColorToolStripMenuItem1->Click += gcnew System::EventHandler(this, &CBIR::textureAndColorToolStripMenuItem1_Click);
 
 		this->deepNetworkEmbeddingsToolStripMenuItem->Click += gcnew System::EventHandler(this, &CBIR::deepNetworkEmbeddingsToolStripMenuItem_Click);
+		this->deepNetworkEmbeddingsToolStripMenuItem1->Click += gcnew System::EventHandler(this, &CBIR::deepNetworkEmbeddingsToolStripMenuItem1_Click);
 		
 		this->customDesignToolStripMenuItem->Click += gcnew System::EventHandler(this, &CBIR::customDesignToolStripMenuItem_Click);
 		this->customDesignToolStripMenuItem1->Click += gcnew System::EventHandler(this, &CBIR::customDesignToolStripMenuItem1_Click);
@@ -735,6 +748,30 @@ namespace GUIProject2 {
 		this->displayImageDirLabel->Text = "Upload Image Directory";
 	}
 
+	/**
+	* @brief Handles the click event for the "Deep Network Embeddings" menu item of Generate Feature Vector, resetting controls and updating UI elements accordingly.
+	*
+	* @param sender The object that raised the event.
+	* @param e The event data.
+	* @return void
+	*/
+	private: System::Void deepNetworkEmbeddingsToolStripMenuItem1_Click(System::Object^ sender, System::EventArgs^ e) {
+		resetAllControls();
+
+		// Update UI elements
+		this->headingLabel->Text = "Generate Feature Vector - Deep Network Embeddings";
+		this->uploadImageDirButton->Visible = true;
+		this->displayImageDirLabel->Visible = true;
+
+		this->submitButton->Visible = true;
+
+		this->taskNo = 1;
+		this->subTaskNo = 5;
+
+		this->uploadImageDirButton->Text = "Upload Directory";
+		this->displayImageDirLabel->Text = "Upload Image Directory";
+	}
+
 	/**
 	* @brief Handles the click event for the "Custom Design" menu item, resetting controls and updating UI elements accordingly.
 	*
@@ -1124,6 +1161,9 @@ namespace GUIProject2 {
 			case 4:
 				textureAndColorCalculationTask();
 				break;
+			case 5:
+				deepNetworkEmbeddingsCalculationTask();
+				break;
 			case 6:
 				combinedFeaturesCalculationTask();
 				break;
@@ -1684,6 +1724,38 @@ namespace GUIProject2 {
 		MessageBox::Show(message);
 	}
 
+	/**
+	* @brief Handles the deep network embeddings, including saving the computed embeddings.
+	*
+	* @return void
+	*/
+	private: System::Void  deepNetworkEmbeddingsCalculationTask() {
+		if (saveFileDialog1->ShowDialog() == System::Windows::Forms::DialogResult::OK) {
+			saveFeatureFilePath = saveFileDialog1->FileName;
+
+		}
+		// Validate inputs
+		if (System::String::IsNullOrWhiteSpace(this->imageDirectoryPath)) {
+			MessageBox::Show("Please select image directory");
+			return;
+		}
+
+		// Convert System::String to std::string for native function call
+		msclr::interop::marshal_context context;
+		std::string stdImageDirectoryPath = context.marshal_as<std::string>(this->imageDirectoryPath);
+		std::string stdSaveFeatureFilePath = context.marshal_as<std::string>(this->saveFeatureFilePath);
+
+		this->progressBar1->Visible = true;
+		this->progressBar1->Refresh();
+
+		performDeepEmbeddingCalculation(stdImageDirectoryPath, stdSaveFeatureFilePath);
+
+		this->progressBar1->Visible = false;
+
+		System::String^ message = "Features computed and saved to " + saveFeatureFilePath;
+		MessageBox::Show(message);
+	}
+
 	/**
 	* @brief Handles the custom design, including saving the computed features.
 	*
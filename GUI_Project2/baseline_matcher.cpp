@@ -17,8 +17,9 @@
 #include <string>
 #include <algorithm>
 #include <filesystem>
-#include "csv_util.h"  
 #include "feature_utils.h"
+#include "feature_indexer.h"
+#include "search_engine.h"
 
 /**
  * @brief Extracts a 7x7 feature vector from the center of an image, encapsulating the color information of each pixel within this square.
@@ -55,27 +56,14 @@ std::vector<float> extract7x7FeatureVector(const cv::Mat& image) {
 }
 
 /**
- * @brief Computes the sum of squared differences between two feature vectors, serving as a distance metric.
- * This function is essential for evaluating the similarity between images based on their feature vectors.
- *
- * @param vec1 The first feature vector as a std::vector<float>.
- * @param vec2 The second feature vector as a std::vector<float>.
- * @return float The computed sum of squared differences between the two vectors.
- * @throws std::invalid_argument if the vectors are not of the same size.
+ * @brief Extractor for the search engine: the 7x7 center square of an image.
  */
-
-float computeDistance(const std::vector<float>& vec1, const std::vector<float>& vec2) {
-    if (vec1.size() != vec2.size()) {
-        throw std::invalid_argument("Vectors must be of the same size to compute distance.");
+struct Baseline7x7Extractor {
+    bool operator()(const cv::Mat& image, std::vector<float>& features) const {
+        features = extract7x7FeatureVector(image);
+        return true;
     }
-
-    float sum = 0.0f;
-    for (size_t i = 0; i < vec1.size(); ++i) {
-        float diff = vec1[i] - vec2[i];
-        sum += diff * diff;
-    }
-    return sum;
-}
+};
 
 /**
  * @brief Matches a target image against a database of images based on the sum of squared difference metric,
@@ -90,44 +78,13 @@ float computeDistance(const std::vector<float>& vec1, const std::vector<float>&
  */
 
 std::vector<std::string> performBaselineMatching(const std::string& targetImageFile, int topN, const std::string& featureFile) {
-    // Load the target image
-    cv::Mat targetImage = cv::imread(targetImageFile, cv::IMREAD_COLOR);
-    if (targetImage.empty()) {
-        std::cerr << "Could not read the image: " << targetImageFile << std::endl;
-    }
-
-    // Extract the feature vector from the target image
-    std::vector<float> targetFeatures = extract7x7FeatureVector(targetImage);
-
-    // Read the feature vectors and filenames from the CSV file
-    std::vector<char*> filenames;
-    std::vector<std::vector<float>> databaseFeatures;
-    if (read_image_data_csv(const_cast<char*>(featureFile.c_str()), filenames, databaseFeatures, false) != 0) {
-        std::cerr << "Error reading feature data from CSV file." << std::endl;
-    }
-
-    // Compute distances from the target features to each image's features in the database
-    std::vector<std::pair<float, std::string>> distances;
-    for (size_t i = 0; i < databaseFeatures.size(); ++i) {
-        float dist = computeDistance(targetFeatures, databaseFeatures[i]);
-
-        if (dist > 0) { // To skip distances with a value of 0
-            distances.push_back(std::make_pair(dist, std::string(filenames[i])));
-        }
-    }
-
-    // Sort the distances in ascending order to get the closest matches first
-    std::sort(distances.begin(), distances.end(), [](const auto& a, const auto& b) {
-        return a.first < b.first;
-        });
-
-    std::vector<std::string> topMatches;
-    for (int i = 0; i < std::min(topN, static_cast<int>(distances.size())); ++i) {
-        topMatches.push_back(distances[i].second);
-    }
-
-    return topMatches;
-
+    // Compare the target's 7x7 square with every image's by sum of squared differences on all scan
+    // threads, closest first. Rows identical to the target (distance 0) are skipped.
+    SearchOptions options;
+    options.skipTargetImage = false;
+    options.skipIdentical = true;
+    const Searcher<Baseline7x7Extractor, SquaredEuclideanMetric> searcher(Baseline7x7Extractor(), options);
+    return searcher.search(targetImageFile, featureFile, topN).paths();
 }
 
 /**
@@ -135,41 +92,21 @@ std::vector<std::string> performBaselineMatching(const std::string& targetImageF
  * This function facilitates the offline computation of feature vectors for all images in a database, optimizing the matching process.
  *
  * @param directory A string representing the path to the directory containing the images to be processed.
- * @param outputFile A string representing the file path where the extracted feature vectors should be saved in CSV format.
- * @note This function will overwrite the existing CSV file if reset_file is set to true; otherwise, it appends to it.
- * @note The function prints an error message if an image cannot be loaded or if writing to the CSV file fails.
+ * @param outputFile A string representing the file path where the extracted feature vectors should be saved (CSV, or a binary feature store for ".cbfs").
+ * @note An existing output file is updated incrementally: only images that are new or changed since the last run are processed.
+ * @note The function prints an error message if an image cannot be loaded or if writing to the output file fails.
  */
 
 void performBaselineCalculation(const std::string& directory, const std::string& outputFile)
 {
-    bool reset_file = true; // Set this to true to overwrite the existing CSV file, or false to append.
-
-    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+    try {
+        FeatureStoreInfo info;
+        info.type = FeatureType::Baseline;
 
-        // Check if the file is a .jpg image before processing
-        if (entry.path().extension() == ".jpg") {
-            std::string imagePath = entry.path().string();
-            cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
-            if (image.empty()) {
-                std::cerr << "Error loading image: " << imagePath << std::endl;
-                continue;
-            }
-
-            // Extract the 7x7 feature vector from the image
-            std::vector<float> featureVector = extract7x7FeatureVector(image);
-
-            // Append the feature vector to the CSV file
-            char* imagePathCStr = new char[imagePath.length() + 1];
-            std::strcpy(imagePathCStr, imagePath.c_str());
-            int status = append_image_data_csv(const_cast<char*>(outputFile.c_str()), imagePathCStr, featureVector, reset_file);
-            delete[] imagePathCStr; // Clean up the allocated memory
-
-            // Only reset the file once, at the beginning
-            reset_file = false;
-
-            if (status != 0) {
-                std::cerr << "Error writing to CSV file." << std::endl;
-            }
-        }
+        // Only new or changed images are decoded; unchanged rows are copied from the previous output
+        indexImageDirectory(directory, outputFile, info, Searcher<Baseline7x7Extractor, SquaredEuclideanMetric>().imageFileExtractor());
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error writing feature file: " << e.what() << std::endl;
     }
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+/*! \file batch_search.cpp
+    \brief Implements running many queries against one feature collection at once.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Work is split into tasks of
+    up to 64 queries and a contiguous range of database rows. A task walks its range in tiles of
+    about 256 KB, multiplies the query tile with each database tile through cv::gemm and turns the
+    products into distances, keeping a top-K heap per query. The heaps of tasks that share a query
+    tile are merged at the end with the (score, row) ordering of the parallel scan, so the results
+    do not depend on the thread count.
+*/
+
+#include "batch_search.h"
+#include "distance_kernels.h"
+#include "feature_index.h"
+#include "parallel_scan.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr std::size_t QUERY_TILE_ROWS = 64;
+constexpr std::size_t DATABASE_TILE_BYTES = 256 * 1024;
+constexpr std::size_t NORM_BLOCK_ROWS = 4096;
+
+using ScoredRow = std::pair<float, std::size_t>;
+
+/**
+ * @brief Wraps rows [begin, end) of a feature matrix in a cv::Mat header without copying them.
+ */
+cv::Mat rowsAsMat(const FeatureMatrix& matrix, std::size_t begin, std::size_t end) {
+    return cv::Mat(static_cast<int>(end - begin), static_cast<int>(matrix.dims()), CV_32F,
+        const_cast<float*>(matrix.row(begin)), matrix.stride() * sizeof(float));
+}
+
+/**
+ * @brief Squared length of every row, computed on the scan threads.
+ */
+std::vector<float> squaredLengths(const FeatureMatrix& matrix) {
+    std::vector<float> lengths(matrix.rows());
+    parallelFor((matrix.rows() + NORM_BLOCK_ROWS - 1) / NORM_BLOCK_ROWS, [&](std::size_t block) {
+        const std::size_t end = std::min(matrix.rows(), (block + 1) * NORM_BLOCK_ROWS);
+        for (std::size_t i = block * NORM_BLOCK_ROWS; i < end; ++i) {
+            lengths[i] = dotProduct(matrix.row(i), matrix.row(i), matrix.dims());
+        }
+    });
+    return lengths;
+}
+
+/**
+ * @brief For every query, the database rows that show the same image (same file name).
+ */
+std::vector<std::vector<std::size_t>> sameImageRows(const FeatureMatrix& queries, const FeatureMatrix& database) {
+    std::unordered_map<std::string, std::vector<std::size_t>> rowsByName;
+    for (std::size_t i = 0; i < database.rows(); ++i) {
+        rowsByName[std::filesystem::path(database.path(i)).filename().string()].push_back(i);
+    }
+
+    std::vector<std::vector<std::size_t>> rows(queries.rows());
+    for (std::size_t q = 0; q < queries.rows(); ++q) {
+        auto match = rowsByName.find(std::filesystem::path(queries.path(q)).filename().string());
+        if (match != rowsByName.end()) rows[q] = match->second;
+    }
+    return rows;
+}
+
+} // namespace
+
+BatchMetric batchMetricFor(FeatureType type) {
+    switch (type) {
+    case FeatureType::Baseline: return BatchMetric::SquaredEuclidean;
+    case FeatureType::Histogram:
+    case FeatureType::MultiHistogram: return BatchMetric::Intersection;
+    case FeatureType::DeepEmbedding: return BatchMetric::CosineDistance;
+    default: return BatchMetric::Euclidean;
+    }
+}
+
+BatchResults batchSearch(const FeatureMatrix& queries, const FeatureMatrix& database, BatchMetric metric, const BatchSearchOptions& options) {
+    BatchResults results(queries.rows());
+    if (queries.empty() || database.empty() || options.topK == 0) return results;
+    if (queries.dims() != database.dims()) {
+        throw std::invalid_argument("Query and database feature vectors differ in length");
+    }
+
+    const std::size_t dims = database.dims();
+    const ScanOrder order = metric == BatchMetric::Intersection ? ScanOrder::Descending : ScanOrder::Ascending;
+    const bool usesProducts = metric != BatchMetric::Intersection;
+    const std::vector<float> queryLengths = usesProducts ? squaredLengths(queries) : std::vector<float>();
+    const std::vector<float> databaseLengths = usesProducts ? squaredLengths(database) : std::vector<float>();
+    std::vector<std::vector<std::size_t>> skipped(queries.rows());
+    if (options.skipSameImage) skipped = sameImageRows(queries, database);
+
+    // Database tiles of about DATABASE_TILE_BYTES stay in cache while a query tile is scored
+    // against them; with few query tiles the database is also split so every thread gets work
+    const std::size_t tileRows = std::max<std::size_t>(16, DATABASE_TILE_BYTES / (database.stride() * sizeof(float)));
+    const std::size_t queryTiles = (queries.rows() + QUERY_TILE_ROWS - 1) / QUERY_TILE_ROWS;
+    const std::size_t databaseTiles = (database.rows() + tileRows - 1) / tileRows;
+    const std::size_t wantedChunks = (2 * static_cast<std::size_t>(scanThreadCount()) + queryTiles - 1) / queryTiles;
+    const std::size_t chunks = std::max<std::size_t>(1, std::min(wantedChunks, databaseTiles));
+    const std::size_t chunkRows = (databaseTiles + chunks - 1) / chunks * tileRows;
+
+    std::vector<std::vector<std::vector<ScoredRow>>> partial(queryTiles * chunks);
+    parallelFor(partial.size(), [&](std::size_t task) {
+        const std::size_t queryBegin = task / chunks * QUERY_TILE_ROWS;
+        const std::size_t queryEnd = std::min(queries.rows(), queryBegin + QUERY_TILE_ROWS);
+        const std::size_t rowBegin = task % chunks * chunkRows;
+        const std::size_t rowEnd = std::min(database.rows(), rowBegin + chunkRows);
+
+        std::vector<TopKHeap> heaps(queryEnd - queryBegin, TopKHeap(options.topK, order));
+        const cv::Mat queryTile = rowsAsMat(queries, queryBegin, queryEnd);
+        cv::Mat products;
+        for (std::size_t tileBegin = rowBegin; tileBegin < rowEnd; tileBegin += tileRows) {
+            const std::size_t tileEnd = std::min(rowEnd, tileBegin + tileRows);
+            if (usesProducts) {
+                cv::gemm(queryTile, rowsAsMat(database, tileBegin, tileEnd), 1.0, cv::noArray(), 0.0, products, cv::GEMM_2_T);
+            }
+
+            for (std::size_t q = queryBegin; q < queryEnd; ++q) {
+                const std::vector<std::size_t>& skip = skipped[q];
+                const float* dots = usesProducts ? products.ptr<float>(static_cast<int>(q - queryBegin)) : nullptr;
+                const float queryLength = usesProducts ? std::sqrt(queryLengths[q]) : 0.0f;
+                for (std::size_t r = tileBegin; r < tileEnd; ++r) {
+                    if (!skip.empty() && std::find(skip.begin(), skip.end(), r) != skip.end()) continue;
+
+                    float score;
+                    if (metric == BatchMetric::Intersection) {
+                        score = intersectionSum(queries.row(q), database.row(r), dims);
+                    }
+                    else if (metric == BatchMetric::CosineDistance) {
+                        // A zero length vector has similarity -1, as in cosineSimilarity
+                        const float lengths = queryLength * std::sqrt(databaseLengths[r]);
+                        score = lengths == 0.0f ? 2.0f : 1.0f - dots[r - tileBegin] / lengths;
+                    }
+                    else {
+                        score = std::max(0.0f, queryLengths[q] + databaseLengths[r] - 2.0f * dots[r - tileBegin]);
+                    }
+                    heaps[q - queryBegin].offer(score, r);
+                }
+            }
+        }
+
+        partial[task].resize(heaps.size());
+        for (std::size_t i = 0; i < heaps.size(); ++i) partial[task][i] = heaps[i].rows();
+    });
+
+    // Merge the chunks of every query tile, then replace the expanded Euclidean distances of the
+    // kept rows by exact ones, which cannot suffer from cancellation
+    const TopKHeap ordering(options.topK, order);
+    for (std::size_t q = 0; q < queries.rows(); ++q) {
+        std::vector<ScoredRow>& merged = results[q];
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            const std::vector<ScoredRow>& rows = partial[q / QUERY_TILE_ROWS * chunks + chunk][q % QUERY_TILE_ROWS];
+            merged.insert(merged.end(), rows.begin(), rows.end());
+        }
+        if (metric == BatchMetric::SquaredEuclidean || metric == BatchMetric::Euclidean) {
+            for (ScoredRow& match : merged) {
+                const float distance = squaredL2Distance(queries.row(q), database.row(match.second), dims);
+                match.first = metric == BatchMetric::Euclidean ? std::sqrt(distance) : distance;
+            }
+        }
+        ordering.sortAndTrim(merged);
+    }
+    return results;
+}
+
+int runBatchSearch(const std::string& queryFilePath, const std::string& databaseFilePath, const std::string& outputFilePath,
+    FeatureType type, const BatchSearchOptions& options) {
+    // Both collections come from the feature index cache, so a file used on both sides is loaded once
+    FeatureIndexHandle queryIndex, databaseIndex;
+    try {
+        databaseIndex = openFeatureIndex(databaseFilePath);
+        queryIndex = openFeatureIndex(queryFilePath);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading feature data: " << e.what() << std::endl;
+        return -1;
+    }
+    const FeatureMatrix& queries = queryIndex->features;
+    const FeatureMatrix& database = databaseIndex->features;
+
+    const auto start = std::chrono::steady_clock::now();
+    BatchResults results;
+    try {
+        results = batchSearch(queries, database, batchMetricFor(type), options);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Batch search failed: " << e.what() << std::endl;
+        return -1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream output(outputFilePath);
+    if (!output) {
+        std::cerr << "Unable to open " << outputFilePath << " for writing" << std::endl;
+        return -1;
+    }
+
+    // The multi-histogram matcher averages the intersections of its two halves
+    const float scale = type == FeatureType::MultiHistogram ? 0.5f : 1.0f;
+    output << "query,rank,match,score\n";
+    for (std::size_t q = 0; q < results.size(); ++q) {
+        for (std::size_t rank = 0; rank < results[q].size(); ++rank) {
+            output << queries.path(q) << ',' << rank + 1 << ',' << database.path(results[q][rank].second) << ','
+                << results[q][rank].first * scale << '\n';
+        }
+    }
+    output.close();
+    if (!output) {
+        std::cerr << "Failed to write " << outputFilePath << std::endl;
+        return -1;
+    }
+
+    std::cout << "Searched " << queries.rows() << " queries against " << database.rows() << " images in "
+        << seconds << " s; results written to " << outputFilePath << std::endl;
+    return 0;
+}
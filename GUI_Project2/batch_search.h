@@ -0,0 +1,87 @@
+/*! \file batch_search.h
+    \brief Declarations for running many queries against one feature collection at once.
+    \author Manushi
+    \date October 16, 2026
+
+    Dedup audits and evaluation runs compare thousands of images against the same collection.
+    A batch search loads the collection once and scores tiles of queries against tiles of
+    database rows, so every tile is read from memory once per query tile instead of once per
+    query. Euclidean and cosine scores are computed from one matrix product per tile, using
+    |a - b|^2 = |a|^2 + |b|^2 - 2 a.b with precomputed lengths; histogram intersection is
+    scored pair by pair inside the tile. Tiles are spread over the scan thread pool.
+*/
+
+#ifndef BATCH_SEARCH_H
+#define BATCH_SEARCH_H
+
+#include "feature_matrix.h"
+#include "feature_store.h"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief How a batch search scores a query against a database row.
+ */
+enum class BatchMetric {
+    SquaredEuclidean, ///< Sum of squared differences, smallest first (baseline features).
+    Euclidean,        ///< Euclidean distance, smallest first (texture and color, custom designs).
+    CosineDistance,   ///< 1 - cosine similarity, smallest first (DNN embeddings).
+    Intersection      ///< Histogram intersection, largest first (color histograms).
+};
+
+/**
+ * @brief Options of a batch search.
+ */
+struct BatchSearchOptions {
+    std::size_t topK = 10;      // Results per query
+    bool skipSameImage = true;  // Leave out database rows with the same file name as the query
+};
+
+/**
+ * @brief Best (score, database row) pairs of every query, best first; indexed by query row.
+ */
+using BatchResults = std::vector<std::vector<std::pair<float, std::size_t>>>;
+
+/**
+ * @brief Returns the metric the single-image matcher of a feature type ranks with.
+ *
+ * @param type Feature type of the collection.
+ * @return The metric; Euclidean for types without a dedicated one.
+ */
+BatchMetric batchMetricFor(FeatureType type);
+
+/**
+ * @brief Finds the best database rows for every query row.
+ *
+ * Ties are broken by the lower database row, as in the single-image matchers. Euclidean scores
+ * of the kept rows are recomputed exactly, so only the ranking of near ties can differ from a
+ * pair-by-pair scan.
+ *
+ * @param queries Query feature rows; the image paths are used to skip the query's own image.
+ * @param database Database feature rows.
+ * @param metric How rows are scored.
+ * @param options Result count and self-match handling.
+ * @return The results of every query.
+ * @throws std::invalid_argument If the query and database rows differ in length.
+ */
+BatchResults batchSearch(const FeatureMatrix& queries, const FeatureMatrix& database, BatchMetric metric, const BatchSearchOptions& options);
+
+/**
+ * @brief Runs a batch search between two feature files and writes every result list to a CSV file.
+ *
+ * Each output line holds query image, rank (from 1), matching image and score. Passing the same
+ * file as queries and database runs an all-pairs search of the collection, e.g. for a dedup audit.
+ *
+ * @param queryFilePath Feature file (CSV or feature store) with one row per query image.
+ * @param databaseFilePath Feature file of the collection to search.
+ * @param outputFilePath Path of the CSV file to write.
+ * @param type Feature type of both files; selects the metric.
+ * @param options Result count and self-match handling.
+ * @return 0 on success, a non-zero value if a file cannot be read or written.
+ */
+int runBatchSearch(const std::string& queryFilePath, const std::string& databaseFilePath, const std::string& outputFilePath,
+    FeatureType type, const BatchSearchOptions& options);
+
+#endif // BATCH_SEARCH_H
@@ -7,12 +7,13 @@
 #include <algorithm> 
 #include <filesystem>
 #include <fstream>
-#include <sstream>
+#include <memory>
+#include "dnn_models.h"
+#include "face_boxes.h"
 #include "feature_utils.h"
-#define NOMINMAX
-#include <windows.h>
-#include <Shlwapi.h> 
-#pragma comment(lib, "Shlwapi.lib")
+#include "feature_store.h"
+#include "feature_indexer.h"
+#include "search_engine.h"
 #include <string>
 
 namespace fs = std::filesystem;
@@ -20,56 +21,10 @@ using namespace cv;
 using namespace std;
 using namespace cv::dnn;
 
-struct FeatureVector {
-    vector<float> colorHistogram;
-    vector<float> textureFeatures;
-    vector<float> dnnFeatures;
-    vector<float> faceFeatures;
-};
-
-/**
- * @brief Retrieves the directory path of the current executable.
- *
- * @return std::string The directory path of the current executable.
- */
-std::string GetCurrentExecutableDirectoryFace() {
-    char path[MAX_PATH];
-    GetModuleFileNameA(NULL, path, MAX_PATH);
-    PathRemoveFileSpecA(path);
-    return std::string(path);
-}
-
-/**
- * @brief Normalizes a given vector by dividing each element by its Euclidean norm.
- *
- * @param v The vector to normalize.
- * @return std::vector<float> The normalized vector.
- */
-vector<float> normalizeVectorFace(const vector<float>& v) {
-    vector<float> nv(v.size());
-    float norm = sqrt(std::inner_product(v.begin(), v.end(), v.begin(), 0.0f));
-    if (norm > 0) {
-        std::transform(v.begin(), v.end(), nv.begin(), [norm](float val) { return val / norm; });
-    }
-    return nv;
-}
-
-
-/**
- * @brief Calculates the Euclidean distance between two feature vectors.
- *
- * @param featureVec1 The first feature vector.
- * @param featureVec2 The second feature vector.
- * @return float The Euclidean distance between the two feature vectors.
- */
-float euclideanDistanceFace(const std::vector<float>& featureVec1, const std::vector<float>& featureVec2) {
-    assert(featureVec1.size() == featureVec2.size());
-    float distance = 0.0f;
-    for (size_t i = 0; i < featureVec1.size(); ++i) {
-        distance += std::pow(featureVec1[i] - featureVec2[i], 2);
-    }
-    return std::sqrt(distance);
-}
+// Faces above this confidence are embedded into the feature vector and stored with it
+const float FACE_EMBEDDING_CONFIDENCE = 0.3f;
+// Faces above this confidence are highlighted in the results
+const float FACE_HIGHLIGHT_CONFIDENCE = 0.5f;
 
 /**
  * @brief Extracts the color histogram features from an input image.
@@ -145,46 +100,13 @@ vector<float> extractLBPFeaturesFace(const Mat& image) {
 }
 
 /**
- * @brief Extracts features using a pre-trained Deep Neural Network (DNN) model.
+ * @brief Extracts DenseNet-121 features, with a network leased from the model registry.
  *
  * @param image The input image.
- * @param modelPath The file path to the DNN model.
- * @param configPath The file path to the configuration file for the DNN model.
- * @param inputSize The input size expected by the DNN model.
- * @param meanVal The mean value to subtract from the input image.
- * @param swapRB Whether to swap the R and B channels.
  * @return std::vector<float> The extracted DNN features.
  */
-vector<float> extractDNNFeaturesFace(const Mat& image, const string& modelPath, const string& configPath, const Size& inputSize, const Scalar& meanVal, bool swapRB) {
-    Net net = readNet(modelPath, configPath);
-    Mat blob;
-    blobFromImage(image, blob, 1.0, inputSize, meanVal, swapRB, false);
-    net.setInput(blob);
-    Mat dnnOutput = net.forward();
-
-    // Convert dnnOutput to a flat vector
-    vector<float> features(dnnOutput.size[1]);
-    memcpy(features.data(), dnnOutput.data, dnnOutput.total() * sizeof(float));
-    return features;
-}
-
-/**
- * @brief Calculates the combined distance between two sets of feature vectors.
- *
- * @param features1 The first set of feature vectors.
- * @param features2 The second set of feature vectors.
- * @return float The combined distance between the two sets of feature vectors.
- */
-float calculateDistanceFace(const FeatureVector& features1, const FeatureVector& features2) {
-    // Example weights
-    float w1 = 0.33, w2 = 0.33, w3 = 0.34;
-
-    float colorDistance = euclideanDistanceFace(features1.colorHistogram, features2.colorHistogram);
-    float textureDistance = euclideanDistanceFace(features1.textureFeatures, features2.textureFeatures);
-    float dnnDistance = 1 - cosineSimilarity(features1.dnnFeatures, features2.dnnFeatures);
-
-    float totalDistance = w1 * colorDistance + w2 * textureDistance + w3 * dnnDistance;
-    return totalDistance;
+vector<float> extractDNNFeaturesFace(const Mat& image) {
+    return dnnFeatures(DnnModel::DenseNet121, image);
 }
 
 /**
@@ -209,124 +131,105 @@ vector<float> getFaceEmbeddings(const Mat& faceROI, Net& faceRecognitionModel) {
 }
 
 /**
- * @brief Extracts various features from faces detected in the input image.
+ * @brief Detects faces in the input image with the SSD face detector.
  *
  * @param image The input image.
  * @param faceNet The face detection model.
- * @param faceRecognitionModel The face recognition model.
- * @return std::vector<float> The extracted face features.
+ * @param minConfidence Detections at or below this confidence are dropped.
+ * @return std::vector<FaceBox> The detected faces, in coordinates relative to the image size.
  */
-vector<float> extractFaceFeatures(const Mat& image, Net& faceNet, Net& faceRecognitionModel) {
-    vector<float> faceFeatures;
+vector<FaceBox> detectFaces(const Mat& image, Net& faceNet, float minConfidence) {
     Mat inputBlob = blobFromImage(image, 1.0, Size(300, 300), Scalar(104.0, 177.0, 123.0), false, false);
     faceNet.setInput(inputBlob);
     Mat detections = faceNet.forward();
-
     Mat detectionMat(detections.size[2], detections.size[3], CV_32F, detections.ptr<float>());
 
+    vector<FaceBox> faces;
     for (int i = 0; i < detectionMat.rows; i++) {
         float confidence = detectionMat.at<float>(i, 2);
-        if (confidence > 0.3) { // Only consider detections with high confidence
-            // Calculate the (x, y)-coordinates of the bounding box for the object
-            int x1 = static_cast<int>(detectionMat.at<float>(i, 3) * image.cols);
-            int y1 = static_cast<int>(detectionMat.at<float>(i, 4) * image.rows);
-            int x2 = static_cast<int>(detectionMat.at<float>(i, 5) * image.cols);
-            int y2 = static_cast<int>(detectionMat.at<float>(i, 6) * image.rows);
-            Rect faceRect(x1, y1, x2 - x1, y2 - y1);
-
-            // Ensure the bounding box fits within the frame
-            faceRect = faceRect & Rect(0, 0, image.cols, image.rows);
-           
-            // Extract the face ROI and possibly resize it for your face feature extractor input
-            Mat faceROI = image(faceRect).clone();
-            resize(faceROI, faceROI, Size(96, 96)); // Example resize if needed
-
-            // Here you would pass the faceROI to your face feature extractor
-            // For example, let's say we have a function called 'getFaceEmbeddings' that returns a vector of floats
-            vector<float> faceEmbeddings = getFaceEmbeddings(faceROI, faceRecognitionModel);
-
-            // Then add these face features to the faceFeatures vector
-            faceFeatures.insert(faceFeatures.end(), faceEmbeddings.begin(), faceEmbeddings.end());
+        if (confidence > minConfidence) {
+            faces.push_back({ detectionMat.at<float>(i, 3), detectionMat.at<float>(i, 4),
+                detectionMat.at<float>(i, 5), detectionMat.at<float>(i, 6), confidence });
         }
     }
-    return faceFeatures;
+    return faces;
 }
 
+/**
+ * @brief Converts a face box to pixel coordinates of an image.
+ *
+ * @param face The face box, relative to the image size.
+ * @param imageSize Size of the image in pixels.
+ * @return cv::Rect The bounding box of the face in pixels (not clipped to the image).
+ */
+Rect faceRectangle(const FaceBox& face, const Size& imageSize) {
+    int x1 = static_cast<int>(face.left * imageSize.width);
+    int y1 = static_cast<int>(face.top * imageSize.height);
+    int x2 = static_cast<int>(face.right * imageSize.width);
+    int y2 = static_cast<int>(face.bottom * imageSize.height);
+    return Rect(x1, y1, x2 - x1, y2 - y1);
+}
 
 /**
- * @brief Highlights faces detected in the input image.
+ * @brief Extracts various features from faces detected in the input image.
  *
  * @param image The input image.
- * @param faceNet The face detection model.
+ * @param faces The faces detected in the image.
+ * @param faceRecognitionModel The face recognition model.
+ * @return std::vector<float> The extracted face features.
  */
-void highlightFaces(Mat& image, Net& faceNet) {
-    Mat inputBlob = blobFromImage(image, 1.0, Size(300, 300), Scalar(104.0, 177.0, 123.0), false, false);
-    faceNet.setInput(inputBlob);
-    Mat detections = faceNet.forward();
-    Mat detectionMat(detections.size[2], detections.size[3], CV_32F, detections.ptr<float>());
-
-    for (int i = 0; i < detectionMat.rows; ++i) {
-        float confidence = detectionMat.at<float>(i, 2);
-        if (confidence > 0.5) {
-            int x1 = static_cast<int>(detectionMat.at<float>(i, 3) * image.cols);
-            int y1 = static_cast<int>(detectionMat.at<float>(i, 4) * image.rows);
-            int x2 = static_cast<int>(detectionMat.at<float>(i, 5) * image.cols);
-            int y2 = static_cast<int>(detectionMat.at<float>(i, 6) * image.rows);
-            rectangle(image, Point(x1, y1), Point(x2, y2), Scalar(0, 255, 0), 2, 4);
-        }
+vector<float> extractFaceFeatures(const Mat& image, const vector<FaceBox>& faces, Net& faceRecognitionModel) {
+    vector<float> faceFeatures;
+    for (const FaceBox& face : faces) {
+        // Ensure the bounding box fits within the frame
+        Rect faceRect = faceRectangle(face, image.size()) & Rect(0, 0, image.cols, image.rows);
+        if (faceRect.empty()) continue;
+
+        // Extract the face ROI and resize it for the face feature extractor input
+        Mat faceROI = image(faceRect).clone();
+        resize(faceROI, faceROI, Size(96, 96));
+
+        // Add the embeddings of this face to the faceFeatures vector
+        vector<float> faceEmbeddings = getFaceEmbeddings(faceROI, faceRecognitionModel);
+        faceFeatures.insert(faceFeatures.end(), faceEmbeddings.begin(), faceEmbeddings.end());
     }
+    return faceFeatures;
 }
-/**
-* @brief Save feature vectors to a CSV file.
-*
-* @param csvFilePath The path to the CSV file.
-* @param featureVectors The feature vectors to be saved.
-* @param imagePaths The corresponding image paths.
-*/
-void saveFeatureVectorsFaceToCSV(const std::string& csvFilePath, const std::vector<std::vector<float>>& featureVectors, const std::vector<std::string>& imagePaths) {
-    std::ofstream file(csvFilePath, std::ofstream::out | std::ofstream::app); // Open in append mode
 
-    for (size_t i = 0; i < featureVectors.size(); ++i) {
-        file << imagePaths[i];
-        for (const auto& feature : featureVectors[i]) {
-            file << "," << feature;
+
+/**
+ * @brief Highlights faces in the input image.
+ *
+ * @param image The input image.
+ * @param faces The faces detected in the image; only confident detections are drawn.
+ */
+void highlightFaces(Mat& image, const vector<FaceBox>& faces) {
+    for (const FaceBox& face : faces) {
+        if (face.confidence > FACE_HIGHLIGHT_CONFIDENCE) {
+            rectangle(image, faceRectangle(face, image.size()), Scalar(0, 255, 0), 2, 4);
         }
-        file << "\n"; // 
     }
-
-    file.close();
 }
-
 /**
-* @brief Calculate the custom design feature vector with face detection for an image and return it.
+* @brief Calculate the custom design feature vector with face detection for an image whose DNN features are already computed.
 *
 * @param image The input image.
+* @param dnnOutput The DenseNet-121 output for the image, e.g. one row of a batched forward pass.
+* @param detectedFaces If not null, receives the faces that were detected and embedded.
 * @return The custom design feature vector with face detection.
 */
-std::vector<float> extractCustomDesignFaceFeatureVector(const cv::Mat& image) {
-    std::string baseDir = GetCurrentExecutableDirectoryFace();
-
-    std::string modelPath = baseDir + "\\models\\DenseNet_121.prototxt";
-    std::string configPath = baseDir + "\\models\\DenseNet_121.caffemodel";
-
-    std::string faceDetectorModelPath = baseDir + "\\models\\deploy.prototxt";
-    std::string faceDetectorConfigPath = baseDir + "\\models\\res10_300x300_ssd_iter_140000_fp16.caffemodel";
-
-    std::string faceRecognitionModelPath = baseDir + "\\models\\openface.nn4.small2.v1.t7";
-
-    vector<float> colorHist = normalizeVectorFace(extractColorHistogramFace(image));
-    vector<float> textureFeatures = normalizeVectorFace(extractLBPFeaturesFace(image));
-    vector<float> dnnFeatures = normalizeVectorFace(extractDNNFeaturesFace(image, modelPath, configPath, Size(224, 224), Scalar(104, 117, 123), true));
-
-
-    // Load face detection model
-    Net faceNet = readNet(faceDetectorModelPath, faceDetectorConfigPath);
-
-    // Load the face recognition model
-    Net faceRecognitionModel = readNetFromTorch(faceRecognitionModelPath);
-
-    // Extract face features
-    vector<float> faceFeatures = extractFaceFeatures(image, faceNet, faceRecognitionModel);
+std::vector<float> combineCustomDesignFaceFeatures(const cv::Mat& image, const std::vector<float>& dnnOutput,
+    std::vector<FaceBox>* detectedFaces = nullptr) {
+    vector<float> colorHist = normalizeVector(extractColorHistogramFace(image));
+    vector<float> textureFeatures = normalizeVector(extractLBPFeaturesFace(image));
+    vector<float> dnnFeatures = normalizeVector(dnnOutput);
+
+    // Extract face features with the face detection and recognition models of the registry
+    DnnNetLease faceNet(DnnModel::FaceDetector);
+    DnnNetLease faceRecognitionModel(DnnModel::FaceEmbedding);
+    vector<FaceBox> faces = detectFaces(image, faceNet.net(), FACE_EMBEDDING_CONFIDENCE);
+    vector<float> faceFeatures = extractFaceFeatures(image, faces, faceRecognitionModel.net());
+    if (detectedFaces) *detectedFaces = std::move(faces);
 
     // Combine all features into a single feature vector
     vector<float> combinedFeatures;
@@ -339,48 +242,24 @@ std::vector<float> extractCustomDesignFaceFeatureVector(const cv::Mat& image) {
 }
 
 /**
-* @brief Split a string by a delimiter.
+* @brief Calculate the custom design feature vector with face detection for an image and return it.
 *
-* @param s The input string to be split.
-* @param delimiter The delimiter character.
-* @return A vector containing the split substrings.
+* @param image The input image.
+* @return The custom design feature vector with face detection.
 */
-std::vector<std::string> splitFace(const std::string& s, char delimiter) {
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter)) {
-        tokens.push_back(token);
-    }
-    return tokens;
+std::vector<float> extractCustomDesignFaceFeatureVector(const cv::Mat& image) {
+    return combineCustomDesignFaceFeatures(image, extractDNNFeaturesFace(image));
 }
 
-
 /**
-* @brief Read feature vectors from a CSV file.
-*
-* @param csvFilePath The path to the CSV file.
-* @return A vector of pairs containing image paths and corresponding feature vectors.
-*/
-std::vector<std::pair<std::string, std::vector<float>>> readFeatureVectorsFaceFromCSV(const std::string& csvFilePath) {
-    std::vector<std::pair<std::string, std::vector<float>>> featureVectors;
-    std::ifstream file(csvFilePath);
-    std::string line;
-
-    while (std::getline(file, line)) {
-        auto tokens = splitFace(line, ',');
-        if (tokens.size() > 1) {
-            std::string imagePath = tokens[0];
-            std::vector<float> features(tokens.size() - 1, 0.0f);
-            for (size_t i = 1; i < tokens.size(); ++i) {
-                features[i - 1] = std::stof(tokens[i]);
-            }
-            featureVectors.push_back({ imagePath, features });
-        }
+ * @brief Extractor for the search engine: the custom design feature vector with face embeddings of an image.
+ */
+struct CustomDesignFaceExtractor {
+    bool operator()(const cv::Mat& image, std::vector<float>& features) const {
+        features = extractCustomDesignFaceFeatureVector(image);
+        return true;
     }
-
-    return featureVectors;
-}
+};
 
 /**
  * @brief Performs content-based image retrieval (CBIR) with custom-designed features and face detection.
@@ -391,58 +270,67 @@ std::vector<std::pair<std::string, std::vector<float>>> readFeatureVectorsFaceFr
  * @return std::vector<std::pair<cv::Mat, std::string>> A vector of pairs, each containing a processed image and its file path.
  */
 std::vector<std::pair<cv::Mat, std::string>> performCustomDesignFaceCbir(const std::string& featureVectorCSVPath, const std::string& targetImageFile, int topN) {
-    // Load the target image
-    cv::Mat targetImage = cv::imread(targetImageFile, cv::IMREAD_COLOR);
-    if (targetImage.empty()) {
-        std::cerr << "Error loading target image." << std::endl;
+    // Rows hold one embedding per detected face and are zero padded to the widest row, so the
+    // target vector is padded (or cut) to the same width. The closest images are found on all scan threads.
+    SearchOptions options;
+    options.padQuery = true;
+    const Searcher<CustomDesignFaceExtractor, EuclideanMetric> searcher(CustomDesignFaceExtractor(), options);
+    const SearchResults results = searcher.search(targetImageFile, featureVectorCSVPath, topN);
+    if (!results.index) {
         return {};
     }
 
-    std::string baseDir = GetCurrentExecutableDirectoryFace();
-
-    std::string faceDetectorModelPath = baseDir + "\\models\\deploy.prototxt";
-    std::string faceDetectorConfigPath = baseDir + "\\models\\res10_300x300_ssd_iter_140000_fp16.caffemodel";
-
-    // Load face detection model
-    Net faceNet = readNet(faceDetectorModelPath, faceDetectorConfigPath);
-
-    // Extract the feature vector for the target image
-    std::vector<float> targetFeatureVector = extractCustomDesignFaceFeatureVector(targetImage);
-
-    // Read the precomputed feature vectors from the CSV file
-    auto featureVectors = readFeatureVectorsFaceFromCSV(featureVectorCSVPath);
-
-    // Compute distances between the target image and each image in the dataset
-    std::vector<std::pair<float, std::string>> distances;
-    for (const auto& [imagePath, features] : featureVectors) {
-        // Skip comparison if the current image is the target image
-        if (std::filesystem::path(imagePath).filename() == std::filesystem::path(targetImageFile).filename()) {
-            continue; // Skip this image
-        }
-
-        float distance = euclideanDistanceFace(targetFeatureVector, features);
-        distances.push_back({ distance, imagePath });
-    }
-
-    // Sort images by ascending distance
-    std::sort(distances.begin(), distances.end(), [](const auto& a, const auto& b) {
-        return a.first < b.first;
-        });
-
-    // Highlight faces and collect top N matches
+    // Highlight the faces found when the matches were indexed; no detection runs on them here
+    const FaceBoxesHandle faceBoxes = openFaceBoxes(featureVectorCSVPath);
     std::vector<std::pair<cv::Mat, std::string>> topMatches;
-    for (int i = 0; i < std::min(topN, static_cast<int>(distances.size())); ++i) {
-        cv::Mat image = cv::imread(distances[i].second, cv::IMREAD_COLOR);
-        highlightFaces(image, faceNet); 
-        topMatches.push_back({ image, distances[i].second });
+    for (const std::string& imagePath : results.paths()) {
+        cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
+        auto faces = faceBoxes->find(imagePath);
+        if (!image.empty() && faces != faceBoxes->end()) highlightFaces(image, faces->second);
+        topMatches.push_back({ image, imagePath });
     }
 
     return topMatches;
 }
 
+/**
+* @brief Saves the face boxes of every image of a newly indexed feature file.
+*
+* Boxes come from this run's detections, or from the previous face box file for rows the indexer
+* reused. Images found in neither (e.g. rows of a file indexed before boxes were stored) are
+* detected here, so queries never have to.
+*
+* @param featureFile The feature file that was just written.
+* @param detected Faces detected while indexing, by image path.
+* @param previous Faces stored with the previous feature file, by image path.
+*/
+static void saveIndexedFaceBoxes(const std::string& featureFile, const FaceBoxMap& detected, const FaceBoxMap& previous) {
+    const FeatureIndexHandle index = openFeatureIndex(featureFile);
+    std::unique_ptr<DnnNetLease> faceNet;
+    FaceBoxMap boxes;
+    for (std::size_t i = 0; i < index->features.rows(); ++i) {
+        const std::string& imagePath = index->features.path(i);
+        auto faces = detected.find(imagePath);
+        if (faces != detected.end()) {
+            boxes[imagePath] = faces->second;
+            continue;
+        }
+        faces = previous.find(imagePath);
+        if (faces != previous.end()) {
+            boxes[imagePath] = faces->second;
+            continue;
+        }
 
-
-
+        cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "Could not read the image: " << imagePath << std::endl;
+            continue;
+        }
+        if (!faceNet) faceNet.reset(new DnnNetLease(DnnModel::FaceDetector));
+        boxes[imagePath] = detectFaces(image, faceNet->net(), FACE_EMBEDDING_CONFIDENCE);
+    }
+    saveFaceBoxes(faceBoxesPath(featureFile), boxes);
+}
 
 /**
 * @brief Perform custom design with FAce detection calculation and save feature vectors to a CSV file.
@@ -452,24 +340,36 @@ std::vector<std::pair<cv::Mat, std::string>> performCustomDesignFaceCbir(const s
 */
 void performCustomDesignCalculationFace(const std::string& directory, const std::string& outputFile)
 {
-    std::vector<std::vector<float>> featureVectors;
-    std::vector<std::string> imagePaths;
-
-    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
-        if (entry.path().extension() == ".jpg") {
-            std::string imagePath = entry.path().string();
-            cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
-            if (!image.empty()) {
-                std::vector<float> featureVector = extractCustomDesignFaceFeatureVector(image);
-
-                featureVectors.push_back(featureVector);
-                imagePaths.push_back(imagePath);
-            }
+    try {
+        FeatureStoreInfo info;
+        info.type = FeatureType::CustomDesignFace;
+        info.binsPerChannel = 8;
+
+        // Faces stored with the previous output cover the rows the indexer reuses
+        FaceBoxMap previousFaces;
+        try {
+            previousFaces = loadFaceBoxes(faceBoxesPath(outputFile));
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Ignoring stored face boxes: " << e.what() << std::endl;
         }
-    }
 
-    // Save extracted feature vectors to a CSV file
-    saveFeatureVectorsFaceToCSV(outputFile, featureVectors, imagePaths);
+        // Only new or changed images are processed; unchanged rows are copied from the previous output.
+        // DenseNet-121 runs once per batch of images; faces are still detected and embedded per image,
+        // and their boxes are kept so queries can highlight them without detecting them again.
+        FaceBoxMap detectedFaces;
+        auto combine = [&detectedFaces](const std::string& imagePath, const cv::Mat& image, const std::vector<float>& dnnRow) {
+            std::vector<FaceBox> faces;
+            std::vector<float> features = combineCustomDesignFaceFeatures(image, dnnRow, &faces);
+            detectedFaces[imagePath] = std::move(faces);
+            return features;
+        };
+        indexImageDirectory(directory, outputFile, info, dnnBatchExtractor(DnnModel::DenseNet121, combine), dnnBatchSize(DnnModel::DenseNet121));
+        saveIndexedFaceBoxes(outputFile, detectedFaces, previousFaces);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to save feature vectors: " << e.what() << std::endl;
+    }
 }
 
 
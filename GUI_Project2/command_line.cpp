@@ -0,0 +1,440 @@
+/*! \file command_line.cpp
+    \brief Implements the command-line (non-GUI) mode of the CBIR system.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. It parses the arguments
+    passed to the executable and dispatches them to the matching maintenance command.
+*/
+
+#include "command_line.h"
+#include "batch_search.h"
+#include "distance_kernels.h"
+#include "dnn_models.h"
+#include "feature_store.h"
+#include "feature_utils.h"
+#include "hnsw_index.h"
+#include "ivfpq_index.h"
+#include "parallel_scan.h"
+#include "vp_tree.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+/**
+ * @brief Attaches the process to the console it was started from, so output is visible for a GUI-subsystem executable.
+ */
+static void attachParentConsole() {
+#ifdef _WIN32
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        FILE* stream = nullptr;
+        freopen_s(&stream, "CONOUT$", "w", stdout);
+        freopen_s(&stream, "CONOUT$", "w", stderr);
+        std::cout.clear();
+        std::cerr.clear();
+    }
+#endif
+}
+
+/**
+ * @brief Prints the supported commands.
+ */
+static void printUsage() {
+    std::cerr << "Usage:\n"
+        << "  CBIR [--threads <count>] --convert <csvFile> <storeFile> <featureType> [binsPerChannel] [textureBins]\n"
+        << "  CBIR [--threads <count>] [--dnn-precision <precision>] --index <featureType> <imageDirectory> <outputFile> [binsPerChannel] [textureBins]\n"
+        << "  CBIR [--threads <count>] --batch <featureType> <queryFeatureFile> <databaseFeatureFile> <outputCsv> [topN]\n"
+        << "  CBIR [--threads <count>] --build-hnsw <embeddingFile> [M] [efConstruction]\n"
+        << "  CBIR [--threads <count>] --build-ivfpq <featureFile> <featureType> [codeBytes] [lists]\n"
+        << "  CBIR [--threads <count>] --build-vptree <featureFile>\n"
+        << "  CBIR [--threads <count>] [--dnn-precision <precision>] --dnn-benchmark <imageDirectory> [batchSize...]\n"
+        << "  CBIR [--threads <count>] --dnn-precision-check <imageDirectory> [topK] [maxImages]\n"
+        << "  CBIR [--threads <count>] --query <featureType> <targetImage> <featureFile> [topN] [queryOptions...]\n"
+        << "  CBIR --self-test\n"
+        << "      featureType: baseline, histogram, multihistogram, texturecolor, dnn, custom, customface\n"
+        << "      --threads: threads used to scan feature collections; 0 (the default) uses all cores\n"
+        << "      --dnn-precision: fp32 (the default), fp16 or int8 (calibrated on the \"calibration\" images of the model directory)\n"
+        << "      queryOptions: --bins <count> --texture-bins <count>\n"
+        << "                    dnn, custom: --precision <fp32|fp16|bf16|int8> --rescore <count> --ivf-probes <lists>\n"
+        << "                    dnn: --hnsw-ef <ef> --hnsw-m <M> --hnsw-ef-construction <efConstruction>\n"
+        << "                    texturecolor: --vptree --max-distances <count>\n"
+        << "                    histogram, texturecolor: --cascade --shortlist <count>\n";
+}
+
+/**
+ * @brief Handles --convert: converts a CSV feature file into a binary feature store.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runConvert(const std::vector<std::string>& args) {
+    if (args.size() < 4) {
+        printUsage();
+        return 1;
+    }
+
+    FeatureStoreInfo info;
+    info.type = parseFeatureType(args[3]);
+    if (info.type == FeatureType::Unknown) {
+        std::cerr << "Unknown feature type: " << args[3] << std::endl;
+        return 1;
+    }
+    if (args.size() > 4) info.binsPerChannel = static_cast<std::uint32_t>(std::stoul(args[4]));
+    if (args.size() > 5) info.textureBins = static_cast<std::uint32_t>(std::stoul(args[5]));
+
+    return convertCsvToFeatureStore(args[1], args[2], info) == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Handles --batch: finds the best matches of every query row in a collection and writes them to a CSV file.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runBatch(const std::vector<std::string>& args) {
+    if (args.size() < 5) {
+        printUsage();
+        return 1;
+    }
+
+    const FeatureType type = parseFeatureType(args[1]);
+    if (type == FeatureType::Unknown) {
+        std::cerr << "Unknown feature type: " << args[1] << std::endl;
+        return 1;
+    }
+    BatchSearchOptions options;
+    if (args.size() > 5) options.topK = std::stoul(args[5]);
+
+    return runBatchSearch(args[2], args[3], args[4], type, options) == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Handles --index: computes the features of every image in a directory and writes them to a feature file.
+ *
+ * Like the GUI, an existing output file is updated incrementally. DNN models run at the precision
+ * set with --dnn-precision.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runIndex(const std::vector<std::string>& args) {
+    if (args.size() < 4) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string& directory = args[2];
+    const std::string& outputFile = args[3];
+    const int bins = args.size() > 4 ? std::stoi(args[4]) : 8;
+    const int textureBins = args.size() > 5 ? std::stoi(args[5]) : 16;
+    switch (parseFeatureType(args[1])) {
+    case FeatureType::Baseline:
+        performBaselineCalculation(directory, outputFile);
+        break;
+    case FeatureType::Histogram:
+        performHistogramCalculation(directory, bins, outputFile);
+        break;
+    case FeatureType::MultiHistogram:
+        performMultiHistogramCalculationTask(directory, bins, outputFile);
+        break;
+    case FeatureType::TextureColor:
+        performTextureAndColorCalculationTask(directory, bins, textureBins, outputFile);
+        break;
+    case FeatureType::DeepEmbedding:
+        performDeepEmbeddingCalculation(directory, outputFile);
+        break;
+    case FeatureType::CustomDesign:
+        performCustomDesignCalculation(directory, outputFile);
+        break;
+    case FeatureType::CustomDesignFace:
+        performCustomDesignCalculationFace(directory, outputFile);
+        break;
+    default:
+        std::cerr << "Unknown feature type: " << args[1] << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Handles --build-hnsw: builds the HNSW index of an embedding file and saves it next to the file.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runBuildHnsw(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        printUsage();
+        return 1;
+    }
+
+    HnswParameters parameters;
+    if (args.size() > 2) parameters.M = static_cast<std::uint32_t>(std::stoul(args[2]));
+    if (args.size() > 3) parameters.efConstruction = static_cast<std::uint32_t>(std::stoul(args[3]));
+
+    buildHnswIndex(args[1], hnswIndexPath(args[1]), parameters);
+    return 0;
+}
+
+/**
+ * @brief Handles --build-ivfpq: builds the IVF-PQ index of the DNN embeddings in a feature file.
+ *
+ * Deep embedding files are indexed whole; custom design files index their "dnn" slice.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runBuildIvfPq(const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        printUsage();
+        return 1;
+    }
+
+    const FeatureType type = parseFeatureType(args[2]);
+    if (type != FeatureType::DeepEmbedding && type != FeatureType::CustomDesign) {
+        std::cerr << "IVF-PQ indexes are built for dnn and custom feature files, not " << args[2] << std::endl;
+        return 1;
+    }
+    const std::string component = type == FeatureType::DeepEmbedding ? "features" : "dnn";
+
+    IvfPqParameters parameters;
+    if (args.size() > 3) parameters.codeBytes = static_cast<std::uint32_t>(std::stoul(args[3]));
+    if (args.size() > 4) parameters.lists = static_cast<std::uint32_t>(std::stoul(args[4]));
+
+    buildIvfPqIndex(args[1], component, type, ivfPqIndexPath(args[1], component), parameters);
+    return 0;
+}
+
+/**
+ * @brief Handles --build-vptree: builds the vantage-point tree of a texture and color feature file.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runBuildVpTree(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        printUsage();
+        return 1;
+    }
+
+    buildVpTree(args[1], vpTreePath(args[1]));
+    return 0;
+}
+
+/**
+ * @brief Handles --dnn-benchmark: measures DenseNet-121 throughput at several batch sizes.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runDnnBenchmark(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::size_t> batchSizes;
+    for (std::size_t i = 2; i < args.size(); ++i) {
+        batchSizes.push_back(static_cast<std::size_t>(std::stoul(args[i])));
+    }
+    if (batchSizes.empty()) batchSizes = { 1, 8, 32, 64 };
+
+    benchmarkDnnThroughput(DnnModel::DenseNet121, args[1], batchSizes);
+    return 0;
+}
+
+/**
+ * @brief Handles --dnn-precision-check: compares DenseNet-121 and the face detection and embedding
+ * models at fp16 and int8 with fp32 on sample images.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code; 1 if any model could not be checked.
+ */
+static int runDnnPrecisionCheck(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        printUsage();
+        return 1;
+    }
+
+    const std::size_t topK = args.size() > 2 ? static_cast<std::size_t>(std::stoul(args[2])) : 10;
+    const std::size_t maxImages = args.size() > 3 ? static_cast<std::size_t>(std::stoul(args[3])) : 200;
+    int exitCode = 0;
+    for (DnnModel model : { DnnModel::DenseNet121, DnnModel::FaceDetector, DnnModel::FaceEmbedding }) {
+        try {
+            checkDnnPrecision(model, args[1], { DnnPrecision::FP32, DnnPrecision::FP16, DnnPrecision::INT8 }, topK, maxImages);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Precision check of " << dnnModelSpec(model).name << " failed: " << e.what() << std::endl;
+            exitCode = 1;
+        }
+    }
+    return exitCode;
+}
+
+/**
+ * @brief Handles --query: finds the best matches of one image in a feature file and prints their paths, best first.
+ *
+ * Options after the positional arguments select the histogram sizes the feature file was written with
+ * and how embeddings are searched.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code.
+ */
+static int runQuery(const std::vector<std::string>& args) {
+    std::vector<std::string> positional;
+    int bins = 8;
+    int textureBins = 16;
+    EmbeddingSearchOptions embeddingOptions;
+    VpTreeSearchOptions treeOptions;
+    HistogramCascadeOptions cascadeOptions;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+        if (arg == "--vptree") {
+            treeOptions.useTree = true;
+            continue;
+        }
+        if (arg == "--cascade") {
+            cascadeOptions.useCascade = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        const std::string& value = args[++i];
+        if (arg == "--bins") bins = std::stoi(value);
+        else if (arg == "--texture-bins") textureBins = std::stoi(value);
+        else if (arg == "--precision") embeddingOptions.precision = parseEmbeddingPrecision(value);
+        else if (arg == "--rescore") embeddingOptions.rescoreCandidates = std::stoul(value);
+        else if (arg == "--hnsw-ef") embeddingOptions.hnswEfSearch = std::stoul(value);
+        else if (arg == "--hnsw-m") embeddingOptions.hnswM = static_cast<std::uint32_t>(std::stoul(value));
+        else if (arg == "--hnsw-ef-construction") embeddingOptions.hnswEfConstruction = static_cast<std::uint32_t>(std::stoul(value));
+        else if (arg == "--ivf-probes") embeddingOptions.ivfProbes = std::stoul(value);
+        else if (arg == "--max-distances") treeOptions.maxDistanceEvaluations = std::stoul(value);
+        else if (arg == "--shortlist") cascadeOptions.shortlist = std::stoul(value);
+        else {
+            std::cerr << "Unknown query option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (positional.size() < 3) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string& target = positional[1];
+    const std::string& featureFile = positional[2];
+    const int topN = positional.size() > 3 ? std::stoi(positional[3]) : 10;
+
+    std::vector<std::string> results;
+    switch (parseFeatureType(positional[0])) {
+    case FeatureType::Baseline:
+        results = performBaselineMatching(target, topN, featureFile);
+        break;
+    case FeatureType::Histogram:
+        results = performHistogramMatching(target, topN, bins, featureFile, cascadeOptions);
+        break;
+    case FeatureType::MultiHistogram:
+        results = performMultiHistogramMatchingTask(target, topN, bins, featureFile);
+        break;
+    case FeatureType::TextureColor:
+        results = performTextureAndColorMatchingTask(target, topN, bins, textureBins, featureFile, treeOptions, cascadeOptions);
+        break;
+    case FeatureType::DeepEmbedding:
+        results = performdeepNetworkEmbeddingsMatching(target, topN, featureFile, embeddingOptions);
+        break;
+    case FeatureType::CustomDesign:
+        results = performCustomDesignCbir(target, featureFile, topN, embeddingOptions);
+        break;
+    case FeatureType::CustomDesignFace:
+        for (const auto& match : performCustomDesignFaceCbir(featureFile, target, topN)) {
+            results.push_back(match.second);
+        }
+        break;
+    default:
+        std::cerr << "Unknown feature type: " << positional[0] << std::endl;
+        return 1;
+    }
+
+    for (const std::string& path : results) {
+        std::cout << path << "\n";
+    }
+    std::cout.flush();
+    return 0;
+}
+
+/**
+ * @brief Handles --self-test: checks every SIMD distance kernel set the CPU supports against the scalar kernels.
+ *
+ * @return The process exit code; 1 if any kernel set disagrees with the scalar results.
+ */
+static int runSelfTest() {
+    if (!verifyDistanceKernels()) {
+        std::cerr << "Distance kernel self-test failed: a SIMD kernel set disagrees with the scalar kernels" << std::endl;
+        return 1;
+    }
+    std::cout << "Distance kernel self-test passed; using " << distanceKernelName() << " kernels" << std::endl;
+    return 0;
+}
+
+int runCommandLine(const std::vector<std::string>& arguments) {
+    attachParentConsole();
+    selectDistanceKernels(); // Reports a kernel set that fails its self-check before any command runs
+
+    std::vector<std::string> args = arguments;
+    try {
+        // Global options come before the command
+        while (args.size() >= 2 && (args[0] == "--threads" || args[0] == "--dnn-precision")) {
+            if (args[0] == "--threads") {
+                setScanThreadCount(static_cast<unsigned>(std::stoul(args[1])));
+            }
+            else {
+                DnnRuntimeOptions options = dnnModelOptions();
+                if (!parseDnnPrecision(args[1], options.precision)) {
+                    std::cerr << "Invalid precision: " << args[1] << std::endl;
+                    return 1;
+                }
+                configureDnnModels(options);
+            }
+            args.erase(args.begin(), args.begin() + 2);
+        }
+    }
+    catch (const std::exception&) {
+        std::cerr << "Invalid thread count: " << args[1] << std::endl;
+        return 1;
+    }
+
+    if (args.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    try {
+        if (args[0] == "--convert") return runConvert(args);
+        if (args[0] == "--batch") return runBatch(args);
+        if (args[0] == "--index") return runIndex(args);
+        if (args[0] == "--build-hnsw") return runBuildHnsw(args);
+        if (args[0] == "--build-ivfpq") return runBuildIvfPq(args);
+        if (args[0] == "--build-vptree") return runBuildVpTree(args);
+        if (args[0] == "--dnn-benchmark") return runDnnBenchmark(args);
+        if (args[0] == "--dnn-precision-check") return runDnnPrecisionCheck(args);
+        if (args[0] == "--query") return runQuery(args);
+        if (args[0] == "--self-test") return runSelfTest();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,47 @@
+/*! \file command_line.h
+    \brief Declarations for the command-line (non-GUI) mode of the CBIR system.
+    \author Manushi
+    \date October 16, 2026
+
+    When the executable is started with arguments it runs the requested maintenance or batch
+    command and exits instead of opening the GUI.
+*/
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Runs a command-line command.
+ *
+ * Supported commands:
+ *   --convert <csvFile> <storeFile> <featureType> [binsPerChannel] [textureBins]
+ *   --index <featureType> <imageDirectory> <outputFile> [binsPerChannel] [textureBins]   (defaults 8 and 16)
+ *   --batch <featureType> <queryFeatureFile> <databaseFeatureFile> <outputCsv> [topN]
+ *   --build-hnsw <embeddingFile> [M] [efConstruction]
+ *   --build-ivfpq <featureFile> <featureType> [codeBytes] [lists]
+ *   --build-vptree <featureFile>
+ *   --dnn-benchmark <imageDirectory> [batchSize...]   (default batch sizes 1 8 32 64)
+ *   --dnn-precision-check <imageDirectory> [topK] [maxImages]   (DenseNet-121 and the face detection and embedding models)
+ *   --query <featureType> <targetImage> <featureFile> [topN] [options]   (prints the best matches, default top 10)
+ *       --bins <count>, --texture-bins <count>   Histogram sizes of the feature file (defaults 8 and 16)
+ *       --precision <fp32|fp16|bf16|int8>, --rescore <count>   Embedding codes and fp32 rescoring (dnn, custom)
+ *       --ivf-probes <lists>   Searches the IVF-PQ index of the DNN embeddings, probing this many lists (dnn, custom)
+ *       --hnsw-ef <ef>   Searches the HNSW index of the embedding file with this candidate list size (dnn)
+ *       --hnsw-m <M>, --hnsw-ef-construction <efConstruction>   Rebuilds the HNSW index first if it was built with other values (dnn)
+ *       --vptree, --max-distances <count>   Searches the vantage-point tree, optionally stopping after count distances (texturecolor)
+ *       --cascade, --shortlist <count>   Coarse-to-fine search, optionally scoring at most count images at full resolution (histogram, texturecolor)
+ *   --self-test   (exits with 1 if a SIMD distance kernel disagrees with the scalar kernels)
+ *
+ * Global options, given before the command:
+ *   --threads <count>   Threads used to scan feature collections; 0 uses one per hardware thread.
+ *   --dnn-precision <fp32|fp16|int8>   Precision the DNN models run at, for --index and --query too.
+ *
+ * @param args The command-line arguments, without the program name.
+ * @return The process exit code, 0 on success.
+ */
+int runCommandLine(const std::vector<std::string>& args);
+
+#endif // COMMAND_LINE_H
@@ -0,0 +1,94 @@
+/*! \file cpu_features.cpp
+    \brief Implements runtime CPU feature detection.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. It queries CPUID for the
+    instruction set extensions used by the SIMD kernels and XGETBV for the register state the
+    operating system preserves (AVX needs YMM state, AVX-512 additionally needs ZMM/opmask state).
+*/
+
+#include "cpu_features.h"
+#include <cstdint>
+#if CBIR_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+#if CBIR_X86
+/**
+ * @brief Runs CPUID for a leaf/subleaf and stores EAX, EBX, ECX, EDX in regs.
+ */
+void cpuid(int leaf, int subleaf, std::uint32_t regs[4]) {
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, leaf, subleaf);
+    for (int i = 0; i < 4; ++i) regs[i] = static_cast<std::uint32_t>(values[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/**
+ * @brief Reads extended control register 0 (the register state enabled by the OS).
+ */
+std::uint64_t readXcr0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    std::uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+/**
+ * @brief Queries the processor and operating system once.
+ */
+CpuFeatures detectCpuFeatures() {
+    CpuFeatures features;
+#if CBIR_X86
+    std::uint32_t regs[4];
+    cpuid(0, 0, regs);
+    const std::uint32_t maxLeaf = regs[0];
+    if (maxLeaf < 1) return features;
+
+    cpuid(1, 0, regs);
+    features.sse42 = (regs[2] >> 20) & 1;
+    const bool osxsave = (regs[2] >> 27) & 1;
+    const bool avxBit = (regs[2] >> 28) & 1;
+    const bool fmaBit = (regs[2] >> 12) & 1;
+    const bool f16cBit = (regs[2] >> 29) & 1;
+
+    const std::uint64_t xcr0 = osxsave ? readXcr0() : 0;
+    const bool ymmState = (xcr0 & 0x6) == 0x6;    // SSE and AVX state
+    const bool zmmState = (xcr0 & 0xE6) == 0xE6;  // plus opmask and ZMM state
+
+    features.avx = avxBit && ymmState;
+    features.fma = features.avx && fmaBit;
+    features.f16c = features.avx && f16cBit;
+
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, regs);
+        features.avx2 = features.avx && ((regs[1] >> 5) & 1);
+        features.avx512f = zmmState && ((regs[1] >> 16) & 1);
+        features.avx512bw = features.avx512f && ((regs[1] >> 30) & 1);
+        features.avx512vnni = features.avx512bw && ((regs[2] >> 11) & 1);
+    }
+#endif
+    return features;
+}
+
+} // namespace
+
+const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
@@ -0,0 +1,52 @@
+/*! \file cpu_features.h
+    \brief Declarations for runtime CPU feature detection.
+    \author Manushi
+    \date October 16, 2026
+
+    SIMD kernels are compiled for several instruction sets and the fastest one the running CPU
+    (and operating system) supports is picked at startup.
+*/
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+/**
+ * @brief Enables an instruction set for a single function on GCC/Clang; MSVC needs no annotation.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define CBIR_TARGET(features) __attribute__((target(features)))
+#else
+#define CBIR_TARGET(features)
+#endif
+
+/**
+ * @brief True when compiling for x86/x64, where the SIMD kernels are available.
+ */
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CBIR_X86 1
+#else
+#define CBIR_X86 0
+#endif
+
+/**
+ * @brief Instruction set extensions usable on the running machine.
+ */
+struct CpuFeatures {
+    bool sse42 = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vnni = false;
+};
+
+/**
+ * @brief Returns the detected CPU features; detection runs once on the first call.
+ *
+ * Extensions whose register state the operating system does not save are reported as absent.
+ */
+const CpuFeatures& cpuFeatures();
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,252 @@
+/*! \file csv_loader.cpp
+    \brief Implements the fast, parallel loader for CSV feature files.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. The file is read twice in
+    fixed-size blocks; the partial line at the end of a block is carried over to the next one,
+    so only one block of text is held at a time. Every block is cut into chunks that end on a
+    newline and the chunks are handled on the scan thread pool. The first pass counts the rows and
+    the widest row, so the matrix is allocated once at its final size. The second pass counts the
+    rows of each chunk, which gives every chunk its first row, and parses the chunks with
+    std::from_chars straight into their rows of the matrix.
+*/
+
+#include "csv_loader.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr std::size_t READ_BLOCK_SIZE = 16 * 1024 * 1024;
+
+/**
+ * @brief A newline-terminated piece of a block, and what a pass found in it.
+ */
+struct Chunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    std::size_t rows = 0;       // Lines with a comma
+    std::size_t maxCols = 0;    // Values in the widest row
+    std::size_t firstRow = 0;   // Matrix row of the chunk's first row
+    std::size_t shortRows = 0;  // Rows with fewer values than the matrix has columns
+};
+
+/**
+ * @brief Returns the end of the line starting at p, excluding the newline and a trailing carriage return.
+ */
+const char* lineEnd(const char* p, const char* end, const char*& next) {
+    const char* newline = std::find(p, end, '\n');
+    next = (newline == end) ? end : newline + 1;
+    if (newline > p && *(newline - 1) == '\r') --newline;
+    return newline;
+}
+
+/**
+ * @brief Skips the separator spacing and sign accepted in front of a value.
+ */
+const char* skipSpacing(const char* cursor, const char* end) {
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '+')) ++cursor;
+    return cursor;
+}
+
+/**
+ * @brief Parses the values after the path of one line, storing at most maxValues of them.
+ *
+ * An empty field at the end of the line (a trailing comma) is not a value; other empty or malformed
+ * fields are read as 0.
+ *
+ * @param comma The comma after the image path.
+ * @return The number of values in the line.
+ */
+std::size_t parseValues(const char* comma, const char* end, float* values, std::size_t maxValues) {
+    std::size_t cols = 0;
+    const char* cursor = comma;
+    while (cursor < end) {
+        cursor = skipSpacing(cursor + 1, end); // Skip the comma
+        if (cursor == end) break;
+        if (cols < maxValues) {
+            float value = 0.0f;
+            auto result = std::from_chars(cursor, end, value);
+            values[cols] = (result.ec == std::errc()) ? value : 0.0f;
+        }
+        ++cols;
+        cursor = std::find(cursor, end, ',');
+    }
+    return cols;
+}
+
+/**
+ * @brief First pass over a chunk: counts its rows and the values of its widest row.
+ *
+ * A line has one value per comma after the path, less an empty field after a trailing comma,
+ * which is what parseValues reads.
+ */
+void measureChunk(Chunk& chunk) {
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        const char* next;
+        const char* end = lineEnd(p, chunk.end, next);
+        const char* comma = std::find(p, end, ',');
+        if (comma != end) {
+            ++chunk.rows;
+            std::size_t cols = static_cast<std::size_t>(std::count(comma, end, ','));
+            const char* last = end;
+            while (last > comma && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '+')) --last;
+            if (last[-1] == ',') --cols;
+            chunk.maxCols = std::max(chunk.maxCols, cols);
+        }
+        p = next;
+    }
+}
+
+/**
+ * @brief Counts the lines of a chunk that hold a row (those with a comma).
+ */
+void countChunkRows(Chunk& chunk) {
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        const char* next;
+        const char* end = lineEnd(p, chunk.end, next);
+        if (std::find(p, end, ',') != end) ++chunk.rows;
+        p = next;
+    }
+}
+
+/**
+ * @brief Second pass over a chunk: parses its rows into the matrix, starting at chunk.firstRow.
+ */
+void parseChunk(Chunk& chunk, FeatureMatrix& matrix) {
+    std::size_t row = chunk.firstRow;
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        const char* next;
+        const char* end = lineEnd(p, chunk.end, next);
+        const char* comma = std::find(p, end, ',');
+        if (comma != end) {
+            matrix.path(row).assign(p, comma);
+            if (parseValues(comma, end, matrix.mutableRow(row), matrix.dims()) < matrix.dims()) ++chunk.shortRows;
+            ++row;
+        }
+        p = next;
+    }
+}
+
+/**
+ * @brief Cuts a block of complete lines into roughly equal chunks that each end just after a newline.
+ */
+std::vector<Chunk> splitBlock(const char* data, const char* dataEnd, std::size_t chunkCount) {
+    std::vector<Chunk> chunks;
+    const std::size_t targetSize = static_cast<std::size_t>(dataEnd - data) / chunkCount + 1;
+    for (const char* p = data; p < dataEnd;) {
+        const char* cut = (static_cast<std::size_t>(dataEnd - p) > targetSize) ? p + targetSize : dataEnd;
+        cut = std::find(cut, dataEnd, '\n');
+        if (cut != dataEnd) ++cut;
+        Chunk chunk;
+        chunk.begin = p;
+        chunk.end = cut;
+        chunks.push_back(chunk);
+        p = cut;
+    }
+    return chunks;
+}
+
+/**
+ * @brief Reads a file from the start in blocks of complete lines and hands each block, cut into chunks, to visit.
+ *
+ * @return False if the file could not be read.
+ */
+template <typename Visitor>
+bool forEachBlock(FILE* fp, unsigned threadCount, Visitor visit) {
+    if (std::fseek(fp, 0, SEEK_SET) != 0) return false;
+
+    std::vector<char> block;
+    std::size_t carried = 0;
+    bool endOfFile = false;
+    while (!endOfFile) {
+        block.resize(carried + READ_BLOCK_SIZE);
+        const std::size_t count = std::fread(block.data() + carried, 1, READ_BLOCK_SIZE, fp);
+        endOfFile = (count < READ_BLOCK_SIZE);
+        const std::size_t filled = carried + count;
+
+        // Hand over up to the last newline; the partial line after it is carried to the next block
+        std::size_t complete = filled;
+        if (!endOfFile) {
+            while (complete > 0 && block[complete - 1] != '\n') --complete;
+            if (complete == 0) {
+                // A single line longer than the block: keep reading until its newline
+                carried = filled;
+                continue;
+            }
+        }
+
+        std::vector<Chunk> chunks = splitBlock(block.data(), block.data() + complete, threadCount);
+        visit(chunks);
+
+        carried = filled - complete;
+        std::memmove(block.data(), block.data() + complete, carried);
+    }
+    return std::ferror(fp) == 0;
+}
+
+} // namespace
+
+int loadFeatureCsvParallel(const std::string& csvFilePath, FeatureMatrix& matrix, unsigned threadCount) {
+    FILE* fp = std::fopen(csvFilePath.c_str(), "rb");
+    if (!fp) {
+        std::cerr << "Unable to open feature file " << csvFilePath << std::endl;
+        return -1;
+    }
+
+    if (threadCount == 0) {
+        threadCount = scanThreadCount();
+    }
+
+    // First pass: the size of the matrix
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    bool readOk = forEachBlock(fp, threadCount, [&](std::vector<Chunk>& chunks) {
+        parallelFor(chunks.size(), [&chunks](std::size_t i) { measureChunk(chunks[i]); });
+        for (const Chunk& chunk : chunks) {
+            rows += chunk.rows;
+            cols = std::max(cols, chunk.maxCols);
+        }
+    });
+
+    // Second pass: every chunk parses into its own rows of the matrix
+    FeatureMatrix loaded(readOk ? rows : 0, readOk ? cols : 0);
+    std::size_t row = 0;
+    std::size_t shortRows = 0;
+    bool changed = false;
+    readOk = readOk && forEachBlock(fp, threadCount, [&](std::vector<Chunk>& chunks) {
+        parallelFor(chunks.size(), [&chunks](std::size_t i) { countChunkRows(chunks[i]); });
+        for (Chunk& chunk : chunks) {
+            chunk.firstRow = row;
+            row += chunk.rows;
+        }
+        if (changed || row > rows) {
+            changed = true;
+            return;
+        }
+        parallelFor(chunks.size(), [&chunks, &loaded](std::size_t i) { parseChunk(chunks[i], loaded); });
+        for (const Chunk& chunk : chunks) shortRows += chunk.shortRows;
+    });
+    std::fclose(fp);
+    if (!readOk) {
+        std::cerr << "Unable to read feature file " << csvFilePath << std::endl;
+        return -1;
+    }
+    if (changed || row != rows) {
+        std::cerr << "Feature file changed while it was read: " << csvFilePath << std::endl;
+        return -1;
+    }
+
+    if (shortRows > 0) {
+        std::cerr << "Warning: " << shortRows << " of " << rows << " rows in " << csvFilePath
+                  << " have fewer than " << cols << " values and were zero padded" << std::endl;
+    }
+    matrix = std::move(loaded);
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*! \file csv_loader.h
+    \brief Declarations for the fast, parallel loader for CSV feature files.
+    \author Manushi
+    \date October 16, 2026
+
+    The loader reads a CSV feature file (image path in the first column, floats in the others)
+    in fixed-size blocks, splits every block on line boundaries into one chunk per scan thread,
+    and handles the chunks on the scan thread pool before the next block is read. A counting
+    pass sizes the matrix, then a second pass parses every row in place.
+*/
+
+#ifndef CSV_LOADER_H
+#define CSV_LOADER_H
+
+#include "feature_matrix.h"
+#include <string>
+
+/**
+ * @brief Loads a CSV feature file using the scan threads.
+ *
+ * Both the "," and ", " separators written by the different precompute tasks are accepted,
+ * as are LF and CRLF line endings. Lines without a comma are skipped, and so is an empty field
+ * after a trailing comma. Rows shorter than the widest row are zero padded, with a warning giving
+ * the number of such rows.
+ *
+ * @param csvFilePath Path to the CSV feature file.
+ * @param matrix Receives the image paths and the feature rows.
+ * @param threadCount Number of chunks each block is split into; 0 uses one per scan thread.
+ * @return 0 on success, a non-zero value if the file cannot be read.
+ */
+int loadFeatureCsvParallel(const std::string& csvFilePath, FeatureMatrix& matrix, unsigned threadCount = 0);
+
+#endif // CSV_LOADER_H
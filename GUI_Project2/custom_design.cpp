@@ -12,16 +12,22 @@
 #include <vector>
 #include <iostream>
 #include <numeric>
+#include <cmath>
 #include <algorithm> 
 #include <filesystem>
 #include <fstream>
 #include <sstream>
+#include "distance_kernels.h"
+#include "dnn_models.h"
 #include "feature_utils.h"
 #include "csv_util.h"  
-#define NOMINMAX
-#include <windows.h>
-#include <Shlwapi.h> 
-#pragma comment(lib, "Shlwapi.lib")
+#include "feature_store.h"
+#include "feature_index.h"
+#include "feature_indexer.h"
+#include "quantized_embeddings.h"
+#include "ivfpq_index.h"
+#include "parallel_scan.h"
+#include "search_engine.h"
 #include <string>
 #include <cstring>
 
@@ -30,43 +36,16 @@ using namespace cv;
 using namespace std;
 using namespace cv::dnn;
 
-struct FeatureVector {
-    vector<float> sunsetColorHistogram; // Emphasizing sunset colors
-    vector<float> textureFeatures;
-    vector<float> dnnFeatures;
-    vector<float> edgeFeatures; // New: for horizon line detection
-};
-
-/**
-* @brief Normalize a vector.
-* @param v The vector to be normalized.
-* @return The normalized vector.
-*/
-vector<float> normalizeVector(const vector<float>& v) {
-    vector<float> nv(v.size());
-    float norm = sqrt(std::inner_product(v.begin(), v.end(), v.begin(), 0.0f));
-    if (norm > 0) {
-        std::transform(v.begin(), v.end(), nv.begin(), [norm](float val) { return val / norm; });
-    }
-    return nv;
-}
-
-
 /**
-* @brief Calculate the Euclidean distance between two feature vectors.
-* 
-* @param featureVec1 The first feature vector.
-* @param featureVec2 The second feature vector.
+* @brief Calculate the Euclidean distance between two feature vectors stored in place, such as feature matrix rows.
+*
+* @param featureVec1 Pointer to the first feature vector.
+* @param featureVec2 Pointer to the second feature vector.
+* @param count Number of values in each vector.
 * @return The Euclidean distance between the two feature vectors.
 */
-float euclideanDistance(const std::vector<float>& featureVec1, const std::vector<float>& featureVec2) {
-    std::cout << "FeatureVec1 size: " << featureVec1.size() << ", FeatureVec2 size: " << featureVec2.size() << std::endl;
-    assert(featureVec1.size() == featureVec2.size());
-    float distance = 0.0f;
-    for (size_t i = 0; i < featureVec1.size(); ++i) {
-        distance += std::pow(featureVec1[i] - featureVec2[i], 2);
-    }
-    return std::sqrt(distance);
+float euclideanDistance(const float* featureVec1, const float* featureVec2, size_t count) {
+    return std::sqrt(squaredL2Distance(featureVec1, featureVec2, count));
 }
 
 /**
@@ -181,97 +160,27 @@ vector<float> extractLBPFeatures(const Mat& image) {
 }
 
 /**
-* @brief Calculate the distance between two feature vectors, considering different feature weights.
-* 
-* @param features1 The first feature vector.
-* @param features2 The second feature vector.
-* @return The distance between the two feature vectors.
-*/
-vector<float> extractDNNFeatures(const Mat& image, const string& modelPath, const string& configPath, const Size& inputSize, const Scalar& meanVal, bool swapRB) {
-    Net net = readNet(modelPath, configPath);
-    Mat blob;
-    blobFromImage(image, blob, 1.0, inputSize, meanVal, swapRB, false);
-    net.setInput(blob);
-    Mat dnnOutput = net.forward();
-
-    // Convert dnnOutput to a flat vector
-    vector<float> features(dnnOutput.size[1]);
-    memcpy(features.data(), dnnOutput.data, dnnOutput.total() * sizeof(float));
-    return features;
-}
-
-/**
-* @brief Calculate the distance between two feature vectors, considering different feature weights.
-* 
-* @param features1 The first feature vector.
-* @param features2 The second feature vector.
-* @return The distance between the two feature vectors.
-*/
-float calculateDistance(const FeatureVector& features1, const FeatureVector& features2) {
-    // Adjust weights for sunset-specific features
-    float w1 = 0.4; // Increased weight for sunset colors
-    float w2 = 0.1; // Decreased weight for texture
-    float w3 = 0.2; // DNN features
-    float w4 = 0.3; // Increased weight for edge features (horizon detection)
-
-    float colorDistance = euclideanDistance(features1.sunsetColorHistogram, features2.sunsetColorHistogram);
-    float textureDistance = euclideanDistance(features1.textureFeatures, features2.textureFeatures);
-    float dnnDistance = 1 - cosineSimilarity(features1.dnnFeatures, features2.dnnFeatures);
-    float edgeDistance = euclideanDistance(features1.edgeFeatures, features2.edgeFeatures);
-
-    float totalDistance = w1 * colorDistance + w2 * textureDistance + w3 * dnnDistance + w4 * edgeDistance;
-    return totalDistance;
-}
-
-/**
-* @brief Save feature vectors to a CSV file.
-* 
-* @param csvFilePath The path to the CSV file.
-* @param featureVectors The feature vectors to be saved.
-* @param imagePaths The corresponding image paths.
-*/
-void saveFeatureVectorsToCSV(const std::string& csvFilePath, const std::vector<std::vector<float>>& featureVectors, const std::vector<std::string>& imagePaths) {
-    std::ofstream file(csvFilePath, std::ofstream::out | std::ofstream::app); // Open in append mode
-
-    for (size_t i = 0; i < featureVectors.size(); ++i) {
-        file << imagePaths[i]; 
-        for (const auto& feature : featureVectors[i]) {
-            file << "," << feature; 
-        }
-        file << "\n"; // 
-    }
-
-    file.close();
-}
-
-/**
-* @brief Get the directory of the current executable.
-* 
-* @return The directory path.
+* @brief Extract DenseNet-121 features from an image, with a network leased from the model registry.
+*
+* @param image The input image.
+* @return The DNN feature vector.
 */
-std::string GetCurrentExecutableDirectory() {
-    char path[MAX_PATH];
-    GetModuleFileNameA(NULL, path, MAX_PATH);
-    PathRemoveFileSpecA(path);
-    return std::string(path);
+vector<float> extractDNNFeatures(const Mat& image) {
+    return dnnFeatures(DnnModel::DenseNet121, image);
 }
 
 /**
-* @brief Extract custom design feature vector from an image.
-* 
+* @brief Build the custom design feature vector of an image whose DNN features are already computed.
+*
 * @param image The input image.
+* @param dnnOutput The DenseNet-121 output for the image, e.g. one row of a batched forward pass.
 * @return The custom design feature vector.
 */
-std::vector<float> extractCustomDesignFeatureVector(const cv::Mat& image) {
-    std::string baseDir = GetCurrentExecutableDirectory();
-
-    std::string modelPath = baseDir + "\\models\\DenseNet_121.prototxt";
-    std::string configPath = baseDir + "\\models\\DenseNet_121.caffemodel";
-
+std::vector<float> combineCustomDesignFeatures(const cv::Mat& image, const std::vector<float>& dnnOutput) {
     // This function combines all custom design features into a single vector for an image
     vector<float> sunsetColorHistogram = normalizeVector(extractSunsetColorHistogram(image));
     vector<float> textureFeatures = normalizeVector(extractLBPFeatures(image));
-    vector<float> dnnFeatures = normalizeVector(extractDNNFeatures(image, modelPath, configPath, Size(224, 224), Scalar(104, 117, 123), true));
+    vector<float> dnnFeatures = normalizeVector(dnnOutput);
     vector<float> edgeFeatures = normalizeVector(extractEdgeFeatures(image));
 
     // Combine all features into a single vector
@@ -285,74 +194,47 @@ std::vector<float> extractCustomDesignFeatureVector(const cv::Mat& image) {
 }
 
 /**
-* @brief Perform custom design calculation and save feature vectors to a CSV file.
+* @brief Extract custom design feature vector from an image.
 * 
-* @param directory The directory containing images.
-* @param outputFile The path to the output CSV file.
+* @param image The input image.
+* @return The custom design feature vector.
 */
-void performCustomDesignCalculation(const std::string& directory, const std::string& outputFile)
-{
-    std::vector<std::vector<float>> featureVectors;
-    std::vector<std::string> imagePaths;
-
-    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
-        if (entry.path().extension() == ".jpg") {
-            std::string imagePath = entry.path().string();
-            cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
-            if (!image.empty()) {
-                std::vector<float> featureVector = extractCustomDesignFeatureVector(image);
-
-                featureVectors.push_back(featureVector);
-                imagePaths.push_back(imagePath);
-            }
-        }
-    }
-
-    // Save extracted feature vectors to a CSV file
-    saveFeatureVectorsToCSV(outputFile, featureVectors, imagePaths);
+std::vector<float> extractCustomDesignFeatureVector(const cv::Mat& image) {
+    return combineCustomDesignFeatures(image, extractDNNFeatures(image));
 }
 
 /**
-* @brief Split a string by a delimiter.
-* 
-* @param s The input string to be split.
-* @param delimiter The delimiter character.
-* @return A vector containing the split substrings.
+* @brief Extractor for the search engine: the custom design feature vector of an image.
 */
-std::vector<std::string> split(const std::string& s, char delimiter) {
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter)) {
-        tokens.push_back(token);
+struct CustomDesignExtractor {
+    bool operator()(const cv::Mat& image, std::vector<float>& features) const {
+        features = extractCustomDesignFeatureVector(image);
+        return true;
     }
-    return tokens;
-}
+};
 
 /**
-* @brief Read feature vectors from a CSV file.
+* @brief Perform custom design calculation and save feature vectors to a CSV file.
 * 
-* @param csvFilePath The path to the CSV file.
-* @return A vector of pairs containing image paths and corresponding feature vectors.
+* @param directory The directory containing images.
+* @param outputFile The path to the output CSV file.
 */
-std::vector<std::pair<std::string, std::vector<float>>> readFeatureVectorsFromCSV(const std::string& csvFilePath) {
-    std::vector<std::pair<std::string, std::vector<float>>> featureVectors;
-    std::ifstream file(csvFilePath);
-    std::string line;
-
-    while (std::getline(file, line)) {
-        auto tokens = split(line, ',');
-        if (tokens.size() > 1) {
-            std::string imagePath = tokens[0];
-            std::vector<float> features(tokens.size() - 1, 0.0f);
-            for (size_t i = 1; i < tokens.size(); ++i) {
-                features[i - 1] = std::stof(tokens[i]);
-            }
-            featureVectors.push_back({ imagePath, features });
-        }
+void performCustomDesignCalculation(const std::string& directory, const std::string& outputFile)
+{
+    try {
+        FeatureStoreInfo info;
+        info.type = FeatureType::CustomDesign;
+
+        // Only new or changed images are processed; unchanged rows are copied from the previous output.
+        // DenseNet-121 runs once per batch of images rather than once per image.
+        auto combine = [](const std::string&, const cv::Mat& image, const std::vector<float>& dnnRow) {
+            return combineCustomDesignFeatures(image, dnnRow);
+        };
+        indexImageDirectory(directory, outputFile, info, dnnBatchExtractor(DnnModel::DenseNet121, combine), dnnBatchSize(DnnModel::DenseNet121));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to save feature vectors: " << e.what() << std::endl;
     }
-
-    return featureVectors;
 }
 
 /**
@@ -361,44 +243,185 @@ std::vector<std::pair<std::string, std::vector<float>>> readFeatureVectorsFromCS
 * @param targetImageFile The path to the target image.
 * @param featureVectorCSVPath The path to the CSV file containing feature vectors.
 * @param topN The number of top matches to retrieve.
+* @param options Storage precision of the DNN slice or IVF-PQ probing of it, and fp32 rescoring of the best candidates.
 * @return A vector containing the paths of the top N matching images.
 */
-std::vector<std::string> performCustomDesignCbir(const std::string& targetImageFile, const std::string& featureVectorCSVPath, int topN) {
+std::vector<std::string> performCustomDesignCbir(const std::string& targetImageFile, const std::string& featureVectorCSVPath, int topN, const EmbeddingSearchOptions& options) {
     // Extract the feature vector for the target image
-    cv::Mat targetImage = cv::imread(targetImageFile, cv::IMREAD_COLOR);
-    if (targetImage.empty()) {
-        std::cerr << "Error: Target image could not be read." << std::endl;
+    const Searcher<CustomDesignExtractor, EuclideanMetric> searcher;
+    std::vector<float> queryFeatures;
+    if (!searcher.extract(targetImageFile, queryFeatures)) {
         return {};
     }
 
-    std::vector<float> queryFeatures = extractCustomDesignFeatureVector(targetImage);
+    // The DNN slice can be scanned at reduced precision from its codes file, or only the images
+    // whose slice lies in one of the inverted lists an IVF-PQ search probes are ranked. Its share
+    // of the squared distance is |q|^2 + |r|^2 - 2 |q| |r| cosine similarity.
+    QuantizedEmbeddingHandle dnn;
+    QuantizedEmbeddings::Query dnnQuery;
+    IvfPqIndexHandle ivf;
+    size_t dnnBegin = 0, dnnEnd = 0;
+    try {
+        if (options.ivfProbes > 0) {
+            ivf = openIvfPqIndex(featureVectorCSVPath, "dnn", FeatureType::CustomDesign);
+            dnnBegin = ivf->componentOffset();
+            dnnEnd = dnnBegin + ivf->dims();
+        }
+        else if (options.precision != EmbeddingPrecision::Float32) {
+            dnn = openQuantizedEmbeddings(featureVectorCSVPath, options.precision, "dnn", FeatureType::CustomDesign);
+            dnnBegin = dnn->componentOffset;
+            dnnEnd = dnnBegin + dnn->embeddings.dims();
+        }
+        if (queryFeatures.size() < dnnEnd) {
+            dnn.reset();
+            ivf.reset();
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Scanning DNN features at full precision: " << e.what() << std::endl;
+        dnn.reset();
+        ivf.reset();
+    }
 
-    // Read the feature vectors from the CSV file
-    auto featureVectors = readFeatureVectorsFromCSV(featureVectorCSVPath);
-    std::vector<std::pair<float, std::string>> imageDistances;
+    // With codes or an IVF-PQ index over a binary store, rows are read in place from the store's
+    // mapping, so no fp32 copy of the collection is held. Otherwise they come from the cached
+    // feature index (loaded on first use).
+    std::shared_ptr<const FeatureStore> store;
+    FeatureIndexHandle index;
+    try {
+        if (dnn && dnn->store) {
+            store = dnn->store;
+        }
+        else if (ivf && FeatureStore::isFeatureStoreFile(featureVectorCSVPath)) {
+            store = std::make_shared<const FeatureStore>(featureVectorCSVPath);
+        }
+        const size_t indexedRows = dnn ? dnn->size() : ivf ? ivf->size() : 0;
+        if (store && store->rows() != indexedRows) {
+            store.reset();
+        }
+        if (!store) {
+            index = openFeatureIndex(featureVectorCSVPath);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading feature vectors: " << e.what() << std::endl;
+        return {};
+    }
+    const size_t rows = store ? store->rows() : index->size();
+    const size_t dims = store ? store->dims() : index->features.dims();
+    auto rowAt = [&](size_t i) { return store ? store->row(i) : index->features.row(i); };
+    auto pathAt = [&](size_t i) { return store ? store->path(i) : index->features.path(i); };
+    if (queryFeatures.size() != dims) {
+        std::cerr << "Feature vector size mismatch for " << featureVectorCSVPath << std::endl;
+        return {};
+    }
+    if ((dnn && dnn->size() != rows) || (ivf && ivf->size() != rows)) {
+        std::cerr << "Scanning DNN features at full precision: the index does not match " << featureVectorCSVPath << std::endl;
+        dnn.reset();
+        ivf.reset();
+    }
 
-    // Calculate distances between the query image features and each feature vector in the CSV
-    for (const auto& [imagePath, features] : featureVectors) {
-        // Skip comparison if the current image is the target image
-        if (std::filesystem::path(imagePath).filename() == std::filesystem::path(targetImageFile).filename()) {
-            continue; // Skip this image
+    // Length of the query's DNN slice, and where the feature index keeps the inverse lengths of the rows' slices
+    float dnnQueryLength = 1.0f;
+    size_t dnnComponent = index ? index->components.size() : 0;
+    if (dnn || ivf) {
+        dnnQueryLength = vectorLength(queryFeatures.data() + dnnBegin, dnnEnd - dnnBegin);
+    }
+    if (dnn) {
+        dnnQuery = dnn->embeddings.prepareQuery(queryFeatures.data() + dnnBegin);
+    }
+    if (ivf && index) {
+        dnnComponent = index->componentIndex("dnn");
+        if (dnnComponent < index->components.size()
+            && (index->components[dnnComponent].offset != dnnBegin || index->components[dnnComponent].dims != dnnEnd - dnnBegin)) {
+            dnnComponent = index->components.size();
         }
-        float distance = euclideanDistance(queryFeatures, features);
-        imageDistances.push_back(std::make_pair(distance, imagePath));
     }
 
-    // Sort based on distances
-    std::sort(imageDistances.begin(), imageDistances.end(), [](const std::pair<float, std::string>& a, const std::pair<float, std::string>& b) {
-        return a.first < b.first; // Ascending order
-        });
+    // Keep enough candidates for the fp32 rescore when the DNN slice is scored approximately
+    const size_t topK = static_cast<size_t>(std::max(topN, 0));
+    const bool rescore = (dnn || ivf) && options.rescoreCandidates > 0;
+    const size_t candidates = rescore ? std::max(options.rescoreCandidates, topK) : topK;
+
+    // Distance of row i given its DNN similarity and length, or SKIPPED_ROW for the target image
+    const std::string targetName = std::filesystem::path(targetImageFile).filename().string();
+    auto distanceAt = [&](size_t i, float similarity, float rowLength) {
+        if (hasFileName(dnn ? dnn->imagePaths[i] : pathAt(i), targetName)) {
+            return SKIPPED_ROW;
+        }
+        // Everything but the DNN slice, which is scored from its codes
+        const float* row = rowAt(i);
+        float sum = squaredL2Distance(queryFeatures.data(), row, std::min(dnnBegin, dims));
+        if (dnnEnd < dims) {
+            sum += squaredL2Distance(queryFeatures.data() + dnnEnd, row + dnnEnd, dims - dnnEnd);
+        }
+        sum += std::max(0.0f, dnnQueryLength * dnnQueryLength + rowLength * rowLength - 2.0f * dnnQueryLength * rowLength * similarity);
+        return std::sqrt(sum);
+    };
+
+    // Calculate distances between the query image features and each feature vector on all scan
+    // threads, closest first
+    std::vector<std::pair<float, size_t>> imageDistances;
+    if (ivf) {
+        // Only the probed rows are read and scored; in row order, so ties break as in a full scan
+        std::vector<std::pair<float, size_t>> probed = ivf->probe(queryFeatures.data() + dnnBegin, options.ivfProbes);
+        std::sort(probed.begin(), probed.end(), [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) {
+            return a.second < b.second;
+            });
+        imageDistances = scanTopK(probed.size(), candidates, ScanOrder::Ascending, [&](size_t begin, size_t end, float* scores) {
+            for (size_t j = begin; j < end; ++j) {
+                const size_t i = probed[j].second;
+                float rowLength;
+                if (index) {
+                    const float inverse = dnnComponent < index->components.size() ? index->inverseLength(i, dnnComponent) : 1.0f;
+                    rowLength = inverse > 0.0f ? 1.0f / inverse : 0.0f;
+                }
+                else {
+                    rowLength = vectorLength(rowAt(i) + dnnBegin, dnnEnd - dnnBegin);
+                }
+                scores[j - begin] = distanceAt(i, 1.0f - probed[j].first, rowLength);
+            }
+            });
+        for (auto& candidate : imageDistances) {
+            candidate.second = probed[candidate.second].second;
+        }
+    }
+    else if (dnn) {
+        imageDistances = scanTopK(rows, candidates, ScanOrder::Ascending, [&](size_t begin, size_t end, float* scores) {
+            for (size_t i = begin; i < end; ++i) {
+                scores[i - begin] = distanceAt(i, dnn->embeddings.similarity(dnnQuery, i), dnn->embeddings.length(i));
+            }
+            });
+    }
+    else {
+        if (!index) {
+            try {
+                index = openFeatureIndex(featureVectorCSVPath);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Error reading feature vectors: " << e.what() << std::endl;
+                return {};
+            }
+        }
+        imageDistances = searcher.scan(*index, queryFeatures, candidates, targetImageFile);
+    }
+
+    // Rescore the best candidates with the exact fp32 distance
+    if (rescore) {
+        for (auto& candidate : imageDistances) {
+            candidate.first = euclideanDistance(queryFeatures.data(), rowAt(candidate.second), dims);
+        }
+        std::sort(imageDistances.begin(), imageDistances.end(), [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) {
+            return a.first != b.first ? a.first < b.first : a.second < b.second; // Ascending order
+            });
+    }
 
     // Extract top N matches
     std::vector<std::string> topMatches;
     int loopLimit = std::min(topN, static_cast<int>(imageDistances.size()));
     for (int i = 0; i < loopLimit; ++i) {
-        topMatches.push_back(imageDistances[i].second);
+        topMatches.push_back(pathAt(imageDistances[i].second));
     }
 
     return topMatches;
 }
-
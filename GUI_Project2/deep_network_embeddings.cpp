@@ -3,10 +3,18 @@
     \author Manushi
     \date February 10, 2024
 
-    This file contains the implementation of functions for loading deep network embeddings from a CSV file,
-    normalizing feature vectors, and performing deep network embeddings matching to find similar images.
+    This file contains the implementation of functions for embedding images with ResNet-18, indexing
+    a directory of images, and performing deep network embeddings matching to find similar images.
 */
+#include "dnn_models.h"
 #include "feature_utils.h"
+#include "feature_indexer.h"
+#include "feature_store.h"
+#include "feature_index.h"
+#include "quantized_embeddings.h"
+#include "hnsw_index.h"
+#include "ivfpq_index.h"
+#include "search_engine.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -17,103 +25,239 @@
 namespace fs = std::filesystem;
 
 /**
- * @brief Load embeddings and filenames from a CSV file.
+ * @brief Embeds an image with ResNet-18, with a network leased from the model registry.
  *
- * @param filePath The path to the CSV file containing embeddings.
- * @return A vector of pairs, where each pair consists of a filename and its corresponding feature vector.
+ * @param image The input image.
+ * @return The 512-value embedding.
  */
-std::vector<std::pair<std::string, std::vector<float>>> loadDeepFeatureVectors(const std::string& filePath) {
-    std::vector<std::pair<std::string, std::vector<float>>> embeddings;
-    std::ifstream file(filePath);
-    std::string line;
-
-    while (getline(file, line)) {
-        std::istringstream iss(line);
-        std::string filename;
-        std::string value;
-        std::vector<float> embedding;
-
-        // Extract filename
-        getline(iss, filename, ',');
-
-        // Extract embedding values
-        while (getline(iss, value, ',')) {
-            embedding.push_back(std::stof(value));
-        }
-      
-        embeddings.push_back({ filename, embedding });
+std::vector<float> extractResNet18Embedding(const cv::Mat& image) {
+    return dnnFeatures(DnnModel::ResNet18, image);
+}
+
+/**
+ * @brief Extractor for the search engine: the ResNet-18 embedding of an image.
+ */
+struct ResNet18Extractor {
+    bool operator()(const cv::Mat& image, std::vector<float>& features) const {
+        features = extractResNet18Embedding(image);
+        return true;
     }
+};
 
-    return embeddings;
+/**
+ * @brief Embeds a target image whose embedding is not in the feature file.
+ *
+ * @param targetImageFile The path to the target image file.
+ * @param dims Number of values per embedding in the feature file.
+ * @param embedding Receives the embedding.
+ * @return False (after a message) if the image cannot be embedded or its embedding does not fit the file.
+ */
+static bool embedTargetImage(const std::string& targetImageFile, size_t dims, std::vector<float>& embedding) {
+    // One forward pass on a pooled network
+    const Searcher<ResNet18Extractor, CosineDistanceMetric> searcher;
+    if (!searcher.extract(targetImageFile, embedding)) {
+        return false;
+    }
+    if (embedding.size() != dims) {
+        std::cerr << "The embedding of the target image has " << embedding.size() << " values, the feature file has " << dims << std::endl;
+        return false;
+    }
+    std::cout << "Target image is not in the feature file; embedded it with ResNet-18." << std::endl;
+    return true;
 }
 
 /**
- * @brief Normalize a vector to unit length.
+ * @brief Deep network embeddings matching on reduced-precision embeddings.
  *
- * @param vec The vector to be normalized.
- * @return The normalized vector.
+ * @param targetImageFile The path to the target image file.
+ * @param topN The number of top matching images to retrieve.
+ * @param featureFile The path to the feature file containing the embeddings.
+ * @param options Storage precision and fp32 rescoring of the scan.
+ * @return (cosine distance, filename) pairs of the closest images.
  */
-std::vector<float> normalizeVectorDne(const std::vector<float>& vec) {
-    std::vector<float> normalizedVec(vec.size());
-    float len = vectorLength(vec);
-    if (len > 0) {
-        for (size_t i = 0; i < vec.size(); ++i) {
-            normalizedVec[i] = vec[i] / len;
+static std::vector<std::pair<float, std::string>> quantizedEmbeddingDistances(const std::string& targetImageFile, int topN, const std::string& featureFile, const EmbeddingSearchOptions& options) {
+    QuantizedEmbeddingHandle set;
+    try {
+        set = openQuantizedEmbeddings(featureFile, options.precision, "features", FeatureType::DeepEmbedding);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading embeddings: " << e.what() << std::endl;
+        return {};
+    }
+
+    std::string targetFilename = std::filesystem::path(targetImageFile).filename().string();
+    auto target = std::find_if(set->imagePaths.begin(), set->imagePaths.end(),
+        [&](const std::string& imagePath) { return hasFileName(imagePath, targetFilename); });
+    std::vector<float> targetEmbedding;
+    if (target == set->imagePaths.end()) {
+        if (!embedTargetImage(targetImageFile, set->embeddings.dims(), targetEmbedding)) return {};
+    }
+    else {
+        // Decoding the target avoids loading the fp32 rows of a CSV file unless they are needed for rescoring
+        const size_t targetRow = static_cast<size_t>(target - set->imagePaths.begin());
+        try {
+            targetEmbedding = (set->store || options.rescoreCandidates > 0) ? set->exactRow(targetRow) : set->embeddings.decode(targetRow);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error reading embeddings: " << e.what() << std::endl;
+            return {};
+        }
+    }
+
+    // One extra result because the target image may find itself
+    std::vector<std::pair<float, std::string>> distances;
+    for (const auto& [similarity, row] : searchQuantizedEmbeddings(*set, targetEmbedding.data(), static_cast<size_t>(topN) + 1, options)) {
+        if (!hasFileName(set->imagePaths[row], targetFilename)) {
+            distances.push_back({ 1 - similarity, set->imagePaths[row] });
         }
     }
-    return normalizedVec;
+    return distances;
 }
 
 /**
- * @brief Perform deep network embeddings matching to find similar images.
+ * @brief Deep network embeddings matching through the HNSW index of the embedding file.
  *
  * @param targetImageFile The path to the target image file.
  * @param topN The number of top matching images to retrieve.
- * @param featureFile The path to the CSV file containing feature vectors.
- * @return A vector of paths to the top matching images.
+ * @param featureFile The path to the feature file containing the embeddings.
+ * @param options Candidate list size of the search, and the build parameters the index must have if set.
+ * @return (cosine distance, filename) pairs of the closest images.
  */
-std::vector<std::string> performdeepNetworkEmbeddingsMatching(const std::string& targetImageFile, int topN, const std::string& featureFile) {
-    // Load the target image and compute its histograms manually
-    cv::Mat targetImage = cv::imread(targetImageFile, cv::IMREAD_COLOR);
-    if (targetImage.empty()) {
-        std::cerr << "Error loading target image." << std::endl;
+static std::vector<std::pair<float, std::string>> hnswEmbeddingDistances(const std::string& targetImageFile, int topN, const std::string& featureFile,
+    const EmbeddingSearchOptions& options) {
+    // The index is built on first use and rebuilt whenever the embedding file changes, or when it
+    // was built with other parameters than those requested
+    HnswIndexHandle index;
+    try {
+        if (options.hnswM > 0 || options.hnswEfConstruction > 0) {
+            HnswParameters parameters;
+            parameters.M = options.hnswM;
+            parameters.efConstruction = options.hnswEfConstruction;
+            index = openHnswIndex(featureFile, parameters);
+        }
+        else {
+            index = openHnswIndex(featureFile);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading embeddings: " << e.what() << std::endl;
+        return {};
     }
-
-    auto embeddings = loadDeepFeatureVectors(featureFile);
 
     std::string targetFilename = std::filesystem::path(targetImageFile).filename().string();
-
-    // Find the embedding for the target image
+    size_t targetRow = 0;
     std::vector<float> targetEmbedding;
-    bool found = false;
-    for (const auto& e : embeddings) {
-        if (e.first == targetFilename) {
-            targetEmbedding = e.second;
-            found = true;
-            break;
+    if (!index->findRow(targetFilename, targetRow) && !index->findRow(targetImageFile, targetRow)) {
+        if (!embedTargetImage(targetImageFile, index->dims(), targetEmbedding)) return {};
+    }
+    const float* query = targetEmbedding.empty() ? index->vector(targetRow) : targetEmbedding.data();
+
+    // One extra result because the target image may find itself
+    std::vector<std::pair<float, std::string>> distances;
+    for (const auto& [distance, row] : index->search(query, static_cast<size_t>(std::max(topN, 0)) + 1, options.hnswEfSearch)) {
+        std::string imagePath = index->path(row);
+        if (!hasFileName(imagePath, targetFilename)) {
+            distances.push_back({ distance, imagePath });
         }
     }
+    return distances;
+}
 
-    if (!found) {
-        std::cout << "Embedding for the target image not found." << std::endl;
+/**
+ * @brief Deep network embeddings matching through the IVF-PQ index of the embedding file.
+ *
+ * @param targetImageFile The path to the target image file.
+ * @param topN The number of top matching images to retrieve.
+ * @param featureFile The path to the feature file containing the embeddings.
+ * @param options Number of inverted lists probed and exact reranking of the best candidates.
+ * @return (cosine distance, filename) pairs of the closest images.
+ */
+static std::vector<std::pair<float, std::string>> ivfPqEmbeddingDistances(const std::string& targetImageFile, int topN, const std::string& featureFile, const EmbeddingSearchOptions& options) {
+    // The index is built on first use and rebuilt whenever the embedding file changes
+    IvfPqIndexHandle index;
+    std::string targetFilename = std::filesystem::path(targetImageFile).filename().string();
+    size_t targetRow = 0;
+    std::vector<std::pair<float, size_t>> closest;
+    try {
+        index = openIvfPqIndex(featureFile, "features", FeatureType::DeepEmbedding);
+
+        // The codes are lossy, so a stored query is read back from the feature file. One extra
+        // result because the target image may find itself.
+        std::vector<float> targetEmbedding;
+        if (index->findRow(targetFilename, targetRow) || index->findRow(targetImageFile, targetRow)) {
+            targetEmbedding = index->exactVector(targetRow);
+        }
+        else if (!embedTargetImage(targetImageFile, index->dims(), targetEmbedding)) {
+            return {};
+        }
+        closest = index->search(targetEmbedding.data(), static_cast<size_t>(std::max(topN, 0)) + 1, options.ivfProbes, options.rescoreCandidates);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading embeddings: " << e.what() << std::endl;
+        return {};
     }
 
     std::vector<std::pair<float, std::string>> distances;
-    std::vector<float> normTargetEmbedding = normalizeVectorDne(targetEmbedding);
-    for (const auto& e : embeddings) {
-        if (e.first != targetFilename) {
-            std::vector<float> normEmbedding = normalizeVectorDne(e.second);
-            float similarity = cosineSimilarity(normTargetEmbedding, normEmbedding);
-            float distance = 1 - similarity; // Cosine distance
-            distances.push_back({ distance, e.first });
+    for (const auto& [distance, row] : closest) {
+        std::string imagePath = index->path(row);
+        if (!hasFileName(imagePath, targetFilename)) {
+            distances.push_back({ distance, imagePath });
         }
     }
+    return distances;
+}
 
-    // Sort by distance in ascending order
-    std::sort(distances.begin(), distances.end(), [](const auto& a, const auto& b) {
-        return a.first < b.first;
-        });
+/**
+ * @brief Perform deep network embeddings matching to find similar images.
+ *
+ * @param targetImageFile The path to the target image file.
+ * @param topN The number of top matching images to retrieve.
+ * @param featureFile The path to the CSV file containing feature vectors.
+ * @param options Storage precision of the embeddings, or an HNSW or IVF-PQ search; fp32 scans the feature index directly.
+ * @return A vector of paths to the top matching images.
+ */
+std::vector<std::string> performdeepNetworkEmbeddingsMatching(const std::string& targetImageFile, int topN, const std::string& featureFile, const EmbeddingSearchOptions& options) {
+    std::string targetFilename = std::filesystem::path(targetImageFile).filename().string();
+    std::vector<std::pair<float, std::string>> distances;
 
+    if (options.hnswEfSearch > 0) {
+        distances = hnswEmbeddingDistances(targetImageFile, topN, featureFile, options);
+    }
+    else if (options.ivfProbes > 0) {
+        distances = ivfPqEmbeddingDistances(targetImageFile, topN, featureFile, options);
+    }
+    else if (options.precision != EmbeddingPrecision::Float32) {
+        distances = quantizedEmbeddingDistances(targetImageFile, topN, featureFile, options);
+    }
+    else {
+        // Get the embeddings from the cached index (loaded on first use)
+        FeatureIndexHandle index;
+        try {
+            index = openFeatureIndex(featureFile);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error reading embeddings: " << e.what() << std::endl;
+            return {};
+        }
+
+        // Use the stored embedding of the target image, or embed the image if it is not in the file
+        const FeatureMatrix& embeddings = index->features;
+        auto target = std::find_if(embeddings.paths().begin(), embeddings.paths().end(),
+            [&](const std::string& imagePath) { return hasFileName(imagePath, targetFilename); });
+        std::vector<float> embeddedTarget;
+        if (target == embeddings.paths().end() && !embedTargetImage(targetImageFile, embeddings.dims(), embeddedTarget)) {
+            return {};
+        }
+        const float* targetEmbedding = embeddedTarget.empty()
+            ? embeddings.row(static_cast<size_t>(target - embeddings.paths().begin())) : embeddedTarget.data();
+
+        // The index keeps the inverse length of every row, so each comparison is one dot product of
+        // the rows in place. All scan threads take part and the closest rows come back first.
+        std::vector<std::pair<float, size_t>> closest = searchIndex<CosineDistanceMetric>(*index, targetEmbedding, static_cast<size_t>(std::max(topN, 0)), targetFilename);
+        for (const auto& match : closest) {
+            distances.push_back({ match.first, embeddings.path(match.second) });
+        }
+    }
 
     // Display closest matches
     std::cout << "Closest matches to " << targetFilename << ":\n";
@@ -127,8 +271,9 @@ std::vector<std::string> performdeepNetworkEmbeddingsMatching(const std::string&
 
     std::vector<std::string> topMatches;
     for (int i = 0; i < std::min(topN, static_cast<int>(distances.size())); ++i) {
-        std::string matchFilename = distances[i].second;
-        std::string imagePath = (dirPath / matchFilename).string();
+        // Files written by an external tool hold file names next to the target; the indexer stores full paths
+        fs::path matchPath(distances[i].second);
+        std::string imagePath = matchPath.has_parent_path() ? matchPath.string() : (dirPath / matchPath).string();
 
         topMatches.push_back(imagePath);
     }
@@ -136,3 +281,25 @@ std::vector<std::string> performdeepNetworkEmbeddingsMatching(const std::string&
     return topMatches;
 
 }
+
+/**
+ * @brief Embeds the images in a directory with ResNet-18 and saves the embeddings to a feature file.
+ *
+ * @param directory The directory containing images.
+ * @param outputFile The path to the output file (CSV, or a binary feature store for ".cbfs").
+ */
+void performDeepEmbeddingCalculation(const std::string& directory, const std::string& outputFile)
+{
+    try {
+        FeatureStoreInfo info;
+        info.type = FeatureType::DeepEmbedding;
+
+        // Only new or changed images are embedded, a batch of them per forward pass; unchanged rows
+        // are copied from the previous output
+        auto embedding = [](const std::string&, const cv::Mat&, const std::vector<float>& dnnRow) { return dnnRow; };
+        indexImageDirectory(directory, outputFile, info, dnnBatchExtractor(DnnModel::ResNet18, embedding), dnnBatchSize(DnnModel::ResNet18));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to save feature vectors: " << e.what() << std::endl;
+    }
+}
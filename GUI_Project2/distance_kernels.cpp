@@ -0,0 +1,635 @@
+/*! \file distance_kernels.cpp
+    \brief Implements the runtime-dispatched SIMD distance kernels.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Each kernel set walks the
+    vectors in blocks of two registers with independent accumulators and finishes the remainder
+    with scalar code (AVX-512 uses masked loads instead), so inputs need no padding or alignment.
+    The scalar kernels keep the plain left-to-right loops the matchers used before, so machines
+    without SIMD get the same results as earlier versions. The bounded squared Euclidean kernels
+    run the same loops and compare the running sum with the bound every few cache lines, so a row
+    that is not abandoned gets exactly the score the unbounded kernel gives it.
+*/
+
+#include "distance_kernels.h"
+#include "cpu_features.h"
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+#if CBIR_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using PairKernel = float (*)(const float* a, const float* b, std::size_t n);
+using BoundedKernel = float (*)(const float* a, const float* b, std::size_t n, float bound);
+using CosineKernel = CosineTerms (*)(const float* a, const float* b, std::size_t n);
+
+/**
+ * @brief One implementation of every measure for one instruction set.
+ */
+struct KernelSet {
+    const char* name;
+    PairKernel l2Squared;
+    BoundedKernel l2SquaredBounded;
+    PairKernel l1;
+    PairKernel intersection;
+    PairKernel dot;
+    CosineKernel cosine;
+};
+
+/**
+ * @brief Floats between two checks of a bounded kernel's running sum against its bound.
+ */
+constexpr std::size_t BOUND_CHECK_FLOATS = 64;
+
+/**
+ * @brief The same for AVX-512, whose horizontal sum goes through memory and costs as much as a few blocks.
+ */
+constexpr std::size_t AVX512_BOUND_CHECK_FLOATS = 256;
+
+/**
+ * @brief Relative widening of a squared Euclidean bound (2^-20, several float roundings).
+ */
+constexpr float EUCLIDEAN_BOUND_MARGIN = 1.0f / 1048576.0f;
+
+// ----- Scalar kernels -----
+
+float l2SquaredScalar(const float* a, const float* b, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+float l2SquaredBoundedScalar(const float* a, const float* b, std::size_t n, float bound) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+        if ((i + 1) % BOUND_CHECK_FLOATS == 0 && sum > bound) return sum;
+    }
+    return sum;
+}
+
+float l1Scalar(const float* a, const float* b, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) sum += std::fabs(a[i] - b[i]);
+    return sum;
+}
+
+float intersectionScalar(const float* a, const float* b, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) sum += a[i] < b[i] ? a[i] : b[i];
+    return sum;
+}
+
+float dotScalar(const float* a, const float* b, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+CosineTerms cosineScalar(const float* a, const float* b, std::size_t n) {
+    CosineTerms terms;
+    for (std::size_t i = 0; i < n; ++i) {
+        terms.dot += a[i] * b[i];
+        terms.squaredNormA += a[i] * a[i];
+        terms.squaredNormB += b[i] * b[i];
+    }
+    return terms;
+}
+
+const KernelSet SCALAR_KERNELS = { "scalar", l2SquaredScalar, l2SquaredBoundedScalar, l1Scalar, intersectionScalar, dotScalar, cosineScalar };
+
+#if CBIR_X86
+// ----- SSE4.2 kernels -----
+
+CBIR_TARGET("sse4.2")
+float horizontalSum128(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+    return _mm_cvtss_f32(v);
+}
+
+CBIR_TARGET("sse4.2")
+float l2SquaredSse(const float* a, const float* b, std::size_t n) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+    }
+    float sum = horizontalSum128(_mm_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+CBIR_TARGET("sse4.2")
+float l2SquaredBoundedSse(const float* a, const float* b, std::size_t n, float bound) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+        if ((i + 8) % BOUND_CHECK_FLOATS == 0) {
+            const float partial = horizontalSum128(_mm_add_ps(acc0, acc1));
+            if (partial > bound) return partial;
+        }
+    }
+    float sum = horizontalSum128(_mm_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+CBIR_TARGET("sse4.2")
+float l1Sse(const float* a, const float* b, std::size_t n) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i))));
+        acc1 = _mm_add_ps(acc1, _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4))));
+    }
+    float sum = horizontalSum128(_mm_add_ps(acc0, acc1));
+    for (; i < n; ++i) sum += std::fabs(a[i] - b[i]);
+    return sum;
+}
+
+CBIR_TARGET("sse4.2")
+float intersectionSse(const float* a, const float* b, std::size_t n) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_min_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_min_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float sum = horizontalSum128(_mm_add_ps(acc0, acc1));
+    for (; i < n; ++i) sum += a[i] < b[i] ? a[i] : b[i];
+    return sum;
+}
+
+CBIR_TARGET("sse4.2")
+float dotSse(const float* a, const float* b, std::size_t n) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float sum = horizontalSum128(_mm_add_ps(acc0, acc1));
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+CBIR_TARGET("sse4.2")
+CosineTerms cosineSse(const float* a, const float* b, std::size_t n) {
+    __m128 dot = _mm_setzero_ps(), normA = _mm_setzero_ps(), normB = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i), vb = _mm_loadu_ps(b + i);
+        dot = _mm_add_ps(dot, _mm_mul_ps(va, vb));
+        normA = _mm_add_ps(normA, _mm_mul_ps(va, va));
+        normB = _mm_add_ps(normB, _mm_mul_ps(vb, vb));
+    }
+    CosineTerms terms;
+    terms.dot = horizontalSum128(dot);
+    terms.squaredNormA = horizontalSum128(normA);
+    terms.squaredNormB = horizontalSum128(normB);
+    for (; i < n; ++i) {
+        terms.dot += a[i] * b[i];
+        terms.squaredNormA += a[i] * a[i];
+        terms.squaredNormB += b[i] * b[i];
+    }
+    return terms;
+}
+
+// ----- AVX2 kernels -----
+
+CBIR_TARGET("avx")
+float horizontalSum256(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+
+CBIR_TARGET("avx2,fma")
+float l2SquaredAvx2(const float* a, const float* b, std::size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    float sum = horizontalSum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+CBIR_TARGET("avx2,fma")
+float l2SquaredBoundedAvx2(const float* a, const float* b, std::size_t n, float bound) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        if ((i + 16) % BOUND_CHECK_FLOATS == 0) {
+            const float partial = horizontalSum256(_mm256_add_ps(acc0, acc1));
+            if (partial > bound) return partial;
+        }
+    }
+    float sum = horizontalSum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+CBIR_TARGET("avx2,fma")
+float l1Avx2(const float* a, const float* b, std::size_t n) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+        acc1 = _mm256_add_ps(acc1, _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8))));
+    }
+    float sum = horizontalSum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) sum += std::fabs(a[i] - b[i]);
+    return sum;
+}
+
+CBIR_TARGET("avx2,fma")
+float intersectionAvx2(const float* a, const float* b, std::size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_min_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_min_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    float sum = horizontalSum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) sum += a[i] < b[i] ? a[i] : b[i];
+    return sum;
+}
+
+CBIR_TARGET("avx2,fma")
+float dotAvx2(const float* a, const float* b, std::size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    float sum = horizontalSum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+CBIR_TARGET("avx2,fma")
+CosineTerms cosineAvx2(const float* a, const float* b, std::size_t n) {
+    __m256 dot = _mm256_setzero_ps(), normA = _mm256_setzero_ps(), normB = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 va = _mm256_loadu_ps(a + i), vb = _mm256_loadu_ps(b + i);
+        dot = _mm256_fmadd_ps(va, vb, dot);
+        normA = _mm256_fmadd_ps(va, va, normA);
+        normB = _mm256_fmadd_ps(vb, vb, normB);
+    }
+    CosineTerms terms;
+    terms.dot = horizontalSum256(dot);
+    terms.squaredNormA = horizontalSum256(normA);
+    terms.squaredNormB = horizontalSum256(normB);
+    for (; i < n; ++i) {
+        terms.dot += a[i] * b[i];
+        terms.squaredNormA += a[i] * a[i];
+        terms.squaredNormB += b[i] * b[i];
+    }
+    return terms;
+}
+
+// ----- AVX-512 kernels; the last partial block is read with a masked load -----
+
+CBIR_TARGET("avx512f")
+float horizontalSum512(__m512 v) {
+    // Reduced through memory: GCC's 512-to-256 bit extracts trip -Wuninitialized in its own headers
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, v);
+    float sum = 0.0f;
+    for (float lane : lanes) sum += lane;
+    return sum;
+}
+
+/**
+ * @brief Mask selecting the first count (< 16) lanes.
+ */
+inline __mmask16 tailMask(std::size_t count) {
+    return static_cast<__mmask16>((1u << count) - 1u);
+}
+
+CBIR_TARGET("avx512f")
+float l2SquaredAvx512(const float* a, const float* b, std::size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i < n; i += 16) {
+        const __mmask16 mask = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : tailMask(n - i);
+        __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    return horizontalSum512(_mm512_add_ps(acc0, acc1));
+}
+
+CBIR_TARGET("avx512f")
+float l2SquaredBoundedAvx512(const float* a, const float* b, std::size_t n, float bound) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        if ((i + 32) % AVX512_BOUND_CHECK_FLOATS == 0) {
+            const float partial = horizontalSum512(_mm512_add_ps(acc0, acc1));
+            if (partial > bound) return partial;
+        }
+    }
+    for (; i < n; i += 16) {
+        const __mmask16 mask = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : tailMask(n - i);
+        __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    return horizontalSum512(_mm512_add_ps(acc0, acc1));
+}
+
+CBIR_TARGET("avx512f")
+float l1Avx512(const float* a, const float* b, std::size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))));
+        acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16))));
+    }
+    for (; i < n; i += 16) {
+        const __mmask16 mask = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : tailMask(n - i);
+        acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i))));
+    }
+    return horizontalSum512(_mm512_add_ps(acc0, acc1));
+}
+
+CBIR_TARGET("avx512f")
+float intersectionAvx512(const float* a, const float* b, std::size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_add_ps(acc0, _mm512_maskz_min_ps(0xFFFF, _mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+        acc1 = _mm512_add_ps(acc1, _mm512_maskz_min_ps(0xFFFF, _mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16)));
+    }
+    for (; i < n; i += 16) {
+        const __mmask16 mask = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : tailMask(n - i);
+        acc0 = _mm512_add_ps(acc0, _mm512_maskz_min_ps(0xFFFF, _mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i)));
+    }
+    return horizontalSum512(_mm512_add_ps(acc0, acc1));
+}
+
+CBIR_TARGET("avx512f")
+float dotAvx512(const float* a, const float* b, std::size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i < n; i += 16) {
+        const __mmask16 mask = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : tailMask(n - i);
+        acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc0);
+    }
+    return horizontalSum512(_mm512_add_ps(acc0, acc1));
+}
+
+CBIR_TARGET("avx512f")
+CosineTerms cosineAvx512(const float* a, const float* b, std::size_t n) {
+    __m512 dot = _mm512_setzero_ps(), normA = _mm512_setzero_ps(), normB = _mm512_setzero_ps();
+    for (std::size_t i = 0; i < n; i += 16) {
+        const __mmask16 mask = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : tailMask(n - i);
+        __m512 va = _mm512_maskz_loadu_ps(mask, a + i), vb = _mm512_maskz_loadu_ps(mask, b + i);
+        dot = _mm512_fmadd_ps(va, vb, dot);
+        normA = _mm512_fmadd_ps(va, va, normA);
+        normB = _mm512_fmadd_ps(vb, vb, normB);
+    }
+    CosineTerms terms;
+    terms.dot = horizontalSum512(dot);
+    terms.squaredNormA = horizontalSum512(normA);
+    terms.squaredNormB = horizontalSum512(normB);
+    return terms;
+}
+
+const KernelSet SSE42_KERNELS = { "sse4.2", l2SquaredSse, l2SquaredBoundedSse, l1Sse, intersectionSse, dotSse, cosineSse };
+const KernelSet AVX2_KERNELS = { "avx2", l2SquaredAvx2, l2SquaredBoundedAvx2, l1Avx2, intersectionAvx2, dotAvx2, cosineAvx2 };
+const KernelSet AVX512_KERNELS = { "avx512", l2SquaredAvx512, l2SquaredBoundedAvx512, l1Avx512, intersectionAvx512, dotAvx512, cosineAvx512 };
+#endif
+
+/**
+ * @brief Kernel sets the running CPU supports, widest first; the scalar set is not included.
+ */
+std::vector<const KernelSet*> supportedKernelSets() {
+    std::vector<const KernelSet*> sets;
+#if CBIR_X86
+    const CpuFeatures& cpu = cpuFeatures();
+    if (cpu.avx512f) sets.push_back(&AVX512_KERNELS);
+    if (cpu.avx2 && cpu.fma) sets.push_back(&AVX2_KERNELS);
+    if (cpu.sse42) sets.push_back(&SSE42_KERNELS);
+#endif
+    return sets;
+}
+
+/**
+ * @brief Checks one result against a double precision reference.
+ *
+ * Reordered float sums differ from each other by a few units of rounding per element, relative
+ * to the sum of the magnitudes of the terms.
+ */
+bool closeTo(float value, double reference, double magnitude, std::size_t n) {
+    return std::fabs(static_cast<double>(value) - reference) <= 1e-6 * static_cast<double>(n + 1) * magnitude + 1e-6;
+}
+
+/**
+ * @brief Checks that the bounded squared Euclidean kernel matches the unbounded one bit for bit
+ * unless it is abandoned, and that an abandoned row scores above the bound.
+ */
+bool boundedAgrees(const KernelSet& set, const float* x, const float* y, std::size_t n, float l2Squared) {
+    const float half = 0.5f * l2Squared;
+    const float halfBounded = set.l2SquaredBounded(x, y, n, half);
+    return set.l2SquaredBounded(x, y, n, std::numeric_limits<float>::infinity()) == l2Squared
+        && set.l2SquaredBounded(x, y, n, l2Squared) == l2Squared
+        && (halfBounded == l2Squared || (halfBounded > half && halfBounded <= l2Squared));
+}
+
+/**
+ * @brief Compares one kernel set with double precision references; scalar kernels are checked the same way.
+ */
+bool agreesWithReference(const KernelSet& set) {
+    constexpr std::size_t maxLength = 300;
+    constexpr std::size_t maxOffset = 3;
+
+    // Fixed pseudo-random values in [-1, 1), some of them zero like empty histogram bins
+    std::vector<float> a(maxLength + maxOffset), b(maxLength + maxOffset);
+    std::uint32_t state = 12345u;
+    auto next = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 9) % 4 == 0 ? 0.0f : static_cast<float>(state >> 8) / 8388608.0f - 1.0f;
+    };
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        a[i] = next();
+        b[i] = next();
+    }
+
+    for (std::size_t offset = 0; offset <= maxOffset; ++offset) {
+        for (std::size_t n = 0; n <= maxLength; ++n) {
+            const float* x = a.data() + offset;
+            const float* y = b.data() + (maxOffset - offset);
+            double l2 = 0.0, l1 = 0.0, minSum = 0.0, minMagnitude = 0.0, dot = 0.0, dotMagnitude = 0.0, normX = 0.0, normY = 0.0;
+            for (std::size_t i = 0; i < n; ++i) {
+                const double diff = static_cast<double>(x[i]) - y[i];
+                const double low = x[i] < y[i] ? x[i] : y[i];
+                l2 += diff * diff;
+                l1 += std::fabs(diff);
+                minSum += low;
+                minMagnitude += std::fabs(low);
+                dot += static_cast<double>(x[i]) * y[i];
+                dotMagnitude += std::fabs(static_cast<double>(x[i]) * y[i]);
+                normX += static_cast<double>(x[i]) * x[i];
+                normY += static_cast<double>(y[i]) * y[i];
+            }
+            const CosineTerms terms = set.cosine(x, y, n);
+            const float l2Squared = set.l2Squared(x, y, n);
+            if (!closeTo(l2Squared, l2, l2, n) || !boundedAgrees(set, x, y, n, l2Squared) || !closeTo(set.l1(x, y, n), l1, l1, n)
+                || !closeTo(set.intersection(x, y, n), minSum, minMagnitude, n) || !closeTo(set.dot(x, y, n), dot, dotMagnitude, n)
+                || !closeTo(terms.dot, dot, dotMagnitude, n) || !closeTo(terms.squaredNormA, normX, normX, n)
+                || !closeTo(terms.squaredNormB, normY, normY, n)) {
+                std::cerr << "Distance kernels '" << set.name << "' disagree with the reference at length " << n
+                    << ", offset " << offset << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief The kernel set in use, and whether a wider supported set failed the self-check.
+ */
+struct Selection {
+    const KernelSet* set = &SCALAR_KERNELS;
+    bool fellBack = false;
+};
+
+/**
+ * @brief Picks the widest supported kernel set that passes the self-check; runs once.
+ */
+const Selection& selection() {
+    static const Selection selected = []() {
+        Selection result;
+        const std::vector<const KernelSet*> sets = supportedKernelSets();
+        for (const KernelSet* set : sets) {
+            if (agreesWithReference(*set)) {
+                result.set = set;
+                break;
+            }
+        }
+        result.fellBack = !sets.empty() && result.set != sets.front();
+        if (result.fellBack) {
+            std::cerr << "Distance kernels '" << sets.front()->name << "' failed the self-check; using '" << result.set->name
+                << "' kernels" << std::endl;
+        }
+        return result;
+    }();
+    return selected;
+}
+
+const KernelSet& kernels() {
+    return *selection().set;
+}
+
+} // namespace
+
+float squaredL2Distance(const float* a, const float* b, std::size_t n) {
+    return kernels().l2Squared(a, b, n);
+}
+
+float squaredL2DistanceBounded(const float* a, const float* b, std::size_t n, float bound) {
+    return kernels().l2SquaredBounded(a, b, n, bound);
+}
+
+float euclideanDistanceBounded(const float* a, const float* b, std::size_t n, float bound) {
+    // The squared bound is widened by a few units of rounding, so a partial sum above it has a
+    // square root strictly above the bound; rows within rounding of the bound are scored in full
+    const float squaredBound = bound * bound * (1.0f + EUCLIDEAN_BOUND_MARGIN);
+    return std::sqrt(kernels().l2SquaredBounded(a, b, n, squaredBound));
+}
+
+float l1Distance(const float* a, const float* b, std::size_t n) {
+    return kernels().l1(a, b, n);
+}
+
+float intersectionSum(const float* a, const float* b, std::size_t n) {
+    return kernels().intersection(a, b, n);
+}
+
+float dotProduct(const float* a, const float* b, std::size_t n) {
+    return kernels().dot(a, b, n);
+}
+
+CosineTerms cosineTerms(const float* a, const float* b, std::size_t n) {
+    return kernels().cosine(a, b, n);
+}
+
+float inverseLength(const float* a, std::size_t n) {
+    const float squaredLength = kernels().dot(a, a, n);
+    return squaredLength > 0.0f ? 1.0f / std::sqrt(squaredLength) : 0.0f;
+}
+
+const char* distanceKernelName() {
+    return kernels().name;
+}
+
+bool selectDistanceKernels() {
+    return !selection().fellBack;
+}
+
+bool verifyDistanceKernels() {
+    bool agree = agreesWithReference(SCALAR_KERNELS);
+    for (const KernelSet* set : supportedKernelSets()) {
+        agree = agreesWithReference(*set) && agree;
+    }
+    return agree;
+}
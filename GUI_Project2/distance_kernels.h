@@ -0,0 +1,111 @@
+/*! \file distance_kernels.h
+    \brief Declarations for the runtime-dispatched SIMD distance kernels.
+    \author Manushi
+    \date October 16, 2026
+
+    Every matcher compares float vectors with one of a handful of measures: squared Euclidean
+    distance, L1 distance, histogram intersection (sum of bin-wise minima), dot product and
+    cosine similarity. Each has a scalar, an SSE4.2, an AVX2 and an AVX-512 implementation; the
+    widest one the running CPU supports is picked on first use, after checking that it agrees
+    with the scalar implementation. Squared Euclidean distance also has bounded variants for
+    top-K scans, which give up on a row once its running sum passes the current K-th best score.
+*/
+
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+#include <cstddef>
+
+/**
+ * @brief Dot product and squared lengths of two vectors, gathered in one pass for cosine similarity.
+ */
+struct CosineTerms {
+    float dot = 0.0f;
+    float squaredNormA = 0.0f;
+    float squaredNormB = 0.0f;
+};
+
+/**
+ * @brief Sum of squared differences of two vectors of n floats.
+ */
+float squaredL2Distance(const float* a, const float* b, std::size_t n);
+
+/**
+ * @brief Sum of squared differences that stops early once it exceeds a bound.
+ *
+ * The running sum is compared with the bound every 64 to 256 floats, as a top-K scan would compare a
+ * row with its current K-th best score. If the sum stays within the bound the result equals
+ * squaredL2Distance exactly; otherwise the partial sum is returned, which is above the bound and
+ * not above the full sum.
+ *
+ * @param bound Score a row has to beat; +infinity scores every row in full.
+ */
+float squaredL2DistanceBounded(const float* a, const float* b, std::size_t n, float bound);
+
+/**
+ * @brief Euclidean distance that stops early once it exceeds a bound.
+ *
+ * Equals sqrt(squaredL2Distance) unless the distance is above the bound, in which case a value
+ * above the bound (and not above the full distance) is returned.
+ */
+float euclideanDistanceBounded(const float* a, const float* b, std::size_t n, float bound);
+
+/**
+ * @brief Sum of absolute differences of two vectors of n floats.
+ */
+float l1Distance(const float* a, const float* b, std::size_t n);
+
+/**
+ * @brief Histogram intersection: sum of the element-wise minima of two vectors of n floats.
+ */
+float intersectionSum(const float* a, const float* b, std::size_t n);
+
+/**
+ * @brief Dot product of two vectors of n floats.
+ */
+float dotProduct(const float* a, const float* b, std::size_t n);
+
+/**
+ * @brief Dot product and both squared lengths of two vectors of n floats.
+ *
+ * Cosine similarity is dot / sqrt(squaredNormA * squaredNormB); callers decide what a zero
+ * length vector means.
+ */
+CosineTerms cosineTerms(const float* a, const float* b, std::size_t n);
+
+/**
+ * @brief Reciprocal of the Euclidean length of a vector of n floats, or 0 for a zero vector.
+ *
+ * Stored with every row of a feature collection so cosine similarity needs only a dot product:
+ * dot * inverseLength(a) * inverseLength(b), where a zero on either side means no direction.
+ */
+float inverseLength(const float* a, std::size_t n);
+
+/**
+ * @brief Name of the selected kernel set: "avx512", "avx2", "sse4.2" or "scalar".
+ */
+const char* distanceKernelName();
+
+/**
+ * @brief Selects the kernel set now instead of on the first distance computed, running the self-check.
+ *
+ * The application calls this at startup, so a kernel set that fails the check is reported before
+ * any search uses the kernels.
+ *
+ * @return False if the widest kernel set the CPU supports failed the check and a narrower one
+ *         (scalar at the end) is used instead.
+ */
+bool selectDistanceKernels();
+
+/**
+ * @brief Compares every kernel set the CPU supports with the scalar kernels.
+ *
+ * Runs each measure on fixed pseudo-random vectors of every length up to a few hundred floats,
+ * including unaligned starts. Kernel selection runs this check once and falls back to a narrower
+ * set if a wider one disagrees.
+ *
+ * @return True if all supported kernel sets agree with the scalar results within float rounding.
+ */
+bool verifyDistanceKernels();
+
+#endif // DISTANCE_KERNELS_H
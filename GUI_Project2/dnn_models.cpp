@@ -0,0 +1,602 @@
+/*! \file dnn_models.cpp
+    \brief Implements the registry of DNN models shared by the feature extractors.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Every model has a pool of
+    idle instances and a count of the instances in existence. A lease takes an idle instance or,
+    below the limit, loads a new one outside the lock, since parsing a model takes seconds. When
+    the options change, a generation counter makes returned instances of the old options be dropped
+    instead of pooled. Batched passes stack the preprocessed images into one blob and split the
+    output along its first dimension. An int8 network is quantized once, when it is loaded, and
+    pooled like any other instance.
+*/
+
+#include "dnn_models.h"
+#include "distance_kernels.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const DnnModelSpec DENSENET_121 = { "DenseNet-121", "DenseNet_121.prototxt", "DenseNet_121.caffemodel",
+    cv::Size(224, 224), 1.0, cv::Scalar(104, 117, 123), cv::Scalar(), true, 64u << 20 };
+const DnnModelSpec FACE_DETECTOR = { "face detector", "deploy.prototxt", "res10_300x300_ssd_iter_140000_fp16.caffemodel",
+    cv::Size(300, 300), 1.0, cv::Scalar(104.0, 177.0, 123.0), cv::Scalar(), false, 32u << 20 };
+constexpr std::size_t DNN_CALIBRATION_IMAGES = 16;
+constexpr float DNN_FACE_CONFIDENCE = 0.3f; // Detections the precision check compares, as in the face feature extractor
+
+// torchvision preprocessing: RGB scaled to [0, 1] and standardized with the ImageNet mean and
+// standard deviation of each channel, applied to the 0-255 blob as mean * 255 and std * 255
+const DnnModelSpec RESNET_18 = { "ResNet-18", "resnet18.onnx", "",
+    cv::Size(224, 224), 1.0, cv::Scalar(123.675, 116.28, 103.53), cv::Scalar(58.395, 57.12, 57.375), true, 24u << 20 };
+
+const DnnModelSpec FACE_EMBEDDING = { "OpenFace", "openface.nn4.small2.v1.t7", "",
+    cv::Size(96, 96), 1.0 / 255, cv::Scalar(0, 0, 0), cv::Scalar(), true, 8u << 20 };
+
+/**
+ * @brief Instances of one model: the idle ones and how many exist in total.
+ */
+struct ModelPool {
+    std::vector<cv::dnn::Net> idle;
+    std::size_t instances = 0;
+};
+
+std::mutex registryMutex;
+std::condition_variable instanceReturned;
+DnnRuntimeOptions runtimeOptions;
+std::uint64_t optionsGeneration = 0;
+std::map<DnnModel, ModelPool> pools;
+
+/**
+ * @brief Background warm-up thread, joined when the process exits.
+ */
+struct WarmUpThread {
+    std::thread thread;
+    ~WarmUpThread() {
+        if (thread.joinable()) thread.join();
+    }
+};
+WarmUpThread warmUpThread;
+
+/**
+ * @brief Directory the executable was started from.
+ */
+fs::path executableDirectory() {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    const DWORD length = GetModuleFileNameA(NULL, path, MAX_PATH);
+    if (length > 0 && length < MAX_PATH) return fs::path(std::string(path, length)).parent_path();
+#endif
+    return fs::current_path();
+}
+
+/**
+ * @brief Physical memory not in use, in bytes; 0 if unknown.
+ */
+std::uint64_t availableMemory() {
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) return status.ullAvailPhys;
+    return 0;
+#else
+    const long pages = sysconf(_SC_AVPHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    return pages > 0 && pageSize > 0 ? static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize) : 0;
+#endif
+}
+
+/**
+ * @brief Splits an output blob along its first dimension into one flattened row per image.
+ */
+std::vector<std::vector<float>> splitOutputRows(cv::Mat output, std::size_t images) {
+    if (!output.isContinuous()) output = output.clone();
+    if (images == 0 || output.total() % images != 0) {
+        throw std::runtime_error("DNN output of " + std::to_string(output.total()) + " values does not split into "
+            + std::to_string(images) + " images");
+    }
+    const std::size_t width = output.total() / images;
+    const float* values = output.ptr<float>();
+    std::vector<std::vector<float>> rows(images);
+    for (std::size_t i = 0; i < images; ++i) {
+        rows[i].assign(values + i * width, values + (i + 1) * width);
+    }
+    return rows;
+}
+
+/**
+ * @brief Stacks images into one input blob: resized, mean subtracted, scaled and, for a model with a
+ * standard deviation, divided by it channel by channel (blobFromImages has a single scale factor).
+ */
+cv::Mat inputBlob(const DnnModelSpec& spec, const std::vector<cv::Mat>& images) {
+    cv::Mat blob = cv::dnn::blobFromImages(images, spec.scale, spec.inputSize, spec.mean, spec.swapRB, false);
+    if (spec.stdDev != cv::Scalar()) {
+        for (int image = 0; image < blob.size[0]; ++image) {
+            for (int channel = 0; channel < std::min(blob.size[1], 4); ++channel) {
+                cv::Mat plane(blob.size[2], blob.size[3], CV_32F, blob.ptr<float>(image, channel));
+                plane *= 1.0 / spec.stdDev[channel];
+            }
+        }
+    }
+    return blob;
+}
+
+/**
+ * @brief Decodes up to maxImages ".jpg" images of a directory.
+ */
+std::vector<cv::Mat> readSampleImages(const std::string& directory, std::size_t maxImages) {
+    std::vector<cv::Mat> images;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (images.size() >= maxImages) break;
+        if (!entry.is_regular_file() || entry.path().extension() != ".jpg") continue;
+        cv::Mat image = cv::imread(entry.path().string(), cv::IMREAD_COLOR);
+        if (!image.empty()) images.push_back(image);
+    }
+    return images;
+}
+
+/**
+ * @brief Quantizes a network to int8, calibrated on the images of the calibration directory.
+ *
+ * @return The quantized network, or the network unchanged (after a message) if it cannot be quantized.
+ */
+cv::dnn::Net quantizeModel(DnnModel model, cv::dnn::Net& net, const fs::path& modelDirectory, const DnnRuntimeOptions& options) {
+    const DnnModelSpec& spec = dnnModelSpec(model);
+    const fs::path calibrationDirectory = options.calibrationDirectory.empty() ? modelDirectory / "calibration" : fs::path(options.calibrationDirectory);
+    try {
+        const std::vector<cv::Mat> images = readSampleImages(calibrationDirectory.string(), DNN_CALIBRATION_IMAGES);
+        if (images.empty()) {
+            throw std::runtime_error("no calibration images in " + calibrationDirectory.string());
+        }
+        cv::dnn::Net quantized = net.quantize(inputBlob(spec, images), CV_32F, CV_32F);
+
+        // Quantized layers only run on the OpenCV backend on the CPU
+        quantized.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+        quantized.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+        return quantized;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Running " << spec.name << " at fp32, it could not be quantized to int8: " << e.what() << std::endl;
+        return net;
+    }
+}
+
+/**
+ * @brief Parses a model's files and applies the backend, target and precision of the options.
+ */
+cv::dnn::Net loadModel(DnnModel model, const DnnRuntimeOptions& options) {
+    const DnnModelSpec& spec = dnnModelSpec(model);
+    const fs::path directory = options.modelDirectory.empty() ? executableDirectory() / "models" : fs::path(options.modelDirectory);
+
+    const auto start = std::chrono::steady_clock::now();
+    cv::dnn::Net net = *spec.configFile
+        ? cv::dnn::readNet((directory / spec.modelFile).string(), (directory / spec.configFile).string())
+        : cv::dnn::readNet((directory / spec.modelFile).string());
+    net.setPreferableBackend(options.backend);
+    net.setPreferableTarget(options.target);
+    switch (options.precision) {
+    case DnnPrecision::FP16:
+        if (options.target == cv::dnn::DNN_TARGET_CPU) net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU_FP16);
+        else if (options.target == cv::dnn::DNN_TARGET_OPENCL) net.setPreferableTarget(cv::dnn::DNN_TARGET_OPENCL_FP16);
+        break;
+    case DnnPrecision::INT8:
+        net = quantizeModel(model, net, directory, options);
+        break;
+    default:
+        break;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << spec.name << " (" << dnnPrecisionName(options.precision) << ") in " << seconds << " s" << std::endl;
+    return net;
+}
+
+} // namespace
+
+const DnnModelSpec& dnnModelSpec(DnnModel model) {
+    switch (model) {
+    case DnnModel::FaceDetector: return FACE_DETECTOR;
+    case DnnModel::FaceEmbedding: return FACE_EMBEDDING;
+    case DnnModel::ResNet18: return RESNET_18;
+    default: return DENSENET_121;
+    }
+}
+
+const char* dnnPrecisionName(DnnPrecision precision) {
+    switch (precision) {
+    case DnnPrecision::FP16: return "fp16";
+    case DnnPrecision::INT8: return "int8";
+    default: return "fp32";
+    }
+}
+
+bool parseDnnPrecision(const std::string& name, DnnPrecision& precision) {
+    for (DnnPrecision candidate : { DnnPrecision::FP32, DnnPrecision::FP16, DnnPrecision::INT8 }) {
+        if (name == dnnPrecisionName(candidate)) {
+            precision = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void configureDnnModels(const DnnRuntimeOptions& options) {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        runtimeOptions = options;
+        ++optionsGeneration;
+        pools.clear();
+    }
+    instanceReturned.notify_all();
+    if (options.inferenceThreads >= 0) cv::setNumThreads(options.inferenceThreads);
+}
+
+DnnRuntimeOptions dnnModelOptions() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return runtimeOptions;
+}
+
+DnnNetLease::DnnNetLease(DnnModel model) : model(model), generation(0) {
+    DnnRuntimeOptions options;
+    {
+        std::unique_lock<std::mutex> lock(registryMutex);
+        const std::size_t limit = runtimeOptions.maxInstances > 0 ? runtimeOptions.maxInstances : scanThreadCount();
+        instanceReturned.wait(lock, [&]() {
+            const ModelPool& pool = pools[model];
+            return !pool.idle.empty() || pool.instances < limit;
+        });
+
+        ModelPool& pool = pools[model];
+        generation = optionsGeneration;
+        if (!pool.idle.empty()) {
+            instance = pool.idle.back();
+            pool.idle.pop_back();
+            return;
+        }
+        ++pool.instances; // Reserved while it loads
+        options = runtimeOptions;
+    }
+
+    try {
+        instance = loadModel(model, options);
+    }
+    catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (generation == optionsGeneration) --pools[model].instances;
+        }
+        instanceReturned.notify_one();
+        throw;
+    }
+}
+
+DnnNetLease::~DnnNetLease() {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (generation == optionsGeneration) pools[model].idle.push_back(instance);
+    }
+    instanceReturned.notify_one();
+}
+
+cv::Mat DnnNetLease::forward(const cv::Mat& image) {
+    const DnnModelSpec& spec = dnnModelSpec(model);
+    instance.setInput(inputBlob(spec, { image }));
+    return instance.forward();
+}
+
+cv::Mat DnnNetLease::forward(const std::vector<cv::Mat>& images) {
+    const DnnModelSpec& spec = dnnModelSpec(model);
+    instance.setInput(inputBlob(spec, images));
+    return instance.forward();
+}
+
+std::vector<float> dnnFeatures(DnnModel model, const cv::Mat& image) {
+    DnnNetLease lease(model);
+    cv::Mat output = lease.forward(image);
+    if (!output.isContinuous()) output = output.clone();
+    const float* values = output.ptr<float>();
+    return std::vector<float>(values, values + output.total());
+}
+
+std::vector<std::vector<float>> dnnFeatureBatch(DnnModel model, const std::vector<cv::Mat>& images) {
+    if (images.empty()) return {};
+    DnnNetLease lease(model);
+    return splitOutputRows(lease.forward(images), images.size());
+}
+
+std::size_t dnnBatchSize(DnnModel model) {
+    std::size_t batchSize = std::max<std::size_t>(dnnModelOptions().batchSize, 1);
+    const std::uint64_t available = availableMemory();
+    if (available > 0) {
+        const std::uint64_t fitting = available / 4 / dnnModelSpec(model).bytesPerImage;
+        batchSize = static_cast<std::size_t>(std::max<std::uint64_t>(std::min<std::uint64_t>(batchSize, fitting), 1));
+    }
+    return batchSize;
+}
+
+ImageBatchFeatureExtractor dnnBatchExtractor(DnnModel model, DnnFeatureCombiner combine) {
+    return [model, combine](const std::vector<std::string>& imagePaths, std::vector<std::vector<float>>& features,
+        std::vector<char>& extracted) {
+        // Images are decoded on the scan threads; the forward pass then uses OpenCV's own threads
+        std::vector<cv::Mat> decoded(imagePaths.size());
+        parallelFor(imagePaths.size(), [&](std::size_t i) { decoded[i] = cv::imread(imagePaths[i], cv::IMREAD_COLOR); });
+
+        std::vector<cv::Mat> images;
+        std::vector<std::size_t> slots;
+        for (std::size_t i = 0; i < imagePaths.size(); ++i) {
+            const cv::Mat& image = decoded[i];
+            if (image.empty()) {
+                std::cerr << "Could not read the image: " << imagePaths[i] << std::endl;
+                continue;
+            }
+            images.push_back(image);
+            slots.push_back(i);
+        }
+
+        // One forward pass for the whole batch, then each output row goes back to its image
+        const std::vector<std::vector<float>> dnnRows = dnnFeatureBatch(model, images);
+        for (std::size_t j = 0; j < images.size(); ++j) {
+            const std::size_t slot = slots[j];
+            try {
+                features[slot] = combine(imagePaths[slot], images[j], dnnRows[j]);
+                extracted[slot] = 1;
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Could not extract features from " << imagePaths[slot] << ": " << e.what() << std::endl;
+            }
+        }
+    };
+}
+
+void benchmarkDnnThroughput(DnnModel model, const std::string& imageDirectory, const std::vector<std::size_t>& batchSizes,
+    std::size_t maxImages) {
+    const std::vector<cv::Mat> images = readSampleImages(imageDirectory, maxImages);
+    if (images.empty()) {
+        throw std::runtime_error("No images to benchmark in " + imageDirectory);
+    }
+
+    const DnnModelSpec& spec = dnnModelSpec(model);
+    std::cout << "Benchmarking " << spec.name << " (" << dnnPrecisionName(dnnModelOptions().precision) << ") on " << images.size() << " images (batch size "
+        << dnnBatchSize(model) << " fits in memory)" << std::endl;
+    for (std::size_t batchSize : batchSizes) {
+        batchSize = std::max<std::size_t>(batchSize, 1);
+        DnnNetLease lease(model);
+
+        // The first pass at a new batch shape allocates the network's buffers; it is not timed
+        lease.forward(std::vector<cv::Mat>(images.begin(), images.begin() + std::min(batchSize, images.size())));
+
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t begin = 0; begin < images.size(); begin += batchSize) {
+            const std::size_t end = std::min(begin + batchSize, images.size());
+            lease.forward(std::vector<cv::Mat>(images.begin() + begin, images.begin() + end));
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "  batch " << batchSize << ": " << images.size() / seconds << " images/s" << std::endl;
+    }
+}
+
+void warmUpDnnModels(const std::vector<DnnModel>& models) {
+    for (DnnModel model : models) {
+        try {
+            DnnNetLease lease(model);
+            lease.forward(cv::Mat(dnnModelSpec(model).inputSize, CV_8UC3, cv::Scalar::all(0)));
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Could not warm up " << dnnModelSpec(model).name << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+void startDnnWarmUp(const std::vector<DnnModel>& models) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (warmUpThread.thread.joinable()) return; // Warmed up once per process
+    warmUpThread.thread = std::thread([models]() { warmUpDnnModels(models); });
+}
+
+namespace {
+
+/**
+ * @brief Outputs of a model for a set of images at the current options, and how fast they were computed.
+ */
+std::vector<std::vector<float>> runSampleImages(DnnModel model, const std::vector<cv::Mat>& images, double& imagesPerSecond) {
+    const std::size_t batchSize = dnnBatchSize(model);
+
+    // Loading (and quantizing) happens on the first pass, which is not timed
+    dnnFeatureBatch(model, std::vector<cv::Mat>(images.begin(), images.begin() + std::min(batchSize, images.size())));
+
+    std::vector<std::vector<float>> rows;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t begin = 0; begin < images.size(); begin += batchSize) {
+        const std::size_t end = std::min(begin + batchSize, images.size());
+        std::vector<std::vector<float>> batch = dnnFeatureBatch(model, std::vector<cv::Mat>(images.begin() + begin, images.begin() + end));
+        for (auto& row : batch) rows.push_back(std::move(row));
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    imagesPerSecond = seconds > 0 ? images.size() / seconds : 0;
+    return rows;
+}
+
+/**
+ * @brief Faces the detector finds in each image at the current options, as boxes relative to the
+ * image size, and how fast they were found.
+ *
+ * A batched pass returns the detections of all its images in one list whose first column is the
+ * image's index in the batch.
+ */
+std::vector<std::vector<cv::Rect2f>> detectSampleFaces(const std::vector<cv::Mat>& images, double& imagesPerSecond) {
+    const std::size_t batchSize = dnnBatchSize(DnnModel::FaceDetector);
+    DnnNetLease lease(DnnModel::FaceDetector);
+
+    // Loading (and quantizing) happens on the first pass, which is not timed
+    lease.forward(std::vector<cv::Mat>(images.begin(), images.begin() + std::min(batchSize, images.size())));
+
+    std::vector<std::vector<cv::Rect2f>> faces(images.size());
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t begin = 0; begin < images.size(); begin += batchSize) {
+        const std::size_t end = std::min(begin + batchSize, images.size());
+        cv::Mat detections = lease.forward(std::vector<cv::Mat>(images.begin() + begin, images.begin() + end));
+        if (!detections.isContinuous()) detections = detections.clone();
+        const float* values = detections.ptr<float>();
+        for (std::size_t i = 0; i + 7 <= detections.total(); i += 7) {
+            const float* detection = values + i;
+            const std::size_t image = begin + static_cast<std::size_t>(std::max(detection[0], 0.0f));
+            if (detection[2] > DNN_FACE_CONFIDENCE && image < end) {
+                faces[image].emplace_back(detection[3], detection[4], detection[5] - detection[3], detection[6] - detection[4]);
+            }
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    imagesPerSecond = seconds > 0 ? images.size() / seconds : 0;
+    return faces;
+}
+
+/**
+ * @brief Compares the faces found at one precision with the fp32 faces of the same images.
+ *
+ * @param meanOverlap Set to the mean intersection over union of each fp32 face with its closest face.
+ * @param recall Set to the fraction of fp32 faces matched with an overlap of at least 0.5.
+ */
+void compareSampleFaces(const std::vector<std::vector<cv::Rect2f>>& reference, const std::vector<std::vector<cv::Rect2f>>& faces,
+    double& meanOverlap, double& recall) {
+    double overlapSum = 0;
+    std::size_t found = 0, total = 0;
+    for (std::size_t i = 0; i < reference.size(); ++i) {
+        for (const cv::Rect2f& expected : reference[i]) {
+            double best = 0;
+            for (const cv::Rect2f& face : faces[i]) {
+                const double intersection = (expected & face).area();
+                const double unionArea = expected.area() + face.area() - intersection;
+                if (unionArea > 0) best = std::max(best, intersection / unionArea);
+            }
+            overlapSum += best;
+            found += best >= 0.5 ? 1 : 0;
+            ++total;
+        }
+    }
+    meanOverlap = total > 0 ? overlapSum / total : 1.0;
+    recall = total > 0 ? static_cast<double>(found) / total : 1.0;
+}
+
+/**
+ * @brief Cosine similarity of two outputs; 0 if either has no direction.
+ */
+float outputCosine(const std::vector<float>& a, const std::vector<float>& b) {
+    const std::size_t n = std::min(a.size(), b.size());
+    return dotProduct(a.data(), b.data(), n) * inverseLength(a.data(), n) * inverseLength(b.data(), n);
+}
+
+/**
+ * @brief The topK other images whose outputs are closest to one image's by cosine similarity, closest first.
+ */
+std::vector<std::size_t> nearestOutputs(const std::vector<std::vector<float>>& rows, std::size_t query, std::size_t topK) {
+    std::vector<std::pair<float, std::size_t>> similarities;
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        if (i != query) similarities.emplace_back(-outputCosine(rows[query], rows[i]), i);
+    }
+    topK = std::min(topK, similarities.size());
+    std::partial_sort(similarities.begin(), similarities.begin() + topK, similarities.end());
+    std::vector<std::size_t> nearest;
+    for (std::size_t i = 0; i < topK; ++i) nearest.push_back(similarities[i].second);
+    return nearest;
+}
+
+} // namespace
+
+std::vector<DnnPrecisionResult> checkDnnPrecision(DnnModel model, const std::string& imageDirectory,
+    const std::vector<DnnPrecision>& precisions, std::size_t topK, std::size_t maxImages) {
+    const std::vector<cv::Mat> images = readSampleImages(imageDirectory, maxImages);
+    const bool detector = model == DnnModel::FaceDetector;
+    if (detector ? images.empty() : (images.size() <= topK || topK == 0)) {
+        throw std::runtime_error("The precision check needs more than " + std::to_string(detector ? 0 : topK) + " images in " + imageDirectory);
+    }
+
+    const DnnRuntimeOptions original = dnnModelOptions();
+    auto configureAt = [&](DnnPrecision precision) {
+        DnnRuntimeOptions options = original;
+        options.precision = precision;
+        configureDnnModels(options);
+    };
+    auto runAt = [&](DnnPrecision precision, double& imagesPerSecond) {
+        configureAt(precision);
+        return runSampleImages(model, images, imagesPerSecond);
+    };
+    auto detectAt = [&](DnnPrecision precision, double& imagesPerSecond) {
+        configureAt(precision);
+        return detectSampleFaces(images, imagesPerSecond);
+    };
+
+    std::vector<DnnPrecisionResult> results;
+    try {
+        double referenceSpeed = 0;
+        if (detector) {
+            const std::vector<std::vector<cv::Rect2f>> reference = detectAt(DnnPrecision::FP32, referenceSpeed);
+            for (DnnPrecision precision : precisions) {
+                DnnPrecisionResult result;
+                result.precision = precision;
+                result.imagesPerSecond = referenceSpeed;
+                compareSampleFaces(reference, precision == DnnPrecision::FP32 ? reference : detectAt(precision, result.imagesPerSecond),
+                    result.meanCosine, result.recall);
+                results.push_back(result);
+            }
+        }
+        else {
+            const std::vector<std::vector<float>> reference = runAt(DnnPrecision::FP32, referenceSpeed);
+            std::vector<std::vector<std::size_t>> referenceNeighbours;
+            for (std::size_t i = 0; i < reference.size(); ++i) referenceNeighbours.push_back(nearestOutputs(reference, i, topK));
+
+            for (DnnPrecision precision : precisions) {
+                DnnPrecisionResult result;
+                result.precision = precision;
+                const std::vector<std::vector<float>> rows = precision == DnnPrecision::FP32 ? reference : runAt(precision, result.imagesPerSecond);
+                if (precision == DnnPrecision::FP32) result.imagesPerSecond = referenceSpeed;
+
+                double cosineSum = 0, recallSum = 0;
+                for (std::size_t i = 0; i < rows.size(); ++i) {
+                    cosineSum += outputCosine(rows[i], reference[i]);
+                    std::vector<std::size_t> found = nearestOutputs(rows, i, topK);
+                    std::vector<std::size_t> expected = referenceNeighbours[i];
+                    std::sort(found.begin(), found.end());
+                    std::sort(expected.begin(), expected.end());
+                    std::vector<std::size_t> common;
+                    std::set_intersection(found.begin(), found.end(), expected.begin(), expected.end(), std::back_inserter(common));
+                    recallSum += static_cast<double>(common.size()) / expected.size();
+                }
+                result.meanCosine = cosineSum / rows.size();
+                result.recall = recallSum / rows.size();
+                results.push_back(result);
+            }
+        }
+    }
+    catch (...) {
+        configureDnnModels(original);
+        throw;
+    }
+    configureDnnModels(original);
+
+    std::cout << "Precision check of " << dnnModelSpec(model).name << " on " << images.size() << " images, "
+        << (detector ? std::string("faces found") : "recall@" + std::to_string(topK)) << " against fp32:" << std::endl;
+    for (const DnnPrecisionResult& result : results) {
+        std::cout << "  " << dnnPrecisionName(result.precision) << ": " << result.imagesPerSecond << " images/s, "
+            << (detector ? "mean overlap " : "mean cosine ") << result.meanCosine << ", recall " << result.recall << std::endl;
+    }
+    return results;
+}
@@ -0,0 +1,235 @@
+/*! \file dnn_models.h
+    \brief Declarations for the registry of DNN models shared by the feature extractors.
+    \author Manushi
+    \date October 16, 2026
+
+    The custom design extractors run three networks: DenseNet-121 for image features, an SSD face
+    detector and the OpenFace embedding model; deep network embeddings come from ResNet-18. Parsing a model costs far more than running it on
+    one image, so the registry loads each network once and keeps a pool of loaded instances per
+    model. A caller leases an instance for its forward passes and gives it back when the lease
+    ends; a cv::dnn::Net is not safe to run from two threads at once, so concurrent callers get
+    instances of their own, up to a configurable limit. The models can be warmed up in the
+    background when the application starts, so the first query does not pay for loading them.
+
+    Indexing runs DenseNet-121 on batches of images, one forward pass per batch, which keeps the
+    inference engine far busier than one image per pass; the batch size is capped by the memory
+    available when indexing starts.
+
+    The networks can run at reduced precision: fp16 on targets that support it, or int8 after
+    OpenCV quantizes them with a few calibration images. A precision check measures how much
+    each setting speeds a model up and how well its outputs keep the fp32 nearest neighbours.
+*/
+
+#ifndef DNN_MODELS_H
+#define DNN_MODELS_H
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "feature_indexer.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The networks the feature extractors use.
+ */
+enum class DnnModel {
+    DenseNet121,   ///< Image features for the custom design extractors (Caffe).
+    FaceDetector,  ///< SSD face detector with a ResNet-10 base (Caffe).
+    FaceEmbedding, ///< OpenFace nn4.small2 face embeddings (Torch).
+    ResNet18       ///< 512-value image embeddings from the pooling layer of ResNet-18 (ONNX, exported without its classifier).
+};
+
+/**
+ * @brief Files and input preprocessing of one model.
+ */
+struct DnnModelSpec {
+    const char* name;
+    const char* modelFile;   // Relative to the model directory
+    const char* configFile;  // Relative to the model directory; empty for single-file models
+    cv::Size inputSize;
+    double scale;
+    cv::Scalar mean;
+    cv::Scalar stdDev;  // Per-channel divisor applied after the mean and scale; zero for none
+    bool swapRB;
+    std::size_t bytesPerImage;  // Rough working memory of one image in a batched forward pass
+};
+
+/**
+ * @brief Returns the files and preprocessing of a model.
+ */
+const DnnModelSpec& dnnModelSpec(DnnModel model);
+
+/**
+ * @brief Numeric precision the networks run at.
+ */
+enum class DnnPrecision {
+    FP32,  ///< Full precision, as the models were trained.
+    FP16,  ///< Half precision on the CPU or OpenCL target; other targets keep their own precision.
+    INT8   ///< Weights and activations quantized by OpenCV from calibration images; falls back to fp32 if a model cannot be quantized.
+};
+
+/**
+ * @brief Returns "fp32", "fp16" or "int8".
+ */
+const char* dnnPrecisionName(DnnPrecision precision);
+
+/**
+ * @brief Parses "fp32", "fp16" or "int8".
+ *
+ * @return False if the name is not one of them.
+ */
+bool parseDnnPrecision(const std::string& name, DnnPrecision& precision);
+
+/**
+ * @brief How the registry loads and runs networks.
+ */
+struct DnnRuntimeOptions {
+    std::string modelDirectory;                  // Empty: the "models" directory next to the executable
+    int backend = cv::dnn::DNN_BACKEND_DEFAULT;  // cv::dnn::Backend of every loaded network
+    int target = cv::dnn::DNN_TARGET_CPU;        // cv::dnn::Target of every loaded network
+    int inferenceThreads = -1;                   // Threads OpenCV uses inside one forward pass; -1 keeps its default
+    std::size_t maxInstances = 0;                // Instances kept per model; 0 uses one per scan thread
+    std::size_t batchSize = 32;                  // Most images per batched forward pass; fewer if memory is short
+    DnnPrecision precision = DnnPrecision::FP32; // Precision every loaded network runs at
+    std::string calibrationDirectory;            // Images int8 quantization calibrates with; empty: "calibration" in the model directory
+};
+
+/**
+ * @brief Replaces the runtime options; loaded networks are dropped and reloaded on next use.
+ *
+ * Leases held while the options change stay valid; their instances are discarded when returned.
+ */
+void configureDnnModels(const DnnRuntimeOptions& options);
+
+/**
+ * @brief Returns the current runtime options.
+ */
+DnnRuntimeOptions dnnModelOptions();
+
+/**
+ * @brief Exclusive use of one loaded instance of a model, returned to the pool when the lease ends.
+ */
+class DnnNetLease {
+public:
+    /**
+     * @brief Takes an idle instance, loads a new one if the pool is below its limit, or waits for one.
+     *
+     * @throws cv::Exception If the model files cannot be loaded.
+     */
+    explicit DnnNetLease(DnnModel model);
+    ~DnnNetLease();
+
+    DnnNetLease(const DnnNetLease&) = delete;
+    DnnNetLease& operator=(const DnnNetLease&) = delete;
+
+    cv::dnn::Net& net() { return instance; }
+
+    /**
+     * @brief Preprocesses an image as the model expects and runs one forward pass.
+     */
+    cv::Mat forward(const cv::Mat& image);
+
+    /**
+     * @brief Preprocesses several images as the model expects and runs them in one forward pass.
+     *
+     * @return The output blob; its first dimension is the image.
+     */
+    cv::Mat forward(const std::vector<cv::Mat>& images);
+
+private:
+    DnnModel model;
+    cv::dnn::Net instance;
+    std::uint64_t generation; // Options generation the instance was loaded under
+};
+
+/**
+ * @brief Runs a model on an image and returns its output flattened into one row.
+ */
+std::vector<float> dnnFeatures(DnnModel model, const cv::Mat& image);
+
+/**
+ * @brief Runs a model on several images in one forward pass and returns each image's output flattened into one row.
+ */
+std::vector<std::vector<float>> dnnFeatureBatch(DnnModel model, const std::vector<cv::Mat>& images);
+
+/**
+ * @brief Batch size for a model: the batchSize option, capped so a batch uses at most a quarter of the available memory.
+ *
+ * @return At least 1.
+ */
+std::size_t dnnBatchSize(DnnModel model);
+
+/**
+ * @brief Builds the feature row of one image from the decoded image and its row of model output.
+ */
+using DnnFeatureCombiner = std::function<std::vector<float>(const std::string& imagePath, const cv::Mat& image,
+    const std::vector<float>& dnnRow)>;
+
+/**
+ * @brief Adapts a combiner to the indexing job: decodes a batch of image files, runs the model on
+ *        all of them in one forward pass and combines each image with its output row.
+ *
+ * Images that cannot be decoded or combined are reported and left out; a failed forward pass throws,
+ * so the indexer retries the images one at a time.
+ */
+ImageBatchFeatureExtractor dnnBatchExtractor(DnnModel model, DnnFeatureCombiner combine);
+
+/**
+ * @brief Measures a model's throughput at several batch sizes and prints images per second for each.
+ *
+ * @param imageDirectory Directory whose ".jpg" images are run through the model.
+ * @param batchSizes Batch sizes to measure.
+ * @param maxImages Most images decoded from the directory; each batch size runs over all of them.
+ */
+void benchmarkDnnThroughput(DnnModel model, const std::string& imageDirectory, const std::vector<std::size_t>& batchSizes,
+    std::size_t maxImages = 64);
+
+/**
+ * @brief Loads one instance of each model and runs it once on a blank image; failures are reported, not thrown.
+ */
+void warmUpDnnModels(const std::vector<DnnModel>& models);
+
+/**
+ * @brief Runs warmUpDnnModels on a background thread and returns at once.
+ *
+ * Queries that arrive while the warm-up runs take the instances it has finished loading, or load their own.
+ */
+void startDnnWarmUp(const std::vector<DnnModel>& models = { DnnModel::DenseNet121, DnnModel::FaceDetector, DnnModel::FaceEmbedding,
+    DnnModel::ResNet18 });
+
+/**
+ * @brief Speed and accuracy of a model at one precision, measured against fp32 on sample images.
+ *
+ * For the face detector, whose outputs are boxes rather than vectors, meanCosine is the mean overlap
+ * (intersection over union) of each fp32 face with its closest face at this precision, and recall is
+ * the fraction of fp32 faces found with an overlap of at least 0.5.
+ */
+struct DnnPrecisionResult {
+    DnnPrecision precision;
+    double imagesPerSecond = 0;  // Throughput of batched forward passes
+    double meanCosine = 0;       // Mean cosine similarity of each image's output to its fp32 output
+    double recall = 0;           // Mean fraction of each image's fp32 top-K neighbours (by cosine) found at this precision
+};
+
+/**
+ * @brief Runs a model on sample images at each precision and compares its outputs and their nearest neighbours with fp32.
+ *
+ * Every sample image is a query against the others, so the recall is that of a retrieval over the
+ * sample set. The face detector is instead compared on the faces it finds. The runtime options are
+ * restored afterwards. Results are also printed.
+ *
+ * @param model The model to check.
+ * @param imageDirectory Directory whose ".jpg" images form the sample set.
+ * @param precisions Precisions to compare with fp32.
+ * @param topK Neighbours compared per query (unused for the face detector).
+ * @param maxImages Most images decoded from the directory.
+ * @return One result per precision, in the order given.
+ * @throws std::runtime_error If the directory has no more than topK images (no images for the face detector).
+ */
+std::vector<DnnPrecisionResult> checkDnnPrecision(DnnModel model, const std::string& imageDirectory,
+    const std::vector<DnnPrecision>& precisions, std::size_t topK = 10, std::size_t maxImages = 200);
+
+#endif // DNN_MODELS_H
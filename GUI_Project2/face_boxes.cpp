@@ -0,0 +1,150 @@
+/*! \file face_boxes.cpp
+    \brief Implements the face detections stored alongside a custom design face feature file.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. The file is small (a few
+    boxes per image), so it is read whole into a map rather than memory-mapped.
+
+    File layout (all integers little endian):
+      - FaceBoxesHeader
+      - for every image: uint32 path bytes, uint32 face count, the path, face count x FaceBox
+*/
+
+#include "face_boxes.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char FACE_BOXES_MAGIC[8] = { 'C', 'B', 'I', 'R', 'F', 'A', 'C', 'E' };
+constexpr std::uint32_t FACE_BOXES_VERSION = 1;
+
+#pragma pack(push, 1)
+/**
+ * @brief Fixed-size header at the start of a face box file.
+ */
+struct FaceBoxesHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t imageCount;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FaceBox) == 5 * sizeof(float), "FaceBox is stored as five floats");
+
+struct CachedFaceBoxes {
+    std::uintmax_t fileSize = 0;
+    fs::file_time_type modifiedTime;
+    FaceBoxesHandle boxes;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedFaceBoxes> cachedFaceBoxes;
+
+} // namespace
+
+std::string faceBoxesPath(const std::string& featureFilePath) {
+    return featureFilePath + ".faces";
+}
+
+FaceBoxMap loadFaceBoxes(const std::string& faceBoxesFilePath) {
+    FaceBoxMap boxes;
+    std::ifstream in(faceBoxesFilePath, std::ios::binary);
+    if (!in.is_open()) return boxes;
+
+    FaceBoxesHeader header = {};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, FACE_BOXES_MAGIC, sizeof(header.magic)) != 0 || header.version != FACE_BOXES_VERSION) {
+        throw std::runtime_error("Not a valid face box file (or unsupported version): " + faceBoxesFilePath);
+    }
+
+    const std::uintmax_t fileSize = fs::file_size(faceBoxesFilePath);
+    for (std::uint64_t image = 0; image < header.imageCount; ++image) {
+        std::uint32_t counts[2] = {};
+        in.read(reinterpret_cast<char*>(counts), sizeof(counts));
+        if (!in || counts[0] + static_cast<std::uintmax_t>(counts[1]) * sizeof(FaceBox) > fileSize) {
+            throw std::runtime_error("Face box file is truncated: " + faceBoxesFilePath);
+        }
+        std::string path(counts[0], '\0');
+        std::vector<FaceBox> faces(counts[1]);
+        in.read(&path[0], counts[0]);
+        in.read(reinterpret_cast<char*>(faces.data()), static_cast<std::streamsize>(faces.size() * sizeof(FaceBox)));
+        if (!in) {
+            throw std::runtime_error("Face box file is truncated: " + faceBoxesFilePath);
+        }
+        boxes[path] = std::move(faces);
+    }
+    return boxes;
+}
+
+void saveFaceBoxes(const std::string& faceBoxesFilePath, const FaceBoxMap& boxes) {
+    FaceBoxesHeader header = {};
+    std::memcpy(header.magic, FACE_BOXES_MAGIC, sizeof(header.magic));
+    header.version = FACE_BOXES_VERSION;
+    header.imageCount = boxes.size();
+
+    // Written under a temporary name so an interrupted write never leaves a half-written file
+    const std::string partialPath = faceBoxesFilePath + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to open face box file for writing: " + partialPath);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& image : boxes) {
+            const std::uint32_t counts[2] = { static_cast<std::uint32_t>(image.first.size()), static_cast<std::uint32_t>(image.second.size()) };
+            out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+            out.write(image.first.data(), static_cast<std::streamsize>(image.first.size()));
+            out.write(reinterpret_cast<const char*>(image.second.data()), static_cast<std::streamsize>(image.second.size() * sizeof(FaceBox)));
+        }
+        if (!out.good()) {
+            throw std::runtime_error("Error writing face box file: " + partialPath);
+        }
+    }
+    std::error_code error;
+    fs::rename(partialPath, faceBoxesFilePath, error);
+    if (error) {
+        fs::remove(partialPath, error);
+        throw std::runtime_error("Unable to replace face box file: " + faceBoxesFilePath);
+    }
+}
+
+FaceBoxesHandle openFaceBoxes(const std::string& featureFilePath) {
+    const std::string faceBoxesFilePath = faceBoxesPath(featureFilePath);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(faceBoxesFilePath, error);
+    const fs::file_time_type modifiedTime = fs::last_write_time(faceBoxesFilePath, error);
+    if (error) {
+        std::cerr << "No stored face boxes for " << featureFilePath << "; calculate its features again to store them" << std::endl;
+        cachedFaceBoxes.erase(faceBoxesFilePath);
+        return std::make_shared<const FaceBoxMap>();
+    }
+    auto cached = cachedFaceBoxes.find(faceBoxesFilePath);
+    if (cached != cachedFaceBoxes.end() && cached->second.fileSize == fileSize && cached->second.modifiedTime == modifiedTime) {
+        return cached->second.boxes;
+    }
+
+    CachedFaceBoxes entry;
+    entry.fileSize = fileSize;
+    entry.modifiedTime = modifiedTime;
+    try {
+        entry.boxes = std::make_shared<const FaceBoxMap>(loadFaceBoxes(faceBoxesFilePath));
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << "Ignoring stored face boxes: " << e.what() << std::endl;
+        entry.boxes = std::make_shared<const FaceBoxMap>();
+    }
+    cachedFaceBoxes[faceBoxesFilePath] = entry;
+    return entry.boxes;
+}
@@ -0,0 +1,70 @@
+/*! \file face_boxes.h
+    \brief Declarations for the face detections stored alongside a custom design face feature file.
+    \author Manushi
+    \date October 16, 2026
+
+    Indexing custom design face features runs the SSD face detector on every image to embed its
+    faces. The boxes it finds are kept, with their confidences, in "<featureFile>.faces", so a
+    query can draw the faces of its matches without running the detector again. Boxes are stored
+    in coordinates relative to the image size, so they fit the image however it is decoded.
+*/
+
+#ifndef FACE_BOXES_H
+#define FACE_BOXES_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One detected face; corners are fractions of the image width and height.
+ */
+struct FaceBox {
+    float left;
+    float top;
+    float right;
+    float bottom;
+    float confidence;
+};
+
+/**
+ * @brief Detected faces of every image of a feature file, by image path.
+ */
+using FaceBoxMap = std::map<std::string, std::vector<FaceBox>>;
+
+/**
+ * @brief Shared, read-only handle to the cached face boxes of a feature file.
+ */
+using FaceBoxesHandle = std::shared_ptr<const FaceBoxMap>;
+
+/**
+ * @brief Returns the path of the face box file that belongs to a feature file.
+ */
+std::string faceBoxesPath(const std::string& featureFilePath);
+
+/**
+ * @brief Reads a face box file.
+ *
+ * @param faceBoxesFilePath Path to the ".faces" file.
+ * @return The boxes by image path; empty if the file does not exist.
+ * @throws std::runtime_error If the file exists but is not a valid face box file.
+ */
+FaceBoxMap loadFaceBoxes(const std::string& faceBoxesFilePath);
+
+/**
+ * @brief Writes a face box file, replacing any previous one only once it is complete.
+ *
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void saveFaceBoxes(const std::string& faceBoxesFilePath, const FaceBoxMap& boxes);
+
+/**
+ * @brief Returns the face boxes of a feature file, read once and cached until the file changes.
+ *
+ * @return The boxes; an empty map (after a message) if the file is missing or invalid.
+ */
+FaceBoxesHandle openFaceBoxes(const std::string& featureFilePath);
+
+#endif // FACE_BOXES_H
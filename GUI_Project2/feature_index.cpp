@@ -0,0 +1,105 @@
+/*! \file feature_index.cpp
+    \brief Implements the process-resident feature index cache.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. It keeps every feature file
+    that has been queried open (feature stores mapped, CSV files parsed) and revalidates it against
+    the file's size and modification time on each open. Inverse component lengths are taken from
+    feature stores that hold them and measured on the scan threads otherwise.
+*/
+
+#include "feature_index.h"
+#include "parallel_scan.h"
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::mutex cacheMutex;
+std::map<std::string, FeatureIndexHandle> cachedIndexes;
+
+/**
+ * @brief Loads a feature file into a new index.
+ *
+ * @param filePath Path to the CSV feature file or binary feature store.
+ * @param fileSize Size of the file when the load started.
+ * @param modifiedTime Modification time of the file when the load started.
+ * @return The loaded index.
+ * @throws std::runtime_error If the file cannot be read.
+ */
+FeatureIndexHandle loadFeatureIndex(const std::string& filePath, std::uintmax_t fileSize, fs::file_time_type modifiedTime) {
+    auto index = std::make_shared<FeatureIndex>();
+    index->filePath = filePath;
+    index->fileSize = fileSize;
+    index->modifiedTime = modifiedTime;
+
+    if (FeatureStore::isFeatureStoreFile(filePath)) {
+        // The rows are read from the mapping; the matrix keeps the store open
+        auto store = std::make_shared<const FeatureStore>(filePath);
+        index->features = FeatureMatrix(store);
+        index->components = resolveFeatureComponents(store->info(), store->dims());
+        if (store->hasInverseLengths() && !store->info().components.empty()) {
+            const float* lengths = store->inverseLengths(0);
+            index->inverseLengths.assign(lengths, lengths + store->rows() * index->components.size());
+        }
+    }
+    else {
+        index->features = readFeatureMatrix(filePath);
+        index->components = { { "features", 0, static_cast<std::uint32_t>(index->features.dims()) } };
+    }
+
+    // CSV files and version 1 stores carry no lengths, so they are measured once here
+    if (index->inverseLengths.empty()) {
+        const std::size_t perRow = index->components.size();
+        index->inverseLengths.resize(index->size() * perRow);
+        parallelFor(index->size(), [&](std::size_t row) {
+            computeInverseLengths(index->features.row(row), index->components, index->inverseLengths.data() + row * perRow);
+        });
+    }
+
+    std::cout << "Loaded " << index->size() << " feature rows from " << filePath << std::endl;
+    return index;
+}
+
+} // namespace
+
+std::size_t FeatureIndex::componentIndex(const std::string& name) const {
+    for (std::size_t i = 0; i < components.size(); ++i) {
+        if (components[i].name == name) return i;
+    }
+    return components.size();
+}
+
+FeatureIndexHandle openFeatureIndex(const std::string& filePath) {
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(filePath, error);
+    if (error) {
+        throw std::runtime_error("Unable to open feature file: " + filePath);
+    }
+    const fs::file_time_type modifiedTime = fs::last_write_time(filePath, error);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto cached = cachedIndexes.find(filePath);
+    if (cached != cachedIndexes.end() && cached->second->fileSize == fileSize && cached->second->modifiedTime == modifiedTime) {
+        return cached->second;
+    }
+
+    FeatureIndexHandle index = loadFeatureIndex(filePath, fileSize, modifiedTime);
+    cachedIndexes[filePath] = index;
+    return index;
+}
+
+void releaseFeatureIndex(const std::string& filePath) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cachedIndexes.erase(filePath);
+}
+
+void clearFeatureIndexCache() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cachedIndexes.clear();
+}
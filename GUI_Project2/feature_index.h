@@ -0,0 +1,82 @@
+/*! \file feature_index.h
+    \brief Declarations for the process-resident feature index cache.
+    \author Manushi
+    \date October 16, 2026
+
+    A feature index holds the rows of one feature file in a feature matrix (a binary feature store
+    is read in place from its mapping, a CSV file is parsed into an aligned matrix), together
+    with the inverse length of every component of every row (read from the feature store, or
+    measured once when the file is loaded).
+    Indexes are opened once and kept in a process-wide cache keyed by file path, so repeated
+    queries from the GUI or from batch callers only pay the scoring cost. A cached index is
+    reloaded automatically when the size or modification time of its file changes.
+*/
+
+#ifndef FEATURE_INDEX_H
+#define FEATURE_INDEX_H
+
+#include "feature_matrix.h"
+#include "feature_store.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A feature collection loaded into memory, together with the file state it was loaded from.
+ */
+struct FeatureIndex {
+    std::string filePath;
+    std::uintmax_t fileSize = 0;
+    std::filesystem::file_time_type modifiedTime;
+
+    FeatureMatrix features; // Feature rows (mapped for feature stores) and the image path of every row
+    std::vector<FeatureComponent> components; // Component layout; one "features" component for CSV files
+    std::vector<float> inverseLengths;        // components.size() per row: 1 / length of the component, 0 if it is zero
+
+    std::size_t size() const { return features.rows(); }
+
+    /**
+     * @brief Inverse length of one component of a row, so cosine similarity is dot * inverseLength * inverseLength.
+     */
+    float inverseLength(std::size_t row, std::size_t component) const { return inverseLengths[row * components.size() + component]; }
+
+    /**
+     * @brief Position of a component in the layout, or components.size() if there is none with that name.
+     */
+    std::size_t componentIndex(const std::string& name) const;
+};
+
+/**
+ * @brief Shared, read-only handle to a cached feature index.
+ *
+ * Holding the handle keeps the index alive even if the cache reloads or drops it.
+ */
+using FeatureIndexHandle = std::shared_ptr<const FeatureIndex>;
+
+/**
+ * @brief Returns the cached index for a feature file, loading or reloading it if needed.
+ *
+ * The file is loaded on the first call and whenever its size or modification time differs
+ * from the cached copy; otherwise the cached index is returned without touching the file contents.
+ *
+ * @param filePath Path to the CSV feature file or binary feature store.
+ * @return Handle to the loaded index.
+ * @throws std::runtime_error If the file cannot be read.
+ */
+FeatureIndexHandle openFeatureIndex(const std::string& filePath);
+
+/**
+ * @brief Drops the cached index of one feature file; outstanding handles stay valid.
+ *
+ * @param filePath Path of the feature file to drop.
+ */
+void releaseFeatureIndex(const std::string& filePath);
+
+/**
+ * @brief Drops every cached index; outstanding handles stay valid.
+ */
+void clearFeatureIndexCache();
+
+#endif // FEATURE_INDEX_H
@@ -0,0 +1,596 @@
+/*! \file feature_indexer.cpp
+    \brief Implements the incremental, manifest-driven image indexing job.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. The manifest is a text file
+    with a header naming the extractor configuration, one "size, time, hash, path" line per indexed
+    image and a trailer holding the size of the feature file it belongs to; a manifest without its
+    trailer, or whose feature file has a different size, is ignored. Directory entries carry their
+    size and time, so unchanged images are recognised without opening them. Checkpoint segments are
+    small feature files with manifests of the same format, so an interrupted run's segments are
+    read back like any previous output.
+*/
+
+#include "feature_indexer.h"
+#include "csv_loader.h"
+#include "feature_index.h"
+#include "feature_writer.h"
+#include "quantized_embeddings.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char MANIFEST_MAGIC[] = "CBIR-MANIFEST";
+constexpr int MANIFEST_VERSION = 1;
+constexpr char MANIFEST_TRAILER[] = "#end";
+constexpr std::size_t HASH_BLOCK_SIZE = 1024 * 1024;
+constexpr std::size_t CHECKPOINT_IMAGES = 256;          // Extracted images per checkpoint segment
+constexpr std::chrono::seconds CHECKPOINT_INTERVAL(60); // Longest time an extracted row waits for its checkpoint
+
+/**
+ * @brief State of one image when it was indexed.
+ */
+struct ManifestEntry {
+    std::uint64_t size = 0;
+    std::int64_t modifiedTime = 0;
+    std::uint64_t hash = 0;
+};
+
+/**
+ * @brief A manifest read back from disk.
+ */
+struct Manifest {
+    std::string signature;
+    std::uint64_t featureFileSize = 0;
+    std::unordered_map<std::string, ManifestEntry> entries;
+};
+
+/**
+ * @brief Describes the extractor configuration; rows are only reused if this matches.
+ */
+std::string extractorSignature(const FeatureStoreInfo& info) {
+    return "type=" + std::to_string(static_cast<int>(info.type)) + " version=" + std::to_string(info.extractorVersion)
+        + " bins=" + std::to_string(info.binsPerChannel) + " texture=" + std::to_string(info.textureBins);
+}
+
+/**
+ * @brief Returns a path next to filePath with ".partial" inserted before the extension.
+ *
+ * The extension is kept so the feature writer still picks the right format.
+ */
+std::string partialPath(const std::string& filePath) {
+    fs::path path(filePath);
+    fs::path partial = path.parent_path() / (path.stem().string() + ".partial" + path.extension().string());
+    return partial.string();
+}
+
+/**
+ * @brief Parses one unsigned or signed integer field and advances past the following tab.
+ */
+template <typename T>
+bool parseField(const char*& p, const char* end, T& value, int base = 10) {
+    auto result = std::from_chars(p, end, value, base);
+    if (result.ec != std::errc() || result.ptr == end || *result.ptr != '\t') return false;
+    p = result.ptr + 1;
+    return true;
+}
+
+/**
+ * @brief Reads a manifest; returns false if it is missing, malformed or incomplete.
+ */
+bool readManifest(const std::string& manifestPath, Manifest& manifest) {
+    FILE* fp = std::fopen(manifestPath.c_str(), "rb");
+    if (!fp) return false;
+
+    std::string line;
+    bool complete = false;
+    bool headerRead = false;
+    char buffer[4096];
+    while (std::fgets(buffer, sizeof(buffer), fp)) {
+        line += buffer;
+        if (line.empty() || line.back() != '\n') continue; // Long line, keep reading
+        line.pop_back();
+
+        const char* p = line.data();
+        const char* end = p + line.size();
+        if (!headerRead) {
+            const std::string expected = std::string(MANIFEST_MAGIC) + " " + std::to_string(MANIFEST_VERSION) + "\t";
+            if (line.compare(0, expected.size(), expected) != 0) break;
+            manifest.signature = line.substr(expected.size());
+            headerRead = true;
+        }
+        else if (line.compare(0, sizeof(MANIFEST_TRAILER), std::string(MANIFEST_TRAILER) + "\t") == 0) {
+            p += sizeof(MANIFEST_TRAILER);
+            complete = std::from_chars(p, end, manifest.featureFileSize).ec == std::errc();
+            break;
+        }
+        else {
+            ManifestEntry entry;
+            if (!parseField(p, end, entry.size) || !parseField(p, end, entry.modifiedTime) || !parseField(p, end, entry.hash, 16)) break;
+            manifest.entries[std::string(p, end)] = entry;
+        }
+        line.clear();
+    }
+    std::fclose(fp);
+    return complete;
+}
+
+/**
+ * @brief Streams a new manifest to disk.
+ */
+class ManifestWriter {
+public:
+    ManifestWriter(const std::string& filePath, const std::string& signature) : path(filePath) {
+        file = std::fopen(filePath.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("Unable to open manifest " + filePath);
+        }
+        std::setvbuf(file, nullptr, _IOFBF, 1024 * 1024);
+        std::fprintf(file, "%s %d\t%s\n", MANIFEST_MAGIC, MANIFEST_VERSION, signature.c_str());
+    }
+
+    ~ManifestWriter() {
+        if (file) std::fclose(file);
+    }
+
+    void add(const std::string& imagePath, const ManifestEntry& entry) {
+        std::fprintf(file, "%llu\t%lld\t%016llx\t%s\n", static_cast<unsigned long long>(entry.size),
+            static_cast<long long>(entry.modifiedTime), static_cast<unsigned long long>(entry.hash), imagePath.c_str());
+    }
+
+    void finish(std::uint64_t featureFileSize, bool durable) {
+        std::fprintf(file, "%s\t%llu\n", MANIFEST_TRAILER, static_cast<unsigned long long>(featureFileSize));
+        const bool failed = std::ferror(file) != 0 || (durable && !syncFileToDisk(file));
+        const bool closed = std::fclose(file) == 0;
+        file = nullptr;
+        if (failed || !closed) {
+            throw std::runtime_error("Error writing manifest " + path);
+        }
+    }
+
+private:
+    std::string path;
+    FILE* file = nullptr;
+};
+
+/**
+ * @brief Feature rows of earlier feature files (the previous output and committed checkpoints), looked up by image path.
+ */
+class PreviousRows {
+public:
+    /**
+     * @brief Opens another feature file; its rows replace rows of the same images from earlier files.
+     *
+     * @param featureFile Path to the feature file.
+     * @param checkpoint True if the file is a checkpoint segment of an interrupted run.
+     * @return False if the file cannot be read.
+     */
+    bool add(const std::string& featureFile, bool checkpoint) {
+        auto source = std::make_unique<Source>();
+        source->checkpoint = checkpoint;
+        try {
+            if (FeatureStore::isFeatureStoreFile(featureFile)) {
+                source->store = std::make_unique<FeatureStore>(featureFile);
+            }
+            else if (loadFeatureCsvParallel(featureFile, source->matrix) != 0) {
+                return false;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Ignoring unreadable feature file " << featureFile << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        const std::size_t sourceIndex = sources.size();
+        const std::size_t rows = source->store ? source->store->rows() : source->matrix.rows();
+        for (std::size_t i = 0; i < rows; ++i) {
+            rowOf[source->store ? source->store->path(i) : source->matrix.path(i)] = { sourceIndex, i };
+        }
+        sources.push_back(std::move(source));
+        return true;
+    }
+
+    /**
+     * @brief Returns the row of an image, or nullptr.
+     *
+     * @param imagePath Image to look up.
+     * @param count Receives the number of values.
+     * @param checkpoint Receives whether the row comes from a checkpoint segment.
+     */
+    const float* find(const std::string& imagePath, std::size_t& count, bool& checkpoint) const {
+        auto row = rowOf.find(imagePath);
+        if (row == rowOf.end()) return nullptr;
+        const Source& source = *sources[row->second.first];
+        checkpoint = source.checkpoint;
+        if (source.store) {
+            count = source.store->dims();
+            return source.store->row(row->second.second);
+        }
+        count = source.matrix.dims();
+        return source.matrix.row(row->second.second);
+    }
+
+    void close() {
+        sources.clear();
+        rowOf.clear();
+    }
+
+private:
+    struct Source {
+        bool checkpoint = false;
+        std::unique_ptr<FeatureStore> store;
+        FeatureMatrix matrix;
+    };
+
+    std::vector<std::unique_ptr<Source>> sources;
+    std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> rowOf; // (source, row)
+};
+
+/**
+ * @brief Writes freshly extracted rows into durable checkpoint segments.
+ *
+ * A segment is a feature file plus a manifest of its images. Both are synced to disk under
+ * ".partial" names and then renamed, data first; a segment counts only once its manifest
+ * exists, is complete and matches the data file's size.
+ */
+class CheckpointWriter {
+public:
+    CheckpointWriter(const std::string& checkpointDirectory, const std::string& extension, const std::string& signature,
+        const FeatureStoreInfo& info, int firstSegment)
+        : directory(checkpointDirectory), extension(extension), signature(signature), info(info), nextSegment(firstSegment) {
+    }
+
+    /**
+     * @brief Adds one extracted row to the open segment, starting a segment if needed.
+     */
+    void add(const std::string& imagePath, const std::vector<float>& features, const ManifestEntry& entry) {
+        if (!writer) {
+            fs::create_directories(directory);
+            dataPath = segmentPath(nextSegment);
+            writer = std::make_unique<FeatureWriter>(partialPath(dataPath), info);
+            writer->setDurable(true);
+            started = std::chrono::steady_clock::now();
+        }
+        writer->write(imagePath, features);
+        entries.emplace_back(imagePath, entry);
+    }
+
+    /**
+     * @brief True when the open segment holds enough rows or time to be committed.
+     */
+    bool due() const {
+        return writer && (entries.size() >= CHECKPOINT_IMAGES || std::chrono::steady_clock::now() - started >= CHECKPOINT_INTERVAL);
+    }
+
+    /**
+     * @brief Makes the open segment durable; does nothing if no segment is open.
+     *
+     * @throws std::runtime_error If the segment cannot be written.
+     */
+    void commit() {
+        if (!writer) return;
+        writer->close();
+        writer.reset();
+
+        const std::string partialData = partialPath(dataPath);
+        const std::string manifestPath = featureManifestPath(dataPath);
+        const std::string partialManifest = manifestPath + ".partial";
+        {
+            ManifestWriter manifest(partialManifest, signature);
+            for (const auto& [imagePath, entry] : entries) manifest.add(imagePath, entry);
+            manifest.finish(fs::file_size(partialData), true);
+        }
+        fs::rename(partialData, dataPath);
+        fs::rename(partialManifest, manifestPath);
+
+        entries.clear();
+        ++nextSegment;
+    }
+
+    /**
+     * @brief Path of the data file of a segment.
+     */
+    std::string segmentPath(int segment) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "segment-%06d", segment);
+        return (fs::path(directory) / (name + extension)).string();
+    }
+
+private:
+    std::string directory;
+    std::string extension;
+    std::string signature;
+    FeatureStoreInfo info;
+    int nextSegment;
+
+    std::unique_ptr<FeatureWriter> writer;
+    std::string dataPath;
+    std::vector<std::pair<std::string, ManifestEntry>> entries;
+    std::chrono::steady_clock::time_point started;
+};
+
+/**
+ * @brief Loads the committed segments of an interrupted run.
+ *
+ * @param checkpointDirectory Directory holding the segments.
+ * @param signature Extractor signature of this run; segments written for another configuration are skipped.
+ * @param previous Receives the manifest entries of the segments' images.
+ * @param rows Receives the segments' rows.
+ * @return The number to give the next segment.
+ */
+int loadCheckpoints(const std::string& checkpointDirectory, const std::string& signature, Manifest& previous, PreviousRows& rows) {
+    std::error_code error;
+    if (!fs::is_directory(checkpointDirectory, error)) return 1;
+
+    // Segment manifests, in segment order
+    std::vector<fs::path> manifests;
+    for (const auto& entry : fs::directory_iterator(checkpointDirectory)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, 8, "segment-") == 0 && entry.path().extension() == ".manifest"
+            && name.find(".partial") == std::string::npos) {
+            manifests.push_back(entry.path());
+        }
+    }
+    std::sort(manifests.begin(), manifests.end());
+
+    int nextSegment = 1;
+    std::size_t resumed = 0;
+    for (const auto& manifestPath : manifests) {
+        const std::string dataPath = (manifestPath.parent_path() / manifestPath.stem()).string();
+        nextSegment = std::max(nextSegment, std::atoi(manifestPath.filename().string().c_str() + 8) + 1);
+
+        Manifest segment;
+        const std::uintmax_t dataSize = fs::file_size(dataPath, error);
+        if (!readManifest(manifestPath.string(), segment) || segment.signature != signature || error
+            || dataSize != segment.featureFileSize || !rows.add(dataPath, true)) {
+            continue;
+        }
+        for (auto& [imagePath, entry] : segment.entries) previous.entries[imagePath] = entry;
+        resumed += segment.entries.size();
+    }
+    if (resumed > 0) {
+        std::cout << "Resuming an interrupted run: " << resumed << " images already indexed" << std::endl;
+    }
+    return nextSegment;
+}
+
+/**
+ * @brief An image whose row is written once the extraction batch it waits on has run.
+ */
+struct PendingImage {
+    std::string path;
+    ManifestEntry entry;
+    bool known = false;          // Listed in the previous manifest
+    const float* row = nullptr;  // Row reused from the previous output, or null if extracted
+    std::size_t count = 0;
+    bool checkpointed = false;
+    std::size_t batchSlot = 0;   // Position in the extraction batch
+};
+
+/**
+ * @brief Runs the extractor on a batch; if it throws, each image is retried alone so one bad image does not fail the others.
+ */
+void extractBatch(const ImageBatchFeatureExtractor& extract, const std::vector<std::string>& imagePaths,
+    std::vector<std::vector<float>>& features, std::vector<char>& extracted) {
+    features.assign(imagePaths.size(), std::vector<float>());
+    extracted.assign(imagePaths.size(), 0);
+    try {
+        extract(imagePaths, features, extracted);
+        return;
+    }
+    catch (const std::exception& e) {
+        if (imagePaths.size() == 1) {
+            std::cerr << "Error extracting features from " << imagePaths[0] << ": " << e.what() << std::endl;
+            extracted[0] = 0;
+            return;
+        }
+        std::cerr << "Error extracting a batch of " << imagePaths.size() << " images, retrying them one at a time: " << e.what() << std::endl;
+    }
+    for (std::size_t i = 0; i < imagePaths.size(); ++i) {
+        std::vector<std::vector<float>> single(1);
+        std::vector<char> singleExtracted(1, 0);
+        extractBatch(extract, { imagePaths[i] }, single, singleExtracted);
+        features[i] = std::move(single[0]);
+        extracted[i] = singleExtracted[0];
+    }
+}
+
+} // namespace
+
+std::string featureManifestPath(const std::string& featureFile) {
+    return featureFile + ".manifest";
+}
+
+std::uint64_t hashFileContents(const std::string& filePath) {
+    FILE* fp = std::fopen(filePath.c_str(), "rb");
+    if (!fp) {
+        throw std::runtime_error("Unable to read " + filePath);
+    }
+
+    // 64-bit FNV-1a over 8-byte words, with a final avalanche so every input bit reaches every output bit
+    constexpr std::uint64_t prime = 0x100000001B3ull;
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    std::vector<unsigned char> block(HASH_BLOCK_SIZE);
+    std::uint64_t total = 0;
+    std::size_t count;
+    while ((count = std::fread(block.data(), 1, block.size(), fp)) > 0) {
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, block.data() + i, sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < count; ++i) {
+            hash = (hash ^ block[i]) * prime;
+        }
+        total += count;
+    }
+    const bool failed = std::ferror(fp) != 0;
+    std::fclose(fp);
+    if (failed) {
+        throw std::runtime_error("Error reading " + filePath);
+    }
+
+    hash = (hash ^ total) * prime;
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+std::string featureCheckpointDirectory(const std::string& featureFile) {
+    return featureFile + ".checkpoints";
+}
+
+IndexingSummary indexImageDirectory(const std::string& directory, const std::string& outputFile,
+    const FeatureStoreInfo& info, const ImageFeatureExtractor& extract) {
+    return indexImageDirectory(directory, outputFile, info, [&extract](const std::vector<std::string>& imagePaths,
+        std::vector<std::vector<float>>& features, std::vector<char>& extracted) {
+        for (std::size_t i = 0; i < imagePaths.size(); ++i) {
+            extracted[i] = extract(imagePaths[i], features[i]) ? 1 : 0;
+        }
+    }, 1);
+}
+
+IndexingSummary indexImageDirectory(const std::string& directory, const std::string& outputFile,
+    const FeatureStoreInfo& info, const ImageBatchFeatureExtractor& extract, std::size_t batchSize) {
+    batchSize = std::max<std::size_t>(batchSize, 1);
+    const std::string signature = extractorSignature(info);
+    const std::string manifestPath = featureManifestPath(outputFile);
+    const std::string checkpointDirectory = featureCheckpointDirectory(outputFile);
+
+    // Reuse earlier rows only if the manifest describes this extractor and this feature file
+    Manifest previous;
+    PreviousRows previousRows;
+    bool incremental = readManifest(manifestPath, previous) && previous.signature == signature;
+    if (incremental) {
+        std::error_code error;
+        const std::uintmax_t featureFileSize = fs::file_size(outputFile, error);
+        incremental = !error && featureFileSize == previous.featureFileSize && previousRows.add(outputFile, false);
+    }
+    if (!incremental) {
+        previous.entries.clear();
+        std::cout << "Indexing " << directory << " from scratch" << std::endl;
+    }
+
+    // Rows committed by an interrupted run take precedence over the previous feature file
+    const int firstSegment = loadCheckpoints(checkpointDirectory, signature, previous, previousRows);
+
+    const std::string partialOutput = partialPath(outputFile);
+    const std::string partialManifest = manifestPath + ".partial";
+    IndexingSummary summary;
+    {
+        FeatureWriter writer(partialOutput, info);
+        ManifestWriter manifest(partialManifest, signature);
+        CheckpointWriter checkpoints(checkpointDirectory, fs::path(outputFile).extension().string(), signature, info, firstSegment);
+
+        // Images to extract are gathered into batches. Images after the first one of a batch wait
+        // for it, so rows are written in directory order whatever the batch size.
+        std::vector<PendingImage> pending;
+        std::vector<std::string> batchPaths;
+        std::vector<std::vector<float>> batchFeatures;
+        std::vector<char> batchExtracted;
+        auto writePending = [&]() {
+            if (!batchPaths.empty()) extractBatch(extract, batchPaths, batchFeatures, batchExtracted);
+            for (const PendingImage& image : pending) {
+                if (image.row) {
+                    writer.write(image.path, image.row, image.count);
+                    ++(image.checkpointed ? summary.resumed : summary.unchanged);
+                }
+                else {
+                    if (!batchExtracted[image.batchSlot]) {
+                        ++summary.failed;
+                        continue; // Not recorded, so the next run tries again
+                    }
+                    const std::vector<float>& features = batchFeatures[image.batchSlot];
+                    writer.write(image.path, features);
+                    checkpoints.add(image.path, features, image.entry);
+                    if (checkpoints.due()) checkpoints.commit();
+                    ++(image.known ? summary.changed : summary.added);
+                }
+                manifest.add(image.path, image.entry);
+            }
+            pending.clear();
+            batchPaths.clear();
+        };
+
+        for (const auto& entry : fs::directory_iterator(directory)) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".jpg") continue;
+
+            PendingImage image;
+            image.path = entry.path().string();
+            image.entry.size = entry.file_size();
+            image.entry.modifiedTime = static_cast<std::int64_t>(entry.last_write_time().time_since_epoch().count());
+
+            // Size and time match: unchanged without reading the file. Otherwise compare content hashes.
+            auto known = previous.entries.find(image.path);
+            bool reuse = false;
+            if (known != previous.entries.end()) {
+                image.known = true;
+                if (known->second.size == image.entry.size && known->second.modifiedTime == image.entry.modifiedTime) {
+                    image.entry.hash = known->second.hash;
+                    reuse = true;
+                }
+                else if (known->second.size == image.entry.size) {
+                    image.entry.hash = hashFileContents(image.path);
+                    reuse = image.entry.hash == known->second.hash;
+                }
+                previous.entries.erase(known);
+            }
+
+            image.row = reuse ? previousRows.find(image.path, image.count, image.checkpointed) : nullptr;
+            if (!image.row) {
+                if (image.entry.hash == 0) image.entry.hash = hashFileContents(image.path);
+                image.batchSlot = batchPaths.size();
+                batchPaths.push_back(image.path);
+            }
+            pending.push_back(std::move(image));
+            if (batchPaths.empty() || batchPaths.size() == batchSize) writePending();
+        }
+        writePending();
+        summary.removed = previous.entries.size();
+
+        // The last segment makes the extracted rows durable even if finishing the output fails
+        checkpoints.commit();
+        writer.close();
+        manifest.finish(fs::file_size(partialOutput), false);
+    }
+
+    // Swap the new pair into place: feature file first, so a crash in between only costs a full rebuild.
+    // Mapped copies of the old file must be closed first, or Windows refuses to replace it: the rows
+    // read above, the cached feature index of a queried store and the stores quantized sets keep open.
+    // Sidecar caches (HNSW, IVF-PQ, VP-tree, pyramid) map only their own files.
+    previousRows.close();
+    releaseFeatureIndex(outputFile);
+    clearQuantizedEmbeddingCache();
+    std::error_code error;
+    fs::rename(partialOutput, outputFile, error);
+    if (!error) fs::rename(partialManifest, manifestPath, error);
+    if (error) {
+        throw std::runtime_error("Unable to replace " + outputFile + ": " + error.message());
+    }
+
+    // Every row is now in the output; the checkpoints of this and earlier runs are no longer needed
+    fs::remove_all(checkpointDirectory, error);
+    if (error) {
+        std::cerr << "Unable to remove checkpoints in " << checkpointDirectory << ": " << error.message() << std::endl;
+    }
+
+    std::cout << "Indexed " << directory << ": " << summary.added << " added, " << summary.changed << " changed, "
+        << summary.unchanged << " unchanged, " << summary.resumed << " resumed, " << summary.removed << " removed, "
+        << summary.failed << " failed" << std::endl;
+    return summary;
+}
@@ -0,0 +1,117 @@
+/*! \file feature_indexer.h
+    \brief Declarations for the incremental, manifest-driven image indexing job.
+    \author Manushi
+    \date October 16, 2026
+
+    Every precompute task walks an image directory, extracts one feature row per image and
+    writes a feature file. indexImageDirectory runs that walk for all of them. Next to the
+    feature file it keeps a manifest recording the path, size, modification time and content
+    hash of every indexed image, so a rebuild only extracts features for new or changed images,
+    copies the rows of unchanged ones from the previous feature file and drops deleted ones.
+    While it runs, freshly extracted rows are committed to durable checkpoints, so a crashed or
+    cancelled run resumes from its last checkpoint instead of starting over.
+*/
+
+#ifndef FEATURE_INDEXER_H
+#define FEATURE_INDEXER_H
+
+#include "feature_store.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Extracts the feature row of one image.
+ *
+ * @param imagePath Path of the image file.
+ * @param features Receives the feature values.
+ * @return False if the image could not be processed; it is then left out of the feature file.
+ */
+using ImageFeatureExtractor = std::function<bool(const std::string& imagePath, std::vector<float>& features)>;
+
+/**
+ * @brief Extracts the feature rows of several images at once, e.g. with one batched DNN forward pass.
+ *
+ * @param imagePaths Paths of the image files.
+ * @param features One entry per image (already sized); receives the feature values.
+ * @param extracted One entry per image (already sized, all 0); set to 1 for every image that was processed.
+ *                  Images left at 0 are left out of the feature file.
+ */
+using ImageBatchFeatureExtractor = std::function<void(const std::vector<std::string>& imagePaths,
+    std::vector<std::vector<float>>& features, std::vector<char>& extracted)>;
+
+/**
+ * @brief Counts of what an indexing run did with each image.
+ */
+struct IndexingSummary {
+    std::size_t added = 0;     // New images, features extracted
+    std::size_t changed = 0;   // Modified images, features extracted again
+    std::size_t unchanged = 0; // Rows copied from the previous feature file
+    std::size_t resumed = 0;   // Rows copied from checkpoints of an interrupted run
+    std::size_t removed = 0;   // Images no longer in the directory
+    std::size_t failed = 0;    // Images the extractor could not process
+};
+
+/**
+ * @brief Returns the manifest path kept next to a feature file ("<featureFile>.manifest").
+ */
+std::string featureManifestPath(const std::string& featureFile);
+
+/**
+ * @brief Returns the directory holding the checkpoints of an unfinished run ("<featureFile>.checkpoints").
+ */
+std::string featureCheckpointDirectory(const std::string& featureFile);
+
+/**
+ * @brief 64-bit hash of a file's contents, used to recognise images whose timestamp changed but whose bytes did not.
+ *
+ * @throws std::runtime_error If the file cannot be read.
+ */
+std::uint64_t hashFileContents(const std::string& filePath);
+
+/**
+ * @brief Indexes the .jpg images of a directory into a feature file, reusing earlier work where possible.
+ *
+ * An image is unchanged if its size and modification time match the manifest, or if only the
+ * time differs and its content hash still matches. Unchanged images keep their previous row;
+ * all others are passed to the extractor. A full rebuild happens when there is no manifest,
+ * when the manifest was written for a different extractor configuration (type, bin counts or
+ * extractor version in info), or when the feature file no longer matches it.
+ *
+ * The new feature file and manifest are written under temporary names and renamed into place,
+ * so an interrupted run leaves the previous pair intact. Every 256 extracted images, or every
+ * minute, the rows extracted since the last checkpoint are flushed to disk as a checkpoint
+ * segment. The next run reuses the rows of all complete segments, so at most one checkpoint
+ * of work is lost; the segments are deleted once the new feature file is in place. An image
+ * whose extractor throws is counted as failed and the run continues.
+ *
+ * @param directory Directory containing the images.
+ * @param outputFile Feature file to write (".cbfs" for a binary store, CSV otherwise).
+ * @param info Feature type and extractor settings recorded in the store header and manifest.
+ * @param extract Extracts the features of one image.
+ * @return What was done with each image.
+ * @throws std::runtime_error If the directory cannot be read or the output cannot be written.
+ */
+IndexingSummary indexImageDirectory(const std::string& directory, const std::string& outputFile,
+    const FeatureStoreInfo& info, const ImageFeatureExtractor& extract);
+
+/**
+ * @brief Indexes a directory like the single-image overload, passing the images to extract in batches.
+ *
+ * Rows are written in the same order as with the single-image overload. If the extractor throws
+ * for a batch, the batch's images are retried one at a time.
+ *
+ * @param directory Directory containing the images.
+ * @param outputFile Feature file to write (".cbfs" for a binary store, CSV otherwise).
+ * @param info Feature type and extractor settings recorded in the store header and manifest.
+ * @param extract Extracts the features of a batch of images.
+ * @param batchSize Most images passed to one call of the extractor.
+ * @return What was done with each image.
+ * @throws std::runtime_error If the directory cannot be read or the output cannot be written.
+ */
+IndexingSummary indexImageDirectory(const std::string& directory, const std::string& outputFile,
+    const FeatureStoreInfo& info, const ImageBatchFeatureExtractor& extract, std::size_t batchSize);
+
+#endif // FEATURE_INDEXER_H
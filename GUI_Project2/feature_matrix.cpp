@@ -0,0 +1,99 @@
+/*! \file feature_matrix.cpp
+    \brief Implements the contiguous, aligned in-memory feature matrix.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. The matrix uses the same
+    row stride as the binary feature store, so a store is read in place from its mapping without
+    copying any rows. CSV files are parsed straight into the rows by the parallel CSV loader.
+*/
+
+#include "feature_matrix.h"
+#include "csv_loader.h"
+#include "feature_store.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static_assert(FEATURE_MATRIX_ALIGNMENT == FEATURE_STORE_ALIGNMENT, "Mapped store rows must have the alignment of matrix rows");
+
+FeatureMatrix::FeatureMatrix(std::size_t rows, std::size_t dims)
+    : rowCount(rows), rowDims(dims), rowStride(strideFor(dims)), imagePaths(rows) {
+    const std::size_t bytes = memoryBytes();
+    if (bytes == 0) return;
+
+#ifdef _WIN32
+    float* data = static_cast<float*>(_aligned_malloc(bytes, FEATURE_MATRIX_ALIGNMENT));
+#else
+    float* data = static_cast<float*>(std::aligned_alloc(FEATURE_MATRIX_ALIGNMENT, bytes));
+#endif
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    std::memset(data, 0, bytes);
+    values.reset(data);
+    rowData = data;
+}
+
+FeatureMatrix::FeatureMatrix(std::shared_ptr<const FeatureStore> mappedStore)
+    : store(std::move(mappedStore)), rowCount(store->rows()), rowDims(store->dims()), rowStride(store->stride()), imagePaths(rowCount) {
+    rowData = rowCount > 0 ? store->row(0) : nullptr;
+    for (std::size_t i = 0; i < rowCount; ++i) {
+        imagePaths[i] = store->path(i);
+    }
+}
+
+FeatureMatrix::FeatureMatrix(FeatureMatrix&& other) noexcept
+    : values(std::move(other.values)), store(std::move(other.store)), rowData(std::exchange(other.rowData, nullptr)),
+    rowCount(std::exchange(other.rowCount, 0)), rowDims(std::exchange(other.rowDims, 0)),
+    rowStride(std::exchange(other.rowStride, 0)), imagePaths(std::move(other.imagePaths)) {
+}
+
+FeatureMatrix& FeatureMatrix::operator=(FeatureMatrix&& other) noexcept {
+    values = std::move(other.values);
+    store = std::move(other.store);
+    rowData = std::exchange(other.rowData, nullptr);
+    rowCount = std::exchange(other.rowCount, 0);
+    rowDims = std::exchange(other.rowDims, 0);
+    rowStride = std::exchange(other.rowStride, 0);
+    imagePaths = std::move(other.imagePaths);
+    other.imagePaths.clear();
+    return *this;
+}
+
+float* FeatureMatrix::mutableRow(std::size_t i) {
+    if (store) {
+        throw std::logic_error("The rows of a mapped feature store are read-only");
+    }
+    return values.get() + i * rowStride;
+}
+
+std::size_t FeatureMatrix::strideFor(std::size_t dims) {
+    constexpr std::size_t floatsPerBlock = FEATURE_MATRIX_ALIGNMENT / sizeof(float);
+    return (dims + floatsPerBlock - 1) / floatsPerBlock * floatsPerBlock;
+}
+
+void FeatureMatrix::AlignedDeleter::operator()(float* data) const {
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    std::free(data);
+#endif
+}
+
+FeatureMatrix readFeatureMatrix(const std::string& filePath) {
+    if (FeatureStore::isFeatureStoreFile(filePath)) {
+        return FeatureMatrix(std::make_shared<const FeatureStore>(filePath));
+    }
+
+    FeatureMatrix matrix;
+    if (loadFeatureCsvParallel(filePath, matrix) != 0) {
+        throw std::runtime_error("Unable to read feature file: " + filePath);
+    }
+    return matrix;
+}
@@ -0,0 +1,133 @@
+/*! \file feature_matrix.h
+    \brief Declarations for the contiguous, aligned in-memory feature matrix.
+    \author Manushi
+    \date October 16, 2026
+
+    A feature matrix holds one feature row per image in a single 64-byte aligned allocation.
+    Every row is padded to a multiple of 64 bytes with zeros, exactly like the rows of a binary
+    feature store, so each row starts on a cache line and vector loads never straddle two rows.
+    The image path of every row is kept in a table indexed by row id. Loaders fill the matrix in
+    place and matchers scan it through row pointers, without per-row allocations or copies.
+    A matrix opened over a binary feature store owns no rows: it keeps the store mapped and its
+    row pointers point into the mapping.
+*/
+
+#ifndef FEATURE_MATRIX_H
+#define FEATURE_MATRIX_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class FeatureStore;
+
+/**
+ * @brief Byte alignment of the matrix and of every row inside it; matches FEATURE_STORE_ALIGNMENT.
+ */
+constexpr std::size_t FEATURE_MATRIX_ALIGNMENT = 64;
+
+/**
+ * @brief Feature rows of a collection in one aligned, row-padded allocation, with the image path of every row.
+ */
+class FeatureMatrix {
+public:
+    FeatureMatrix() = default;
+
+    /**
+     * @brief Allocates a zero-filled matrix with empty paths.
+     *
+     * @param rows Number of rows.
+     * @param dims Number of valid floats per row.
+     * @throws std::bad_alloc If the matrix cannot be allocated.
+     */
+    FeatureMatrix(std::size_t rows, std::size_t dims);
+
+    /**
+     * @brief Reads the rows of a mapped feature store in place; only the image paths are copied.
+     *
+     * The matrix keeps the store, and with it the mapping, alive. Its rows are read-only.
+     *
+     * @param store The mapped feature store.
+     */
+    explicit FeatureMatrix(std::shared_ptr<const FeatureStore> store);
+
+    FeatureMatrix(FeatureMatrix&& other) noexcept;
+    FeatureMatrix& operator=(FeatureMatrix&& other) noexcept;
+    FeatureMatrix(const FeatureMatrix&) = delete;
+    FeatureMatrix& operator=(const FeatureMatrix&) = delete;
+
+    std::size_t rows() const { return rowCount; }
+    std::size_t dims() const { return rowDims; }
+    bool empty() const { return rowCount == 0; }
+
+    /**
+     * @brief Floats from the start of one row to the next; a multiple of 16.
+     */
+    std::size_t stride() const { return rowStride; }
+
+    /**
+     * @brief Returns the feature data of a row; the first dims() floats are valid, the rest is zero padding.
+     */
+    const float* row(std::size_t i) const { return rowData + i * rowStride; }
+
+    /**
+     * @brief Returns a row for writing.
+     *
+     * @throws std::logic_error If the rows are read from a mapped feature store, whose pages are read-only.
+     */
+    float* mutableRow(std::size_t i);
+
+    /**
+     * @brief True if the rows live in this matrix, false if they are read from a mapped feature store.
+     */
+    bool ownsRows() const { return !store; }
+
+    /**
+     * @brief Returns the image path of a row.
+     */
+    const std::string& path(std::size_t i) const { return imagePaths[i]; }
+    std::string& path(std::size_t i) { return imagePaths[i]; }
+
+    /**
+     * @brief Image path of every row, indexed by row id.
+     */
+    const std::vector<std::string>& paths() const { return imagePaths; }
+
+    /**
+     * @brief Bytes used by the feature rows, padding included.
+     */
+    std::size_t memoryBytes() const { return rowCount * rowStride * sizeof(float); }
+
+    /**
+     * @brief Rounds a row length up to a multiple of FEATURE_MATRIX_ALIGNMENT bytes.
+     */
+    static std::size_t strideFor(std::size_t dims);
+
+private:
+    struct AlignedDeleter {
+        void operator()(float* data) const;
+    };
+
+    std::unique_ptr<float[], AlignedDeleter> values;
+    std::shared_ptr<const FeatureStore> store; // Set when the rows are read from a mapped store
+    const float* rowData = nullptr;            // values.get(), or the first row of the mapped store
+    std::size_t rowCount = 0;
+    std::size_t rowDims = 0;
+    std::size_t rowStride = 0;
+    std::vector<std::string> imagePaths;
+};
+
+/**
+ * @brief Reads a feature file, whether it is a binary feature store or a CSV file, into a feature matrix.
+ *
+ * A feature store is mapped and its rows are read in place, so the matrix is read-only. CSV
+ * files are parsed into a matrix that owns its rows; rows shorter than the widest row are zero padded.
+ *
+ * @param filePath Path to the feature store or CSV feature file.
+ * @return The loaded matrix.
+ * @throws std::runtime_error If the file cannot be read.
+ */
+FeatureMatrix readFeatureMatrix(const std::string& filePath);
+
+#endif // FEATURE_MATRIX_H
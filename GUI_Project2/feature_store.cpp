@@ -0,0 +1,386 @@
+/*! \file feature_store.cpp
+    \brief Implements the binary, memory-mapped feature store and the CSV converter.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. It implements reading
+    feature store files through a read-only memory mapping, writing them from in-memory rows,
+    and converting the existing CSV feature files into the binary format.
+
+    File layout (all integers little endian):
+      - FeatureStoreHeader
+      - componentCount x FeatureComponentEntry
+      - zero padding up to a 64-byte boundary
+      - rowCount x rowStride floats (the feature matrix)
+      - (rowCount + 1) x uint64 offsets into the path bytes, followed by the path bytes
+      - version 2: zero padding up to a 64-byte boundary, then rowCount x componentCount floats
+        with the inverse length of every component of every row (0 for a zero length component)
+*/
+
+#include "feature_store.h"
+#include "csv_loader.h"
+#include "distance_kernels.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+#pragma pack(push, 1)
+/**
+ * @brief Fixed-size header at the start of a feature store file.
+ */
+struct FeatureStoreHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t featureType;
+    std::uint32_t extractorVersion;
+    std::uint32_t binsPerChannel;
+    std::uint32_t textureBins;
+    std::uint32_t componentCount;
+    std::uint32_t dims;
+    std::uint32_t rowStride;
+    std::uint64_t rowCount;
+    std::uint64_t matrixOffset;
+    std::uint64_t stringTableOffset;
+    std::uint64_t stringTableSize;
+    std::uint64_t fileSize;
+};
+
+/**
+ * @brief On-disk description of one feature component.
+ */
+struct FeatureComponentEntry {
+    char name[FEATURE_COMPONENT_NAME_SIZE];
+    std::uint32_t offset;
+    std::uint32_t dims;
+};
+#pragma pack(pop)
+
+/**
+ * @brief Rounds a byte offset up to the store alignment.
+ */
+std::uint64_t alignOffset(std::uint64_t offset) {
+    return (offset + FEATURE_STORE_ALIGNMENT - 1) / FEATURE_STORE_ALIGNMENT * FEATURE_STORE_ALIGNMENT;
+}
+
+/**
+ * @brief Byte offset of the inverse length table, which follows the string table.
+ */
+std::uint64_t inverseLengthTableOffset(const FeatureStoreHeader& header) {
+    return alignOffset(header.stringTableOffset + header.stringTableSize);
+}
+
+} // namespace
+
+std::uint32_t featureStoreRowStride(std::uint32_t dims) {
+    const std::uint32_t floatsPerBlock = static_cast<std::uint32_t>(FEATURE_STORE_ALIGNMENT / sizeof(float));
+    return (dims + floatsPerBlock - 1) / floatsPerBlock * floatsPerBlock;
+}
+
+std::vector<FeatureComponent> defaultFeatureComponents(FeatureType type, std::uint32_t dims,
+    std::uint32_t binsPerChannel, std::uint32_t textureBins) {
+    const std::uint32_t colorBins = binsPerChannel * binsPerChannel * binsPerChannel;
+
+    switch (type) {
+    case FeatureType::MultiHistogram:
+        if (colorBins > 0 && dims == 2 * colorBins) {
+            return { { "topHalf", 0, colorBins }, { "bottomHalf", colorBins, colorBins } };
+        }
+        break;
+    case FeatureType::TextureColor:
+        if (colorBins > 0 && dims == colorBins + textureBins) {
+            return { { "color", 0, colorBins }, { "texture", colorBins, textureBins } };
+        }
+        break;
+    case FeatureType::CustomDesign: {
+        // 50x60 hue/saturation histogram, 256-bin LBP histogram, DenseNet output, 1 edge value
+        const std::uint32_t colorDims = 50 * 60, textureDims = 256, edgeDims = 1;
+        if (dims > colorDims + textureDims + edgeDims) {
+            const std::uint32_t dnnDims = dims - colorDims - textureDims - edgeDims;
+            return { { "color", 0, colorDims }, { "texture", colorDims, textureDims },
+                { "dnn", colorDims + textureDims, dnnDims }, { "edge", dims - edgeDims, edgeDims } };
+        }
+        break;
+    }
+    case FeatureType::CustomDesignFace: {
+        // HSV 3D histogram, 256-bin LBP histogram, 1000-d DenseNet output, then face embeddings
+        const std::uint32_t colorDims = (colorBins > 0) ? colorBins : 8 * 8 * 8, textureDims = 256, dnnDims = 1000;
+        if (dims >= colorDims + textureDims + dnnDims) {
+            return { { "color", 0, colorDims }, { "texture", colorDims, textureDims },
+                { "dnn", colorDims + textureDims, dnnDims },
+                { "face", colorDims + textureDims + dnnDims, dims - colorDims - textureDims - dnnDims } };
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return { { "features", 0, dims } };
+}
+
+std::vector<FeatureComponent> resolveFeatureComponents(const FeatureStoreInfo& info, std::uint32_t dims) {
+    return info.components.empty() ? defaultFeatureComponents(info.type, dims, info.binsPerChannel, info.textureBins) : info.components;
+}
+
+void computeInverseLengths(const float* row, const std::vector<FeatureComponent>& components, float* out) {
+    for (std::size_t i = 0; i < components.size(); ++i) {
+        out[i] = inverseLength(row + components[i].offset, components[i].dims);
+    }
+}
+
+std::vector<char> encodeFeatureStorePrologue(const FeatureStoreInfo& info, std::uint32_t dims,
+    std::uint64_t rowCount, std::uint64_t pathBytes) {
+    std::vector<FeatureComponent> components = resolveFeatureComponents(info, dims);
+    if (components.size() > FEATURE_STORE_MAX_COMPONENTS) {
+        throw std::runtime_error("Feature store writer: too many components.");
+    }
+    for (const auto& component : components) {
+        if (component.name.size() >= FEATURE_COMPONENT_NAME_SIZE || component.offset + component.dims > dims) {
+            throw std::runtime_error("Feature store writer: invalid component " + component.name);
+        }
+    }
+
+    const std::uint32_t stride = featureStoreRowStride(dims);
+
+    FeatureStoreHeader header = {};
+    std::memcpy(header.magic, FEATURE_STORE_MAGIC, sizeof(header.magic));
+    header.version = FEATURE_STORE_VERSION;
+    header.featureType = static_cast<std::uint32_t>(info.type);
+    header.extractorVersion = info.extractorVersion;
+    header.binsPerChannel = info.binsPerChannel;
+    header.textureBins = info.textureBins;
+    header.componentCount = static_cast<std::uint32_t>(components.size());
+    header.dims = dims;
+    header.rowStride = stride;
+    header.rowCount = rowCount;
+
+    // Room for the maximum number of components is always reserved, so the matrix offset does
+    // not depend on the layout and streaming writers can fill in the header last
+    header.matrixOffset = alignOffset(sizeof(FeatureStoreHeader) + FEATURE_STORE_MAX_COMPONENTS * sizeof(FeatureComponentEntry));
+    header.stringTableOffset = header.matrixOffset + header.rowCount * stride * sizeof(float);
+    header.stringTableSize = (header.rowCount + 1) * sizeof(std::uint64_t) + pathBytes;
+    header.fileSize = inverseLengthTableOffset(header) + header.rowCount * components.size() * sizeof(float);
+
+    std::vector<char> prologue(static_cast<std::size_t>(header.matrixOffset), 0);
+    std::memcpy(prologue.data(), &header, sizeof(header));
+    for (std::size_t i = 0; i < components.size(); ++i) {
+        FeatureComponentEntry entry = {};
+        std::memcpy(entry.name, components[i].name.data(), components[i].name.size());
+        entry.offset = components[i].offset;
+        entry.dims = components[i].dims;
+        std::memcpy(prologue.data() + sizeof(header) + i * sizeof(entry), &entry, sizeof(entry));
+    }
+    return prologue;
+}
+
+void writeFeatureStore(const std::string& filePath, const FeatureStoreInfo& info, const FeatureMatrix& matrix) {
+    const std::uint32_t dims = static_cast<std::uint32_t>(matrix.dims());
+    const std::uint32_t stride = featureStoreRowStride(dims);
+
+    std::uint64_t pathBytes = 0;
+    for (const auto& imagePath : matrix.paths()) {
+        pathBytes += imagePath.size();
+    }
+    const std::vector<char> prologue = encodeFeatureStorePrologue(info, dims, matrix.rows(), pathBytes);
+
+    std::ofstream out(filePath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("Unable to open feature store for writing: " + filePath);
+    }
+
+    out.write(prologue.data(), static_cast<std::streamsize>(prologue.size()));
+
+    // Matrix rows are zero padded to the same stride, so they are written as they are
+    for (std::size_t i = 0; i < matrix.rows(); ++i) {
+        out.write(reinterpret_cast<const char*>(matrix.row(i)), static_cast<std::streamsize>(stride * sizeof(float)));
+    }
+
+    std::uint64_t offset = 0;
+    for (const auto& imagePath : matrix.paths()) {
+        out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        offset += imagePath.size();
+    }
+    out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    for (const auto& imagePath : matrix.paths()) {
+        out.write(imagePath.data(), static_cast<std::streamsize>(imagePath.size()));
+    }
+
+    // Inverse lengths of every component, after padding the string table to the alignment
+    const std::vector<FeatureComponent> components = resolveFeatureComponents(info, dims);
+    const std::uint64_t tableEnd = prologue.size() + matrix.rows() * stride * sizeof(float) + (matrix.rows() + 1) * sizeof(std::uint64_t) + pathBytes;
+    const std::vector<char> padding(static_cast<std::size_t>(alignOffset(tableEnd) - tableEnd), 0);
+    out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+    std::vector<float> lengths(components.size());
+    for (std::size_t i = 0; i < matrix.rows(); ++i) {
+        computeInverseLengths(matrix.row(i), components, lengths.data());
+        out.write(reinterpret_cast<const char*>(lengths.data()), static_cast<std::streamsize>(lengths.size() * sizeof(float)));
+    }
+
+    if (!out.good()) {
+        throw std::runtime_error("Error writing feature store: " + filePath);
+    }
+}
+
+FeatureType parseFeatureType(const std::string& name) {
+    if (name == "baseline") return FeatureType::Baseline;
+    if (name == "histogram") return FeatureType::Histogram;
+    if (name == "multihistogram") return FeatureType::MultiHistogram;
+    if (name == "texturecolor") return FeatureType::TextureColor;
+    if (name == "dnn") return FeatureType::DeepEmbedding;
+    if (name == "custom") return FeatureType::CustomDesign;
+    if (name == "customface") return FeatureType::CustomDesignFace;
+    return FeatureType::Unknown;
+}
+
+int convertCsvToFeatureStore(const std::string& csvFilePath, const std::string& storeFilePath, const FeatureStoreInfo& info) {
+    FeatureMatrix matrix;
+    if (loadFeatureCsvParallel(csvFilePath, matrix) != 0) {
+        return -1;
+    }
+
+    try {
+        writeFeatureStore(storeFilePath, info, matrix);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to convert " << csvFilePath << ": " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::cout << "Converted " << matrix.rows() << " rows from " << csvFilePath << " to " << storeFilePath << std::endl;
+    return 0;
+}
+
+bool FeatureStore::isFeatureStoreFile(const std::string& filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    char magic[sizeof(FEATURE_STORE_MAGIC)] = {};
+    if (!file.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, FEATURE_STORE_MAGIC, sizeof(magic)) == 0;
+}
+
+FeatureStore::FeatureStore(const std::string& filePath) : sourcePath(filePath), mapping(filePath) {
+    const unsigned char* mappedData = mapping.data();
+    const std::size_t mappedSize = mapping.size();
+
+    FeatureStoreHeader header;
+    if (mappedSize < sizeof(header)) {
+        throw std::runtime_error("Feature store is truncated: " + filePath);
+    }
+    std::memcpy(&header, mappedData, sizeof(header));
+
+    const bool hasLengths = header.version >= 2;
+
+    // Sizes are bounded by the file size first, so the products below cannot overflow
+    const bool valid = std::memcmp(header.magic, FEATURE_STORE_MAGIC, sizeof(header.magic)) == 0
+        && header.version >= 1 && header.version <= FEATURE_STORE_VERSION
+        && header.fileSize == mappedSize
+        && header.componentCount <= FEATURE_STORE_MAX_COMPONENTS
+        && header.matrixOffset % FEATURE_STORE_ALIGNMENT == 0
+        && header.matrixOffset <= mappedSize
+        && header.rowStride >= header.dims
+        && header.rowStride % (FEATURE_STORE_ALIGNMENT / sizeof(float)) == 0
+        && header.rowStride <= mappedSize / sizeof(float)
+        && header.rowCount < mappedSize / sizeof(std::uint64_t)
+        && (header.rowStride == 0 || header.rowCount <= (mappedSize - header.matrixOffset) / (header.rowStride * sizeof(float)))
+        && header.stringTableSize <= mappedSize
+        && header.stringTableSize >= (header.rowCount + 1) * sizeof(std::uint64_t)
+        && header.stringTableOffset == header.matrixOffset + header.rowCount * header.rowStride * sizeof(float)
+        && header.stringTableOffset + header.stringTableSize <= mappedSize
+        && sizeof(header) + header.componentCount * sizeof(FeatureComponentEntry) <= header.matrixOffset
+        && (!hasLengths || inverseLengthTableOffset(header) + header.rowCount * header.componentCount * sizeof(float) == mappedSize);
+    if (!valid) {
+        throw std::runtime_error("Not a valid feature store (or unsupported version): " + filePath);
+    }
+
+    storeInfo.type = static_cast<FeatureType>(header.featureType);
+    storeInfo.extractorVersion = header.extractorVersion;
+    storeInfo.binsPerChannel = header.binsPerChannel;
+    storeInfo.textureBins = header.textureBins;
+
+    const FeatureComponentEntry* entries = reinterpret_cast<const FeatureComponentEntry*>(mappedData + sizeof(header));
+    for (std::uint32_t i = 0; i < header.componentCount; ++i) {
+        FeatureComponentEntry entry;
+        std::memcpy(&entry, entries + i, sizeof(entry));
+        entry.name[FEATURE_COMPONENT_NAME_SIZE - 1] = '\0';
+        if (entry.offset > header.dims || entry.dims > header.dims - entry.offset) {
+            throw std::runtime_error("Feature store component " + std::string(entry.name) + " lies outside the rows: " + filePath);
+        }
+        storeInfo.components.push_back({ entry.name, entry.offset, entry.dims });
+    }
+
+    rowCount = static_cast<std::size_t>(header.rowCount);
+    rowDims = header.dims;
+    rowStride = header.rowStride;
+    matrix = reinterpret_cast<const float*>(mappedData + header.matrixOffset);
+    pathOffsets = reinterpret_cast<const std::uint64_t*>(mappedData + header.stringTableOffset);
+    pathBytes = reinterpret_cast<const char*>(pathOffsets + rowCount + 1);
+
+    // Every path must lie inside the string table, in row order
+    const std::uint64_t pathBytesSize = header.stringTableSize - (header.rowCount + 1) * sizeof(std::uint64_t);
+    if (pathOffsets[0] != 0 || pathOffsets[rowCount] > pathBytesSize) {
+        throw std::runtime_error("Feature store path table is corrupt: " + filePath);
+    }
+    for (std::size_t i = 0; i < rowCount; ++i) {
+        if (pathOffsets[i + 1] < pathOffsets[i]) {
+            throw std::runtime_error("Feature store path table is corrupt: " + filePath);
+        }
+    }
+    if (hasLengths) {
+        inverseLengthTable = reinterpret_cast<const float*>(mappedData + inverseLengthTableOffset(header));
+    }
+}
+
+std::string FeatureStore::path(std::size_t i) const {
+    return std::string(pathBytes + pathOffsets[i], static_cast<std::size_t>(pathOffsets[i + 1] - pathOffsets[i]));
+}
+
+const FeatureComponent* FeatureStore::findComponent(const std::string& name) const {
+    for (const auto& component : storeInfo.components) {
+        if (component.name == name) return &component;
+    }
+    return nullptr;
+}
+
+FeatureStoreView FeatureStore::componentView(const std::string& name) const {
+    const FeatureComponent* component = findComponent(name);
+    if (component == nullptr) {
+        throw std::runtime_error("Feature store has no component named " + name);
+    }
+    FeatureStoreView view;
+    view.base = matrix + component->offset;
+    view.stride = rowStride;
+    view.dims = component->dims;
+    view.rows = rowCount;
+    return view;
+}
+
+std::vector<float> FeatureStore::loadComponents(const std::vector<std::string>& names, std::size_t& outDims) const {
+    std::vector<const FeatureComponent*> selected;
+    outDims = 0;
+    for (const auto& name : names) {
+        const FeatureComponent* component = findComponent(name);
+        if (component == nullptr) {
+            throw std::runtime_error("Feature store has no component named " + name);
+        }
+        selected.push_back(component);
+        outDims += component->dims;
+    }
+
+    std::vector<float> packed(rowCount * outDims);
+    float* out = packed.data();
+    for (std::size_t i = 0; i < rowCount; ++i) {
+        const float* source = row(i);
+        for (const FeatureComponent* component : selected) {
+            std::memcpy(out, source + component->offset, component->dims * sizeof(float));
+            out += component->dims;
+        }
+    }
+    return packed;
+}
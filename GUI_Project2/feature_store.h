@@ -0,0 +1,271 @@
+/*! \file feature_store.h
+    \brief Declarations for the binary, memory-mapped feature store.
+    \author Manushi
+    \date October 16, 2026
+
+    A feature store is a versioned binary replacement for the CSV feature files written by the
+    precompute tasks. It holds a fixed-size header describing the feature type, the layout of the
+    feature components and the extractor parameters, a contiguous 64-byte aligned float matrix
+    with one padded row per image, a string table with the image paths and, from version 2 on,
+    the reciprocal Euclidean length of every component of every row, so cosine scoring needs one
+    dot product per row and never has to measure the stored vectors again. The file is opened
+    with a read-only memory mapping, so opening it costs almost nothing and the pages are shared
+    between every process that reads the same collection.
+*/
+
+#ifndef FEATURE_STORE_H
+#define FEATURE_STORE_H
+
+#include "feature_matrix.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Magic bytes at the start of every feature store file.
+ */
+constexpr char FEATURE_STORE_MAGIC[8] = { 'C', 'B', 'I', 'R', 'F', 'S', '\0', '\0' };
+
+/**
+ * @brief Current on-disk format version written by writeFeatureStore.
+ *
+ * Version 2 appends the inverse length table; version 1 files (without it) are still read.
+ */
+constexpr std::uint32_t FEATURE_STORE_VERSION = 2;
+
+/**
+ * @brief Byte alignment of the float matrix and of every row inside it.
+ */
+constexpr std::size_t FEATURE_STORE_ALIGNMENT = 64;
+
+/**
+ * @brief Maximum length of a component name, including the terminating zero.
+ */
+constexpr std::size_t FEATURE_COMPONENT_NAME_SIZE = 32;
+
+/**
+ * @brief Number of component slots reserved in every header; the matrix starts after them.
+ */
+constexpr std::size_t FEATURE_STORE_MAX_COMPONENTS = 16;
+
+/**
+ * @brief Identifies which precompute task produced a feature file.
+ */
+enum class FeatureType : std::uint32_t {
+    Unknown = 0,
+    Baseline = 1,
+    Histogram = 2,
+    MultiHistogram = 3,
+    TextureColor = 4,
+    DeepEmbedding = 5,
+    CustomDesign = 6,
+    CustomDesignFace = 7
+};
+
+/**
+ * @brief A named, contiguous slice of every feature row (for example the DNN part of a custom design vector).
+ */
+struct FeatureComponent {
+    std::string name;
+    std::uint32_t offset = 0; // First float of the component inside a row
+    std::uint32_t dims = 0;   // Number of floats in the component
+};
+
+/**
+ * @brief Everything the header records about a collection besides its size.
+ */
+struct FeatureStoreInfo {
+    FeatureType type = FeatureType::Unknown;
+    std::uint32_t extractorVersion = 1;
+    std::uint32_t binsPerChannel = 0;
+    std::uint32_t textureBins = 0;
+    std::vector<FeatureComponent> components;
+};
+
+/**
+ * @brief A strided, read-only window over one or more adjacent components of every row.
+ */
+struct FeatureStoreView {
+    const float* base = nullptr; // Component data of row 0
+    std::size_t stride = 0;      // Distance in floats between consecutive rows
+    std::uint32_t dims = 0;      // Floats per row inside the view
+    std::size_t rows = 0;
+
+    const float* row(std::size_t i) const { return base + i * stride; }
+};
+
+/**
+ * @brief Read-only, memory-mapped feature store.
+ *
+ * The object owns the mapping; row pointers and path views stay valid for its lifetime.
+ */
+class FeatureStore {
+public:
+    /**
+     * @brief Maps a feature store file into memory and validates its header.
+     *
+     * @param filePath Path to the feature store file.
+     * @throws std::runtime_error If the file cannot be opened or is not a valid feature store.
+     */
+    explicit FeatureStore(const std::string& filePath);
+
+    FeatureStore(const FeatureStore&) = delete;
+    FeatureStore& operator=(const FeatureStore&) = delete;
+
+    /**
+     * @brief Checks whether a file starts with the feature store magic bytes.
+     *
+     * @param filePath Path to the file to check.
+     * @return true if the file is a feature store, false otherwise (including CSV files).
+     */
+    static bool isFeatureStoreFile(const std::string& filePath);
+
+    std::size_t rows() const { return rowCount; }
+    std::uint32_t dims() const { return rowDims; }
+    std::uint32_t stride() const { return rowStride; }
+    const FeatureStoreInfo& info() const { return storeInfo; }
+    const std::string& filePath() const { return sourcePath; }
+
+    /**
+     * @brief Checks whether the file holds the inverse length of every component (version 2 and later).
+     */
+    bool hasInverseLengths() const { return inverseLengthTable != nullptr; }
+
+    /**
+     * @brief Returns the inverse lengths of a row, one per component in info().components order.
+     *
+     * Only valid if hasInverseLengths(); a zero stands for a zero length component.
+     */
+    const float* inverseLengths(std::size_t i) const { return inverseLengthTable + i * storeInfo.components.size(); }
+
+    /**
+     * @brief Returns the feature data of a row; the first dims() floats are valid, the rest is padding.
+     */
+    const float* row(std::size_t i) const { return matrix + i * rowStride; }
+
+    /**
+     * @brief Returns the image path stored for a row.
+     */
+    std::string path(std::size_t i) const;
+
+    /**
+     * @brief Looks up a component by name.
+     *
+     * @return Pointer to the component, or nullptr if the store has no component with that name.
+     */
+    const FeatureComponent* findComponent(const std::string& name) const;
+
+    /**
+     * @brief Returns a zero-copy view over one component of every row.
+     *
+     * @throws std::runtime_error If the component does not exist.
+     */
+    FeatureStoreView componentView(const std::string& name) const;
+
+    /**
+     * @brief Copies only the requested components into a dense row-major matrix.
+     *
+     * @param names Names of the components to load, in output order.
+     * @param outDims Receives the number of floats per output row.
+     * @return The packed feature data, rows() * outDims floats.
+     * @throws std::runtime_error If one of the components does not exist.
+     */
+    std::vector<float> loadComponents(const std::vector<std::string>& names, std::size_t& outDims) const;
+
+private:
+    std::string sourcePath;
+    MappedFile mapping;
+    FeatureStoreInfo storeInfo;
+    std::size_t rowCount = 0;
+    std::uint32_t rowDims = 0;
+    std::uint32_t rowStride = 0;
+    const float* matrix = nullptr;
+    const std::uint64_t* pathOffsets = nullptr;
+    const char* pathBytes = nullptr;
+    const float* inverseLengthTable = nullptr;
+};
+
+/**
+ * @brief Rounds a row length up so that every row starts on a FEATURE_STORE_ALIGNMENT boundary.
+ *
+ * @param dims Number of valid floats per row.
+ * @return Padded number of floats per row.
+ */
+std::uint32_t featureStoreRowStride(std::uint32_t dims);
+
+/**
+ * @brief Returns the default component layout for a feature type.
+ *
+ * @param type The feature type of the collection.
+ * @param dims Number of floats per row.
+ * @param binsPerChannel Color histogram bins per channel, where the type has one.
+ * @param textureBins Texture histogram bins, where the type has one.
+ * @return The component layout; a single "features" component if the type has no finer split.
+ */
+std::vector<FeatureComponent> defaultFeatureComponents(FeatureType type, std::uint32_t dims,
+    std::uint32_t binsPerChannel, std::uint32_t textureBins);
+
+/**
+ * @brief Returns the component layout a store records: info.components, or the default layout if that is empty.
+ */
+std::vector<FeatureComponent> resolveFeatureComponents(const FeatureStoreInfo& info, std::uint32_t dims);
+
+/**
+ * @brief Computes the inverse length of every component of one row, as stored in the inverse length table.
+ *
+ * @param row The row's feature values.
+ * @param components Component layout of the collection.
+ * @param out Receives components.size() values.
+ */
+void computeInverseLengths(const float* row, const std::vector<FeatureComponent>& components, float* out);
+
+/**
+ * @brief Encodes everything in front of the feature matrix: header, component table and padding.
+ *
+ * The returned block always has the same size, so a streaming writer can reserve it up front
+ * and overwrite it once the row count is known.
+ *
+ * @param info Header information for the collection; an empty layout selects the default one.
+ * @param dims Number of valid floats per row.
+ * @param rowCount Number of rows in the matrix.
+ * @param pathBytes Total length of all image paths.
+ * @return The encoded bytes; the feature matrix starts right after them.
+ * @throws std::runtime_error If the component layout is invalid.
+ */
+std::vector<char> encodeFeatureStorePrologue(const FeatureStoreInfo& info, std::uint32_t dims,
+    std::uint64_t rowCount, std::uint64_t pathBytes);
+
+/**
+ * @brief Writes a complete feature store file from a feature matrix.
+ *
+ * If info.components is empty the default layout for info.type is used.
+ *
+ * @param filePath Path of the feature store file to create (overwritten if it exists).
+ * @param info Header information for the collection.
+ * @param matrix Feature rows and image paths of the collection.
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void writeFeatureStore(const std::string& filePath, const FeatureStoreInfo& info, const FeatureMatrix& matrix);
+
+/**
+ * @brief Parses a feature type name as used on the command line.
+ *
+ * @param name One of baseline, histogram, multihistogram, texturecolor, dnn, custom, customface.
+ * @return The matching feature type, or FeatureType::Unknown.
+ */
+FeatureType parseFeatureType(const std::string& name);
+
+/**
+ * @brief Converts a CSV feature file (as written by append_image_data_csv or the precompute tasks) into a feature store.
+ *
+ * @param csvFilePath Path to the CSV feature file.
+ * @param storeFilePath Path of the feature store file to create.
+ * @param info Header information for the collection; the component layout may be left empty.
+ * @return 0 on success, a non-zero value if the CSV file cannot be read or the store cannot be written.
+ */
+int convertCsvToFeatureStore(const std::string& csvFilePath, const std::string& storeFilePath, const FeatureStoreInfo& info);
+
+#endif // FEATURE_STORE_H
@@ -7,6 +7,7 @@
 */
 
 #include "feature_utils.h"
+#include "distance_kernels.h"
 
 /**
  * @brief Computes a 3D color histogram manually from an input image.
@@ -62,11 +63,33 @@ cv::Mat compute3DColorHistogramManual(const cv::Mat& image, int binsPerChannel)
  * @return The Euclidean norm of the input vector.
  */
 float vectorLength(const std::vector<float>& vec) {
-    float sum = 0.0;
-    for (float elem : vec) {
-        sum += elem * elem;
+    return vectorLength(vec.data(), vec.size());
+}
+
+/**
+ * @brief Computes the Euclidean norm (length) of a vector stored in place, such as a feature matrix row.
+ *
+ * @param vec Pointer to the first value.
+ * @param count Number of values.
+ * @return The Euclidean norm of the vector.
+ */
+float vectorLength(const float* vec, size_t count) {
+    return std::sqrt(dotProduct(vec, vec, count));
+}
+
+/**
+ * @brief Scales a vector to unit length; a zero vector stays zero.
+ *
+ * @param vec The input vector.
+ * @return The normalized vector.
+ */
+std::vector<float> normalizeVector(const std::vector<float>& vec) {
+    std::vector<float> normalized(vec.size());
+    const float scale = inverseLength(vec.data(), vec.size());
+    for (size_t i = 0; i < vec.size(); ++i) {
+        normalized[i] = vec[i] * scale;
     }
-    return std::sqrt(sum);
+    return normalized;
 }
 
 /**
@@ -77,16 +100,41 @@ float vectorLength(const std::vector<float>& vec) {
  * @return The cosine similarity between the two input vectors.
  */
 float cosineSimilarity(const std::vector<float>& vecA, const std::vector<float>& vecB) {
-    float dotProduct = 0.0;
-    float normA = vectorLength(vecA);
-    float normB = vectorLength(vecB);
+    return cosineSimilarity(vecA.data(), vecB.data(), vecA.size());
+}
 
-    for (size_t i = 0; i < vecA.size(); ++i) {
-        dotProduct += vecA[i] * vecB[i];
-    }
+/**
+ * @brief Calculates the cosine similarity between two vectors stored in place, such as feature matrix rows.
+ *
+ * @param vecA Pointer to the first vector.
+ * @param vecB Pointer to the second vector.
+ * @param count Number of values in each vector.
+ * @return The cosine similarity between the two vectors.
+ */
+float cosineSimilarity(const float* vecA, const float* vecB, size_t count) {
+    CosineTerms terms = cosineTerms(vecA, vecB, count);
+    float normA = std::sqrt(terms.squaredNormA);
+    float normB = std::sqrt(terms.squaredNormB);
 
     // Prevent division by zero
     if (normA == 0 || normB == 0) return -1; 
 
-    return dotProduct / (normA * normB);
+    return terms.dot / (normA * normB);
+}
+
+/**
+ * @brief Calculates the cosine similarity of two vectors whose inverse lengths are already known, in one dot product pass.
+ *
+ * @param vecA Pointer to the first vector.
+ * @param vecB Pointer to the second vector.
+ * @param count Number of values in each vector.
+ * @param inverseLengthA 1 / length of the first vector, or 0 if it has zero length.
+ * @param inverseLengthB 1 / length of the second vector, or 0 if it has zero length.
+ * @return The cosine similarity between the two vectors.
+ */
+float cosineSimilarity(const float* vecA, const float* vecB, size_t count, float inverseLengthA, float inverseLengthB) {
+    // Prevent division by zero
+    if (inverseLengthA == 0 || inverseLengthB == 0) return -1;
+
+    return dotProduct(vecA, vecB, count) * inverseLengthA * inverseLengthB;
 }
\ No newline at end of file
@@ -12,6 +12,9 @@
 
 #include <opencv2/opencv.hpp>
 #include <vector>
+#include "quantized_embeddings.h"
+#include "histogram_pyramid.h"
+#include "vp_tree.h"
 
 /**
  * @brief Computes a 3D color histogram manually from an input image.
@@ -25,12 +28,18 @@ cv::Mat compute3DColorHistogramManual(const cv::Mat& image, int binsPerChannel);
 /**
  * @brief Performs deep network embeddings matching to find similar images.
  *
+ * The target image's stored embedding is used if the feature file has one; otherwise the image is
+ * embedded with ResNet-18, so any image can be the target.
+ *
  * @param targetImageFile The path to the target image file.
  * @param topN The number of top matching images to retrieve.
  * @param featureFile The path to the CSV file containing feature vectors.
+ * @param options Storage precision of the embeddings and fp32 rescoring of the best candidates, or an
+ *                approximate search through the HNSW or IVF-PQ index of the feature file.
  * @return A vector of paths to the top matching images.
  */
-std::vector<std::string> performdeepNetworkEmbeddingsMatching(const std::string& targetImageFile, int topN, const std::string& featureFile);
+std::vector<std::string> performdeepNetworkEmbeddingsMatching(const std::string& targetImageFile, int topN, const std::string& featureFile,
+    const EmbeddingSearchOptions& options = EmbeddingSearchOptions());
 
 /**
  * @brief Performs histogram matching to find similar images.
@@ -39,9 +48,11 @@ std::vector<std::string> performdeepNetworkEmbeddingsMatching(const std::string&
  * @param topN The number of top matching images to retrieve.
  * @param binsPerChannel The number of bins per color channel for histogram computation.
  * @param csvFilePath The path to the CSV file containing feature vectors.
+ * @param cascade Bound every image from a coarse level of the feature file's histogram pyramid before scoring at full resolution.
  * @return A vector of paths to the top matching images.
  */
-std::vector<std::string> performHistogramMatching(const std::string& targetImageFile, int topN, int binsPerChannel, const std::string& csvFilePath);
+std::vector<std::string> performHistogramMatching(const std::string& targetImageFile, int topN, int binsPerChannel, const std::string& csvFilePath,
+    const HistogramCascadeOptions& cascade = HistogramCascadeOptions());
 
 /**
  * @brief Calculates histograms for images in a directory and stores them in a CSV file.
@@ -80,9 +91,12 @@ void performMultiHistogramCalculationTask(const std::string& directoryPath, int
  * @param colorBinsPerChannel The number of bins per channel for the color histogram.
  * @param textureBins The number of bins for the texture histogram.
  * @param outputFile The path to the CSV file containing database histograms.
+ * @param options Search through the vantage-point tree of the feature file instead of a full scan, optionally with an evaluation budget.
+ * @param cascade Bound every image from a coarse level of its color histogram before scoring at full resolution (used if options does not pick the tree).
  * @return A vector of filenames of the top matches.
  */
-std::vector<std::string>  performTextureAndColorMatchingTask(const std::string& targetImageFile, int TopN, int colorBinsPerChannel, int textureBins, const std::string& outputFile);
+std::vector<std::string>  performTextureAndColorMatchingTask(const std::string& targetImageFile, int TopN, int colorBinsPerChannel, int textureBins, const std::string& outputFile,
+    const VpTreeSearchOptions& options = VpTreeSearchOptions(), const HistogramCascadeOptions& cascade = HistogramCascadeOptions());
 
 /**
  * @brief Perform texture and color calculation task for a directory of images.
@@ -113,7 +127,7 @@ std::vector<std::string> performBaselineMatching(const std::string& targetImageF
  *
  * @param directory A string representing the path to the directory containing the images to be processed.
  * @param outputFile A string representing the file path where the extracted feature vectors should be saved in CSV format.
- * @note This function will overwrite the existing CSV file if reset_file is set to true; otherwise, it appends to it.
+ * @note An existing output file is updated incrementally: only images that are new or changed since the last run are processed.
  * @note The function prints an error message if an image cannot be loaded or if writing to the CSV file fails.
  */
 void performBaselineCalculation(const std::string& directory, const std::string& outputFile);
@@ -134,9 +148,11 @@ std::vector<std::pair<cv::Mat, std::string>> performCustomDesignFaceCbir(const s
 * @param targetImageFile The path to the target image.
 * @param featureVectorCSVPath The path to the CSV file containing feature vectors.
 * @param topN The number of top matches to retrieve.
+* @param options Storage precision of the DNN slice or IVF-PQ probing of it, and fp32 rescoring of the best candidates.
 * @return A vector containing the paths of the top N matching images.
 */
-std::vector<std::string> performCustomDesignCbir(const std::string& targetImageFile, const std::string& featureVectorCSVPath, int topN);
+std::vector<std::string> performCustomDesignCbir(const std::string& targetImageFile, const std::string& featureVectorCSVPath, int topN,
+    const EmbeddingSearchOptions& options = EmbeddingSearchOptions());
 
 /**
 * @brief Perform custom design calculation and save feature vectors to a CSV file.
@@ -148,6 +164,15 @@ void performCustomDesignCalculation(const std::string& directory, const std::str
 
 void performCustomDesignCalculationFace(const std::string& directory, const std::string& outputFile);
 
+/**
+ * @brief Embeds the images in a directory with ResNet-18 and saves the embeddings to a feature file.
+ *
+ * @param directory The directory containing images.
+ * @param outputFile The path to the output file (CSV, or a binary feature store for ".cbfs").
+ * @note An existing output file is updated incrementally: only images that are new or changed since the last run are embedded.
+ */
+void performDeepEmbeddingCalculation(const std::string& directory, const std::string& outputFile);
+
 /**
  * @brief Calculates the cosine similarity between two vectors.
  *
@@ -157,6 +182,36 @@ void performCustomDesignCalculationFace(const std::string& directory, const std:
  */
 float cosineSimilarity(const std::vector<float>& vecA, const std::vector<float>& vecB);
 
+/**
+ * @brief Calculates the cosine similarity between two vectors stored in place, such as feature matrix rows.
+ *
+ * @param vecA Pointer to the first vector.
+ * @param vecB Pointer to the second vector.
+ * @param count Number of values in each vector.
+ * @return The cosine similarity between the two vectors.
+ */
+float cosineSimilarity(const float* vecA, const float* vecB, size_t count);
+
+/**
+ * @brief Calculates the cosine similarity of two vectors whose inverse lengths are already known, in one dot product pass.
+ *
+ * @param vecA Pointer to the first vector.
+ * @param vecB Pointer to the second vector.
+ * @param count Number of values in each vector.
+ * @param inverseLengthA 1 / length of the first vector, or 0 if it has zero length (see inverseLength).
+ * @param inverseLengthB 1 / length of the second vector, or 0 if it has zero length.
+ * @return The cosine similarity between the two vectors; -1 if either has zero length, as in cosineSimilarity.
+ */
+float cosineSimilarity(const float* vecA, const float* vecB, size_t count, float inverseLengthA, float inverseLengthB);
+
+/**
+ * @brief Scales a vector to unit length; a zero vector stays zero.
+ *
+ * @param vec The input vector.
+ * @return The normalized vector.
+ */
+std::vector<float> normalizeVector(const std::vector<float>& vec);
+
 /**
  * @brief Computes the Euclidean norm (length) of a vector.
  *
@@ -164,4 +219,13 @@ float cosineSimilarity(const std::vector<float>& vecA, const std::vector<float>&
  * @return The Euclidean norm of the input vector.
  */
 float vectorLength(const std::vector<float>& vec);
+
+/**
+ * @brief Computes the Euclidean norm (length) of a vector stored in place, such as a feature matrix row.
+ *
+ * @param vec Pointer to the first value.
+ * @param count Number of values.
+ * @return The Euclidean norm of the vector.
+ */
+float vectorLength(const float* vec, size_t count);
 #endif // FEATURE_UTILS_H
@@ -0,0 +1,288 @@
+/*! \file feature_writer.cpp
+    \brief Implements the buffered, streaming feature file writer.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Rows are formatted into a
+    large buffer with std::to_chars (CSV) or copied as raw floats (binary store). Full buffers are
+    queued to a background thread that writes them to the open file; the queue is bounded so memory
+    use stays flat when the disk is slower than extraction.
+*/
+
+#include "feature_writer.h"
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr std::size_t WRITE_BUFFER_SIZE = 8 * 1024 * 1024;
+constexpr std::size_t MAX_QUEUED_BUFFERS = 4;
+
+} // namespace
+
+bool syncFileToDisk(FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+FeatureFileFormat featureFileFormatFor(const std::string& filePath) {
+    return std::filesystem::path(filePath).extension() == ".cbfs" ? FeatureFileFormat::Store : FeatureFileFormat::Csv;
+}
+
+struct FeatureWriter::Impl {
+    std::string path;
+    FeatureFileFormat format = FeatureFileFormat::Csv;
+    FeatureStoreInfo info;
+    FILE* file = nullptr;
+    bool closed = false;
+    bool durable = false;
+
+    std::size_t rows = 0;
+    std::size_t dims = 0;   // Store mode: valid floats per row, fixed by the first row
+    std::size_t stride = 0; // Store mode: padded floats per row
+    std::vector<std::string> imagePaths; // Store mode: string table, written on close
+    std::uint64_t pathBytes = 0;
+    std::vector<FeatureComponent> components; // Store mode: layout, fixed with the row width
+    std::vector<float> inverseLengths;        // Store mode: inverse length table, written on close
+
+    std::vector<char> active;
+
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<std::vector<char>> queue;
+    bool stopping = false;
+    std::string error;
+    std::thread flusher;
+
+    /**
+     * @brief Background thread: writes queued buffers until asked to stop and the queue is empty.
+     */
+    void flushLoop() {
+        for (;;) {
+            std::vector<char> buffer;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueChanged.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                buffer = std::move(queue.front());
+                queue.pop_front();
+            }
+            queueChanged.notify_all();
+
+            if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                error = "Error writing feature file: " + path;
+            }
+        }
+    }
+
+    /**
+     * @brief Hands the active buffer to the flush thread, waiting if too many buffers are already queued.
+     */
+    void submitActive() {
+        if (active.empty()) return;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this]() { return queue.size() < MAX_QUEUED_BUFFERS; });
+            queue.push_back(std::move(active));
+        }
+        queueChanged.notify_all();
+        active = std::vector<char>();
+        active.reserve(WRITE_BUFFER_SIZE);
+    }
+
+    /**
+     * @brief Throws if the flush thread has recorded a write error.
+     */
+    void checkError() {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (!error.empty()) throw std::runtime_error(error);
+    }
+
+    /**
+     * @brief Appends one CSV line to the active buffer.
+     */
+    void appendCsv(const std::string& imagePath, const float* features, std::size_t count) {
+        std::size_t start = active.size();
+        active.resize(start + imagePath.size() + count * 16 + 1);
+        char* out = active.data() + start;
+        std::memcpy(out, imagePath.data(), imagePath.size());
+        out += imagePath.size();
+        char* end = active.data() + active.size();
+        for (std::size_t i = 0; i < count; ++i) {
+            *out++ = ',';
+            out = std::to_chars(out, end, features[i]).ptr; // Shortest text that reads back as the same float
+        }
+        *out++ = '\n';
+        active.resize(static_cast<std::size_t>(out - active.data()));
+    }
+
+    /**
+     * @brief Appends one padded binary row to the active buffer.
+     */
+    void appendStoreRow(const std::string& imagePath, const float* features, std::size_t count) {
+        if (rows == 0 && dims == 0) {
+            dims = count;
+            stride = featureStoreRowStride(static_cast<std::uint32_t>(dims));
+        }
+        if (components.empty()) {
+            components = resolveFeatureComponents(info, static_cast<std::uint32_t>(dims));
+        }
+        std::size_t start = active.size();
+        active.resize(start + stride * sizeof(float), 0);
+        std::memcpy(active.data() + start, features, std::min(count, dims) * sizeof(float));
+
+        // Measured on the padded copy, so a short row is measured as it is stored
+        const float* stored = reinterpret_cast<const float*>(active.data() + start);
+        inverseLengths.resize(inverseLengths.size() + components.size());
+        computeInverseLengths(stored, components, inverseLengths.data() + inverseLengths.size() - components.size());
+
+        imagePaths.push_back(imagePath);
+        pathBytes += imagePath.size();
+    }
+
+    /**
+     * @brief Store mode: writes the string table and the inverse length table and fills in the reserved header.
+     */
+    void finishStore() {
+        std::vector<char> table((imagePaths.size() + 1) * sizeof(std::uint64_t));
+        std::uint64_t offset = 0;
+        for (std::size_t i = 0; i < imagePaths.size(); ++i) {
+            std::memcpy(table.data() + i * sizeof(offset), &offset, sizeof(offset));
+            offset += imagePaths[i].size();
+        }
+        std::memcpy(table.data() + imagePaths.size() * sizeof(offset), &offset, sizeof(offset));
+        for (const auto& imagePath : imagePaths) {
+            table.insert(table.end(), imagePath.begin(), imagePath.end());
+        }
+
+        std::vector<char> prologue = encodeFeatureStorePrologue(info, static_cast<std::uint32_t>(dims), rows, pathBytes);
+        const std::size_t tableEnd = prologue.size() + rows * stride * sizeof(float) + table.size();
+        table.resize(table.size() + (FEATURE_STORE_ALIGNMENT - tableEnd % FEATURE_STORE_ALIGNMENT) % FEATURE_STORE_ALIGNMENT, 0);
+        const char* lengths = reinterpret_cast<const char*>(inverseLengths.data());
+        table.insert(table.end(), lengths, lengths + inverseLengths.size() * sizeof(float));
+
+        bool ok = std::fwrite(table.data(), 1, table.size(), file) == table.size()
+            && std::fseek(file, 0, SEEK_SET) == 0
+            && std::fwrite(prologue.data(), 1, prologue.size(), file) == prologue.size();
+        if (!ok) {
+            throw std::runtime_error("Error writing feature file: " + path);
+        }
+    }
+};
+
+FeatureWriter::FeatureWriter(const std::string& filePath, const FeatureStoreInfo& info) : impl(new Impl()) {
+    impl->path = filePath;
+    impl->format = featureFileFormatFor(filePath);
+    impl->info = info;
+    impl->file = std::fopen(filePath.c_str(), "wb");
+    if (!impl->file) {
+        throw std::runtime_error("Unable to open output file " + filePath);
+    }
+    std::setvbuf(impl->file, nullptr, _IONBF, 0); // Writes are already large blocks
+
+    if (impl->format == FeatureFileFormat::Store) {
+        // Reserve the header block; it is filled in by close() once the row count is known
+        std::vector<char> reserved = encodeFeatureStorePrologue(FeatureStoreInfo(), 0, 0, 0);
+        std::fill(reserved.begin(), reserved.end(), 0);
+        impl->active = std::move(reserved);
+    }
+    impl->active.reserve(WRITE_BUFFER_SIZE);
+    impl->flusher = std::thread([this]() { impl->flushLoop(); });
+}
+
+FeatureWriter::~FeatureWriter() {
+    try {
+        close();
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void FeatureWriter::setRowDims(std::size_t dims) {
+    if (impl->rows > 0) {
+        throw std::runtime_error("Feature writer: row width must be set before the first row.");
+    }
+    impl->dims = dims;
+    impl->stride = featureStoreRowStride(static_cast<std::uint32_t>(dims));
+}
+
+void FeatureWriter::setDurable(bool durable) {
+    impl->durable = durable;
+}
+
+void FeatureWriter::write(const std::string& imagePath, const float* features, std::size_t count) {
+    if (impl->closed) {
+        throw std::runtime_error("Feature writer is closed: " + impl->path);
+    }
+    impl->checkError();
+
+    if (impl->format == FeatureFileFormat::Store) {
+        impl->appendStoreRow(imagePath, features, count);
+    }
+    else {
+        impl->appendCsv(imagePath, features, count);
+    }
+    ++impl->rows;
+
+    if (impl->active.size() >= WRITE_BUFFER_SIZE) {
+        impl->submitActive();
+    }
+}
+
+void FeatureWriter::close() {
+    if (impl->closed) return;
+    impl->closed = true;
+
+    impl->submitActive();
+    {
+        std::lock_guard<std::mutex> lock(impl->queueMutex);
+        impl->stopping = true;
+    }
+    impl->queueChanged.notify_all();
+    impl->flusher.join();
+
+    try {
+        impl->checkError();
+        if (impl->format == FeatureFileFormat::Store) {
+            impl->finishStore();
+        }
+        if (impl->durable && !syncFileToDisk(impl->file)) {
+            throw std::runtime_error("Error flushing feature file to disk: " + impl->path);
+        }
+    }
+    catch (...) {
+        std::fclose(impl->file);
+        throw;
+    }
+    if (std::fclose(impl->file) != 0) {
+        throw std::runtime_error("Error writing feature file: " + impl->path);
+    }
+}
+
+std::size_t FeatureWriter::rowsWritten() const {
+    return impl->rows;
+}
+
+const std::string& FeatureWriter::filePath() const {
+    return impl->path;
+}
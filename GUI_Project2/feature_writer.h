@@ -0,0 +1,121 @@
+/*! \file feature_writer.h
+    \brief Declarations for the buffered, streaming feature file writer.
+    \author Manushi
+    \date October 16, 2026
+
+    Every precompute task writes its feature rows through a FeatureWriter. The writer keeps the
+    output file open for the whole run, formats rows into large in-memory buffers and hands full
+    buffers to a background thread that writes them out, so extraction never waits on the disk.
+    Files ending in ".cbfs" are written as binary feature stores, anything else as CSV.
+*/
+
+#ifndef FEATURE_WRITER_H
+#define FEATURE_WRITER_H
+
+#include "feature_store.h"
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief On-disk format produced by a FeatureWriter.
+ */
+enum class FeatureFileFormat {
+    Csv,  // One "path,value,value,..." line per image
+    Store // Binary feature store (see feature_store.h)
+};
+
+/**
+ * @brief Picks the output format from a file name: ".cbfs" selects the binary store, anything else CSV.
+ *
+ * @param filePath Path of the feature file.
+ * @return The format to write.
+ */
+FeatureFileFormat featureFileFormatFor(const std::string& filePath);
+
+/**
+ * @brief Flushes a stdio file and asks the operating system to write it through to the storage device.
+ *
+ * @return False if either step failed.
+ */
+bool syncFileToDisk(FILE* file);
+
+/**
+ * @brief Buffered writer for feature rows with a background flush thread.
+ *
+ * In store mode the row width is fixed by the first row (or by FeatureWriter::setRowDims); later
+ * rows are zero padded or truncated to that width.
+ */
+class FeatureWriter {
+public:
+    /**
+     * @brief Opens (and truncates) the output file and starts the flush thread.
+     *
+     * @param filePath Path of the feature file to write.
+     * @param info Header information recorded when writing a binary feature store.
+     * @throws std::runtime_error If the file cannot be opened.
+     */
+    explicit FeatureWriter(const std::string& filePath, const FeatureStoreInfo& info = FeatureStoreInfo());
+
+    /**
+     * @brief Closes the writer; errors at this point are reported on std::cerr instead of thrown.
+     */
+    ~FeatureWriter();
+
+    FeatureWriter(const FeatureWriter&) = delete;
+    FeatureWriter& operator=(const FeatureWriter&) = delete;
+
+    /**
+     * @brief Fixes the row width of a binary feature store before the first row is written.
+     */
+    void setRowDims(std::size_t dims);
+
+    /**
+     * @brief Makes close() flush the file to the storage device before returning.
+     *
+     * Used for checkpoints that must survive a crash or power loss once close() has returned.
+     */
+    void setDurable(bool durable);
+
+    /**
+     * @brief Queues one feature row.
+     *
+     * @param imagePath Path of the image the features belong to.
+     * @param features Feature values.
+     * @param count Number of feature values.
+     * @throws std::runtime_error If an earlier background write failed.
+     */
+    void write(const std::string& imagePath, const float* features, std::size_t count);
+
+    /**
+     * @brief Queues one feature row.
+     */
+    void write(const std::string& imagePath, const std::vector<float>& features) {
+        write(imagePath, features.data(), features.size());
+    }
+
+    /**
+     * @brief Flushes all queued rows, finishes the file and stops the flush thread.
+     *
+     * @throws std::runtime_error If writing the file failed.
+     */
+    void close();
+
+    /**
+     * @brief Number of rows written so far.
+     */
+    std::size_t rowsWritten() const;
+
+    /**
+     * @brief Path of the file being written.
+     */
+    const std::string& filePath() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif // FEATURE_WRITER_H
@@ -4,7 +4,7 @@
     \date February 10, 2024
 
     This file is part of a Content-Based Image Retrieval (CBIR) system, focusing specifically on the histogram matching approach.
-    It includes functions to load database histograms, compute histogram intersection, perform histogram matching, compute color
+    It includes functions to compute histogram intersection, perform histogram matching, compute color
     histograms manually, and preprocess database images.
 */
 
@@ -17,44 +17,16 @@
 #include <string>
 #include <algorithm>
 #include <filesystem>
+#include "distance_kernels.h"
 #include "feature_utils.h"
+#include "feature_store.h"
+#include "feature_indexer.h"
+#include "histogram_pyramid.h"
+#include "parallel_scan.h"
+#include "sparse_histogram.h"
 
 namespace fs = std::filesystem;
 
-/**
- * @brief Reads histogram data from a CSV file containing pre-computed histograms of images in the database. It parses the file line by
- * line, extracts the filename and histogram values, and constructs a vector of pairs containing the filename and corresponding histogram
- * as a cv::Mat.
- *
- * @param csvFilePath The path to the CSV file containing histogram data.
- * @param binsPerChannel The number of bins per color channel in the histogram.
- * @param databaseHistograms Output vector to store the loaded histograms and their corresponding filenames.
- * @throws std::runtime_error If there is an error while reading the CSV file.
- */
-void loadDatabaseHistograms(const std::string& csvFilePath, int binsPerChannel,
-    std::vector<std::pair<std::string, cv::Mat>>& databaseHistograms) {
-    std::ifstream file(csvFilePath);
-    std::string line;
-    while (getline(file, line)) {
-        std::istringstream iss(line);
-        std::string filename;
-        getline(iss, filename, ','); // Extract filename
-
-        std::vector<float> bins;
-        std::string binValue;
-        while (getline(iss, binValue, ',')) {
-            bins.push_back(std::stof(binValue));
-        }
-
-        // Check if the number of bins matches the expected size for a 3D histogram
-        int expectedBinCount = binsPerChannel * binsPerChannel * binsPerChannel;
-
-        // Create a 3D histogram from the flattened vector
-        cv::Mat hist(3, std::vector<int>{binsPerChannel, binsPerChannel, binsPerChannel}.data(), CV_32F, bins.data());
-        databaseHistograms.push_back(std::make_pair(filename, hist.clone())); // Clone the Mat to copy the data
-    }
-}
-
 /**
  * @brief Computes the histogram intersection between two histograms.
  *
@@ -64,6 +36,9 @@ void loadDatabaseHistograms(const std::string& csvFilePath, int binsPerChannel,
  */
 float histogramIntersection(const cv::Mat& hist1, const cv::Mat& hist2) {
     CV_Assert(hist1.dims == hist2.dims && hist1.size == hist2.size && hist1.type() == hist2.type());
+    if (hist1.isContinuous() && hist2.isContinuous()) {
+        return intersectionSum(hist1.ptr<float>(), hist2.ptr<float>(), hist1.total());
+    }
     float intersection = 0.0f;
     for (int r = 0; r < hist1.size[0]; ++r) {
         for (int g = 0; g < hist1.size[1]; ++g) {
@@ -77,6 +52,49 @@ float histogramIntersection(const cv::Mat& hist1, const cv::Mat& hist2) {
     return intersection;
 }
 
+/**
+ * @brief Finds the best histogram intersections with a coarse-to-fine cascade over the pyramid of the feature file.
+ *
+ * @param matches Receives up to topN (intersection, row) pairs, best first.
+ * @return False, with a message, if the pyramid cannot be used; the caller then scans instead.
+ */
+static bool cascadeHistogramSearch(const HistogramIndex& index, const HistogramSet::Query& query, int binsPerChannel, size_t topN,
+    const std::string& targetImageFile, const HistogramCascadeOptions& options, std::vector<std::pair<float, size_t>>& matches) {
+    HistogramPyramidHandle pyramid;
+    try {
+        pyramid = openHistogramPyramid(index.filePath, static_cast<std::uint32_t>(binsPerChannel));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Histogram pyramid unavailable, scanning instead: " << e.what() << std::endl;
+        return false;
+    }
+    const std::uint32_t coarseBins = pyramid->pickLevel(options.coarseBinsPerChannel);
+    if (coarseBins == 0 || pyramid->size() != index.size()) {
+        std::cerr << "No matching coarse level in " << histogramPyramidPath(index.filePath) << ", scanning instead" << std::endl;
+        return false;
+    }
+
+    // The coarse intersection of a row is at least its full resolution intersection
+    const size_t levelBins = static_cast<size_t>(coarseBins) * coarseBins * coarseBins;
+    const size_t fineBins = static_cast<size_t>(binsPerChannel) * binsPerChannel * binsPerChannel;
+    std::vector<float> coarseTarget(levelBins);
+    coarsenHistogram(query.dense.data(), static_cast<std::uint32_t>(binsPerChannel), coarseBins, coarseTarget.data());
+    const float* level = pyramid->level(coarseBins);
+
+    HistogramCascadeStats stats;
+    stats.coarseBins = coarseBins;
+    matches = cascadeTopK(index.size(), topN, ScanOrder::Descending, options.shortlist,
+        [&](size_t begin, size_t end, float* bounds) {
+            for (size_t i = begin; i < end; ++i) {
+                bounds[i - begin] = index.imagePaths[i] == targetImageFile ? SKIPPED_ROW
+                    : intersectionSum(coarseTarget.data(), level + i * levelBins, levelBins);
+            }
+        },
+        [&](size_t row, float) { return index.histograms.intersection(query, row, 0, fineBins); }, &stats);
+    printHistogramCascadeStats(stats);
+    return true;
+}
+
 /**
  * @brief Performs histogram matching between a target image and a database of images.
  *
@@ -84,36 +102,51 @@ float histogramIntersection(const cv::Mat& hist1, const cv::Mat& hist2) {
  * @param topN Number of top matching images to return.
  * @param binsPerChannel Number of bins per color channel in the histogram.
  * @param csvFilePath Path to the CSV file containing database histogram data.
+ * @param cascade Bound every image from a coarse level of the feature file's histogram pyramid before scoring at full resolution.
  * @return std::vector<std::string> Vector of filenames of the top N matching images.
  */
-std::vector<std::string> performHistogramMatching(const std::string& targetImageFile, int topN, int binsPerChannel, const std::string& csvFilePath) {
+std::vector<std::string> performHistogramMatching(const std::string& targetImageFile, int topN, int binsPerChannel, const std::string& csvFilePath,
+    const HistogramCascadeOptions& cascade) {
 
     // Load the target image and compute its histogram manually
     cv::Mat targetImage = cv::imread(targetImageFile, cv::IMREAD_COLOR);
 
     cv::Mat targetHist = compute3DColorHistogramManual(targetImage, binsPerChannel);
 
-    std::vector<std::pair<std::string, cv::Mat>> databaseHistograms; // Pair of filename and histogram
-    loadDatabaseHistograms(csvFilePath, binsPerChannel, databaseHistograms);
-
-    // Compute histogram intersections with the target image
-    std::vector<std::pair<float, std::string>> matches;
-
-    for (const auto& [filename, hist] : databaseHistograms) {
-        if (filename == targetImageFile) continue; // Skip if it's the target image
+    // Get the database histograms from the cached index (loaded on first use); sparse rows keep only their filled bins
+    HistogramIndexHandle index;
+    try {
+        index = openHistogramIndex(csvFilePath);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading histogram data: " << e.what() << std::endl;
+        return {};
+    }
 
-        float intersection = histogramIntersection(targetHist, hist);
-        matches.push_back({ intersection, filename });
+    const size_t expectedBinCount = static_cast<size_t>(binsPerChannel) * binsPerChannel * binsPerChannel;
+    const HistogramSet& histograms = index->histograms;
+    if (histograms.binCount() < expectedBinCount) {
+        std::cerr << "Histogram size mismatch for " << csvFilePath << std::endl;
+        return {};
     }
 
-    // Sort based on the intersection (higher is better)
-    std::sort(matches.begin(), matches.end(), [](const auto& a, const auto& b) {
-        return a.first > b.first; 
-        });
+    // The target histogram is continuous, so its bins can be read as one flat array
+    std::vector<float> targetBins(histograms.binCount(), 0.0f);
+    std::copy(targetHist.ptr<float>(), targetHist.ptr<float>() + expectedBinCount, targetBins.begin());
+    HistogramSet::Query query = histograms.prepareQuery(targetBins.data());
+
+    // Find the highest histogram intersections on all scan threads, skipping rows whose block bounds fall short
+    std::vector<std::pair<float, size_t>> matches;
+    if (!cascade.useCascade
+        || !cascadeHistogramSearch(*index, query, binsPerChannel, static_cast<size_t>(std::max(topN, 0)), targetImageFile, cascade, matches)) {
+        HistogramSearchStats stats;
+        matches = searchIntersectionTopK(*index, query, { expectedBinCount }, static_cast<size_t>(std::max(topN, 0)), targetImageFile, &stats);
+        printHistogramSearchStats(stats);
+    }
 
     std::vector<std::string> topMatches;
-    for (int i = 0; i < std::min(topN, static_cast<int>(matches.size())); ++i) {
-        topMatches.push_back(matches[i].second);
+    for (const auto& match : matches) {
+        topMatches.push_back(index->imagePaths[match.second]);
     }
 
     return topMatches;
@@ -160,30 +193,25 @@ std::vector<float> computeColorHistogramManual(const cv::Mat& image, int binsPer
  * @param directoryPath Path to the directory containing images.
  * @param outputFile Path to the output CSV file to save histogram data.
  * @param binsPerChannel Number of bins per color channel in the histogram.
+ * @throws std::runtime_error If the output file cannot be written.
  */
 void preprocessDatabaseImages(const std::string& directoryPath, const std::string& outputFile, const std::int32_t& binsPerChannel) {
-    std::ofstream out(outputFile);
-
-    // Iterate over all files in the given directory
-    for (const auto& entry : fs::directory_iterator(directoryPath)) {
-        // Check if the entry is a file and has a .jpg extension (you can add more conditions for other formats)
-        if (entry.is_regular_file() && entry.path().extension() == ".jpg") {
-            std::string imagePath = entry.path().string();
-            cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
-            if (image.empty()) {
-                std::cerr << "Unable to read image: " << imagePath << std::endl;
-                continue; // Skip to the next file if this one can't be read
-            }
-
-            // Compute and save the histogram
-            std::vector<float> histogram = computeColorHistogramManual(image, binsPerChannel);
-            out << imagePath;
-            for (float value : histogram) {
-                out << "," << value;
-            }
-            out << "\n";
+    FeatureStoreInfo info;
+    info.type = FeatureType::Histogram;
+    info.binsPerChannel = binsPerChannel;
+
+    // Only new or changed images are decoded; unchanged rows are copied from the previous output
+    indexImageDirectory(directoryPath, outputFile, info, [binsPerChannel](const std::string& imagePath, std::vector<float>& histogram) {
+        cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "Unable to read image: " << imagePath << std::endl;
+            return false; // Skip to the next file if this one can't be read
         }
-    }
+
+        // Compute the histogram
+        histogram = computeColorHistogramManual(image, binsPerChannel);
+        return true;
+        });
 }
 
 /**
@@ -195,7 +223,18 @@ void preprocessDatabaseImages(const std::string& directoryPath, const std::strin
  */
 void performHistogramCalculation(const std::string& directoryPath, int binsPerChannel, const std::string& outputFile)
 {
-    preprocessDatabaseImages(directoryPath, outputFile, binsPerChannel);
+    try {
+        preprocessDatabaseImages(directoryPath, outputFile, binsPerChannel);
+
+        // Coarse levels for cascade searches are summed from the stored histograms now, so no search has to build them
+        if (!coarseHistogramLevels(static_cast<std::uint32_t>(binsPerChannel)).empty()) {
+            buildHistogramPyramid(outputFile, static_cast<std::uint32_t>(binsPerChannel), histogramPyramidPath(outputFile));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to save histograms: " << e.what() << std::endl;
+        return;
+    }
 
     std::cout << "\nHistograms computed and saved to " << outputFile << "\n\n" << std::endl;
 }
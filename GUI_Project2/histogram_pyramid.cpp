@@ -0,0 +1,349 @@
+/*! \file histogram_pyramid.cpp
+    \brief Implements coarse color histogram levels and the coarse-to-fine cascade search.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. A pyramid file holds one
+    contiguous block of values per coarse level and one for the values after the color part, so the
+    coarse pass of a cascade streams a few floats per row instead of touching the full rows. The
+    cascade sorts the bounds lazily: only the next batch of candidates is put in order, and a
+    search that stops early never sorts the rest.
+
+    File layout (all integers little endian, every section starts on a 64-byte boundary):
+      - HistogramPyramidHeader
+      - for every level: rowCount x levelBins^3 floats
+      - rowCount x tailDims floats
+*/
+
+#include "histogram_pyramid.h"
+#include "feature_matrix.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char PYRAMID_MAGIC[8] = { 'C', 'B', 'I', 'R', 'P', 'Y', 'R', 'D' };
+constexpr std::uint32_t PYRAMID_VERSION = 1;
+constexpr std::uint64_t PYRAMID_ALIGNMENT = 64;
+constexpr std::size_t PYRAMID_MAX_LEVELS = 4;
+constexpr std::size_t BOUND_BLOCK_ROWS = 4096;
+constexpr std::size_t CASCADE_BATCH = 256;
+
+#pragma pack(push, 1)
+/**
+ * @brief Fixed-size header at the start of a pyramid file.
+ */
+struct HistogramPyramidHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t binsPerChannel;
+    std::uint32_t levelCount;
+    std::uint32_t tailDims;
+    std::uint64_t rowCount;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModified;
+    std::uint32_t levelBins[PYRAMID_MAX_LEVELS];
+    std::uint64_t levelOffsets[PYRAMID_MAX_LEVELS];
+    std::uint64_t tailOffset;
+    std::uint64_t fileSize;
+};
+#pragma pack(pop)
+
+std::uint64_t alignOffset(std::uint64_t offset) {
+    return (offset + PYRAMID_ALIGNMENT - 1) / PYRAMID_ALIGNMENT * PYRAMID_ALIGNMENT;
+}
+
+std::uint64_t cube(std::uint64_t bins) {
+    return bins * bins * bins;
+}
+
+/**
+ * @brief Size and modification time of a file, as recorded in the pyramid header.
+ */
+void sourceFileState(const std::string& filePath, std::uint64_t& size, std::int64_t& modified) {
+    size = static_cast<std::uint64_t>(fs::file_size(filePath));
+    modified = static_cast<std::int64_t>(fs::last_write_time(filePath).time_since_epoch().count());
+}
+
+/**
+ * @brief True if a bound leaves a row no chance against the k-th best score.
+ *
+ * Bounds and scores are float sums taken in different orders, so a small slack keeps rounding
+ * from dropping a row that ties with the k-th best.
+ */
+bool outOfReach(float bound, float kth, ScanOrder order) {
+    const float slack = 1e-5f * (1.0f + std::fabs(kth));
+    return order == ScanOrder::Descending ? bound + slack < kth : bound - slack > kth;
+}
+
+/**
+ * @brief Cache entry: a loaded pyramid and the file state it was loaded from.
+ */
+struct CachedPyramid {
+    std::uintmax_t fileSize = 0;
+    fs::file_time_type modifiedTime;
+    HistogramPyramidHandle pyramid;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedPyramid> cachedPyramids;
+
+} // namespace
+
+std::vector<std::uint32_t> coarseHistogramLevels(std::uint32_t binsPerChannel) {
+    std::vector<std::uint32_t> levels;
+    for (std::uint32_t bins : { 4u, 2u }) {
+        if (bins < binsPerChannel && binsPerChannel % bins == 0) levels.push_back(bins);
+    }
+    return levels;
+}
+
+void coarsenHistogram(const float* fine, std::uint32_t binsPerChannel, std::uint32_t coarseBinsPerChannel, float* coarse) {
+    const std::uint32_t factor = binsPerChannel / coarseBinsPerChannel;
+    std::fill(coarse, coarse + cube(coarseBinsPerChannel), 0.0f);
+    for (std::uint32_t r = 0; r < binsPerChannel; ++r) {
+        for (std::uint32_t g = 0; g < binsPerChannel; ++g) {
+            const float* run = fine + (static_cast<std::size_t>(r) * binsPerChannel + g) * binsPerChannel;
+            float* target = coarse + (static_cast<std::size_t>(r / factor) * coarseBinsPerChannel + g / factor) * coarseBinsPerChannel;
+            for (std::uint32_t b = 0; b < binsPerChannel; ++b) target[b / factor] += run[b];
+        }
+    }
+}
+
+HistogramPyramid::HistogramPyramid(const std::string& pyramidFilePath) : mapping(pyramidFilePath) {
+    const unsigned char* data = mapping.data();
+    HistogramPyramidHeader header;
+    if (mapping.size() < sizeof(header)) {
+        throw std::runtime_error("Histogram pyramid file is truncated: " + pyramidFilePath);
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    bool valid = std::memcmp(header.magic, PYRAMID_MAGIC, sizeof(header.magic)) == 0
+        && header.version == PYRAMID_VERSION
+        && header.fileSize == mapping.size()
+        && header.levelCount <= PYRAMID_MAX_LEVELS
+        && header.tailOffset % PYRAMID_ALIGNMENT == 0
+        && header.tailOffset + header.rowCount * header.tailDims * sizeof(float) <= mapping.size();
+    for (std::uint32_t i = 0; valid && i < header.levelCount; ++i) {
+        valid = header.levelBins[i] > 0 && header.levelOffsets[i] % PYRAMID_ALIGNMENT == 0
+            && header.levelOffsets[i] + header.rowCount * cube(header.levelBins[i]) * sizeof(float) <= mapping.size();
+    }
+    if (!valid) {
+        throw std::runtime_error("Not a valid histogram pyramid file (or unsupported version): " + pyramidFilePath);
+    }
+
+    rowCount = static_cast<std::size_t>(header.rowCount);
+    fineBinsPerChannel = header.binsPerChannel;
+    tailCount = header.tailDims;
+    sourceSize = header.sourceSize;
+    sourceModified = header.sourceModified;
+    for (std::uint32_t i = 0; i < header.levelCount; ++i) {
+        levels.emplace_back(header.levelBins[i], reinterpret_cast<const float*>(data + header.levelOffsets[i]));
+    }
+    tailValues = reinterpret_cast<const float*>(data + header.tailOffset);
+}
+
+const float* HistogramPyramid::level(std::uint32_t coarseBinsPerChannel) const {
+    for (const auto& stored : levels) {
+        if (stored.first == coarseBinsPerChannel) return stored.second;
+    }
+    return nullptr;
+}
+
+std::uint32_t HistogramPyramid::pickLevel(std::uint32_t coarseBinsPerChannel) const {
+    if (coarseBinsPerChannel == 0) return levels.empty() ? 0 : levels.front().first; // Levels are stored finest first
+    return level(coarseBinsPerChannel) ? coarseBinsPerChannel : 0;
+}
+
+bool HistogramPyramid::isBuiltFrom(const std::string& featureFilePath) const {
+    std::uint64_t size = 0;
+    std::int64_t modified = 0;
+    try {
+        sourceFileState(featureFilePath, size, modified);
+    }
+    catch (const fs::filesystem_error&) {
+        return false;
+    }
+    return size == sourceSize && modified == sourceModified;
+}
+
+std::string histogramPyramidPath(const std::string& featureFilePath) {
+    return featureFilePath + ".pyramid";
+}
+
+void buildHistogramPyramid(const std::string& featureFilePath, std::uint32_t binsPerChannel, const std::string& pyramidFilePath) {
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    sourceFileState(featureFilePath, sourceSize, sourceModified);
+
+    const FeatureMatrix features = readFeatureMatrix(featureFilePath);
+    const std::size_t colorBins = static_cast<std::size_t>(cube(binsPerChannel));
+    if (binsPerChannel == 0 || (!features.empty() && features.dims() < colorBins)) {
+        throw std::runtime_error("Histogram size mismatch for " + featureFilePath);
+    }
+    const std::vector<std::uint32_t> levelBins = coarseHistogramLevels(binsPerChannel);
+
+    HistogramPyramidHeader header = {};
+    std::memcpy(header.magic, PYRAMID_MAGIC, sizeof(header.magic));
+    header.version = PYRAMID_VERSION;
+    header.binsPerChannel = binsPerChannel;
+    header.levelCount = static_cast<std::uint32_t>(levelBins.size());
+    header.tailDims = static_cast<std::uint32_t>(features.empty() ? 0 : features.dims() - colorBins);
+    header.rowCount = features.rows();
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+    std::uint64_t offset = alignOffset(sizeof(HistogramPyramidHeader));
+    for (std::size_t i = 0; i < levelBins.size(); ++i) {
+        header.levelBins[i] = levelBins[i];
+        header.levelOffsets[i] = offset;
+        offset = alignOffset(offset + header.rowCount * cube(levelBins[i]) * sizeof(float));
+    }
+    header.tailOffset = offset;
+    header.fileSize = header.tailOffset + header.rowCount * header.tailDims * sizeof(float);
+
+    // Written under a temporary name so an interrupted build never leaves a half-written pyramid
+    const std::string partialPath = pyramidFilePath + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to open histogram pyramid file for writing: " + partialPath);
+        }
+        std::uint64_t written = 0;
+        auto put = [&](const void* data, std::uint64_t bytes) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            written += bytes;
+        };
+        auto padTo = [&](std::uint64_t target) {
+            static const char zeros[PYRAMID_ALIGNMENT] = {};
+            put(zeros, target - written);
+        };
+
+        put(&header, sizeof(header));
+        for (std::size_t i = 0; i < levelBins.size(); ++i) {
+            padTo(header.levelOffsets[i]);
+            std::vector<float> coarse(static_cast<std::size_t>(cube(levelBins[i])));
+            for (std::size_t row = 0; row < features.rows(); ++row) {
+                coarsenHistogram(features.row(row), binsPerChannel, levelBins[i], coarse.data());
+                put(coarse.data(), coarse.size() * sizeof(float));
+            }
+        }
+        padTo(header.tailOffset);
+        for (std::size_t row = 0; row < features.rows(); ++row) put(features.row(row) + colorBins, header.tailDims * sizeof(float));
+
+        if (!out.good()) {
+            throw std::runtime_error("Error writing histogram pyramid file: " + partialPath);
+        }
+    }
+    std::error_code error;
+    fs::rename(partialPath, pyramidFilePath, error);
+    if (error) {
+        fs::remove(partialPath, error);
+        throw std::runtime_error("Unable to replace histogram pyramid file: " + pyramidFilePath);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Built histogram pyramid of " << features.rows() << " rows in " << seconds << " s: " << pyramidFilePath << std::endl;
+}
+
+HistogramPyramidHandle openHistogramPyramid(const std::string& featureFilePath, std::uint32_t binsPerChannel) {
+    const std::string pyramidFilePath = histogramPyramidPath(featureFilePath);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(pyramidFilePath, error);
+    const fs::file_time_type modifiedTime = fs::last_write_time(pyramidFilePath, error);
+    auto cached = cachedPyramids.find(pyramidFilePath);
+    if (!error && cached != cachedPyramids.end() && cached->second.fileSize == fileSize && cached->second.modifiedTime == modifiedTime
+        && cached->second.pyramid->binsPerChannel() == binsPerChannel && cached->second.pyramid->isBuiltFrom(featureFilePath)) {
+        return cached->second.pyramid;
+    }
+
+    // Drop the cached mapping first, so the file can be replaced if it has to be rebuilt
+    cachedPyramids.erase(pyramidFilePath);
+    HistogramPyramidHandle pyramid;
+    if (!error) {
+        try {
+            auto loaded = std::make_shared<const HistogramPyramid>(pyramidFilePath);
+            if (loaded->binsPerChannel() == binsPerChannel && loaded->isBuiltFrom(featureFilePath)) pyramid = loaded;
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Rebuilding histogram pyramid: " << e.what() << std::endl;
+        }
+    }
+    if (!pyramid) {
+        buildHistogramPyramid(featureFilePath, binsPerChannel, pyramidFilePath);
+        pyramid = std::make_shared<const HistogramPyramid>(pyramidFilePath);
+    }
+
+    CachedPyramid entry;
+    entry.fileSize = fs::file_size(pyramidFilePath);
+    entry.modifiedTime = fs::last_write_time(pyramidFilePath);
+    entry.pyramid = pyramid;
+    cachedPyramids[pyramidFilePath] = entry;
+    return pyramid;
+}
+
+std::vector<std::pair<float, std::size_t>> cascadeTopK(std::size_t rows, std::size_t topK, ScanOrder order, std::size_t shortlist,
+    const RowBlockBounder& bound, const std::function<float(std::size_t row, float threshold)>& score, HistogramCascadeStats* stats) {
+    std::vector<float> bounds(rows);
+    parallelFor(topK > 0 ? (rows + BOUND_BLOCK_ROWS - 1) / BOUND_BLOCK_ROWS : 0, [&](std::size_t block) {
+        const std::size_t begin = block * BOUND_BLOCK_ROWS;
+        bound(begin, std::min(rows, begin + BOUND_BLOCK_ROWS), bounds.data() + begin);
+    });
+
+    std::vector<std::pair<float, std::size_t>> candidates;
+    candidates.reserve(rows);
+    for (std::size_t row = 0; row < rows && topK > 0; ++row) {
+        if (!std::isnan(bounds[row])) candidates.emplace_back(bounds[row], row);
+    }
+
+    // Rows are scored best bound first; each batch is put in order only when the search gets to it
+    TopKHeap heap(topK, order);
+    auto before = [&heap](const std::pair<float, std::size_t>& a, const std::pair<float, std::size_t>& b) { return heap.better(a, b); };
+    std::size_t sorted = 0, fineScored = 0;
+    std::size_t batch = std::max(CASCADE_BATCH, 4 * topK);
+    bool shortlistReached = false;
+    for (std::size_t next = 0; next < candidates.size(); ++next) {
+        if (next == sorted) {
+            const std::size_t end = std::min(candidates.size(), sorted + batch);
+            std::partial_sort(candidates.begin() + sorted, candidates.begin() + end, candidates.end(), before);
+            sorted = end;
+            batch *= 2;
+        }
+
+        const std::pair<float, std::size_t>& candidate = candidates[next];
+        if (heap.full() && outOfReach(candidate.first, heap.worst().first, order)) break;
+        if (shortlist > 0 && fineScored == shortlist) {
+            shortlistReached = true;
+            break;
+        }
+        heap.offer(score(candidate.second, heap.threshold()), candidate.second);
+        ++fineScored;
+    }
+
+    if (stats) {
+        stats->rows = candidates.size();
+        stats->fineScored = fineScored;
+        stats->shortlistReached = shortlistReached;
+    }
+    std::vector<std::pair<float, std::size_t>> matches = heap.rows();
+    heap.sortAndTrim(matches);
+    return matches;
+}
+
+void printHistogramCascadeStats(const HistogramCascadeStats& stats) {
+    std::cout << "Cascade search: " << stats.rows << " rows bounded at " << stats.coarseBins << "x" << stats.coarseBins << "x"
+        << stats.coarseBins << " bins, " << stats.fineScored << " scored at full resolution"
+        << (stats.shortlistReached ? " (shortlist reached, results may differ from a full scan)" : "") << std::endl;
+}
@@ -0,0 +1,183 @@
+/*! \file histogram_pyramid.h
+    \brief Declarations for coarse color histogram levels and the coarse-to-fine cascade search.
+    \author Manushi
+    \date October 16, 2026
+
+    A color histogram of B x B x B bins sums down exactly to one of b x b x b bins whenever b
+    divides B, and each coarse bin holds the mass of (B / b)^3 fine bins. Coarse histograms bound
+    the fine comparisons: the intersection of two coarse histograms is at least the intersection
+    of the fine ones, and the squared Euclidean distance of two fine histograms is at least the
+    squared distance of the coarse ones divided by the number of fine bins per coarse bin.
+
+    A histogram pyramid holds the 4 x 4 x 4 and 2 x 2 x 2 levels of every row of a feature file
+    whose rows start with a fine color histogram, together with the values that follow the color
+    part (e.g. the texture histogram), which are compared exactly. It is derived from the stored
+    rows, so building it decodes no images; it is saved next to the feature file as
+    "<featureFile>.pyramid", memory-mapped when opened, and rebuilt when the feature file changes.
+
+    A cascade search bounds every row from a coarse level, then scores rows at full resolution in
+    order of their bound and stops as soon as no remaining bound can beat the current K-th best,
+    which gives the same results as a full scan. A shortlist size caps the rows scored at full
+    resolution for a faster, approximate search.
+*/
+
+#ifndef HISTOGRAM_PYRAMID_H
+#define HISTOGRAM_PYRAMID_H
+
+#include "mapped_file.h"
+#include "parallel_scan.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Options for searches that can use a histogram pyramid.
+ */
+struct HistogramCascadeOptions {
+    bool useCascade = false;                 // Bound every row from a coarse level before scoring at full resolution
+    std::uint32_t coarseBinsPerChannel = 0;  // Coarse level to bound with, 2 or 4; 0 picks the finest stored level
+    std::size_t shortlist = 0;               // Most rows scored at full resolution (0 scores as many as exact results need)
+};
+
+/**
+ * @brief Work done by one cascade search.
+ */
+struct HistogramCascadeStats {
+    std::size_t rows = 0;              // Rows bounded at the coarse level
+    std::size_t fineScored = 0;        // Rows scored at full resolution
+    std::uint32_t coarseBins = 0;      // Bins per channel of the coarse level
+    bool shortlistReached = false;     // True if the shortlist cut the search short, so results may differ from a full scan
+};
+
+/**
+ * @brief Coarse levels, in bins per channel, that a pyramid holds for a fine histogram (4 and 2 where they divide it).
+ */
+std::vector<std::uint32_t> coarseHistogramLevels(std::uint32_t binsPerChannel);
+
+/**
+ * @brief Sums a fine color histogram down to a coarse one.
+ *
+ * @param fine binsPerChannel^3 values, red major as written by compute3DColorHistogramManual.
+ * @param binsPerChannel Bins per channel of the fine histogram.
+ * @param coarseBinsPerChannel Bins per channel of the coarse histogram; must divide binsPerChannel.
+ * @param coarse Receives coarseBinsPerChannel^3 values.
+ */
+void coarsenHistogram(const float* fine, std::uint32_t binsPerChannel, std::uint32_t coarseBinsPerChannel, float* coarse);
+
+/**
+ * @brief Coarse levels of every row of a feature file, memory-mapped read-only.
+ */
+class HistogramPyramid {
+public:
+    /**
+     * @brief Maps a pyramid file and validates its header.
+     *
+     * @param pyramidFilePath Path to the ".pyramid" file.
+     * @throws std::runtime_error If the file cannot be mapped or is not a valid pyramid.
+     */
+    explicit HistogramPyramid(const std::string& pyramidFilePath);
+
+    std::size_t size() const { return rowCount; }
+    std::uint32_t binsPerChannel() const { return fineBinsPerChannel; }
+
+    /**
+     * @brief Number of values stored after the color part of every row.
+     */
+    std::size_t tailDims() const { return tailCount; }
+
+    /**
+     * @brief Values of a coarse level, coarseBinsPerChannel^3 per row, or nullptr if the level is not stored.
+     */
+    const float* level(std::uint32_t coarseBinsPerChannel) const;
+
+    /**
+     * @brief Picks the level to bound with: the requested one, or the finest stored level if 0 is requested.
+     *
+     * @return Bins per channel of the level, or 0 if no such level is stored.
+     */
+    std::uint32_t pickLevel(std::uint32_t coarseBinsPerChannel) const;
+
+    /**
+     * @brief Values stored after the color part, tailDims() per row.
+     */
+    const float* tail() const { return tailValues; }
+
+    /**
+     * @brief Checks whether the pyramid was built from the current contents of a feature file.
+     */
+    bool isBuiltFrom(const std::string& featureFilePath) const;
+
+private:
+    MappedFile mapping;
+    std::size_t rowCount = 0;
+    std::uint32_t fineBinsPerChannel = 0;
+    std::size_t tailCount = 0;
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    std::vector<std::pair<std::uint32_t, const float*>> levels;
+    const float* tailValues = nullptr;
+};
+
+/**
+ * @brief Shared, read-only handle to a cached histogram pyramid.
+ */
+using HistogramPyramidHandle = std::shared_ptr<const HistogramPyramid>;
+
+/**
+ * @brief Returns the path of the pyramid file that belongs to a feature file.
+ */
+std::string histogramPyramidPath(const std::string& featureFilePath);
+
+/**
+ * @brief Sums the color histograms of a feature file down to every coarse level and saves them.
+ *
+ * @param featureFilePath CSV or feature store file whose rows start with binsPerChannel^3 color bins.
+ * @param binsPerChannel Bins per channel of the stored color histograms.
+ * @param pyramidFilePath Path of the pyramid file to write.
+ * @throws std::runtime_error If the feature file cannot be read, its rows are too short, or the pyramid cannot be written.
+ */
+void buildHistogramPyramid(const std::string& featureFilePath, std::uint32_t binsPerChannel, const std::string& pyramidFilePath);
+
+/**
+ * @brief Returns the cached pyramid of a feature file, building or rebuilding it if needed.
+ *
+ * @param featureFilePath CSV or feature store file.
+ * @param binsPerChannel Bins per channel of the stored color histograms.
+ * @return Handle to the pyramid.
+ * @throws std::runtime_error If the pyramid can neither be opened nor built.
+ */
+HistogramPyramidHandle openHistogramPyramid(const std::string& featureFilePath, std::uint32_t binsPerChannel);
+
+/**
+ * @brief Bounds rows [begin, end) of a collection, writing the bound of row begin + i to bounds[i].
+ *
+ * Bounds are upper bounds of the score for ScanOrder::Descending and lower bounds for
+ * ScanOrder::Ascending. Rows bounded SKIPPED_ROW are left out. Called concurrently for disjoint ranges.
+ */
+using RowBlockBounder = std::function<void(std::size_t begin, std::size_t end, float* bounds)>;
+
+/**
+ * @brief Bounds every row, then scores rows one by one in order of their bound until no remaining bound can beat the K-th best.
+ *
+ * @param rows Number of rows in the collection.
+ * @param topK Maximum number of results.
+ * @param order Whether small or large scores are best.
+ * @param shortlist Most rows to score (0 for no limit).
+ * @param bound Bounds a block of rows on the scan thread pool.
+ * @param score Scores one row exactly, given the current K-th best score; it may give up and return any worse score once the row cannot beat it.
+ * @param stats Receives the work done, if not null.
+ * @return Up to topK (score, row) pairs, best first; ties go to the lower row.
+ */
+std::vector<std::pair<float, std::size_t>> cascadeTopK(std::size_t rows, std::size_t topK, ScanOrder order, std::size_t shortlist,
+    const RowBlockBounder& bound, const std::function<float(std::size_t row, float threshold)>& score, HistogramCascadeStats* stats = nullptr);
+
+/**
+ * @brief Prints how many rows a cascade search scored at each resolution.
+ */
+void printHistogramCascadeStats(const HistogramCascadeStats& stats);
+
+#endif // HISTOGRAM_PYRAMID_H
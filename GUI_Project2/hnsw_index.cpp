@@ -0,0 +1,698 @@
+/*! \file hnsw_index.cpp
+    \brief Implements the HNSW approximate nearest-neighbor index over DNN embeddings.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Construction follows Malkov
+    and Yashunin: every node gets a random top layer, is connected greedily from the top down, and
+    neighbor lists are pruned with the diversity heuristic. Threads insert nodes concurrently;
+    every neighbor list is guarded by one of a fixed set of striped mutexes and is copied out under
+    its lock before it is read.
+
+    File layout (all integers little endian, every section starts on a 64-byte boundary):
+      - HnswHeader
+      - rowCount x rowStride floats: unit-length vectors
+      - rowCount x (1 + 2M) uint32: layer-0 link count and links of every node
+      - rowCount x uint32: top layer of every node
+      - rowCount x uint64: offset of every node's upper-layer links in the upper link array
+      - upper link array: per node and layer above 0, (1 + M) uint32 link count and links
+      - rowCount x uint32: rows sorted by image path
+      - (rowCount + 1) x uint64 offsets into the path bytes, followed by the path bytes
+*/
+
+#include "hnsw_index.h"
+#include "distance_kernels.h"
+#include "feature_matrix.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char HNSW_MAGIC[8] = { 'C', 'B', 'I', 'R', 'H', 'N', 'S', 'W' };
+constexpr std::uint32_t HNSW_VERSION = 1;
+constexpr std::uint64_t HNSW_ALIGNMENT = 64;
+constexpr std::uint32_t HNSW_MAX_LEVEL = 16;
+constexpr std::size_t LOCK_STRIPES = 4096;
+constexpr std::size_t INSERT_BLOCK_ROWS = 64;
+
+#pragma pack(push, 1)
+/**
+ * @brief Fixed-size header at the start of an index file.
+ */
+struct HnswHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dims;
+    std::uint32_t rowStride;
+    std::uint32_t M;
+    std::uint32_t efConstruction;
+    std::uint32_t maxLevel;
+    std::uint32_t entryPoint;
+    std::uint32_t reserved;
+    std::uint64_t rowCount;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModified;
+    std::uint64_t vectorsOffset;
+    std::uint64_t level0Offset;
+    std::uint64_t levelsOffset;
+    std::uint64_t upperOffsetsOffset;
+    std::uint64_t upperLinksOffset;
+    std::uint64_t upperLinkCount;
+    std::uint64_t nameOrderOffset;
+    std::uint64_t stringTableOffset;
+    std::uint64_t stringTableSize;
+    std::uint64_t fileSize;
+};
+#pragma pack(pop)
+
+using Candidate = std::pair<float, std::uint32_t>;
+
+std::uint64_t alignOffset(std::uint64_t offset) {
+    return (offset + HNSW_ALIGNMENT - 1) / HNSW_ALIGNMENT * HNSW_ALIGNMENT;
+}
+
+/**
+ * @brief Size and modification time of a file, as recorded in the index header.
+ */
+void sourceFileState(const std::string& filePath, std::uint64_t& size, std::int64_t& modified) {
+    size = static_cast<std::uint64_t>(fs::file_size(filePath));
+    modified = static_cast<std::int64_t>(fs::last_write_time(filePath).time_since_epoch().count());
+}
+
+/**
+ * @brief Draws the top layer of a node from a hash of its row id (SplitMix64).
+ */
+std::uint32_t nodeLevel(std::uint32_t row, double levelScale) {
+    std::uint64_t z = row + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    const double uniform = (static_cast<double>(z >> 11) + 1.0) / 9007199254740993.0; // (0, 1]
+    return std::min(HNSW_MAX_LEVEL, static_cast<std::uint32_t>(-std::log(uniform) * levelScale));
+}
+
+/**
+ * @brief Per-thread visited marks; a new search bumps the epoch instead of clearing the marks.
+ */
+class VisitedSet {
+public:
+    void reset(std::size_t size) {
+        if (marks.size() < size) marks.assign(size, 0);
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    bool insert(std::uint32_t node) {
+        if (marks[node] == epoch) return false;
+        marks[node] = epoch;
+        return true;
+    }
+
+private:
+    std::vector<std::uint32_t> marks;
+    std::uint32_t epoch = 0;
+};
+
+thread_local VisitedSet visitedNodes;
+
+/**
+ * @brief Walks one layer greedily to the node closest to the query.
+ *
+ * @param links Copies the links of (node, layer) into its output vector.
+ */
+template <class Distance, class Links>
+std::uint32_t greedyClosest(std::uint32_t start, std::uint32_t layer, const Distance& distance, const Links& links) {
+    std::uint32_t current = start;
+    float currentDistance = distance(current);
+    std::vector<std::uint32_t> neighbors;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        links(current, layer, neighbors);
+        for (std::uint32_t neighbor : neighbors) {
+            const float d = distance(neighbor);
+            if (d < currentDistance) {
+                currentDistance = d;
+                current = neighbor;
+                changed = true;
+            }
+        }
+    }
+    return current;
+}
+
+/**
+ * @brief Best-first search of one layer with a candidate list of ef nodes.
+ *
+ * @return Up to ef (distance, node) pairs, closest first.
+ */
+template <class Distance, class Links>
+std::vector<Candidate> searchLayer(std::uint32_t entry, std::size_t ef, std::uint32_t layer, std::size_t nodeCount,
+    const Distance& distance, const Links& links) {
+    visitedNodes.reset(nodeCount);
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::priority_queue<Candidate> results;
+
+    const Candidate start(distance(entry), entry);
+    visitedNodes.insert(entry);
+    candidates.push(start);
+    results.push(start);
+
+    std::vector<std::uint32_t> neighbors;
+    while (!candidates.empty()) {
+        const Candidate closest = candidates.top();
+        if (closest.first > results.top().first && results.size() >= ef) break;
+        candidates.pop();
+
+        links(closest.second, layer, neighbors);
+        for (std::uint32_t neighbor : neighbors) {
+            if (!visitedNodes.insert(neighbor)) continue;
+            const Candidate next(distance(neighbor), neighbor);
+            if (results.size() < ef || next < results.top()) {
+                candidates.push(next);
+                results.push(next);
+                if (results.size() > ef) results.pop();
+            }
+        }
+    }
+
+    std::vector<Candidate> ordered(results.size());
+    for (std::size_t i = ordered.size(); i-- > 0;) {
+        ordered[i] = results.top();
+        results.pop();
+    }
+    return ordered;
+}
+
+/**
+ * @brief Keeps up to maxCount candidates that are closer to the query than to any kept candidate.
+ *
+ * @param candidates Candidates sorted closest first.
+ * @param nodeDistance Distance between two nodes.
+ */
+template <class NodeDistance>
+std::vector<Candidate> selectNeighbors(const std::vector<Candidate>& candidates, std::size_t maxCount, const NodeDistance& nodeDistance) {
+    std::vector<Candidate> selected;
+    for (const Candidate& candidate : candidates) {
+        if (selected.size() >= maxCount) break;
+        bool diverse = true;
+        for (const Candidate& kept : selected) {
+            if (nodeDistance(candidate.second, kept.second) < candidate.first) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) selected.push_back(candidate);
+    }
+    return selected;
+}
+
+/**
+ * @brief Graph under construction, with unit-length vectors held in a feature matrix.
+ */
+class HnswBuilder {
+public:
+    HnswBuilder(const FeatureMatrix& vectors, const HnswParameters& parameters)
+        : vectors(vectors), M(std::max<std::uint32_t>(2, parameters.M)), maxM0(2 * M),
+        efConstruction(std::max(parameters.efConstruction, M)), levels(vectors.rows()),
+        level0(vectors.rows() * (1 + static_cast<std::size_t>(maxM0)), 0), upper(vectors.rows()), locks(LOCK_STRIPES) {
+        const double levelScale = 1.0 / std::log(static_cast<double>(M));
+        for (std::size_t row = 0; row < vectors.rows(); ++row) {
+            levels[row] = nodeLevel(static_cast<std::uint32_t>(row), levelScale);
+            upper[row].assign(levels[row] * (1 + static_cast<std::size_t>(M)), 0);
+        }
+    }
+
+    void insert(std::uint32_t node) {
+        const std::uint32_t level = levels[node];
+
+        // A node that raises the top layer keeps the entry lock until it is linked in
+        std::unique_lock<std::mutex> entryLock(entryMutex);
+        const int currentMax = topLevel;
+        const std::uint32_t entry = entryPoint;
+        if (currentMax < 0) {
+            entryPoint = node;
+            topLevel = static_cast<int>(level);
+            return;
+        }
+        if (static_cast<int>(level) <= currentMax) entryLock.unlock();
+
+        auto distance = [&](std::uint32_t other) { return nodeDistance(node, other); };
+        auto links = [this](std::uint32_t n, std::uint32_t layer, std::vector<std::uint32_t>& out) { copyLinks(n, layer, out); };
+        auto pairDistance = [this](std::uint32_t a, std::uint32_t b) { return nodeDistance(a, b); };
+
+        std::uint32_t current = entry;
+        for (int layer = currentMax; layer > static_cast<int>(level); --layer) {
+            current = greedyClosest(current, static_cast<std::uint32_t>(layer), distance, links);
+        }
+
+        for (int layer = std::min(static_cast<int>(level), currentMax); layer >= 0; --layer) {
+            const std::uint32_t l = static_cast<std::uint32_t>(layer);
+            std::vector<Candidate> candidates = searchLayer(current, efConstruction, l, vectors.rows(), distance, links);
+            std::vector<Candidate> neighbors = selectNeighbors(candidates, M, pairDistance);
+            {
+                std::lock_guard<std::mutex> lock(lockFor(node));
+                std::uint32_t* list = linkList(node, l);
+                list[0] = static_cast<std::uint32_t>(neighbors.size());
+                for (std::size_t i = 0; i < neighbors.size(); ++i) list[1 + i] = neighbors[i].second;
+            }
+            for (const Candidate& neighbor : neighbors) {
+                connect(neighbor.second, node, neighbor.first, l);
+            }
+            current = candidates.front().second;
+        }
+
+        if (static_cast<int>(level) > currentMax) {
+            entryPoint = node;
+            topLevel = static_cast<int>(level);
+        }
+    }
+
+    /**
+     * @brief Writes the finished graph, the vectors and the paths to an index file.
+     */
+    void write(const std::string& filePath, const HnswParameters& parameters, std::uint64_t sourceSize, std::int64_t sourceModified) const {
+        const std::size_t rows = vectors.rows();
+        std::vector<std::uint64_t> upperOffsets(rows);
+        std::uint64_t upperLinkCount = 0;
+        for (std::size_t row = 0; row < rows; ++row) {
+            upperOffsets[row] = upperLinkCount;
+            upperLinkCount += upper[row].size();
+        }
+
+        std::vector<std::uint32_t> nameOrder(rows);
+        for (std::size_t row = 0; row < rows; ++row) nameOrder[row] = static_cast<std::uint32_t>(row);
+        std::sort(nameOrder.begin(), nameOrder.end(), [this](std::uint32_t a, std::uint32_t b) {
+            return vectors.path(a) != vectors.path(b) ? vectors.path(a) < vectors.path(b) : a < b;
+        });
+        std::uint64_t pathBytes = 0;
+        for (const std::string& imagePath : vectors.paths()) pathBytes += imagePath.size();
+
+        HnswHeader header = {};
+        std::memcpy(header.magic, HNSW_MAGIC, sizeof(header.magic));
+        header.version = HNSW_VERSION;
+        header.dims = static_cast<std::uint32_t>(vectors.dims());
+        header.rowStride = static_cast<std::uint32_t>(vectors.stride());
+        header.M = M;
+        header.efConstruction = parameters.efConstruction;
+        header.maxLevel = static_cast<std::uint32_t>(topLevel);
+        header.entryPoint = entryPoint;
+        header.rowCount = rows;
+        header.sourceSize = sourceSize;
+        header.sourceModified = sourceModified;
+        header.vectorsOffset = alignOffset(sizeof(HnswHeader));
+        header.level0Offset = alignOffset(header.vectorsOffset + vectors.memoryBytes());
+        header.levelsOffset = alignOffset(header.level0Offset + level0.size() * sizeof(std::uint32_t));
+        header.upperOffsetsOffset = alignOffset(header.levelsOffset + rows * sizeof(std::uint32_t));
+        header.upperLinksOffset = alignOffset(header.upperOffsetsOffset + rows * sizeof(std::uint64_t));
+        header.upperLinkCount = upperLinkCount;
+        header.nameOrderOffset = alignOffset(header.upperLinksOffset + upperLinkCount * sizeof(std::uint32_t));
+        header.stringTableOffset = alignOffset(header.nameOrderOffset + rows * sizeof(std::uint32_t));
+        header.stringTableSize = (rows + 1) * sizeof(std::uint64_t) + pathBytes;
+        header.fileSize = header.stringTableOffset + header.stringTableSize;
+
+        std::ofstream out(filePath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to open HNSW index for writing: " + filePath);
+        }
+        std::uint64_t written = 0;
+        auto put = [&](const void* data, std::uint64_t bytes) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            written += bytes;
+        };
+        auto padTo = [&](std::uint64_t offset) {
+            static const char zeros[HNSW_ALIGNMENT] = {};
+            put(zeros, offset - written);
+        };
+
+        put(&header, sizeof(header));
+        padTo(header.vectorsOffset);
+        if (rows > 0) put(vectors.row(0), vectors.memoryBytes());
+        padTo(header.level0Offset);
+        put(level0.data(), level0.size() * sizeof(std::uint32_t));
+        padTo(header.levelsOffset);
+        put(levels.data(), rows * sizeof(std::uint32_t));
+        padTo(header.upperOffsetsOffset);
+        put(upperOffsets.data(), rows * sizeof(std::uint64_t));
+        padTo(header.upperLinksOffset);
+        for (const std::vector<std::uint32_t>& links : upper) put(links.data(), links.size() * sizeof(std::uint32_t));
+        padTo(header.nameOrderOffset);
+        put(nameOrder.data(), rows * sizeof(std::uint32_t));
+        padTo(header.stringTableOffset);
+        std::uint64_t offset = 0;
+        for (const std::string& imagePath : vectors.paths()) {
+            put(&offset, sizeof(offset));
+            offset += imagePath.size();
+        }
+        put(&offset, sizeof(offset));
+        for (const std::string& imagePath : vectors.paths()) put(imagePath.data(), imagePath.size());
+
+        if (!out.good()) {
+            throw std::runtime_error("Error writing HNSW index: " + filePath);
+        }
+    }
+
+private:
+    float nodeDistance(std::uint32_t a, std::uint32_t b) const {
+        return 1.0f - dotProduct(vectors.row(a), vectors.row(b), vectors.dims());
+    }
+
+    std::mutex& lockFor(std::uint32_t node) { return locks[node % LOCK_STRIPES]; }
+
+    std::uint32_t* linkList(std::uint32_t node, std::uint32_t layer) {
+        if (layer == 0) return level0.data() + static_cast<std::size_t>(node) * (1 + maxM0);
+        return upper[node].data() + static_cast<std::size_t>(layer - 1) * (1 + M);
+    }
+
+    void copyLinks(std::uint32_t node, std::uint32_t layer, std::vector<std::uint32_t>& out) {
+        std::lock_guard<std::mutex> lock(lockFor(node));
+        const std::uint32_t* list = linkList(node, layer);
+        out.assign(list + 1, list + 1 + list[0]);
+    }
+
+    /**
+     * @brief Adds a back link from a neighbor to a new node, pruning the neighbor's list if it is full.
+     */
+    void connect(std::uint32_t neighbor, std::uint32_t node, float distance, std::uint32_t layer) {
+        const std::size_t maxCount = layer == 0 ? maxM0 : M;
+        std::lock_guard<std::mutex> lock(lockFor(neighbor));
+        std::uint32_t* list = linkList(neighbor, layer);
+        if (list[0] < maxCount) {
+            list[1 + list[0]] = node;
+            ++list[0];
+            return;
+        }
+
+        std::vector<Candidate> candidates;
+        candidates.emplace_back(distance, node);
+        for (std::uint32_t i = 0; i < list[0]; ++i) {
+            candidates.emplace_back(nodeDistance(neighbor, list[1 + i]), list[1 + i]);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        std::vector<Candidate> kept = selectNeighbors(candidates, maxCount,
+            [this](std::uint32_t a, std::uint32_t b) { return nodeDistance(a, b); });
+        list[0] = static_cast<std::uint32_t>(kept.size());
+        for (std::size_t i = 0; i < kept.size(); ++i) list[1 + i] = kept[i].second;
+    }
+
+    const FeatureMatrix& vectors;
+    const std::uint32_t M;
+    const std::uint32_t maxM0;
+    const std::uint32_t efConstruction;
+    std::vector<std::uint32_t> levels;
+    std::vector<std::uint32_t> level0;
+    std::vector<std::vector<std::uint32_t>> upper;
+    std::vector<std::mutex> locks;
+    std::mutex entryMutex;
+    std::uint32_t entryPoint = 0;
+    int topLevel = -1;
+};
+
+/**
+ * @brief Cache entry: a loaded index and the file state it was loaded from.
+ */
+struct CachedIndex {
+    std::uintmax_t fileSize = 0;
+    fs::file_time_type modifiedTime;
+    HnswIndexHandle index;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedIndex> cachedIndexes;
+
+} // namespace
+
+HnswIndex::HnswIndex(const std::string& indexFilePath) : mapping(indexFilePath) {
+    const unsigned char* data = mapping.data();
+    HnswHeader header;
+    if (mapping.size() < sizeof(header)) {
+        throw std::runtime_error("HNSW index is truncated: " + indexFilePath);
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    // Counts are bounded by the file size first, so the offset arithmetic below cannot overflow
+    const std::uint64_t rows = header.rowCount;
+    const std::uint64_t fileSize = mapping.size();
+    const bool valid = std::memcmp(header.magic, HNSW_MAGIC, sizeof(header.magic)) == 0
+        && header.version == HNSW_VERSION
+        && header.fileSize == fileSize
+        && header.rowStride >= header.dims && header.rowStride <= fileSize / sizeof(float)
+        && header.M >= 2 && header.M <= fileSize / sizeof(std::uint32_t)
+        && rows <= fileSize / sizeof(std::uint32_t)
+        && header.upperLinkCount <= fileSize / sizeof(std::uint32_t)
+        && header.stringTableSize <= fileSize
+        && header.stringTableSize >= (rows + 1) * sizeof(std::uint64_t)
+        && rows > 0 && rows <= UINT32_MAX && header.entryPoint < rows && header.maxLevel <= HNSW_MAX_LEVEL
+        && header.vectorsOffset % HNSW_ALIGNMENT == 0
+        && header.level0Offset >= header.vectorsOffset + rows * header.rowStride * sizeof(float)
+        && header.levelsOffset >= header.level0Offset + rows * (1 + 2 * static_cast<std::uint64_t>(header.M)) * sizeof(std::uint32_t)
+        && header.upperOffsetsOffset >= header.levelsOffset + rows * sizeof(std::uint32_t)
+        && header.upperLinksOffset >= header.upperOffsetsOffset + rows * sizeof(std::uint64_t)
+        && header.nameOrderOffset >= header.upperLinksOffset + header.upperLinkCount * sizeof(std::uint32_t)
+        && header.stringTableOffset >= header.nameOrderOffset + rows * sizeof(std::uint32_t)
+        && header.stringTableOffset + header.stringTableSize <= mapping.size();
+    if (!valid) {
+        throw std::runtime_error("Not a valid HNSW index (or unsupported version): " + indexFilePath);
+    }
+
+    buildParameters.M = header.M;
+    buildParameters.efConstruction = header.efConstruction;
+    rowCount = static_cast<std::size_t>(rows);
+    rowDims = header.dims;
+    rowStride = header.rowStride;
+    maxLevel = header.maxLevel;
+    entryPoint = header.entryPoint;
+    sourceSize = header.sourceSize;
+    sourceModified = header.sourceModified;
+    vectors = reinterpret_cast<const float*>(data + header.vectorsOffset);
+    level0Links = reinterpret_cast<const std::uint32_t*>(data + header.level0Offset);
+    nodeLevels = reinterpret_cast<const std::uint32_t*>(data + header.levelsOffset);
+    upperLinkOffsets = reinterpret_cast<const std::uint64_t*>(data + header.upperOffsetsOffset);
+    upperLinks = reinterpret_cast<const std::uint32_t*>(data + header.upperLinksOffset);
+    nameOrder = reinterpret_cast<const std::uint32_t*>(data + header.nameOrderOffset);
+    pathOffsets = reinterpret_cast<const std::uint64_t*>(data + header.stringTableOffset);
+    pathBytes = reinterpret_cast<const char*>(pathOffsets + rowCount + 1);
+    validateGraph(header.upperLinkCount, header.stringTableSize - (rows + 1) * sizeof(std::uint64_t), indexFilePath);
+}
+
+void HnswIndex::validateGraph(std::uint64_t upperLinkCount, std::uint64_t pathBytesSize, const std::string& indexFilePath) const {
+    // Searches follow links without checking them, so every count, link and offset is checked once here
+    auto corrupt = [&]() { return std::runtime_error("HNSW index is corrupt: " + indexFilePath); };
+    const std::uint32_t M = buildParameters.M;
+    if (nodeLevels[entryPoint] != maxLevel) throw corrupt();
+    for (std::size_t node = 0; node < rowCount; ++node) {
+        const std::uint32_t* list = level0Links + node * (1 + 2 * static_cast<std::size_t>(M));
+        if (list[0] > 2 * M) throw corrupt();
+        for (std::uint32_t i = 1; i <= list[0]; ++i) {
+            if (list[i] >= rowCount) throw corrupt();
+        }
+
+        const std::uint32_t level = nodeLevels[node];
+        if (level > maxLevel) throw corrupt();
+        if (level == 0) continue;
+        if (upperLinkOffsets[node] > upperLinkCount || level * (1 + static_cast<std::uint64_t>(M)) > upperLinkCount - upperLinkOffsets[node]) {
+            throw corrupt();
+        }
+        for (std::uint32_t layer = 1; layer <= level; ++layer) {
+            const std::uint32_t* upper = upperLinks + upperLinkOffsets[node] + static_cast<std::size_t>(layer - 1) * (1 + M);
+            if (upper[0] > M) throw corrupt();
+            for (std::uint32_t i = 1; i <= upper[0]; ++i) {
+                // A link on a layer must lead to a node that has that layer
+                if (upper[i] >= rowCount || nodeLevels[upper[i]] < layer) throw corrupt();
+            }
+        }
+    }
+
+    if (pathOffsets[0] != 0 || pathOffsets[rowCount] > pathBytesSize) throw corrupt();
+    for (std::size_t row = 0; row < rowCount; ++row) {
+        if (pathOffsets[row + 1] < pathOffsets[row] || nameOrder[row] >= rowCount) throw corrupt();
+    }
+}
+
+std::string HnswIndex::path(std::size_t row) const {
+    return std::string(pathBytes + pathOffsets[row], static_cast<std::size_t>(pathOffsets[row + 1] - pathOffsets[row]));
+}
+
+bool HnswIndex::findRow(const std::string& imagePath, std::size_t& row) const {
+    const std::uint32_t* end = nameOrder + rowCount;
+    const std::uint32_t* found = std::lower_bound(nameOrder, end, imagePath,
+        [this](std::uint32_t candidate, const std::string& value) { return path(candidate) < value; });
+    if (found == end || path(*found) != imagePath) return false;
+    row = *found;
+    return true;
+}
+
+std::vector<std::pair<float, std::size_t>> HnswIndex::search(const float* query, std::size_t topK, std::size_t efSearch) const {
+    if (topK == 0) return {};
+
+    const float length = std::sqrt(dotProduct(query, query, rowDims));
+    std::vector<float> unit(query, query + rowDims);
+    if (length > 0.0f) {
+        for (float& value : unit) value /= length;
+    }
+
+    const std::uint32_t M = buildParameters.M;
+    auto distance = [&](std::uint32_t node) { return 1.0f - dotProduct(unit.data(), vector(node), rowDims); };
+    auto links = [&](std::uint32_t node, std::uint32_t layer, std::vector<std::uint32_t>& out) {
+        const std::uint32_t* list = layer == 0
+            ? level0Links + static_cast<std::size_t>(node) * (1 + 2 * M)
+            : upperLinks + upperLinkOffsets[node] + static_cast<std::size_t>(layer - 1) * (1 + M);
+        out.assign(list + 1, list + 1 + list[0]);
+    };
+
+    std::uint32_t current = entryPoint;
+    for (std::uint32_t layer = maxLevel; layer > 0; --layer) {
+        current = greedyClosest(current, layer, distance, links);
+    }
+    std::vector<Candidate> found = searchLayer(current, std::max(efSearch, topK), 0, rowCount, distance, links);
+
+    std::vector<std::pair<float, std::size_t>> results;
+    for (std::size_t i = 0; i < found.size() && i < topK; ++i) {
+        results.emplace_back(found[i].first, found[i].second);
+    }
+    return results;
+}
+
+bool HnswIndex::isBuiltFrom(const std::string& embeddingFilePath) const {
+    std::uint64_t size = 0;
+    std::int64_t modified = 0;
+    try {
+        sourceFileState(embeddingFilePath, size, modified);
+    }
+    catch (const fs::filesystem_error&) {
+        return false;
+    }
+    return size == sourceSize && modified == sourceModified;
+}
+
+std::string hnswIndexPath(const std::string& embeddingFilePath) {
+    return embeddingFilePath + ".hnsw";
+}
+
+void buildHnswIndex(const std::string& embeddingFilePath, const std::string& indexFilePath, const HnswParameters& parameters) {
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    sourceFileState(embeddingFilePath, sourceSize, sourceModified);
+
+    const FeatureMatrix source = readFeatureMatrix(embeddingFilePath);
+    if (source.empty() || source.rows() > UINT32_MAX) {
+        throw std::runtime_error("No embeddings to index in " + embeddingFilePath);
+    }
+
+    // Unit-length vectors turn cosine distance into 1 - dot product; zero vectors stay zero.
+    // The index stores its own copy of the vectors, so they are normalized into a new matrix.
+    FeatureMatrix embeddings(source.rows(), source.dims());
+    for (std::size_t row = 0; row < embeddings.rows(); ++row) {
+        const float* values = source.row(row);
+        float* unit = embeddings.mutableRow(row);
+        const float length = std::sqrt(dotProduct(values, values, embeddings.dims()));
+        const float scale = (length > 0.0f) ? 1.0f / length : 0.0f;
+        for (std::size_t i = 0; i < embeddings.dims(); ++i) unit[i] = values[i] * scale;
+        embeddings.path(row) = source.path(row);
+    }
+
+    HnswBuilder builder(embeddings, parameters);
+    builder.insert(0);
+    const std::size_t blocks = (embeddings.rows() - 1 + INSERT_BLOCK_ROWS - 1) / INSERT_BLOCK_ROWS;
+    parallelFor(blocks, [&](std::size_t block) {
+        const std::size_t end = std::min(embeddings.rows(), 1 + (block + 1) * INSERT_BLOCK_ROWS);
+        for (std::size_t row = 1 + block * INSERT_BLOCK_ROWS; row < end; ++row) {
+            builder.insert(static_cast<std::uint32_t>(row));
+        }
+    });
+
+    // Written under a temporary name so an interrupted build never leaves a half-written index
+    const std::string partialPath = indexFilePath + ".partial";
+    builder.write(partialPath, parameters, sourceSize, sourceModified);
+    std::error_code error;
+    fs::rename(partialPath, indexFilePath, error);
+    if (error) {
+        fs::remove(partialPath, error);
+        throw std::runtime_error("Unable to replace HNSW index: " + indexFilePath);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Built HNSW index of " << embeddings.rows() << " embeddings (M " << parameters.M << ", efConstruction "
+        << parameters.efConstruction << ") in " << seconds << " s: " << indexFilePath << std::endl;
+}
+
+namespace {
+
+/**
+ * @brief True if an index can serve a request: built from the current embedding file and, if
+ * parameters are required, with those parameters (a zero field accepts any value).
+ */
+bool isUsable(const HnswIndex& index, const std::string& embeddingFilePath, const HnswParameters* required) {
+    return index.isBuiltFrom(embeddingFilePath)
+        && (!required || ((required->M == 0 || index.parameters().M == required->M)
+            && (required->efConstruction == 0 || index.parameters().efConstruction == required->efConstruction)));
+}
+
+/**
+ * @brief Shared by both openHnswIndex overloads; required is null if any parameters will do.
+ */
+HnswIndexHandle openIndex(const std::string& embeddingFilePath, const HnswParameters* required) {
+    const std::string indexFilePath = hnswIndexPath(embeddingFilePath);
+    HnswParameters parameters;
+    if (required && required->M > 0) parameters.M = required->M;
+    if (required && required->efConstruction > 0) parameters.efConstruction = required->efConstruction;
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(indexFilePath, error);
+    const fs::file_time_type modifiedTime = fs::last_write_time(indexFilePath, error);
+    auto cached = cachedIndexes.find(indexFilePath);
+    if (!error && cached != cachedIndexes.end() && cached->second.fileSize == fileSize && cached->second.modifiedTime == modifiedTime
+        && isUsable(*cached->second.index, embeddingFilePath, required)) {
+        return cached->second.index;
+    }
+
+    // Drop the cached mapping first, so the file can be replaced if it has to be rebuilt
+    cachedIndexes.erase(indexFilePath);
+    HnswIndexHandle index;
+    if (!error) {
+        try {
+            auto loaded = std::make_shared<const HnswIndex>(indexFilePath);
+            if (isUsable(*loaded, embeddingFilePath, required)) index = loaded;
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Rebuilding HNSW index: " << e.what() << std::endl;
+        }
+    }
+    if (!index) {
+        buildHnswIndex(embeddingFilePath, indexFilePath, parameters);
+        index = std::make_shared<const HnswIndex>(indexFilePath);
+    }
+
+    CachedIndex entry;
+    entry.fileSize = fs::file_size(indexFilePath);
+    entry.modifiedTime = fs::last_write_time(indexFilePath);
+    entry.index = index;
+    cachedIndexes[indexFilePath] = entry;
+    return index;
+}
+
+} // namespace
+
+HnswIndexHandle openHnswIndex(const std::string& embeddingFilePath) {
+    return openIndex(embeddingFilePath, nullptr);
+}
+
+HnswIndexHandle openHnswIndex(const std::string& embeddingFilePath, const HnswParameters& parameters) {
+    return openIndex(embeddingFilePath, &parameters);
+}
@@ -0,0 +1,169 @@
+/*! \file hnsw_index.h
+    \brief Declarations for the HNSW approximate nearest-neighbor index over DNN embeddings.
+    \author Manushi
+    \date October 16, 2026
+
+    A Hierarchical Navigable Small World graph links every embedding to a few close neighbors
+    on layer 0 and to progressively fewer, farther ones on the sparse upper layers. A query
+    walks down from the top layer greedily and then explores layer 0 with a bounded candidate
+    list, touching a few thousand vectors instead of the whole collection.
+
+    The index is built from an embedding file (CSV or feature store) and saved next to it as
+    "<embeddingFile>.hnsw". The file holds the unit-length vectors, the links and the image
+    paths, and is memory-mapped when opened, so loading it costs no parsing. It records the size
+    and modification time of the embedding file it was built from and is rebuilt when they change.
+*/
+
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Parameters fixed when an HNSW index is built.
+ */
+struct HnswParameters {
+    std::uint32_t M = 16;               // Links per node on the upper layers; layer 0 keeps 2 * M
+    std::uint32_t efConstruction = 200; // Candidate list size while inserting; larger builds slower but links better
+};
+
+/**
+ * @brief Default candidate list size for searches; at least topK is always used.
+ */
+constexpr std::size_t HNSW_DEFAULT_EF_SEARCH = 64;
+
+/**
+ * @brief A saved HNSW index, memory-mapped read-only.
+ *
+ * Searches only read the mapping, so one index can be searched from several threads at once.
+ */
+class HnswIndex {
+public:
+    /**
+     * @brief Maps an index file and validates its header.
+     *
+     * @param indexFilePath Path to the ".hnsw" file.
+     * @throws std::runtime_error If the file cannot be mapped or is not a valid index.
+     */
+    explicit HnswIndex(const std::string& indexFilePath);
+
+    std::size_t size() const { return rowCount; }
+    std::size_t dims() const { return rowDims; }
+    const HnswParameters& parameters() const { return buildParameters; }
+
+    /**
+     * @brief Returns the unit-length embedding of a row.
+     */
+    const float* vector(std::size_t row) const { return vectors + row * rowStride; }
+
+    /**
+     * @brief Returns the image path stored for a row.
+     */
+    std::string path(std::size_t row) const;
+
+    /**
+     * @brief Finds the row of an image path with a binary search over the sorted paths.
+     *
+     * @param imagePath Path as stored in the embedding file.
+     * @param row Receives the row if found.
+     * @return True if the path is in the index.
+     */
+    bool findRow(const std::string& imagePath, std::size_t& row) const;
+
+    /**
+     * @brief Finds the approximate nearest neighbors of a query by cosine distance.
+     *
+     * @param query Query embedding of dims() floats; it does not need to be unit length.
+     * @param topK Number of neighbors to return.
+     * @param efSearch Candidate list size; larger values are slower but find more of the true neighbors.
+     * @return Up to topK (1 - cosine similarity, row) pairs, closest first.
+     */
+    std::vector<std::pair<float, std::size_t>> search(const float* query, std::size_t topK, std::size_t efSearch = HNSW_DEFAULT_EF_SEARCH) const;
+
+    /**
+     * @brief Checks whether the index was built from the current contents of an embedding file.
+     */
+    bool isBuiltFrom(const std::string& embeddingFilePath) const;
+
+private:
+    /**
+     * @brief Checks every link count, link, layer and path offset of the mapped file.
+     *
+     * @throws std::runtime_error If any of them points outside the file's tables.
+     */
+    void validateGraph(std::uint64_t upperLinkCount, std::uint64_t pathBytesSize, const std::string& indexFilePath) const;
+
+    MappedFile mapping;
+    HnswParameters buildParameters;
+    std::size_t rowCount = 0;
+    std::size_t rowDims = 0;
+    std::size_t rowStride = 0;
+    std::uint32_t maxLevel = 0;
+    std::uint32_t entryPoint = 0;
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    const float* vectors = nullptr;
+    const std::uint32_t* level0Links = nullptr;
+    const std::uint32_t* nodeLevels = nullptr;
+    const std::uint64_t* upperLinkOffsets = nullptr;
+    const std::uint32_t* upperLinks = nullptr;
+    const std::uint32_t* nameOrder = nullptr;
+    const std::uint64_t* pathOffsets = nullptr;
+    const char* pathBytes = nullptr;
+};
+
+/**
+ * @brief Shared, read-only handle to a cached HNSW index.
+ */
+using HnswIndexHandle = std::shared_ptr<const HnswIndex>;
+
+/**
+ * @brief Returns the path of the index file that belongs to an embedding file.
+ */
+std::string hnswIndexPath(const std::string& embeddingFilePath);
+
+/**
+ * @brief Builds an HNSW index from an embedding file and saves it.
+ *
+ * Vectors are inserted in parallel on the scan thread pool. Node layers are drawn from a hash
+ * of the row id, so they do not depend on the thread count; the links can differ slightly
+ * between runs with more than one thread.
+ *
+ * @param embeddingFilePath CSV or feature store file with one embedding per row.
+ * @param indexFilePath Path of the index file to write.
+ * @param parameters Link count and construction candidate list size.
+ * @throws std::runtime_error If the embedding file cannot be read or the index cannot be written.
+ */
+void buildHnswIndex(const std::string& embeddingFilePath, const std::string& indexFilePath, const HnswParameters& parameters = HnswParameters());
+
+/**
+ * @brief Returns the cached index of an embedding file, building or rebuilding it if needed.
+ *
+ * The index is rebuilt when the file is missing, invalid, or was built from a different
+ * version of the embedding file. An existing up-to-date index is used whatever parameters it
+ * was built with (for example by --build-hnsw); a missing one is built with the defaults.
+ *
+ * @param embeddingFilePath CSV or feature store file with one embedding per row.
+ * @return Handle to the index.
+ * @throws std::runtime_error If the index can neither be opened nor built.
+ */
+HnswIndexHandle openHnswIndex(const std::string& embeddingFilePath);
+
+/**
+ * @brief Like openHnswIndex(embeddingFilePath), but also rebuilds an index built with other parameters.
+ *
+ * @param embeddingFilePath CSV or feature store file with one embedding per row.
+ * @param parameters Link count and construction candidate list size the index must have; a zero
+ *                   field accepts any value and builds with the default.
+ * @return Handle to the index.
+ * @throws std::runtime_error If the index can neither be opened nor built.
+ */
+HnswIndexHandle openHnswIndex(const std::string& embeddingFilePath, const HnswParameters& parameters);
+
+#endif // HNSW_INDEX_H
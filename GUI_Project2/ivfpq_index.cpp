@@ -0,0 +1,719 @@
+/*! \file ivfpq_index.cpp
+    \brief Implements the IVF-PQ compressed index over DNN embeddings.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Vectors are normalized,
+    assigned to the closest coarse centroid, and the residual is product quantized with 256
+    codewords per subquantizer. Codes of every inverted list are stored interleaved in blocks of 16
+    rows (byte j of the 16 rows is contiguous), so the lookup-table kernels gather the table
+    entries of 8 or 16 rows with one AVX2 or AVX-512 instruction. Squared distances between unit
+    vectors are twice their cosine distance, so the estimated residual distance halved is the
+    reported score.
+
+    File layout (all integers little endian, every section starts on a 64-byte boundary):
+      - IvfPqHeader
+      - lists x paddedDims floats: coarse centroids
+      - subquantizers x 256 x subDims floats: codebooks
+      - (lists + 1) x uint64: first entry of every list in the list row array
+      - (lists + 1) x uint64: first code block of every list
+      - rowCount x uint32: row ids in list order
+      - code blocks: subquantizers x 16 bytes each
+      - rowCount x uint32: rows sorted by image path
+      - (rowCount + 1) x uint64 offsets into the path bytes, followed by the path bytes
+*/
+
+#include "ivfpq_index.h"
+#include "cpu_features.h"
+#include "distance_kernels.h"
+#include "feature_index.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#if CBIR_X86
+#include <immintrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char IVFPQ_MAGIC[8] = { 'C', 'B', 'I', 'R', 'I', 'V', 'P', 'Q' };
+constexpr std::uint32_t IVFPQ_VERSION = 1;
+constexpr std::uint64_t IVFPQ_ALIGNMENT = 64;
+constexpr std::size_t CODEWORDS = 256;
+constexpr std::size_t BLOCK_ROWS = 16;
+constexpr std::size_t WORK_BLOCK_ROWS = 1024;
+constexpr std::uint64_t TRAINING_SEED = 0x1F2E3D4C5B6A7988ull;
+
+#pragma pack(push, 1)
+/**
+ * @brief Fixed-size header at the start of an index file.
+ */
+struct IvfPqHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dims;
+    std::uint32_t paddedDims;
+    std::uint32_t lists;
+    std::uint32_t subquantizers;
+    std::uint32_t subDims;
+    std::uint32_t componentOffset;
+    std::uint32_t reserved;
+    std::uint64_t rowCount;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModified;
+    std::uint64_t centroidsOffset;
+    std::uint64_t codebooksOffset;
+    std::uint64_t listStartsOffset;
+    std::uint64_t blockStartsOffset;
+    std::uint64_t listRowsOffset;
+    std::uint64_t codesOffset;
+    std::uint64_t codeBlocks;
+    std::uint64_t nameOrderOffset;
+    std::uint64_t stringTableOffset;
+    std::uint64_t stringTableSize;
+    std::uint64_t fileSize;
+};
+#pragma pack(pop)
+
+using ScoredRow = std::pair<float, std::size_t>;
+
+/**
+ * @brief Sums the table entries selected by the codes of some blocks of 16 rows.
+ *
+ * @param tables subquantizers x 256 distances.
+ * @param codes Interleaved code blocks.
+ * @param out Receives blocks x 16 sums.
+ */
+using TableKernel = void (*)(const float* tables, const std::uint8_t* codes, std::size_t subquantizers, std::size_t blocks, float* out);
+
+void tableSumsScalar(const float* tables, const std::uint8_t* codes, std::size_t subquantizers, std::size_t blocks, float* out) {
+    for (std::size_t b = 0; b < blocks; ++b) {
+        float sums[BLOCK_ROWS] = {};
+        const std::uint8_t* block = codes + b * subquantizers * BLOCK_ROWS;
+        for (std::size_t j = 0; j < subquantizers; ++j) {
+            const float* table = tables + j * CODEWORDS;
+            for (std::size_t lane = 0; lane < BLOCK_ROWS; ++lane) sums[lane] += table[block[j * BLOCK_ROWS + lane]];
+        }
+        std::copy(sums, sums + BLOCK_ROWS, out + b * BLOCK_ROWS);
+    }
+}
+
+#if CBIR_X86
+CBIR_TARGET("avx2")
+void tableSumsAvx2(const float* tables, const std::uint8_t* codes, std::size_t subquantizers, std::size_t blocks, float* out) {
+    for (std::size_t b = 0; b < blocks; ++b) {
+        __m256 low = _mm256_setzero_ps();
+        __m256 high = _mm256_setzero_ps();
+        const std::uint8_t* block = codes + b * subquantizers * BLOCK_ROWS;
+        for (std::size_t j = 0; j < subquantizers; ++j) {
+            const float* table = tables + j * CODEWORDS;
+            const __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + j * BLOCK_ROWS));
+            low = _mm256_add_ps(low, _mm256_i32gather_ps(table, _mm256_cvtepu8_epi32(lanes), 4));
+            high = _mm256_add_ps(high, _mm256_i32gather_ps(table, _mm256_cvtepu8_epi32(_mm_srli_si128(lanes, 8)), 4));
+        }
+        _mm256_storeu_ps(out + b * BLOCK_ROWS, low);
+        _mm256_storeu_ps(out + b * BLOCK_ROWS + 8, high);
+    }
+}
+
+CBIR_TARGET("avx512f")
+void tableSumsAvx512(const float* tables, const std::uint8_t* codes, std::size_t subquantizers, std::size_t blocks, float* out) {
+    for (std::size_t b = 0; b < blocks; ++b) {
+        __m512 sums = _mm512_setzero_ps();
+        const std::uint8_t* block = codes + b * subquantizers * BLOCK_ROWS;
+        for (std::size_t j = 0; j < subquantizers; ++j) {
+            const __m512i lanes = _mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + j * BLOCK_ROWS)));
+            sums = _mm512_add_ps(sums, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, lanes, tables + j * CODEWORDS, 4));
+        }
+        _mm512_storeu_ps(out + b * BLOCK_ROWS, sums);
+    }
+}
+#endif
+
+/**
+ * @brief Lookup-table kernel chosen for the running machine.
+ */
+struct Kernel {
+    TableKernel run = tableSumsScalar;
+    const char* name = "scalar";
+};
+
+const Kernel& kernel() {
+    static const Kernel selected = []() {
+        Kernel k;
+#if CBIR_X86
+        const CpuFeatures& cpu = cpuFeatures();
+        if (cpu.avx512f) {
+            k.run = tableSumsAvx512;
+            k.name = "avx512";
+        }
+        else if (cpu.avx2) {
+            k.run = tableSumsAvx2;
+            k.name = "avx2";
+        }
+#endif
+        return k;
+    }();
+    return selected;
+}
+
+std::uint64_t alignOffset(std::uint64_t offset) {
+    return (offset + IVFPQ_ALIGNMENT - 1) / IVFPQ_ALIGNMENT * IVFPQ_ALIGNMENT;
+}
+
+/**
+ * @brief Size and modification time of a file, as recorded in the index header.
+ */
+void sourceFileState(const std::string& filePath, std::uint64_t& size, std::int64_t& modified) {
+    size = static_cast<std::uint64_t>(fs::file_size(filePath));
+    modified = static_cast<std::int64_t>(fs::last_write_time(filePath).time_since_epoch().count());
+}
+
+/**
+ * @brief Copies a vector into a zero padded buffer and scales it to unit length.
+ */
+void normalizeInto(const float* values, std::size_t dims, float* out, std::size_t paddedDims) {
+    const float length = std::sqrt(dotProduct(values, values, dims));
+    const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    for (std::size_t i = 0; i < dims; ++i) out[i] = values[i] * scale;
+    std::fill(out + dims, out + paddedDims, 0.0f);
+}
+
+/**
+ * @brief Index of the closest of count vectors of dims floats.
+ */
+std::size_t closestVector(const float* point, const float* vectors, std::size_t count, std::size_t dims) {
+    std::size_t best = 0;
+    float bestDistance = squaredL2Distance(point, vectors, dims);
+    for (std::size_t i = 1; i < count; ++i) {
+        const float distance = squaredL2Distance(point, vectors + i * dims, dims);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Lloyd's k-means on count points of dims floats, started from k distinct sample points.
+ *
+ * @return k x dims centroids.
+ */
+std::vector<float> trainKMeans(const std::vector<float>& points, std::size_t count, std::size_t dims, std::size_t k,
+    std::uint32_t iterations, std::mt19937_64& random) {
+    std::vector<std::size_t> order(count);
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::shuffle(order.begin(), order.end(), random);
+    std::vector<float> centroids(k * dims);
+    for (std::size_t c = 0; c < k; ++c) {
+        std::copy(points.begin() + order[c] * dims, points.begin() + (order[c] + 1) * dims, centroids.begin() + c * dims);
+    }
+
+    std::vector<std::uint32_t> assignment(count);
+    for (std::uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        parallelFor((count + WORK_BLOCK_ROWS - 1) / WORK_BLOCK_ROWS, [&](std::size_t block) {
+            const std::size_t end = std::min(count, (block + 1) * WORK_BLOCK_ROWS);
+            for (std::size_t i = block * WORK_BLOCK_ROWS; i < end; ++i) {
+                assignment[i] = static_cast<std::uint32_t>(closestVector(points.data() + i * dims, centroids.data(), k, dims));
+            }
+        });
+
+        std::vector<double> sums(k * dims, 0.0);
+        std::vector<std::size_t> members(k, 0);
+        for (std::size_t i = 0; i < count; ++i) {
+            const float* point = points.data() + i * dims;
+            double* sum = sums.data() + assignment[i] * dims;
+            for (std::size_t d = 0; d < dims; ++d) sum[d] += point[d];
+            ++members[assignment[i]];
+        }
+        for (std::size_t c = 0; c < k; ++c) {
+            float* centroid = centroids.data() + c * dims;
+            if (members[c] == 0) {
+                // An empty cluster restarts from a random sample point
+                const std::size_t point = random() % count;
+                std::copy(points.begin() + point * dims, points.begin() + (point + 1) * dims, centroid);
+                continue;
+            }
+            for (std::size_t d = 0; d < dims; ++d) centroid[d] = static_cast<float>(sums[c * dims + d] / members[c]);
+        }
+    }
+    return centroids;
+}
+
+/**
+ * @brief Read access to one component of every row of a feature file.
+ *
+ * Binary feature stores are read through their mapping; CSV files come from the feature index cache.
+ */
+class ComponentSource {
+public:
+    /**
+     * @brief Opens the component at a known position, as recorded in an index.
+     */
+    ComponentSource(const std::string& filePath, std::size_t offset, std::size_t dims) : offset(offset), dims(dims) {
+        open(filePath);
+        if (offset + dims > rowDims()) {
+            throw std::runtime_error("Feature rows are shorter than the indexed component: " + filePath);
+        }
+    }
+
+    /**
+     * @brief Opens a component by name, looked up in the store header or the default layout of layoutType.
+     */
+    ComponentSource(const std::string& filePath, const std::string& component, FeatureType layoutType) {
+        open(filePath);
+        FeatureComponent slice{ "features", 0, static_cast<std::uint32_t>(rowDims()) };
+        bool found = component == "features";
+        if (store) {
+            if (const FeatureComponent* stored = store->findComponent(component)) {
+                slice = *stored;
+                found = true;
+            }
+        }
+        else {
+            for (const auto& candidate : defaultFeatureComponents(layoutType, static_cast<std::uint32_t>(rowDims()), 0, 0)) {
+                if (candidate.name == component) {
+                    slice = candidate;
+                    found = true;
+                }
+            }
+        }
+        if (!found) {
+            throw std::runtime_error("Feature file has no component '" + component + "': " + filePath);
+        }
+        offset = slice.offset;
+        dims = slice.dims;
+    }
+
+    std::size_t rows() const { return store ? store->rows() : index->size(); }
+    const float* row(std::size_t i) const { return (store ? store->row(i) : index->features.row(i)) + offset; }
+    std::string path(std::size_t i) const { return store ? store->path(i) : index->features.path(i); }
+
+    std::size_t offset = 0;
+    std::size_t dims = 0;
+
+private:
+    void open(const std::string& filePath) {
+        if (FeatureStore::isFeatureStoreFile(filePath)) store = std::make_shared<const FeatureStore>(filePath);
+        else index = openFeatureIndex(filePath);
+    }
+
+    std::size_t rowDims() const { return store ? store->dims() : index->features.dims(); }
+
+    std::shared_ptr<const FeatureStore> store;
+    FeatureIndexHandle index;
+};
+
+/**
+ * @brief Cache entry: a loaded index and the file state it was loaded from.
+ */
+struct CachedIndex {
+    std::uintmax_t fileSize = 0;
+    fs::file_time_type modifiedTime;
+    IvfPqIndexHandle index;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedIndex> cachedIndexes;
+
+} // namespace
+
+IvfPqIndex::IvfPqIndex(const std::string& indexFilePath, const std::string& featureFilePath)
+    : mapping(indexFilePath), sourcePath(featureFilePath) {
+    const unsigned char* data = mapping.data();
+    IvfPqHeader header;
+    if (mapping.size() < sizeof(header)) {
+        throw std::runtime_error("IVF-PQ index is truncated: " + indexFilePath);
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    const std::uint64_t rows = header.rowCount;
+    const std::uint64_t lists = header.lists;
+    const std::uint64_t m = header.subquantizers;
+    const bool valid = std::memcmp(header.magic, IVFPQ_MAGIC, sizeof(header.magic)) == 0
+        && header.version == IVFPQ_VERSION
+        && header.fileSize == mapping.size()
+        && rows > 0 && rows <= UINT32_MAX && lists > 0 && m > 0
+        && header.paddedDims == m * header.subDims && header.paddedDims >= header.dims
+        && header.centroidsOffset % IVFPQ_ALIGNMENT == 0
+        && header.codebooksOffset >= header.centroidsOffset + lists * header.paddedDims * sizeof(float)
+        && header.listStartsOffset >= header.codebooksOffset + m * CODEWORDS * header.subDims * sizeof(float)
+        && header.blockStartsOffset >= header.listStartsOffset + (lists + 1) * sizeof(std::uint64_t)
+        && header.listRowsOffset >= header.blockStartsOffset + (lists + 1) * sizeof(std::uint64_t)
+        && header.codesOffset >= header.listRowsOffset + rows * sizeof(std::uint32_t)
+        && header.nameOrderOffset >= header.codesOffset + header.codeBlocks * m * BLOCK_ROWS
+        && header.stringTableOffset >= header.nameOrderOffset + rows * sizeof(std::uint32_t)
+        && header.stringTableOffset + header.stringTableSize <= mapping.size();
+    if (!valid) {
+        throw std::runtime_error("Not a valid IVF-PQ index (or unsupported version): " + indexFilePath);
+    }
+
+    rowCount = static_cast<std::size_t>(rows);
+    vectorDims = header.dims;
+    paddedDims = header.paddedDims;
+    listCount = static_cast<std::size_t>(lists);
+    subquantizers = static_cast<std::size_t>(m);
+    subDims = header.subDims;
+    sliceOffset = header.componentOffset;
+    sourceSize = header.sourceSize;
+    sourceModified = header.sourceModified;
+    centroids = reinterpret_cast<const float*>(data + header.centroidsOffset);
+    codebooks = reinterpret_cast<const float*>(data + header.codebooksOffset);
+    listStarts = reinterpret_cast<const std::uint64_t*>(data + header.listStartsOffset);
+    blockStarts = reinterpret_cast<const std::uint64_t*>(data + header.blockStartsOffset);
+    listRows = reinterpret_cast<const std::uint32_t*>(data + header.listRowsOffset);
+    codes = data + header.codesOffset;
+    nameOrder = reinterpret_cast<const std::uint32_t*>(data + header.nameOrderOffset);
+    pathOffsets = reinterpret_cast<const std::uint64_t*>(data + header.stringTableOffset);
+    pathBytes = reinterpret_cast<const char*>(pathOffsets + rowCount + 1);
+
+    if (listStarts[listCount] != rowCount || blockStarts[listCount] != header.codeBlocks) {
+        throw std::runtime_error("Not a valid IVF-PQ index (or unsupported version): " + indexFilePath);
+    }
+}
+
+std::string IvfPqIndex::path(std::size_t row) const {
+    return std::string(pathBytes + pathOffsets[row], static_cast<std::size_t>(pathOffsets[row + 1] - pathOffsets[row]));
+}
+
+bool IvfPqIndex::findRow(const std::string& imagePath, std::size_t& row) const {
+    const std::uint32_t* end = nameOrder + rowCount;
+    const std::uint32_t* found = std::lower_bound(nameOrder, end, imagePath,
+        [this](std::uint32_t candidate, const std::string& value) { return path(candidate) < value; });
+    if (found == end || path(*found) != imagePath) return false;
+    row = *found;
+    return true;
+}
+
+std::vector<std::pair<float, std::size_t>> IvfPqIndex::probe(const float* query, std::size_t probes) const {
+    std::vector<float> unit(paddedDims);
+    normalizeInto(query, vectorDims, unit.data(), paddedDims);
+
+    // Closest coarse centroids first; ties go to the lower list
+    std::vector<ScoredRow> coarse(listCount);
+    for (std::size_t list = 0; list < listCount; ++list) {
+        coarse[list] = { squaredL2Distance(unit.data(), centroids + list * paddedDims, paddedDims), list };
+    }
+    probes = std::min(std::max<std::size_t>(probes, 1), listCount);
+    std::partial_sort(coarse.begin(), coarse.begin() + probes, coarse.end());
+
+    std::vector<std::vector<ScoredRow>> scored(probes);
+    parallelFor(probes, [&](std::size_t p) {
+        const std::size_t list = coarse[p].second;
+        const std::size_t listRowCount = static_cast<std::size_t>(listStarts[list + 1] - listStarts[list]);
+        if (listRowCount == 0) return;
+
+        // Distances from the query residual to every codeword of every subquantizer
+        std::vector<float> residual(paddedDims);
+        const float* centroid = centroids + list * paddedDims;
+        for (std::size_t d = 0; d < paddedDims; ++d) residual[d] = unit[d] - centroid[d];
+        std::vector<float> tables(subquantizers * CODEWORDS);
+        for (std::size_t j = 0; j < subquantizers; ++j) {
+            const float* codebook = codebooks + j * CODEWORDS * subDims;
+            for (std::size_t c = 0; c < CODEWORDS; ++c) {
+                tables[j * CODEWORDS + c] = squaredL2Distance(residual.data() + j * subDims, codebook + c * subDims, subDims);
+            }
+        }
+
+        const std::size_t blocks = static_cast<std::size_t>(blockStarts[list + 1] - blockStarts[list]);
+        std::vector<float> sums(blocks * BLOCK_ROWS);
+        kernel().run(tables.data(), codes + blockStarts[list] * subquantizers * BLOCK_ROWS, subquantizers, blocks, sums.data());
+
+        const std::uint32_t* rows = listRows + listStarts[list];
+        scored[p].reserve(listRowCount);
+        for (std::size_t i = 0; i < listRowCount; ++i) scored[p].emplace_back(0.5f * sums[i], rows[i]);
+    });
+
+    std::vector<ScoredRow> results;
+    for (const std::vector<ScoredRow>& list : scored) results.insert(results.end(), list.begin(), list.end());
+    return results;
+}
+
+std::vector<std::pair<float, std::size_t>> IvfPqIndex::search(const float* query, std::size_t topK, std::size_t probes, std::size_t rerankCandidates) const {
+    if (topK == 0) return {};
+
+    std::vector<ScoredRow> results = probe(query, probes);
+    TopKHeap(std::max(topK, rerankCandidates), ScanOrder::Ascending).sortAndTrim(results);
+
+    if (rerankCandidates > 0) {
+        // Exact cosine distances, read in place from the store mapping or the cached fp32 index
+        const ComponentSource source(sourcePath, sliceOffset, vectorDims);
+        for (ScoredRow& candidate : results) {
+            if (candidate.second >= source.rows()) continue;
+            const CosineTerms terms = cosineTerms(query, source.row(candidate.second), vectorDims);
+            const float lengths = std::sqrt(terms.squaredNormA * terms.squaredNormB);
+            candidate.first = lengths > 0.0f ? 1.0f - terms.dot / lengths : 1.0f;
+        }
+        TopKHeap(topK, ScanOrder::Ascending).sortAndTrim(results);
+    }
+    return results;
+}
+
+std::vector<float> IvfPqIndex::exactVector(std::size_t row) const {
+    const ComponentSource source(sourcePath, sliceOffset, vectorDims);
+    if (row >= source.rows()) {
+        throw std::runtime_error("Feature file has fewer rows than its IVF-PQ index: " + sourcePath);
+    }
+    return std::vector<float>(source.row(row), source.row(row) + vectorDims);
+}
+
+bool IvfPqIndex::isUpToDate() const {
+    std::uint64_t size = 0;
+    std::int64_t modified = 0;
+    try {
+        sourceFileState(sourcePath, size, modified);
+    }
+    catch (const fs::filesystem_error&) {
+        return false;
+    }
+    return size == sourceSize && modified == sourceModified;
+}
+
+const char* IvfPqIndex::kernelName() {
+    return kernel().name;
+}
+
+std::string ivfPqIndexPath(const std::string& featureFilePath, const std::string& component) {
+    return featureFilePath + "." + component + ".ivfpq";
+}
+
+void buildIvfPqIndex(const std::string& featureFilePath, const std::string& component, FeatureType layoutType,
+    const std::string& indexFilePath, const IvfPqParameters& parameters) {
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    sourceFileState(featureFilePath, sourceSize, sourceModified);
+
+    const ComponentSource source(featureFilePath, component, layoutType);
+    const std::size_t rows = source.rows();
+    if (rows == 0 || rows > UINT32_MAX || source.dims == 0) {
+        throw std::runtime_error("No embeddings to index in " + featureFilePath);
+    }
+
+    // Every subquantizer covers subDims values; the last one is zero padded
+    const std::size_t dims = source.dims;
+    const std::size_t subquantizers = std::min<std::size_t>(std::max<std::uint32_t>(parameters.codeBytes, 1), dims);
+    const std::size_t subDims = (dims + subquantizers - 1) / subquantizers;
+    const std::size_t paddedDims = subquantizers * subDims;
+    const std::size_t sampleRows = std::min<std::size_t>(rows, std::max<std::uint32_t>(parameters.trainingRows, 1));
+    std::size_t lists = parameters.lists > 0 ? parameters.lists : static_cast<std::size_t>(4.0 * std::sqrt(static_cast<double>(rows)));
+    lists = std::max<std::size_t>(1, std::min(lists, sampleRows));
+
+    // Training sample, drawn with a fixed seed so rebuilding the same file gives the same index
+    std::mt19937_64 random(TRAINING_SEED);
+    std::vector<std::size_t> sampleIds(rows);
+    std::iota(sampleIds.begin(), sampleIds.end(), std::size_t(0));
+    if (sampleRows < rows) {
+        for (std::size_t i = 0; i < sampleRows; ++i) std::swap(sampleIds[i], sampleIds[i + random() % (rows - i)]);
+        sampleIds.resize(sampleRows);
+        std::sort(sampleIds.begin(), sampleIds.end());
+    }
+    std::vector<float> sample(sampleRows * paddedDims);
+    for (std::size_t i = 0; i < sampleRows; ++i) {
+        normalizeInto(source.row(sampleIds[i]), dims, sample.data() + i * paddedDims, paddedDims);
+    }
+
+    const std::vector<float> centroids = trainKMeans(sample, sampleRows, paddedDims, lists, parameters.iterations, random);
+
+    // Residuals of the sample to their coarse centroids train one codebook per subquantizer
+    for (std::size_t i = 0; i < sampleRows; ++i) {
+        float* point = sample.data() + i * paddedDims;
+        const float* centroid = centroids.data() + closestVector(point, centroids.data(), lists, paddedDims) * paddedDims;
+        for (std::size_t d = 0; d < paddedDims; ++d) point[d] -= centroid[d];
+    }
+    // With a tiny sample some codewords stay unused; they are never selected while encoding
+    const std::size_t codewords = std::min(CODEWORDS, sampleRows);
+    std::vector<float> codebooks(subquantizers * CODEWORDS * subDims, 0.0f);
+    std::vector<float> subvectors(sampleRows * subDims);
+    for (std::size_t j = 0; j < subquantizers; ++j) {
+        for (std::size_t i = 0; i < sampleRows; ++i) {
+            std::copy_n(sample.data() + i * paddedDims + j * subDims, subDims, subvectors.data() + i * subDims);
+        }
+        const std::vector<float> codebook = trainKMeans(subvectors, sampleRows, subDims, codewords, parameters.iterations, random);
+        std::copy(codebook.begin(), codebook.end(), codebooks.begin() + j * CODEWORDS * subDims);
+    }
+    sample = std::vector<float>();
+
+    // Encode every row: closest coarse centroid, then the closest codeword of every residual slice
+    std::vector<std::uint32_t> assignment(rows);
+    std::vector<std::uint8_t> rowCodes(rows * subquantizers);
+    parallelFor((rows + WORK_BLOCK_ROWS - 1) / WORK_BLOCK_ROWS, [&](std::size_t block) {
+        std::vector<float> unit(paddedDims);
+        const std::size_t end = std::min(rows, (block + 1) * WORK_BLOCK_ROWS);
+        for (std::size_t row = block * WORK_BLOCK_ROWS; row < end; ++row) {
+            normalizeInto(source.row(row), dims, unit.data(), paddedDims);
+            const std::size_t list = closestVector(unit.data(), centroids.data(), lists, paddedDims);
+            const float* centroid = centroids.data() + list * paddedDims;
+            for (std::size_t d = 0; d < paddedDims; ++d) unit[d] -= centroid[d];
+            assignment[row] = static_cast<std::uint32_t>(list);
+            for (std::size_t j = 0; j < subquantizers; ++j) {
+                rowCodes[row * subquantizers + j] = static_cast<std::uint8_t>(
+                    closestVector(unit.data() + j * subDims, codebooks.data() + j * CODEWORDS * subDims, codewords, subDims));
+            }
+        }
+    });
+
+    // Group the rows by list, in row order, and interleave the codes of every 16 rows
+    std::vector<std::uint64_t> listStarts(lists + 1, 0), blockStarts(lists + 1, 0);
+    for (std::uint32_t list : assignment) ++listStarts[list + 1];
+    for (std::size_t list = 0; list < lists; ++list) {
+        blockStarts[list + 1] = blockStarts[list] + (listStarts[list + 1] + BLOCK_ROWS - 1) / BLOCK_ROWS;
+        listStarts[list + 1] += listStarts[list];
+    }
+    std::vector<std::uint32_t> listRows(rows);
+    std::vector<std::uint8_t> codes(blockStarts[lists] * subquantizers * BLOCK_ROWS, 0);
+    std::vector<std::uint64_t> filled(listStarts.begin(), listStarts.end() - 1);
+    for (std::size_t row = 0; row < rows; ++row) {
+        const std::uint32_t list = assignment[row];
+        const std::uint64_t position = filled[list]++;
+        listRows[position] = static_cast<std::uint32_t>(row);
+        const std::uint64_t entry = position - listStarts[list];
+        std::uint8_t* block = codes.data() + (blockStarts[list] + entry / BLOCK_ROWS) * subquantizers * BLOCK_ROWS;
+        for (std::size_t j = 0; j < subquantizers; ++j) block[j * BLOCK_ROWS + entry % BLOCK_ROWS] = rowCodes[row * subquantizers + j];
+    }
+    rowCodes = std::vector<std::uint8_t>();
+
+    std::vector<std::string> paths(rows);
+    std::uint64_t pathBytes = 0;
+    for (std::size_t row = 0; row < rows; ++row) {
+        paths[row] = source.path(row);
+        pathBytes += paths[row].size();
+    }
+    std::vector<std::uint32_t> nameOrder(rows);
+    std::iota(nameOrder.begin(), nameOrder.end(), std::uint32_t(0));
+    std::sort(nameOrder.begin(), nameOrder.end(), [&paths](std::uint32_t a, std::uint32_t b) {
+        return paths[a] != paths[b] ? paths[a] < paths[b] : a < b;
+    });
+
+    IvfPqHeader header = {};
+    std::memcpy(header.magic, IVFPQ_MAGIC, sizeof(header.magic));
+    header.version = IVFPQ_VERSION;
+    header.dims = static_cast<std::uint32_t>(dims);
+    header.paddedDims = static_cast<std::uint32_t>(paddedDims);
+    header.lists = static_cast<std::uint32_t>(lists);
+    header.subquantizers = static_cast<std::uint32_t>(subquantizers);
+    header.subDims = static_cast<std::uint32_t>(subDims);
+    header.componentOffset = static_cast<std::uint32_t>(source.offset);
+    header.rowCount = rows;
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+    header.centroidsOffset = alignOffset(sizeof(IvfPqHeader));
+    header.codebooksOffset = alignOffset(header.centroidsOffset + centroids.size() * sizeof(float));
+    header.listStartsOffset = alignOffset(header.codebooksOffset + codebooks.size() * sizeof(float));
+    header.blockStartsOffset = alignOffset(header.listStartsOffset + listStarts.size() * sizeof(std::uint64_t));
+    header.listRowsOffset = alignOffset(header.blockStartsOffset + blockStarts.size() * sizeof(std::uint64_t));
+    header.codesOffset = alignOffset(header.listRowsOffset + listRows.size() * sizeof(std::uint32_t));
+    header.codeBlocks = blockStarts[lists];
+    header.nameOrderOffset = alignOffset(header.codesOffset + codes.size());
+    header.stringTableOffset = alignOffset(header.nameOrderOffset + nameOrder.size() * sizeof(std::uint32_t));
+    header.stringTableSize = (rows + 1) * sizeof(std::uint64_t) + pathBytes;
+    header.fileSize = header.stringTableOffset + header.stringTableSize;
+
+    // Written under a temporary name so an interrupted build never leaves a half-written index
+    const std::string partialPath = indexFilePath + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to open IVF-PQ index for writing: " + partialPath);
+        }
+        std::uint64_t written = 0;
+        auto put = [&](const void* data, std::uint64_t bytes) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            written += bytes;
+        };
+        auto padTo = [&](std::uint64_t offset) {
+            static const char zeros[IVFPQ_ALIGNMENT] = {};
+            put(zeros, offset - written);
+        };
+
+        put(&header, sizeof(header));
+        padTo(header.centroidsOffset);
+        put(centroids.data(), centroids.size() * sizeof(float));
+        padTo(header.codebooksOffset);
+        put(codebooks.data(), codebooks.size() * sizeof(float));
+        padTo(header.listStartsOffset);
+        put(listStarts.data(), listStarts.size() * sizeof(std::uint64_t));
+        padTo(header.blockStartsOffset);
+        put(blockStarts.data(), blockStarts.size() * sizeof(std::uint64_t));
+        padTo(header.listRowsOffset);
+        put(listRows.data(), listRows.size() * sizeof(std::uint32_t));
+        padTo(header.codesOffset);
+        put(codes.data(), codes.size());
+        padTo(header.nameOrderOffset);
+        put(nameOrder.data(), nameOrder.size() * sizeof(std::uint32_t));
+        padTo(header.stringTableOffset);
+        std::uint64_t offset = 0;
+        for (const std::string& imagePath : paths) {
+            put(&offset, sizeof(offset));
+            offset += imagePath.size();
+        }
+        put(&offset, sizeof(offset));
+        for (const std::string& imagePath : paths) put(imagePath.data(), imagePath.size());
+
+        if (!out.good()) {
+            throw std::runtime_error("Error writing IVF-PQ index: " + partialPath);
+        }
+    }
+    std::error_code error;
+    fs::rename(partialPath, indexFilePath, error);
+    if (error) {
+        fs::remove(partialPath, error);
+        throw std::runtime_error("Unable to replace IVF-PQ index: " + indexFilePath);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Built IVF-PQ index of " << rows << " '" << component << "' vectors (" << lists << " lists, "
+        << subquantizers << " bytes per vector) in " << seconds << " s: " << indexFilePath << std::endl;
+}
+
+IvfPqIndexHandle openIvfPqIndex(const std::string& featureFilePath, const std::string& component, FeatureType layoutType,
+    const IvfPqParameters& parameters) {
+    const std::string indexFilePath = ivfPqIndexPath(featureFilePath, component);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(indexFilePath, error);
+    const fs::file_time_type modifiedTime = fs::last_write_time(indexFilePath, error);
+    auto cached = cachedIndexes.find(indexFilePath);
+    if (!error && cached != cachedIndexes.end() && cached->second.fileSize == fileSize && cached->second.modifiedTime == modifiedTime
+        && cached->second.index->isUpToDate()) {
+        return cached->second.index;
+    }
+
+    // Drop the cached mapping first, so the file can be replaced if it has to be rebuilt
+    cachedIndexes.erase(indexFilePath);
+    IvfPqIndexHandle index;
+    if (!error) {
+        try {
+            auto loaded = std::make_shared<const IvfPqIndex>(indexFilePath, featureFilePath);
+            if (loaded->isUpToDate()) index = loaded;
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Rebuilding IVF-PQ index: " << e.what() << std::endl;
+        }
+    }
+    if (!index) {
+        buildIvfPqIndex(featureFilePath, component, layoutType, indexFilePath, parameters);
+        index = std::make_shared<const IvfPqIndex>(indexFilePath, featureFilePath);
+    }
+
+    CachedIndex entry;
+    entry.fileSize = fs::file_size(indexFilePath);
+    entry.modifiedTime = fs::last_write_time(indexFilePath);
+    entry.index = index;
+    cachedIndexes[indexFilePath] = entry;
+    return index;
+}
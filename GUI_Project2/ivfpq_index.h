@@ -0,0 +1,191 @@
+/*! \file ivfpq_index.h
+    \brief Declarations for the IVF-PQ compressed index over DNN embeddings.
+    \author Manushi
+    \date October 16, 2026
+
+    An inverted-file index with product quantization keeps only a few bytes per image. k-means
+    on a sample of the (unit-length) embeddings splits the collection into inverted lists around
+    coarse centroids. The residual of every vector to its centroid is cut into subvectors, and
+    each subvector is replaced by the one-byte id of its closest codeword in a 256-entry codebook.
+    A query probes the nprobe closest lists only and scores their codes with lookup tables of
+    query-to-codeword distances (asymmetric distance computation), so neither the fp32 nor the
+    fp16 vectors need to be in memory. The best candidates can be reranked with the exact vectors
+    read back from the feature file.
+
+    The index is saved next to the feature file as "<featureFile>.<component>.ivfpq" and is
+    memory-mapped when opened. It records the size and modification time of the feature file it
+    was built from and is rebuilt when they change.
+*/
+
+#ifndef IVFPQ_INDEX_H
+#define IVFPQ_INDEX_H
+
+#include "feature_store.h"
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Parameters fixed when an IVF-PQ index is built.
+ */
+struct IvfPqParameters {
+    std::uint32_t lists = 0;             // Inverted lists; 0 picks about 4 * sqrt(rows)
+    std::uint32_t codeBytes = 32;        // Subquantizers, one code byte each (16 to 64 is typical)
+    std::uint32_t trainingRows = 65536;  // Rows sampled to train the centroids and codebooks
+    std::uint32_t iterations = 10;       // k-means iterations
+};
+
+/**
+ * @brief Default number of inverted lists probed per query.
+ */
+constexpr std::size_t IVFPQ_DEFAULT_PROBES = 16;
+
+/**
+ * @brief A saved IVF-PQ index, memory-mapped read-only.
+ *
+ * Searches only read the mapping, so one index can be searched from several threads at once.
+ */
+class IvfPqIndex {
+public:
+    /**
+     * @brief Maps an index file and validates its header.
+     *
+     * @param indexFilePath Path to the ".ivfpq" file.
+     * @param featureFilePath Feature file the index was built from; exact vectors for reranking are read from it.
+     * @throws std::runtime_error If the file cannot be mapped or is not a valid index.
+     */
+    IvfPqIndex(const std::string& indexFilePath, const std::string& featureFilePath);
+
+    std::size_t size() const { return rowCount; }
+    std::size_t dims() const { return vectorDims; }
+    std::size_t lists() const { return listCount; }
+    std::size_t codeBytes() const { return subquantizers; }
+
+    /**
+     * @brief First float of the indexed component inside a feature row.
+     */
+    std::size_t componentOffset() const { return sliceOffset; }
+
+    /**
+     * @brief Returns the image path stored for a row.
+     */
+    std::string path(std::size_t row) const;
+
+    /**
+     * @brief Finds the row of an image path with a binary search over the sorted paths.
+     *
+     * @param imagePath Path as stored in the feature file.
+     * @param row Receives the row if found.
+     * @return True if the path is in the index.
+     */
+    bool findRow(const std::string& imagePath, std::size_t& row) const;
+
+    /**
+     * @brief Scores every row of the inverted lists closest to a query.
+     *
+     * @param query Query component of dims() floats; it does not need to be unit length.
+     * @param probes Number of lists to scan.
+     * @return (approximate cosine distance, row) of every row in the probed lists, in no particular order.
+     */
+    std::vector<std::pair<float, std::size_t>> probe(const float* query, std::size_t probes) const;
+
+    /**
+     * @brief Finds the approximate nearest neighbors of a query by cosine distance.
+     *
+     * @param query Query component of dims() floats; it does not need to be unit length.
+     * @param topK Number of neighbors to return.
+     * @param probes Number of lists to scan; more lists find more of the true neighbors.
+     * @param rerankCandidates Best max(topK, rerankCandidates) rows rescored with their exact vectors (0 disables reranking).
+     * @return Up to topK (cosine distance, row) pairs, closest first.
+     * @throws std::runtime_error If reranking cannot read the feature file.
+     */
+    std::vector<std::pair<float, std::size_t>> search(const float* query, std::size_t topK, std::size_t probes = IVFPQ_DEFAULT_PROBES,
+        std::size_t rerankCandidates = 0) const;
+
+    /**
+     * @brief Reads the exact values of a row's component back from the feature file.
+     *
+     * @throws std::runtime_error If the feature file cannot be read.
+     */
+    std::vector<float> exactVector(std::size_t row) const;
+
+    /**
+     * @brief Checks whether the index was built from the current contents of its feature file.
+     */
+    bool isUpToDate() const;
+
+    /**
+     * @brief Name of the lookup-table kernel chosen for this machine.
+     */
+    static const char* kernelName();
+
+private:
+    MappedFile mapping;
+    std::string sourcePath;
+    std::size_t rowCount = 0;
+    std::size_t vectorDims = 0;
+    std::size_t paddedDims = 0;
+    std::size_t listCount = 0;
+    std::size_t subquantizers = 0;
+    std::size_t subDims = 0;
+    std::size_t sliceOffset = 0;
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    const float* centroids = nullptr;
+    const float* codebooks = nullptr;
+    const std::uint64_t* listStarts = nullptr;
+    const std::uint64_t* blockStarts = nullptr;
+    const std::uint32_t* listRows = nullptr;
+    const std::uint8_t* codes = nullptr;
+    const std::uint32_t* nameOrder = nullptr;
+    const std::uint64_t* pathOffsets = nullptr;
+    const char* pathBytes = nullptr;
+};
+
+/**
+ * @brief Shared, read-only handle to a cached IVF-PQ index.
+ */
+using IvfPqIndexHandle = std::shared_ptr<const IvfPqIndex>;
+
+/**
+ * @brief Returns the path of the index file for one component of a feature file.
+ */
+std::string ivfPqIndexPath(const std::string& featureFilePath, const std::string& component);
+
+/**
+ * @brief Trains and encodes an IVF-PQ index for one component of a feature file and saves it.
+ *
+ * Binary feature stores are read through their mapping, so only the training sample and the
+ * codes are held in memory. Training and encoding run on the scan thread pool; the sample is
+ * drawn with a fixed seed, so a rebuild of the same file gives the same index.
+ *
+ * @param featureFilePath CSV or feature store file.
+ * @param component Component to index ("features" for the whole row, "dnn" for the custom design slice).
+ * @param layoutType Feature type whose default layout locates the component in a CSV file.
+ * @param indexFilePath Path of the index file to write.
+ * @param parameters List count, code size and training effort.
+ * @throws std::runtime_error If the feature file cannot be read, has no such component, or the index cannot be written.
+ */
+void buildIvfPqIndex(const std::string& featureFilePath, const std::string& component, FeatureType layoutType,
+    const std::string& indexFilePath, const IvfPqParameters& parameters = IvfPqParameters());
+
+/**
+ * @brief Returns the cached index of one component of a feature file, building or rebuilding it if needed.
+ *
+ * An existing up-to-date index is used whatever parameters it was built with.
+ *
+ * @param featureFilePath CSV or feature store file.
+ * @param component Component to index.
+ * @param layoutType Feature type whose default layout locates the component in a CSV file.
+ * @param parameters Parameters used if the index has to be built.
+ * @return Handle to the index.
+ * @throws std::runtime_error If the index can neither be opened nor built.
+ */
+IvfPqIndexHandle openIvfPqIndex(const std::string& featureFilePath, const std::string& component, FeatureType layoutType,
+    const IvfPqParameters& parameters = IvfPqParameters());
+
+#endif // IVFPQ_INDEX_H
@@ -0,0 +1,79 @@
+/*! \file mapped_file.cpp
+    \brief Implements read-only memory-mapped files.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. It wraps
+    CreateFileMapping/MapViewOfFile on Windows and mmap elsewhere.
+*/
+
+#include "mapped_file.h"
+#include <stdexcept>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filePath) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Unable to open " + filePath);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::runtime_error("Unable to map " + filePath);
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        throw std::runtime_error("Unable to map " + filePath);
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Unable to map " + filePath);
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    mappedData = static_cast<const unsigned char*>(view);
+    mappedSize = static_cast<std::size_t>(size.QuadPart);
+#else
+    fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        throw std::runtime_error("Unable to open " + filePath);
+    }
+    struct stat status;
+    if (::fstat(fileDescriptor, &status) != 0 || status.st_size == 0) {
+        ::close(fileDescriptor);
+        throw std::runtime_error("Unable to map " + filePath);
+    }
+    void* view = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (view == MAP_FAILED) {
+        ::close(fileDescriptor);
+        throw std::runtime_error("Unable to map " + filePath);
+    }
+    mappedData = static_cast<const unsigned char*>(view);
+    mappedSize = static_cast<std::size_t>(status.st_size);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    UnmapViewOfFile(mappedData);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+#else
+    ::munmap(const_cast<unsigned char*>(mappedData), mappedSize);
+    ::close(fileDescriptor);
+#endif
+}
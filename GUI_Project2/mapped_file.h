@@ -0,0 +1,48 @@
+/*! \file mapped_file.h
+    \brief Declarations for read-only memory-mapped files.
+    \author Manushi
+    \date October 16, 2026
+
+    Feature stores and nearest-neighbor indexes are read through a read-only memory mapping, so
+    opening them costs no parsing or copying and pages are loaded by the operating system as the
+    data is touched.
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief A whole file mapped read-only into memory; the mapping lives as long as the object.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Maps a file into memory.
+     *
+     * @param filePath Path to the file.
+     * @throws std::runtime_error If the file cannot be opened, is empty or cannot be mapped.
+     */
+    explicit MappedFile(const std::string& filePath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return mappedData; }
+    std::size_t size() const { return mappedSize; }
+
+private:
+    const unsigned char* mappedData = nullptr;
+    std::size_t mappedSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -4,7 +4,7 @@
     \date February 10, 2024
 
     This file implements a Content-Based Image Retrieval (CBIR) system utilizing multi-histogram matching.
-    It includes functions to load database histograms, compute histogram intersection, perform histogram matching, compute color
+    It includes functions to compute histogram intersection, perform histogram matching, compute color
     histograms manually, and preprocess database images.
 */
 #include <opencv2/opencv.hpp>
@@ -16,7 +16,12 @@
 #include <algorithm>
 #include <filesystem>
 #include <cstring>
+#include "distance_kernels.h"
 #include "feature_utils.h"
+#include "feature_store.h"
+#include "feature_indexer.h"
+#include "parallel_scan.h"
+#include "sparse_histogram.h"
 
 namespace fs = std::filesystem;
 
@@ -74,50 +79,6 @@ std::vector<float> computePartialHistogram(const cv::Mat& image, int binsPerChan
     return histogram;
 }
 
-/**
- * @brief Reads histogram data from a CSV file containing pre-computed histograms of images in the database.
- *
- * @param csvFilePath Path to the CSV file containing histogram data.
- * @param binsPerChannel Number of bins per color channel in the histogram.
- * @param databaseHistograms Output vector to store the loaded histograms and their corresponding filenames.
- * @throws std::runtime_error If there is an error while reading the CSV file.
- */
-void loadDatabaseMultiHistograms(const std::string& csvFilePath, int binsPerChannel,
-    std::vector<std::pair<std::string, cv::Mat>>& databaseHistograms) {
-    std::ifstream file(csvFilePath);
-    std::string line;
-    while (getline(file, line)) {
-        std::istringstream iss(line);
-        std::string filename;
-        getline(iss, filename, ','); // Extract filename
-
-        std::vector<float> bins;
-        std::string binValue;
-        while (getline(iss, binValue, ',')) {
-            bins.push_back(std::stof(binValue));
-        }
-        
-        int expectedBinCount = binsPerChannel * binsPerChannel * binsPerChannel * 2; // For two histograms combined
-        if (bins.size() != expectedBinCount) {
-            std::cerr << "Histogram size mismatch for " << filename << std::endl;
-            continue;
-        }
-
-        // Create a 1D cv::Mat for the histogram data and then reshape it to 3D
-        cv::Mat flatHist = cv::Mat(bins.size(), 1, CV_32F, bins.data());
-
-
-        int newSize[] = { binsPerChannel, binsPerChannel, binsPerChannel * 2 }; // New shape
-        cv::Mat hist = flatHist.reshape(0, 3, newSize);
-        if (hist.total() != bins.size()) {
-            throw std::runtime_error("Reshape operation failed due to size mismatch.");
-        }
-        databaseHistograms.push_back(std::make_pair(filename, hist.clone())); // Clone to ensure continuity
-
-
-    }
-}
-
 /**
  * @brief Computes the histogram intersection between two histograms represented as vectors.
  *
@@ -129,15 +90,9 @@ void loadDatabaseMultiHistograms(const std::string& csvFilePath, int binsPerChan
 float histogramIntersection(const std::vector<float>::const_iterator& start1,
     const std::vector<float>::const_iterator& end1,
     const std::vector<float>::const_iterator& start2) {
-    float intersection = 0.0f;
-    auto it1 = start1;
-    auto it2 = start2;
-    while (it1 != end1) {
-        intersection += std::min(*it1, *it2);
-        ++it1;
-        ++it2;
-    }
-    return intersection;
+    const std::size_t count = static_cast<std::size_t>(end1 - start1);
+    if (count == 0) return 0.0f;
+    return intersectionSum(&*start1, &*start2, count);
 }
 
 /**
@@ -163,41 +118,32 @@ std::vector<std::string> performMultiHistogramMatchingTask(const std::string& ta
     // Combine histograms of the target image
     std::vector<float> combinedTargetHist = combineHistograms({ topHalfHist, bottomHalfHist });
 
-    // Load database histograms
-    std::vector<std::pair<std::string, cv::Mat>> databaseHistograms;
-    loadDatabaseMultiHistograms(outputFile, binsPerChannel, databaseHistograms);
-
-    // Compute histogram intersections with the target image
-    std::vector<std::pair<float, std::string>> matches;
-    for (const auto& [filename, histMat] : databaseHistograms) {
-        if (filename == targetImageFile) continue; // Skip the target image
-
-        // Ensure histMat is continuous and has a type of CV_32F for comparison
-        if (!histMat.isContinuous() || histMat.type() != CV_32F) {
-            std::cerr << "Histogram data is not in expected format." << std::endl;
-            continue;
-        }
-
-        // Convert Mat to a vector for comparison
-        std::vector<float> dbHist(histMat.begin<float>(), histMat.end<float>());
-
-        // Calculate intersection for each part and then average them
-        float intersectionTop = histogramIntersection(combinedTargetHist.begin(), combinedTargetHist.begin() + topHalfHist.size(), dbHist.begin());
-        float intersectionBottom = histogramIntersection(combinedTargetHist.begin() + topHalfHist.size(), combinedTargetHist.end(), dbHist.begin() + topHalfHist.size());
-
-        float combinedIntersection = (intersectionTop + intersectionBottom) / 2;
+    // Get the database histograms from the cached index (loaded on first use); sparse rows keep only their filled bins
+    HistogramIndexHandle index;
+    try {
+        index = openHistogramIndex(outputFile);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading histogram data: " << e.what() << std::endl;
+        return {};
+    }
 
-        matches.push_back({ combinedIntersection, filename });
+    const HistogramSet& histograms = index->histograms;
+    if (histograms.binCount() != combinedTargetHist.size()) {
+        std::cerr << "Histogram size mismatch for " << outputFile << std::endl;
+        return {};
     }
+    HistogramSet::Query query = histograms.prepareQuery(combinedTargetHist.data());
 
-    // Sort based on the combined intersection (higher is better)
-    std::sort(matches.begin(), matches.end(), [](const auto& a, const auto& b) {
-        return a.first > b.first;
-        });
+    // Average the intersections of the two halves on all scan threads, skipping rows whose block bounds fall short
+    HistogramSearchStats stats;
+    std::vector<std::pair<float, size_t>> matches = searchIntersectionTopK(*index, query, { topHalfHist.size(), combinedTargetHist.size() },
+        static_cast<size_t>(std::max(topN, 0)), targetImageFile, &stats);
+    printHistogramSearchStats(stats);
 
     std::vector<std::string> topMatches;
-    for (int i = 0; i < std::min(topN, static_cast<int>(matches.size())); ++i) {
-        topMatches.push_back(matches[i].second);
+    for (const auto& match : matches) {
+        topMatches.push_back(index->imagePaths[match.second]);
     }
 
     return topMatches;    
@@ -209,36 +155,29 @@ std::vector<std::string> performMultiHistogramMatchingTask(const std::string& ta
  * @param directoryPath Path to the directory containing images.
  * @param outputFile Path to the output CSV file to save histogram data.
  * @param binsPerChannel Number of bins per color channel in the histograms.
+ * @throws std::runtime_error If the output file cannot be written.
  */
 void preprocessMultiHistogramDatabaseImages(const std::string& directoryPath, const std::string& outputFile, const std::int32_t& binsPerChannel) {
-    std::ofstream out(outputFile);
-
-    // Iterate over all files in the given directory
-    for (const auto& entry : fs::directory_iterator(directoryPath)) {
-        // Check if the entry is a file and has a .jpg extension (you can add more conditions for other formats)
-        if (entry.is_regular_file() && entry.path().extension() == ".jpg") {
-            std::string imagePath = entry.path().string();
-            cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
-            if (image.empty()) {
-                std::cerr << "Unable to read image: " << imagePath << std::endl;
-                continue; // Skip to the next file if this one can't be read
-            }
-
-            // Compute histograms for different parts
-            std::vector<float> topHalfHist = computePartialHistogram(image, binsPerChannel, 0, 0, image.cols, image.rows / 2);
-            std::vector<float> bottomHalfHist = computePartialHistogram(image, binsPerChannel, 0, image.rows / 2, image.cols, image.rows / 2);
+    FeatureStoreInfo info;
+    info.type = FeatureType::MultiHistogram;
+    info.binsPerChannel = binsPerChannel;
+
+    // Only new or changed images are decoded; unchanged rows are copied from the previous output
+    indexImageDirectory(directoryPath, outputFile, info, [binsPerChannel](const std::string& imagePath, std::vector<float>& combinedHist) {
+        cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "Unable to read image: " << imagePath << std::endl;
+            return false; // Skip to the next file if this one can't be read
+        }
 
-            // Combine histograms
-            std::vector<float> combinedHist = combineHistograms({ topHalfHist, bottomHalfHist });
+        // Compute histograms for different parts
+        std::vector<float> topHalfHist = computePartialHistogram(image, binsPerChannel, 0, 0, image.cols, image.rows / 2);
+        std::vector<float> bottomHalfHist = computePartialHistogram(image, binsPerChannel, 0, image.rows / 2, image.cols, image.rows / 2);
 
-            // Save combined histogram
-            out << imagePath;
-            for (float value : combinedHist) {
-                out << "," << value;
-            }
-            out << "\n";
-        }
-    }
+        // Combine histograms
+        combinedHist = combineHistograms({ topHalfHist, bottomHalfHist });
+        return true;
+        });
 }
 
 /**
@@ -250,7 +189,13 @@ void preprocessMultiHistogramDatabaseImages(const std::string& directoryPath, co
  */
 void performMultiHistogramCalculationTask(const std::string& directoryPath, int binsPerChannel, const std::string& outputFile)
 {
-    preprocessMultiHistogramDatabaseImages(directoryPath, outputFile, binsPerChannel);
+    try {
+        preprocessMultiHistogramDatabaseImages(directoryPath, outputFile, binsPerChannel);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to save histograms: " << e.what() << std::endl;
+        return;
+    }
 
     std::cout << "Histograms computed and saved to " << outputFile << "\n\n" << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+/*! \file parallel_scan.cpp
+    \brief Implements the multi-core top-K scan over a feature collection.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. The worker threads are
+    started once and sleep between scans. During a scan the calling thread works alongside them,
+    and blocks of rows are handed out through an atomic counter so a slow block does not hold up
+    the others.
+*/
+
+#include "parallel_scan.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+constexpr std::size_t SCAN_BLOCK_ROWS = 512;
+
+using ScoredRow = std::pair<float, std::size_t>;
+
+/**
+ * @brief Worker threads that run one job at a time, together with the thread that submits it.
+ */
+class ScanThreadPool {
+public:
+    explicit ScanThreadPool(unsigned threadCount) {
+        for (unsigned worker = 1; worker < threadCount; ++worker) {
+            workers.emplace_back([this, worker]() { workerLoop(worker); });
+        }
+    }
+
+    ~ScanThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    /**
+     * @brief Runs job(worker) on every thread, the caller being worker 0, and waits for all of them.
+     */
+    void run(const std::function<void(unsigned worker)>& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &task;
+            pending = static_cast<unsigned>(workers.size());
+            ++generation;
+        }
+        wake.notify_all();
+        task(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    void workerLoop(unsigned worker) {
+        std::uint64_t seen = 0;
+        for (;;) {
+            const std::function<void(unsigned)>* task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                task = job;
+            }
+            (*task)(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(unsigned)>* job = nullptr;
+    std::uint64_t generation = 0;
+    unsigned pending = 0;
+    bool stopping = false;
+};
+
+std::mutex poolMutex;
+std::unique_ptr<ScanThreadPool> pool;
+unsigned configuredThreads = 0;
+
+unsigned resolveThreadCount(unsigned threadCount) {
+    return threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief Runs job(worker) for workers [0, threadCount) on the scan threads and rethrows the first exception.
+ *
+ * @param maxThreads Upper bound on the threads worth using; the calling thread alone runs the job when it is 1.
+ * @param job Called once per worker; stop is set when a worker fails so the others can finish early.
+ */
+void runOnScanThreads(unsigned maxThreads, const std::function<void(unsigned worker)>& job, std::atomic<bool>& stop) {
+    std::unique_lock<std::mutex> lock(poolMutex);
+    const unsigned poolSize = resolveThreadCount(configuredThreads);
+    const unsigned threadCount = std::max(1u, std::min(maxThreads, poolSize));
+    std::vector<std::exception_ptr> errors(threadCount);
+    auto guarded = [&](unsigned worker) {
+        if (worker >= threadCount) return; // The pool keeps all configured threads
+        try {
+            job(worker);
+        }
+        catch (...) {
+            errors[worker] = std::current_exception();
+            stop = true;
+        }
+    };
+
+    if (threadCount == 1) {
+        lock.unlock();
+        guarded(0);
+    }
+    else {
+        if (!pool || pool->size() != poolSize) {
+            pool.reset();
+            pool = std::make_unique<ScanThreadPool>(poolSize);
+        }
+        pool->run(guarded);
+        lock.unlock();
+    }
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+/**
+ * @brief Scores blocks taken from a shared counter into a worker's heap until none are left.
+ */
+void scoreBlocks(std::size_t rows, std::atomic<std::size_t>& nextBlock, const std::atomic<bool>& stop, const RowBlockHeapScorer& scorer, TopKHeap& heap) {
+    while (!stop) {
+        const std::size_t begin = nextBlock.fetch_add(1) * SCAN_BLOCK_ROWS;
+        if (begin >= rows) return;
+        scorer(begin, std::min(rows, begin + SCAN_BLOCK_ROWS), heap);
+    }
+}
+
+} // namespace
+
+void TopKHeap::offer(float score, std::size_t row) {
+    if (std::isnan(score) || topK == 0) return;
+    auto worse = [this](const ScoredRow& a, const ScoredRow& b) { return better(a, b); };
+    if (kept.size() < topK) {
+        kept.emplace_back(score, row);
+        std::push_heap(kept.begin(), kept.end(), worse);
+    }
+    else if (better(ScoredRow(score, row), kept.front())) {
+        std::pop_heap(kept.begin(), kept.end(), worse);
+        kept.back() = ScoredRow(score, row);
+        std::push_heap(kept.begin(), kept.end(), worse);
+    }
+}
+
+void TopKHeap::sortAndTrim(std::vector<std::pair<float, std::size_t>>& pairs) const {
+    std::sort(pairs.begin(), pairs.end(), [this](const ScoredRow& a, const ScoredRow& b) { return better(a, b); });
+    if (pairs.size() > topK) pairs.resize(topK);
+}
+
+std::vector<std::pair<float, std::size_t>> scanTopK(std::size_t rows, std::size_t topK, ScanOrder order, const RowBlockScorer& scorer) {
+    return streamTopK(rows, topK, order, [&scorer](std::size_t begin, std::size_t end, TopKHeap& heap) {
+        thread_local std::vector<float> scores(SCAN_BLOCK_ROWS);
+        scorer(begin, end, scores.data());
+        for (std::size_t row = begin; row < end; ++row) {
+            heap.offer(scores[row - begin], row);
+        }
+    });
+}
+
+std::vector<std::pair<float, std::size_t>> streamTopK(std::size_t rows, std::size_t topK, ScanOrder order, const RowBlockHeapScorer& scorer) {
+    if (rows == 0 || topK == 0) return {};
+
+    // Small collections are not worth waking the pool for
+    const std::size_t blocks = (rows + SCAN_BLOCK_ROWS - 1) / SCAN_BLOCK_ROWS;
+    const unsigned maxThreads = blocks <= 2 ? 1u : static_cast<unsigned>(std::min<std::size_t>(blocks, scanThreadCount()));
+
+    std::atomic<std::size_t> nextBlock(0);
+    std::atomic<bool> stop(false);
+    std::vector<TopKHeap> heaps(maxThreads, TopKHeap(topK, order));
+    runOnScanThreads(maxThreads, [&](unsigned worker) {
+        scoreBlocks(rows, nextBlock, stop, scorer, heaps[worker]);
+    }, stop);
+
+    // Merge the per-thread heaps; (score, row) is a total order, so the merge is deterministic
+    std::vector<ScoredRow> merged;
+    for (const TopKHeap& heap : heaps) merged.insert(merged.end(), heap.rows().begin(), heap.rows().end());
+    heaps[0].sortAndTrim(merged);
+    return merged;
+}
+
+void parallelFor(std::size_t taskCount, const std::function<void(std::size_t task)>& task) {
+    if (taskCount == 0) return;
+
+    std::atomic<std::size_t> nextTask(0);
+    std::atomic<bool> stop(false);
+    runOnScanThreads(static_cast<unsigned>(std::min<std::size_t>(taskCount, scanThreadCount())), [&](unsigned) {
+        while (!stop) {
+            const std::size_t index = nextTask.fetch_add(1);
+            if (index >= taskCount) return;
+            task(index);
+        }
+    }, stop);
+}
+
+void setScanThreadCount(unsigned threadCount) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    configuredThreads = threadCount;
+}
+
+unsigned scanThreadCount() {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return resolveThreadCount(configuredThreads);
+}
@@ -0,0 +1,167 @@
+/*! \file parallel_scan.h
+    \brief Declarations for the multi-core top-K scan over a feature collection.
+    \author Manushi
+    \date October 16, 2026
+
+    Every matcher scores all rows of a collection and keeps the best few. The scan splits the rows
+    into blocks that a pool of worker threads takes in turn; each worker keeps its own bounded
+    heap of the best rows it has seen, and the heaps are merged once all blocks are scored.
+    Results are ordered by score and then by row id, so they do not depend on the thread count
+    or on which worker scored which block. A streaming scan hands the worker's heap to the scorer,
+    so each row can be compared with the current K-th best score while it is being scored.
+*/
+
+#ifndef PARALLEL_SCAN_H
+#define PARALLEL_SCAN_H
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Which end of the score range is best.
+ */
+enum class ScanOrder {
+    Ascending,  ///< Smallest score first, for distances.
+    Descending  ///< Largest score first, for similarities.
+};
+
+/**
+ * @brief Score that leaves a row out of the results, e.g. the query image itself.
+ */
+constexpr float SKIPPED_ROW = std::numeric_limits<float>::quiet_NaN();
+
+/**
+ * @brief Scores rows [begin, end) of a collection, writing the score of row begin + i to scores[i].
+ *
+ * Called concurrently from several threads for disjoint row ranges, so it must not modify shared
+ * state. Rows scored SKIPPED_ROW (or any NaN) are left out.
+ */
+using RowBlockScorer = std::function<void(std::size_t begin, std::size_t end, float* scores)>;
+
+/**
+ * @brief Keeps the best topK (score, row) pairs offered to it.
+ *
+ * Pairs are ranked by score and then by the lower row id. The worst kept pair sits on top of a
+ * heap, so offering a row that does not make the cut costs one comparison.
+ */
+class TopKHeap {
+public:
+    TopKHeap(std::size_t topK, ScanOrder order) : topK(topK), order(order) {}
+
+    /**
+     * @brief True if a ranks before b.
+     */
+    bool better(const std::pair<float, std::size_t>& a, const std::pair<float, std::size_t>& b) const {
+        if (a.first != b.first) return order == ScanOrder::Ascending ? a.first < b.first : a.first > b.first;
+        return a.second < b.second;
+    }
+
+    /**
+     * @brief Offers a row; NaN scores are ignored.
+     */
+    void offer(float score, std::size_t row);
+
+    /**
+     * @brief True once topK pairs are kept, so a new row has to beat worst() to get in.
+     */
+    bool full() const { return kept.size() >= topK; }
+
+    /**
+     * @brief Score a new row has to beat (or tie with a lower row id) to get in: the worst kept
+     * score once full, otherwise +infinity for ascending and -infinity for descending order.
+     */
+    float threshold() const {
+        if (full() && topK > 0) return kept.front().first;
+        return order == ScanOrder::Ascending ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+    }
+
+    /**
+     * @brief The kept pair that ranks last; only valid if something is kept.
+     */
+    const std::pair<float, std::size_t>& worst() const { return kept.front(); }
+
+    /**
+     * @brief Kept pairs in heap order.
+     */
+    const std::vector<std::pair<float, std::size_t>>& rows() const { return kept; }
+
+    /**
+     * @brief Sorts pairs best first and keeps the first topK; used to merge several heaps.
+     */
+    void sortAndTrim(std::vector<std::pair<float, std::size_t>>& pairs) const;
+
+private:
+    std::vector<std::pair<float, std::size_t>> kept;
+    std::size_t topK;
+    ScanOrder order;
+};
+
+/**
+ * @brief Scores rows [begin, end) of a collection and offers them to a worker's heap.
+ *
+ * Called concurrently from several threads for disjoint row ranges, each with its own heap. The
+ * scorer may read heap.threshold() before scoring a row and stop early once the row cannot beat
+ * it; rows that are not offered are left out.
+ */
+using RowBlockHeapScorer = std::function<void(std::size_t begin, std::size_t end, TopKHeap& heap)>;
+
+/**
+ * @brief Scores every row of a collection on the scan thread pool and returns the best ones.
+ *
+ * Ties are broken by the lower row id, so the result is the same for every thread count. Small
+ * collections are scored on the calling thread. Scans from different threads take turns on the
+ * pool; a scorer must not start a scan itself.
+ *
+ * @param rows Number of rows in the collection.
+ * @param topK Maximum number of results.
+ * @param order Whether small or large scores are best.
+ * @param scorer Scores a block of rows.
+ * @return Up to topK (score, row) pairs, best first.
+ * @throws Anything the scorer throws, rethrown on the calling thread once all workers stopped.
+ */
+std::vector<std::pair<float, std::size_t>> scanTopK(std::size_t rows, std::size_t topK, ScanOrder order, const RowBlockScorer& scorer);
+
+/**
+ * @brief Like scanTopK, but the scorer offers rows to the worker's heap itself as it scores them.
+ *
+ * The threshold the scorer sees tightens row by row, so kernels such as squaredL2DistanceBounded
+ * can give up on rows that cannot make the cut. Results equal those of scanTopK as long as the
+ * scorer only gives up on rows whose score would be worse than the threshold.
+ *
+ * @param rows Number of rows in the collection.
+ * @param topK Maximum number of results.
+ * @param order Whether small or large scores are best.
+ * @param scorer Scores a block of rows and offers them to the heap.
+ * @return Up to topK (score, row) pairs, best first.
+ * @throws Anything the scorer throws, rethrown on the calling thread once all workers stopped.
+ */
+std::vector<std::pair<float, std::size_t>> streamTopK(std::size_t rows, std::size_t topK, ScanOrder order, const RowBlockHeapScorer& scorer);
+
+/**
+ * @brief Runs task(i) for every i in [0, taskCount) on the scan thread pool and waits for all of them.
+ *
+ * Tasks are handed out in order through a shared counter. Like scanTopK, calls from different
+ * threads take turns on the pool, and a task must not start a scan itself.
+ *
+ * @param taskCount Number of tasks.
+ * @param task Runs one task; called concurrently for different indices.
+ * @throws Anything a task throws, rethrown on the calling thread once all workers stopped.
+ */
+void parallelFor(std::size_t taskCount, const std::function<void(std::size_t task)>& task);
+
+/**
+ * @brief Sets the number of threads used by scans, the calling thread included.
+ *
+ * @param threadCount Number of threads; 0 uses one per hardware thread, 1 scans serially.
+ */
+void setScanThreadCount(unsigned threadCount);
+
+/**
+ * @brief Number of threads used by scans.
+ */
+unsigned scanThreadCount();
+
+#endif // PARALLEL_SCAN_H
@@ -0,0 +1,854 @@
+/*! \file quantized_embeddings.cpp
+    \brief Implements reduced-precision storage and scanning of DNN embeddings.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Vectors are normalized and
+    encoded as fp32, fp16, bf16 or int8 codes with one scale per vector. Dot products run directly
+    on the codes: F16C converts half floats in registers, bf16 is widened with a shift, and int8
+    codes are multiplied with AVX2 (or AVX-512 VNNI, where available) into 32-bit sums. The kernel
+    for each format is picked once at runtime, with a scalar fallback.
+
+    Codes file layout (all integers little endian, every section starts on a 64-byte boundary):
+      - QuantizedHeader
+      - rowCount x paddedDims codes (4, 2 or 1 bytes each)
+      - rowCount x float: int8 scales (int8 only)
+      - rowCount x int32: int8 code sums (int8 only)
+      - rowCount x float: lengths of the rows before they were normalized
+      - (rowCount + 1) x uint64 offsets into the path bytes, followed by the path bytes
+*/
+
+#include "quantized_embeddings.h"
+#include "cpu_features.h"
+#include "csv_loader.h"
+#include "distance_kernels.h"
+#include "feature_index.h"
+#include "mapped_file.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#if CBIR_X86
+#include <immintrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::size_t ROW_PADDING = 64; // Values; one AVX-512 register of int8 codes
+const char QUANTIZED_MAGIC[8] = { 'C', 'B', 'I', 'R', 'Q', 'E', 'M', 'B' };
+constexpr std::uint32_t QUANTIZED_VERSION = 1;
+constexpr std::uint64_t QUANTIZED_ALIGNMENT = 64;
+
+#pragma pack(push, 1)
+/**
+ * @brief Fixed-size header at the start of a codes file.
+ */
+struct QuantizedHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t precision;
+    std::uint32_t dims;
+    std::uint32_t paddedDims;
+    std::uint32_t componentOffset;
+    std::uint32_t reserved;
+    std::uint64_t rowCount;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModified;
+    std::uint64_t codesOffset;
+    std::uint64_t scalesOffset;
+    std::uint64_t codeSumsOffset;
+    std::uint64_t lengthsOffset;
+    std::uint64_t stringTableOffset;
+    std::uint64_t stringTableSize;
+    std::uint64_t fileSize;
+};
+#pragma pack(pop)
+
+using HalfDotKernel = float (*)(const float* query, const std::uint16_t* codes, std::size_t n);
+using ByteDotKernel = std::int32_t (*)(const std::int8_t* query, const std::uint8_t* biased, const std::int8_t* codes, std::int32_t codeSum, std::size_t n);
+
+/**
+ * @brief Converts a float to IEEE half precision, rounding to nearest even.
+ */
+std::uint16_t floatToHalf(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const std::uint32_t sign = (bits >> 16) & 0x8000u;
+    const std::uint32_t exponent = (bits >> 23) & 0xFFu;
+    std::uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFF) { // Inf or NaN
+        return static_cast<std::uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+    }
+    int halfExponent = static_cast<int>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1F) { // Overflow to infinity
+        return static_cast<std::uint16_t>(sign | 0x7C00u);
+    }
+    if (halfExponent <= 0) { // Subnormal or zero
+        if (halfExponent < -10) return static_cast<std::uint16_t>(sign);
+        mantissa |= 0x800000u;
+        const int shift = 14 - halfExponent;
+        std::uint32_t half = mantissa >> shift;
+        const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const std::uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) ++half;
+        return static_cast<std::uint16_t>(sign | half);
+    }
+    std::uint32_t half = (static_cast<std::uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    const std::uint32_t remainder = mantissa & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) ++half; // May carry into the exponent, which is correct
+    return static_cast<std::uint16_t>(sign | half);
+}
+
+/**
+ * @brief Converts an IEEE half precision value to float.
+ */
+float halfToFloat(std::uint16_t half) {
+    const std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000u) << 16;
+    std::uint32_t exponent = (half >> 10) & 0x1Fu;
+    std::uint32_t mantissa = half & 0x3FFu;
+    std::uint32_t bits;
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        }
+        else { // Subnormal: renormalize
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400u) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    }
+    else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Converts a float to bfloat16, rounding to nearest even.
+ */
+std::uint16_t floatToBFloat16(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u) { // Keep NaN a NaN
+        return static_cast<std::uint16_t>((bits >> 16) | 0x40u);
+    }
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return static_cast<std::uint16_t>(bits >> 16);
+}
+
+/**
+ * @brief Converts a bfloat16 value to float.
+ */
+float bfloat16ToFloat(std::uint16_t value) {
+    const std::uint32_t bits = static_cast<std::uint32_t>(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// ----- Scalar kernels -----
+
+float dotFloat16Scalar(const float* query, const std::uint16_t* codes, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) sum += query[i] * halfToFloat(codes[i]);
+    return sum;
+}
+
+float dotBFloat16Scalar(const float* query, const std::uint16_t* codes, std::size_t n) {
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i) sum += query[i] * bfloat16ToFloat(codes[i]);
+    return sum;
+}
+
+std::int32_t dotInt8Scalar(const std::int8_t* query, const std::uint8_t*, const std::int8_t* codes, std::int32_t, std::size_t n) {
+    std::int32_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i) sum += static_cast<std::int32_t>(query[i]) * codes[i];
+    return sum;
+}
+
+#if CBIR_X86
+// ----- SIMD kernels; n is always a multiple of ROW_PADDING -----
+
+CBIR_TARGET("avx")
+float horizontalSum(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+
+CBIR_TARGET("avx,f16c,fma")
+float dotFloat16F16c(const float* query, const std::uint16_t* codes, std::size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (std::size_t i = 0; i < n; i += 16) {
+        __m256 c0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)));
+        __m256 c1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i + 8)));
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i), c0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i + 8), c1, acc1);
+    }
+    return horizontalSum(_mm256_add_ps(acc0, acc1));
+}
+
+CBIR_TARGET("avx2,fma")
+float dotBFloat16Avx2(const float* query, const std::uint16_t* codes, std::size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (std::size_t i = 0; i < n; i += 16) {
+        __m256i wide = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i));
+        // bf16 is the upper half of a float: zero extend each half to 32 bits and shift it up
+        __m256 c0 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(wide)), 16));
+        __m256 c1 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(wide, 1)), 16));
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i), c0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i + 8), c1, acc1);
+    }
+    return horizontalSum(_mm256_add_ps(acc0, acc1));
+}
+
+CBIR_TARGET("avx2")
+std::int32_t dotInt8Avx2(const std::int8_t* query, const std::uint8_t*, const std::int8_t* codes, std::int32_t, std::size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < n; i += 16) {
+        __m256i q = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(query + i)));
+        __m256i c = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(q, c));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+CBIR_TARGET("avx512f,avx512bw,avx512vnni")
+std::int32_t dotInt8Vnni(const std::int8_t*, const std::uint8_t* biased, const std::int8_t* codes, std::int32_t codeSum, std::size_t n) {
+    // VPDPBUSD multiplies unsigned by signed bytes, so the query is stored biased by +128;
+    // sum((q + 128) * c) = sum(q * c) + 128 * sum(c), and sum(c) is kept per row
+    __m512i acc = _mm512_setzero_si512();
+    for (std::size_t i = 0; i < n; i += 64) {
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(biased + i), _mm512_loadu_si512(codes + i));
+    }
+    alignas(64) std::int32_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    std::int32_t sum = 0;
+    for (std::int32_t lane : lanes) sum += lane;
+    return sum - 128 * codeSum;
+}
+#endif
+
+/**
+ * @brief Dot-product kernels chosen for the running machine; fp32 uses the shared distance kernels.
+ */
+struct Kernels {
+    HalfDotKernel float16 = dotFloat16Scalar;
+    HalfDotKernel bfloat16 = dotBFloat16Scalar;
+    ByteDotKernel int8 = dotInt8Scalar;
+    const char* float16Name = "scalar";
+    const char* bfloat16Name = "scalar";
+    const char* int8Name = "scalar";
+};
+
+const Kernels& kernels() {
+    static const Kernels selected = []() {
+        Kernels k;
+#if CBIR_X86
+        const CpuFeatures& cpu = cpuFeatures();
+        if (cpu.avx2 && cpu.fma) {
+            k.bfloat16 = dotBFloat16Avx2;
+            k.bfloat16Name = "avx2";
+        }
+        if (cpu.f16c && cpu.fma) {
+            k.float16 = dotFloat16F16c;
+            k.float16Name = "f16c";
+        }
+        if (cpu.avx512vnni) {
+            k.int8 = dotInt8Vnni;
+            k.int8Name = "avx512-vnni";
+        }
+        else if (cpu.avx2) {
+            k.int8 = dotInt8Avx2;
+            k.int8Name = "avx2";
+        }
+#endif
+        return k;
+    }();
+    return selected;
+}
+
+/**
+ * @brief Copies a vector into a zero padded buffer and scales it to unit length; returns its length.
+ */
+float normalizeInto(const float* vector, std::size_t dims, std::vector<float>& out, std::size_t paddedDims) {
+    out.assign(paddedDims, 0.0f);
+    double sumSquares = 0.0;
+    for (std::size_t i = 0; i < dims; ++i) sumSquares += static_cast<double>(vector[i]) * vector[i];
+    const float inverse = sumSquares > 0.0 ? static_cast<float>(1.0 / std::sqrt(sumSquares)) : 0.0f;
+    for (std::size_t i = 0; i < dims; ++i) out[i] = vector[i] * inverse;
+    return static_cast<float>(std::sqrt(sumSquares));
+}
+
+/**
+ * @brief Encodes a normalized vector as int8 codes with one scale; returns the scale.
+ */
+float encodeInt8(const std::vector<float>& values, std::int8_t* codes) {
+    float maxAbs = 0.0f;
+    for (float value : values) maxAbs = std::max(maxAbs, std::fabs(value));
+    const float scale = maxAbs / 127.0f;
+    const float inverse = scale > 0.0f ? 1.0f / scale : 0.0f;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        const long code = std::lround(values[i] * inverse);
+        codes[i] = static_cast<std::int8_t>(std::clamp(code, -127L, 127L));
+    }
+    return scale;
+}
+
+std::uint64_t alignOffset(std::uint64_t offset) {
+    return (offset + QUANTIZED_ALIGNMENT - 1) / QUANTIZED_ALIGNMENT * QUANTIZED_ALIGNMENT;
+}
+
+/**
+ * @brief Size and modification time of a file, as recorded in the codes file header.
+ */
+void sourceFileState(const std::string& filePath, std::uint64_t& size, std::int64_t& modified) {
+    size = static_cast<std::uint64_t>(fs::file_size(filePath));
+    modified = static_cast<std::int64_t>(fs::last_write_time(filePath).time_since_epoch().count());
+}
+
+/**
+ * @brief Maps a codes file and checks every section against the file size.
+ *
+ * @param codesFilePath Path to the codes file.
+ * @param featureFilePath Path to the feature file the codes were encoded from.
+ * @param precision Expected storage precision.
+ * @return The set, or nullptr if the codes were encoded from an older version of the feature file.
+ * @throws std::runtime_error If the file is not a valid codes file.
+ */
+std::shared_ptr<QuantizedEmbeddingSet> loadCodesFile(const std::string& codesFilePath, const std::string& featureFilePath, EmbeddingPrecision precision) {
+    auto mapping = std::make_shared<const MappedFile>(codesFilePath);
+    const unsigned char* data = mapping->data();
+    const std::uint64_t fileSize = mapping->size();
+    QuantizedHeader header;
+    if (fileSize < sizeof(header)) {
+        throw std::runtime_error("Codes file is truncated: " + codesFilePath);
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    // Counts are bounded by the file size first, so the offset arithmetic below cannot overflow
+    const std::uint64_t rows = header.rowCount;
+    const std::uint64_t bytesPerValue = QuantizedEmbeddings::bytesPerValue(precision);
+    const bool int8 = precision == EmbeddingPrecision::Int8;
+    const bool valid = std::memcmp(header.magic, QUANTIZED_MAGIC, sizeof(header.magic)) == 0
+        && header.version == QUANTIZED_VERSION
+        && header.precision == static_cast<std::uint32_t>(precision)
+        && header.fileSize == fileSize
+        && header.dims > 0 && header.paddedDims == (header.dims + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING
+        && rows <= fileSize / sizeof(float) && header.paddedDims <= fileSize / bytesPerValue / std::max<std::uint64_t>(rows, 1)
+        && header.stringTableSize <= fileSize
+        && header.stringTableSize >= (rows + 1) * sizeof(std::uint64_t)
+        && header.codesOffset % QUANTIZED_ALIGNMENT == 0 && header.codesOffset >= sizeof(header)
+        && header.scalesOffset >= header.codesOffset + rows * header.paddedDims * bytesPerValue
+        && header.codeSumsOffset >= header.scalesOffset + (int8 ? rows * sizeof(float) : 0)
+        && header.lengthsOffset >= header.codeSumsOffset + (int8 ? rows * sizeof(std::int32_t) : 0)
+        && header.stringTableOffset >= header.lengthsOffset + rows * sizeof(float)
+        && header.stringTableOffset <= fileSize - header.stringTableSize
+        && header.scalesOffset % sizeof(float) == 0 && header.codeSumsOffset % sizeof(std::int32_t) == 0
+        && header.lengthsOffset % sizeof(float) == 0 && header.stringTableOffset % sizeof(std::uint64_t) == 0;
+    if (!valid) {
+        throw std::runtime_error("Not a valid codes file (or unsupported version): " + codesFilePath);
+    }
+
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    sourceFileState(featureFilePath, sourceSize, sourceModified);
+    if (header.sourceSize != sourceSize || header.sourceModified != sourceModified) {
+        return nullptr;
+    }
+
+    const std::uint64_t* pathOffsets = reinterpret_cast<const std::uint64_t*>(data + header.stringTableOffset);
+    const char* pathBytes = reinterpret_cast<const char*>(pathOffsets + rows + 1);
+    const std::uint64_t pathBytesSize = header.stringTableSize - (rows + 1) * sizeof(std::uint64_t);
+    if (pathOffsets[0] != 0 || pathOffsets[rows] > pathBytesSize) {
+        throw std::runtime_error("Codes file path table is corrupt: " + codesFilePath);
+    }
+
+    QuantizedEmbeddings::Sections sections;
+    sections.codes = data + header.codesOffset;
+    sections.scales = int8 ? reinterpret_cast<const float*>(data + header.scalesOffset) : nullptr;
+    sections.codeSums = int8 ? reinterpret_cast<const std::int32_t*>(data + header.codeSumsOffset) : nullptr;
+    sections.lengths = reinterpret_cast<const float*>(data + header.lengthsOffset);
+    auto set = std::make_shared<QuantizedEmbeddingSet>(
+        QuantizedEmbeddings(precision, header.dims, static_cast<std::size_t>(rows), sections, mapping));
+    set->componentOffset = header.componentOffset;
+    set->imagePaths.resize(static_cast<std::size_t>(rows));
+    for (std::size_t row = 0; row < rows; ++row) {
+        if (pathOffsets[row + 1] < pathOffsets[row]) {
+            throw std::runtime_error("Codes file path table is corrupt: " + codesFilePath);
+        }
+        set->imagePaths[row].assign(pathBytes + pathOffsets[row], static_cast<std::size_t>(pathOffsets[row + 1] - pathOffsets[row]));
+    }
+    return set;
+}
+
+/**
+ * @brief Cache entry: an open set and the state of the codes file it was mapped from.
+ */
+struct CachedSet {
+    std::uintmax_t fileSize = 0;
+    fs::file_time_type modifiedTime;
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    QuantizedEmbeddingHandle set;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedSet> cachedSets;
+
+} // namespace
+
+const char* embeddingPrecisionName(EmbeddingPrecision precision) {
+    switch (precision) {
+    case EmbeddingPrecision::Float16: return "fp16";
+    case EmbeddingPrecision::BFloat16: return "bf16";
+    case EmbeddingPrecision::Int8: return "int8";
+    default: return "fp32";
+    }
+}
+
+EmbeddingPrecision parseEmbeddingPrecision(const std::string& name) {
+    for (EmbeddingPrecision precision : { EmbeddingPrecision::Float32, EmbeddingPrecision::Float16,
+        EmbeddingPrecision::BFloat16, EmbeddingPrecision::Int8 }) {
+        if (name == embeddingPrecisionName(precision)) return precision;
+    }
+    throw std::invalid_argument("Unknown embedding precision: " + name);
+}
+
+QuantizedEmbeddings::QuantizedEmbeddings(EmbeddingPrecision precision, std::size_t dims)
+    : storagePrecision(precision), vectorDims(dims),
+      paddedDims((dims + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING) {
+}
+
+QuantizedEmbeddings::QuantizedEmbeddings(EmbeddingPrecision precision, std::size_t dims, std::size_t rows, const Sections& sections, std::shared_ptr<const MappedFile> file)
+    : storagePrecision(precision), vectorDims(dims),
+      paddedDims((dims + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING), rowCount(rows),
+      codeRows(sections.codes), rowScales(sections.scales), rowCodeSums(sections.codeSums), rowLengths(sections.lengths),
+      mapping(std::move(file)) {
+}
+
+std::size_t QuantizedEmbeddings::bytesPerValue(EmbeddingPrecision precision) {
+    switch (precision) {
+    case EmbeddingPrecision::Float16:
+    case EmbeddingPrecision::BFloat16:
+        return sizeof(std::uint16_t);
+    case EmbeddingPrecision::Int8:
+        return sizeof(std::int8_t);
+    default:
+        return sizeof(float);
+    }
+}
+
+void QuantizedEmbeddings::reserve(std::size_t rows) {
+    switch (storagePrecision) {
+    case EmbeddingPrecision::Float32:
+        floats.reserve(rows * paddedDims);
+        break;
+    case EmbeddingPrecision::Float16:
+    case EmbeddingPrecision::BFloat16:
+        halves.reserve(rows * paddedDims);
+        break;
+    case EmbeddingPrecision::Int8:
+        bytes.reserve(rows * paddedDims);
+        scales.reserve(rows);
+        codeSums.reserve(rows);
+        break;
+    }
+    lengths.reserve(rows);
+}
+
+void QuantizedEmbeddings::add(const float* vector) {
+    std::vector<float> normalized;
+    lengths.push_back(normalizeInto(vector, vectorDims, normalized, paddedDims));
+
+    switch (storagePrecision) {
+    case EmbeddingPrecision::Float32:
+        floats.insert(floats.end(), normalized.begin(), normalized.end());
+        break;
+    case EmbeddingPrecision::Float16:
+        for (float value : normalized) halves.push_back(floatToHalf(value));
+        break;
+    case EmbeddingPrecision::BFloat16:
+        for (float value : normalized) halves.push_back(floatToBFloat16(value));
+        break;
+    case EmbeddingPrecision::Int8: {
+        const std::size_t start = bytes.size();
+        bytes.resize(start + paddedDims);
+        scales.push_back(encodeInt8(normalized, bytes.data() + start));
+        std::int32_t sum = 0;
+        for (std::size_t i = 0; i < paddedDims; ++i) sum += bytes[start + i];
+        codeSums.push_back(sum);
+        break;
+    }
+    }
+    ++rowCount;
+    bindOwnedRows();
+}
+
+void QuantizedEmbeddings::bindOwnedRows() {
+    switch (storagePrecision) {
+    case EmbeddingPrecision::Float16:
+    case EmbeddingPrecision::BFloat16:
+        codeRows = halves.data();
+        break;
+    case EmbeddingPrecision::Int8:
+        codeRows = bytes.data();
+        break;
+    default:
+        codeRows = floats.data();
+        break;
+    }
+    rowScales = scales.empty() ? nullptr : scales.data();
+    rowCodeSums = codeSums.empty() ? nullptr : codeSums.data();
+    rowLengths = lengths.data();
+}
+
+QuantizedEmbeddings::Query QuantizedEmbeddings::prepareQuery(const float* vector) const {
+    Query query;
+    normalizeInto(vector, vectorDims, query.values, paddedDims);
+    if (storagePrecision == EmbeddingPrecision::Int8) {
+        query.codes.resize(paddedDims);
+        query.scale = encodeInt8(query.values, query.codes.data());
+        query.biased.resize(paddedDims);
+        for (std::size_t i = 0; i < paddedDims; ++i) {
+            query.biased[i] = static_cast<std::uint8_t>(query.codes[i] + 128);
+        }
+    }
+    return query;
+}
+
+std::vector<float> QuantizedEmbeddings::decode(std::size_t row) const {
+    std::vector<float> values(vectorDims);
+    const std::size_t start = row * paddedDims;
+    const std::uint16_t* halfRows = static_cast<const std::uint16_t*>(codeRows);
+    const std::int8_t* byteRows = static_cast<const std::int8_t*>(codeRows);
+    const float* floatRows = static_cast<const float*>(codeRows);
+    for (std::size_t i = 0; i < vectorDims; ++i) {
+        switch (storagePrecision) {
+        case EmbeddingPrecision::Float16: values[i] = halfToFloat(halfRows[start + i]); break;
+        case EmbeddingPrecision::BFloat16: values[i] = bfloat16ToFloat(halfRows[start + i]); break;
+        case EmbeddingPrecision::Int8: values[i] = byteRows[start + i] * rowScales[row]; break;
+        default: values[i] = floatRows[start + i]; break;
+        }
+    }
+    return values;
+}
+
+float QuantizedEmbeddings::similarity(const Query& query, std::size_t row) const {
+    const Kernels& k = kernels();
+    const std::size_t start = row * paddedDims;
+    switch (storagePrecision) {
+    case EmbeddingPrecision::Float16:
+        return k.float16(query.values.data(), static_cast<const std::uint16_t*>(codeRows) + start, paddedDims);
+    case EmbeddingPrecision::BFloat16:
+        return k.bfloat16(query.values.data(), static_cast<const std::uint16_t*>(codeRows) + start, paddedDims);
+    case EmbeddingPrecision::Int8: {
+        const std::int32_t dot = k.int8(query.codes.data(), query.biased.data(), static_cast<const std::int8_t*>(codeRows) + start, rowCodeSums[row], paddedDims);
+        return static_cast<float>(dot) * query.scale * rowScales[row];
+    }
+    default:
+        return dotProduct(query.values.data(), static_cast<const float*>(codeRows) + start, paddedDims);
+    }
+}
+
+void QuantizedEmbeddings::similarities(const Query& query, float* out) const {
+    for (std::size_t row = 0; row < rowCount; ++row) {
+        out[row] = similarity(query, row);
+    }
+}
+
+std::size_t QuantizedEmbeddings::memoryBytes() const {
+    const std::size_t perRow = paddedDims * bytesPerValue(storagePrecision) + sizeof(float)
+        + (storagePrecision == EmbeddingPrecision::Int8 ? sizeof(float) + sizeof(std::int32_t) : 0);
+    return rowCount * perRow;
+}
+
+const char* QuantizedEmbeddings::kernelName() const {
+    const Kernels& k = kernels();
+    switch (storagePrecision) {
+    case EmbeddingPrecision::Float16: return k.float16Name;
+    case EmbeddingPrecision::BFloat16: return k.bfloat16Name;
+    case EmbeddingPrecision::Int8: return k.int8Name;
+    default: return distanceKernelName();
+    }
+}
+
+std::vector<float> QuantizedEmbeddingSet::exactSimilarities(const float* query, const std::vector<std::size_t>& rows) const {
+    const std::size_t dims = embeddings.dims();
+    double queryNorm = 0.0;
+    for (std::size_t i = 0; i < dims; ++i) queryNorm += static_cast<double>(query[i]) * query[i];
+
+    // Rows are read in place from the store mapping or the cached fp32 index
+    FeatureIndexHandle index;
+    if (!store) index = openFeatureIndex(filePath);
+
+    std::vector<float> result;
+    result.reserve(rows.size());
+    for (std::size_t row : rows) {
+        const float* values = store ? (row < store->rows() ? store->row(row) + componentOffset : nullptr)
+            : (row < index->size() && componentOffset + dims <= index->features.dims()) ? index->features.row(row) + componentOffset : nullptr;
+        double dot = 0.0, rowNorm = 0.0;
+        for (std::size_t i = 0; values && i < dims; ++i) {
+            dot += static_cast<double>(query[i]) * values[i];
+            rowNorm += static_cast<double>(values[i]) * values[i];
+        }
+        const double denominator = std::sqrt(queryNorm * rowNorm);
+        result.push_back(denominator > 0.0 ? static_cast<float>(dot / denominator) : 0.0f);
+    }
+    return result;
+}
+
+std::vector<float> QuantizedEmbeddingSet::exactRow(std::size_t row) const {
+    const std::size_t dims = embeddings.dims();
+    if (store) {
+        if (row >= store->rows()) {
+            throw std::runtime_error("Feature file has fewer rows than its codes: " + filePath);
+        }
+        const float* values = store->row(row) + componentOffset;
+        return std::vector<float>(values, values + dims);
+    }
+
+    FeatureIndexHandle index = openFeatureIndex(filePath);
+    std::vector<float> values(dims, 0.0f);
+    if (row < index->size()) {
+        const float* features = index->features.row(row);
+        for (std::size_t i = 0; i < dims && componentOffset + i < index->features.dims(); ++i) {
+            values[i] = features[componentOffset + i];
+        }
+    }
+    return values;
+}
+
+std::string quantizedEmbeddingsPath(const std::string& featureFilePath, const std::string& component, EmbeddingPrecision precision) {
+    return featureFilePath + "." + component + "." + embeddingPrecisionName(precision);
+}
+
+void buildQuantizedEmbeddings(const std::string& featureFilePath, EmbeddingPrecision precision, const std::string& component,
+    FeatureType layoutType, const std::string& codesFilePath) {
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    sourceFileState(featureFilePath, sourceSize, sourceModified);
+
+    // A store is read through its mapping; a CSV file is parsed once, for the encoding only
+    std::unique_ptr<const FeatureStore> store;
+    FeatureMatrix matrix;
+    std::size_t rowDims = 0;
+    std::vector<FeatureComponent> layout;
+    if (FeatureStore::isFeatureStoreFile(featureFilePath)) {
+        store = std::make_unique<const FeatureStore>(featureFilePath);
+        rowDims = store->dims();
+        layout = store->info().components;
+    }
+    else {
+        if (loadFeatureCsvParallel(featureFilePath, matrix) != 0) {
+            throw std::runtime_error("Unable to read feature file: " + featureFilePath);
+        }
+        rowDims = matrix.dims();
+        layout = defaultFeatureComponents(layoutType, static_cast<std::uint32_t>(rowDims), 0, 0);
+    }
+    const std::size_t rows = store ? store->rows() : matrix.rows();
+
+    FeatureComponent slice{ "features", 0, static_cast<std::uint32_t>(rowDims) };
+    bool found = component == "features";
+    for (const FeatureComponent& candidate : layout) {
+        if (candidate.name == component) {
+            slice = candidate;
+            found = true;
+        }
+    }
+    if (!found || slice.dims == 0) {
+        throw std::runtime_error("Feature file has no component '" + component + "': " + featureFilePath);
+    }
+
+    QuantizedEmbeddings embeddings(precision, slice.dims);
+    embeddings.reserve(rows);
+    std::vector<std::string> paths(rows);
+    std::uint64_t pathBytes = 0;
+    for (std::size_t i = 0; i < rows; ++i) {
+        embeddings.add((store ? store->row(i) : matrix.row(i)) + slice.offset);
+        paths[i] = store ? store->path(i) : std::move(matrix.path(i));
+        pathBytes += paths[i].size();
+    }
+
+    const bool int8 = precision == EmbeddingPrecision::Int8;
+    const QuantizedEmbeddings::Sections sections = embeddings.sections();
+    QuantizedHeader header = {};
+    std::memcpy(header.magic, QUANTIZED_MAGIC, sizeof(header.magic));
+    header.version = QUANTIZED_VERSION;
+    header.precision = static_cast<std::uint32_t>(precision);
+    header.dims = slice.dims;
+    header.paddedDims = static_cast<std::uint32_t>(embeddings.paddedSize());
+    header.componentOffset = slice.offset;
+    header.rowCount = rows;
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+    header.codesOffset = alignOffset(sizeof(QuantizedHeader));
+    header.scalesOffset = alignOffset(header.codesOffset + rows * embeddings.paddedSize() * QuantizedEmbeddings::bytesPerValue(precision));
+    header.codeSumsOffset = alignOffset(header.scalesOffset + (int8 ? rows * sizeof(float) : 0));
+    header.lengthsOffset = alignOffset(header.codeSumsOffset + (int8 ? rows * sizeof(std::int32_t) : 0));
+    header.stringTableOffset = alignOffset(header.lengthsOffset + rows * sizeof(float));
+    header.stringTableSize = (rows + 1) * sizeof(std::uint64_t) + pathBytes;
+    header.fileSize = header.stringTableOffset + header.stringTableSize;
+
+    // Written under a temporary name so an interrupted build never leaves a half-written file
+    const std::string partialPath = codesFilePath + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to open codes file for writing: " + partialPath);
+        }
+        std::uint64_t written = 0;
+        auto put = [&](const void* data, std::uint64_t bytes) {
+            if (bytes > 0) out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            written += bytes;
+        };
+        auto padTo = [&](std::uint64_t offset) {
+            static const char zeros[QUANTIZED_ALIGNMENT] = {};
+            put(zeros, offset - written);
+        };
+
+        put(&header, sizeof(header));
+        padTo(header.codesOffset);
+        put(sections.codes, rows * embeddings.paddedSize() * QuantizedEmbeddings::bytesPerValue(precision));
+        padTo(header.scalesOffset);
+        if (int8) put(sections.scales, rows * sizeof(float));
+        padTo(header.codeSumsOffset);
+        if (int8) put(sections.codeSums, rows * sizeof(std::int32_t));
+        padTo(header.lengthsOffset);
+        put(sections.lengths, rows * sizeof(float));
+        padTo(header.stringTableOffset);
+        std::uint64_t offset = 0;
+        for (const std::string& imagePath : paths) {
+            put(&offset, sizeof(offset));
+            offset += imagePath.size();
+        }
+        put(&offset, sizeof(offset));
+        for (const std::string& imagePath : paths) put(imagePath.data(), imagePath.size());
+
+        if (!out.good()) {
+            throw std::runtime_error("Error writing codes file: " + partialPath);
+        }
+    }
+    std::error_code error;
+    fs::rename(partialPath, codesFilePath, error);
+    if (error) {
+        fs::remove(partialPath, error);
+        throw std::runtime_error("Unable to replace codes file: " + codesFilePath);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Encoded " << rows << " " << embeddingPrecisionName(precision) << " '" << component << "' embeddings ("
+        << embeddings.memoryBytes() / (1024 * 1024) << " MB) in " << seconds << " s: " << codesFilePath << std::endl;
+}
+
+QuantizedEmbeddingHandle openQuantizedEmbeddings(const std::string& filePath, EmbeddingPrecision precision, const std::string& component, FeatureType layoutType) {
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    try {
+        sourceFileState(filePath, sourceSize, sourceModified);
+    }
+    catch (const fs::filesystem_error&) {
+        throw std::runtime_error("Unable to open feature file: " + filePath);
+    }
+    const std::string codesFilePath = quantizedEmbeddingsPath(filePath, component, precision);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(codesFilePath, error);
+    const fs::file_time_type modifiedTime = fs::last_write_time(codesFilePath, error);
+    auto cached = cachedSets.find(codesFilePath);
+    if (!error && cached != cachedSets.end() && cached->second.fileSize == fileSize && cached->second.modifiedTime == modifiedTime
+        && cached->second.sourceSize == sourceSize && cached->second.sourceModified == sourceModified) {
+        return cached->second.set;
+    }
+
+    // Drop the cached mapping first, so the file can be replaced if it has to be rewritten
+    cachedSets.erase(codesFilePath);
+    std::shared_ptr<QuantizedEmbeddingSet> set;
+    if (!error) {
+        try {
+            set = loadCodesFile(codesFilePath, filePath, precision);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Re-encoding embeddings: " << e.what() << std::endl;
+        }
+    }
+    if (!set) {
+        buildQuantizedEmbeddings(filePath, precision, component, layoutType, codesFilePath);
+        set = loadCodesFile(codesFilePath, filePath, precision);
+        if (!set) {
+            throw std::runtime_error("Feature file changed while its embeddings were encoded: " + filePath);
+        }
+    }
+
+    // Rescoring reads the exact rows in place from a store's mapping
+    set->filePath = filePath;
+    set->component = component;
+    if (FeatureStore::isFeatureStoreFile(filePath)) {
+        set->store = std::make_shared<const FeatureStore>(filePath);
+    }
+
+    CachedSet entry;
+    entry.fileSize = fs::file_size(codesFilePath);
+    entry.modifiedTime = fs::last_write_time(codesFilePath);
+    entry.sourceSize = sourceSize;
+    entry.sourceModified = sourceModified;
+    entry.set = set;
+    cachedSets[codesFilePath] = entry;
+    return set;
+}
+
+std::vector<std::pair<float, std::size_t>> searchQuantizedEmbeddings(const QuantizedEmbeddingSet& set, const float* query, std::size_t topK, const EmbeddingSearchOptions& options) {
+    const QuantizedEmbeddings& embeddings = set.embeddings;
+    const QuantizedEmbeddings::Query prepared = embeddings.prepareQuery(query);
+
+    // Most similar first; ties go to the lower row so results are deterministic
+    const std::size_t candidates = std::max(topK, options.rescoreCandidates);
+    std::vector<std::pair<float, std::size_t>> results = scanTopK(embeddings.size(), candidates, ScanOrder::Descending,
+        [&](std::size_t begin, std::size_t end, float* scores) {
+            for (std::size_t row = begin; row < end; ++row) scores[row - begin] = embeddings.similarity(prepared, row);
+        });
+
+    if (options.rescoreCandidates > 0 && embeddings.precision() != EmbeddingPrecision::Float32) {
+        std::vector<std::size_t> rows(results.size());
+        for (std::size_t i = 0; i < rows.size(); ++i) rows[i] = results[i].second;
+        std::vector<float> exact = set.exactSimilarities(query, rows);
+        for (std::size_t i = 0; i < rows.size(); ++i) results[i].first = exact[i];
+        std::sort(results.begin(), results.end(), [](const std::pair<float, std::size_t>& a, const std::pair<float, std::size_t>& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+    }
+
+    if (results.size() > topK) results.resize(topK);
+    return results;
+}
+
+void clearQuantizedEmbeddingCache() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cachedSets.clear();
+}
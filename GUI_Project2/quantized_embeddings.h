@@ -0,0 +1,302 @@
+/*! \file quantized_embeddings.h
+    \brief Declarations for reduced-precision storage and scanning of DNN embeddings.
+    \author Manushi
+    \date October 16, 2026
+
+    DNN embeddings (the deep embedding files and the "dnn" slice of the custom design vectors)
+    are compared by cosine similarity. Stored as 4-byte floats they dominate memory use and scan
+    time, so they can instead be kept as fp16, bf16 or per-vector scaled int8 codes and scanned
+    with SIMD dot-product kernels on the codes directly. An optional fp32 rescore of the best
+    candidates restores the exact ranking at the top of the result list.
+
+    The codes of a feature file are saved next to it as <featureFile>.<component>.<precision>
+    (for example "embeddings.cbfs.features.int8") and memory-mapped when they are opened, so a
+    scan neither re-encodes the fp32 rows nor holds them in memory.
+*/
+
+#ifndef QUANTIZED_EMBEDDINGS_H
+#define QUANTIZED_EMBEDDINGS_H
+
+#include "feature_store.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class MappedFile;
+
+/**
+ * @brief Element format used to store embeddings.
+ */
+enum class EmbeddingPrecision {
+    Float32,  // 4 bytes per value, exact
+    Float16,  // 2 bytes per value, IEEE half precision
+    BFloat16, // 2 bytes per value, upper half of a float
+    Int8      // 1 byte per value plus one float scale per vector
+};
+
+/**
+ * @brief Options for embedding searches.
+ */
+struct EmbeddingSearchOptions {
+    EmbeddingPrecision precision = EmbeddingPrecision::Float32;
+    std::size_t rescoreCandidates = 0; // Best candidates rescored with fp32 values (0 disables rescoring)
+    std::size_t hnswEfSearch = 0;      // Candidate list size of an HNSW search (0 scans every embedding exactly)
+    std::uint32_t hnswM = 0;           // Link count the HNSW index must be built with; 0 accepts the index as built
+    std::uint32_t hnswEfConstruction = 0; // Construction candidate list size the HNSW index must have; 0 accepts the index as built
+    std::size_t ivfProbes = 0;         // Inverted lists probed by an IVF-PQ search (0 disables it); rescoreCandidates reranks its best rows
+};
+
+/**
+ * @brief Returns the name of a precision ("fp32", "fp16", "bf16" or "int8").
+ */
+const char* embeddingPrecisionName(EmbeddingPrecision precision);
+
+/**
+ * @brief Parses a precision name as returned by embeddingPrecisionName.
+ *
+ * @throws std::invalid_argument If the name is not recognised.
+ */
+EmbeddingPrecision parseEmbeddingPrecision(const std::string& name);
+
+/**
+ * @brief A collection of unit-length vectors stored at reduced precision.
+ *
+ * Every vector is normalized before it is encoded, so the dot product of two stored vectors is
+ * their cosine similarity. Rows are zero padded to a multiple of 64 values so the kernels never
+ * need a remainder loop.
+ */
+class QuantizedEmbeddings {
+public:
+    /**
+     * @brief A query vector prepared for scanning one collection.
+     */
+    struct Query {
+        std::vector<float> values;        // Normalized, padded query (fp32/fp16/bf16 scans)
+        std::vector<std::int8_t> codes;   // Int8 codes of the query
+        std::vector<std::uint8_t> biased; // Int8 codes + 128, for the VNNI kernel
+        float scale = 0.0f;               // Int8 scale of the query
+    };
+
+    /**
+     * @brief Row data in the layout of a codes file.
+     */
+    struct Sections {
+        const void* codes = nullptr;            // size() x paddedDims() values of the storage precision
+        const float* scales = nullptr;          // Int8 scale of every row (int8 only)
+        const std::int32_t* codeSums = nullptr; // Int8 sum of the codes of every row (int8 only)
+        const float* lengths = nullptr;         // Length of every row before it was normalized
+    };
+
+    /**
+     * @brief Creates an empty collection that rows are added to.
+     */
+    QuantizedEmbeddings(EmbeddingPrecision precision, std::size_t dims);
+
+    /**
+     * @brief Reads the rows of a mapped codes file in place.
+     *
+     * @param precision Storage precision of the codes.
+     * @param dims Number of values per vector.
+     * @param rows Number of rows.
+     * @param sections Row data inside the mapping.
+     * @param file The mapping, kept alive by the collection.
+     */
+    QuantizedEmbeddings(EmbeddingPrecision precision, std::size_t dims, std::size_t rows, const Sections& sections, std::shared_ptr<const MappedFile> file);
+
+    // Rows are read through pointers into the vectors below or the mapping, so copies are not allowed
+    QuantizedEmbeddings(QuantizedEmbeddings&&) = default;
+    QuantizedEmbeddings(const QuantizedEmbeddings&) = delete;
+    QuantizedEmbeddings& operator=(const QuantizedEmbeddings&) = delete;
+
+    /**
+     * @brief Normalizes and encodes one vector of dims() values and appends it.
+     */
+    void add(const float* vector);
+
+    /**
+     * @brief Reserves space for a number of rows.
+     */
+    void reserve(std::size_t rows);
+
+    /**
+     * @brief Normalizes and encodes a query for scanning this collection.
+     */
+    Query prepareQuery(const float* vector) const;
+
+    /**
+     * @brief Decodes one row back to floats (normalized, dims() values).
+     */
+    std::vector<float> decode(std::size_t row) const;
+
+    /**
+     * @brief Approximate cosine similarity between a prepared query and one row.
+     */
+    float similarity(const Query& query, std::size_t row) const;
+
+    /**
+     * @brief Approximate cosine similarity between a prepared query and every row.
+     *
+     * @param query Query prepared by prepareQuery.
+     * @param out Receives size() similarities.
+     */
+    void similarities(const Query& query, float* out) const;
+
+    /**
+     * @brief Length of a row before it was normalized; cosine similarity times the lengths gives the dot product.
+     */
+    float length(std::size_t row) const { return rowLengths[row]; }
+
+    std::size_t size() const { return rowCount; }
+    std::size_t dims() const { return vectorDims; }
+    std::size_t paddedSize() const { return paddedDims; }
+    EmbeddingPrecision precision() const { return storagePrecision; }
+
+    /**
+     * @brief Row data, as written to a codes file.
+     */
+    Sections sections() const { return { codeRows, rowScales, rowCodeSums, rowLengths }; }
+
+    /**
+     * @brief Bytes per value of the codes of a precision.
+     */
+    static std::size_t bytesPerValue(EmbeddingPrecision precision);
+
+    /**
+     * @brief Bytes used by the codes and scales.
+     */
+    std::size_t memoryBytes() const;
+
+    /**
+     * @brief Name of the dot-product kernel chosen for this machine.
+     */
+    const char* kernelName() const;
+
+private:
+    EmbeddingPrecision storagePrecision;
+    std::size_t vectorDims;
+    std::size_t paddedDims;
+    std::size_t rowCount = 0;
+
+    /**
+     * @brief Points the row pointers at the vectors after rows were added.
+     */
+    void bindOwnedRows();
+
+    // Rows are read through these pointers: into the vectors below, or into a mapped codes file
+    const void* codeRows = nullptr;
+    const float* rowScales = nullptr;
+    const std::int32_t* rowCodeSums = nullptr;
+    const float* rowLengths = nullptr;
+    std::shared_ptr<const MappedFile> mapping;
+
+    std::vector<float> floats;          // Float32 rows
+    std::vector<std::uint16_t> halves;  // Float16 / BFloat16 rows
+    std::vector<std::int8_t> bytes;     // Int8 rows
+    std::vector<float> scales;          // Int8 scale of every row
+    std::vector<std::int32_t> codeSums; // Int8 sum of the codes of every row (VNNI bias correction)
+    std::vector<float> lengths;         // Length of every row before it was normalized
+};
+
+/**
+ * @brief Quantized embeddings of one feature file, with the image path of every row.
+ */
+struct QuantizedEmbeddingSet {
+    std::string filePath;
+    std::string component;                // Feature component that was encoded
+    std::size_t componentOffset = 0;      // First float of the component in a feature row
+    std::vector<std::string> imagePaths;  // Image path of every row
+    QuantizedEmbeddings embeddings;
+
+    QuantizedEmbeddingSet(EmbeddingPrecision precision, std::size_t dims) : embeddings(precision, dims) {}
+    explicit QuantizedEmbeddingSet(QuantizedEmbeddings&& codes) : embeddings(std::move(codes)) {}
+
+    std::size_t size() const { return imagePaths.size(); }
+
+    /**
+     * @brief Exact fp32 cosine similarity between a query and some rows, read back from the feature file.
+     *
+     * Binary feature stores are memory mapped, so only the candidate rows are touched; CSV files
+     * are served from the feature index cache (see feature_index.h).
+     *
+     * @param query The query component (dims() values, any length).
+     * @param rows Row indices to score.
+     * @return The similarity of every requested row.
+     * @throws std::runtime_error If the feature file cannot be read.
+     */
+    std::vector<float> exactSimilarities(const float* query, const std::vector<std::size_t>& rows) const;
+
+    /**
+     * @brief Reads the fp32 values of one row's component back from the feature file.
+     *
+     * @throws std::runtime_error If the feature file cannot be read.
+     */
+    std::vector<float> exactRow(std::size_t row) const;
+
+    std::shared_ptr<const FeatureStore> store; // Mapped source file when it is a binary feature store
+};
+
+/**
+ * @brief Shared, read-only handle to cached quantized embeddings.
+ */
+using QuantizedEmbeddingHandle = std::shared_ptr<const QuantizedEmbeddingSet>;
+
+/**
+ * @brief Path of the codes file of one component of a feature file at one precision.
+ */
+std::string quantizedEmbeddingsPath(const std::string& featureFilePath, const std::string& component, EmbeddingPrecision precision);
+
+/**
+ * @brief Encodes one component of every row of a feature file and writes the codes file.
+ *
+ * The component is looked up in the header of a binary feature store, or in the default layout
+ * of layoutType for CSV files (see defaultFeatureComponents).
+ *
+ * @param featureFilePath Path to the CSV feature file or binary feature store.
+ * @param precision Storage precision of the codes.
+ * @param component Name of the component to encode ("features" for the whole row).
+ * @param layoutType Feature type whose default layout is used for CSV files.
+ * @param codesFilePath Path of the codes file to write (see quantizedEmbeddingsPath).
+ * @throws std::runtime_error If the feature file cannot be read or has no such component, or the codes cannot be written.
+ */
+void buildQuantizedEmbeddings(const std::string& featureFilePath, EmbeddingPrecision precision, const std::string& component,
+    FeatureType layoutType, const std::string& codesFilePath);
+
+/**
+ * @brief Returns the quantized embeddings of one component of a feature file, encoding them if needed.
+ *
+ * The codes file next to the feature file is mapped; it is written on first use and rewritten
+ * whenever the feature file's size or modification time differs from the state it was encoded
+ * from. Open sets are cached per file, component and precision.
+ *
+ * @param filePath Path to the CSV feature file or binary feature store.
+ * @param precision Storage precision of the codes.
+ * @param component Name of the component to encode ("features" for the whole row).
+ * @param layoutType Feature type whose default layout is used for CSV files.
+ * @return Handle to the encoded set.
+ * @throws std::runtime_error If the file cannot be read or has no such component.
+ */
+QuantizedEmbeddingHandle openQuantizedEmbeddings(const std::string& filePath, EmbeddingPrecision precision, const std::string& component, FeatureType layoutType);
+
+/**
+ * @brief Finds the rows most similar to a query.
+ *
+ * Every row is scored on its codes; when options.rescoreCandidates is set, the best
+ * max(topK, rescoreCandidates) rows are rescored with their fp32 values before the final ranking.
+ *
+ * @param set Embeddings to search.
+ * @param query Query component (dims() values).
+ * @param topK Number of results.
+ * @param options Search options; only rescoreCandidates is used here.
+ * @return (cosine similarity, row) pairs, most similar first.
+ */
+std::vector<std::pair<float, std::size_t>> searchQuantizedEmbeddings(const QuantizedEmbeddingSet& set, const float* query, std::size_t topK, const EmbeddingSearchOptions& options);
+
+/**
+ * @brief Drops every cached quantized set; outstanding handles stay valid.
+ */
+void clearQuantizedEmbeddingCache();
+
+#endif // QUANTIZED_EMBEDDINGS_H
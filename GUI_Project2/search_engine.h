@@ -0,0 +1,301 @@
+/*! \file search_engine.h
+    \brief Extractor and metric building blocks and the search engine that combines them.
+    \author Manushi
+    \date October 16, 2026
+
+    Every matcher does the same work: decode the query image, extract its feature vector, get the
+    feature file from the index cache, score every row and keep the best N. A Searcher does that
+    work for any pair of an extractor and a metric:
+
+      - An Extractor turns a decoded image into one feature row. It is a copyable type with
+            bool operator()(const cv::Mat& image, std::vector<float>& features) const;
+        that returns false if the image cannot be described.
+
+      - A Metric scores feature rows against one query. It is a type with
+            static constexpr ScanOrder order;          // Whether small or large scores are best
+            Metric(const FeatureIndex& index, const float* query);
+            float operator()(const float* row, std::size_t i, float threshold) const;
+        constructed once per query, so it can prepare per-query state (such as the query's
+        length) and read per-row data the index keeps (such as inverse lengths). The threshold
+        is the current K-th best score of the scan; a metric may stop early and return any score
+        worse than it once the row cannot beat it, or ignore it.
+
+    Both are template parameters, so the per-row loop is compiled for each pair with the metric
+    inlined and no virtual call per row; the rows are scored on the scan thread pool with the
+    SIMD distance kernels and offered straight to the top-K heaps of parallel_scan.h, whose
+    thresholds feed back into the metric. A new
+    feature type only has to supply its extractor (and a metric, if none of the ones here fits).
+*/
+
+#ifndef SEARCH_ENGINE_H
+#define SEARCH_ENGINE_H
+
+#include <opencv2/opencv.hpp>
+#include "distance_kernels.h"
+#include "feature_index.h"
+#include "feature_indexer.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// The matchers that instantiate these templates are compiled with /clr. Without this, the scan
+// loops would be instantiated as MSIL in those files; they are compiled as native code instead.
+#ifdef _MANAGED
+#pragma managed(push, off)
+#endif
+
+/**
+ * @brief Sum of squared differences, smallest first; rows are abandoned once they pass the threshold.
+ */
+class SquaredEuclideanMetric {
+public:
+    static constexpr ScanOrder order = ScanOrder::Ascending;
+
+    SquaredEuclideanMetric(const FeatureIndex& index, const float* query) : query(query), dims(index.features.dims()) {}
+
+    float operator()(const float* row, std::size_t, float threshold) const { return squaredL2DistanceBounded(query, row, dims, threshold); }
+
+private:
+    const float* query;
+    std::size_t dims;
+};
+
+/**
+ * @brief Euclidean distance, smallest first; rows are abandoned once they pass the threshold.
+ */
+class EuclideanMetric {
+public:
+    static constexpr ScanOrder order = ScanOrder::Ascending;
+
+    EuclideanMetric(const FeatureIndex& index, const float* query) : query(query), dims(index.features.dims()) {}
+
+    float operator()(const float* row, std::size_t, float threshold) const { return euclideanDistanceBounded(query, row, dims, threshold); }
+
+private:
+    const float* query;
+    std::size_t dims;
+};
+
+/**
+ * @brief Histogram intersection (sum of bin-wise minima), largest first.
+ */
+class IntersectionMetric {
+public:
+    static constexpr ScanOrder order = ScanOrder::Descending;
+
+    IntersectionMetric(const FeatureIndex& index, const float* query) : query(query), dims(index.features.dims()) {}
+
+    float operator()(const float* row, std::size_t, float) const { return intersectionSum(query, row, dims); }
+
+private:
+    const float* query;
+    std::size_t dims;
+};
+
+/**
+ * @brief Cosine distance (1 - cosine similarity), smallest first.
+ *
+ * Each row costs one dot product: the query is measured once and the rows' inverse lengths come
+ * from the index when its layout is one component spanning the row. A zero length vector has
+ * similarity -1, as in cosineSimilarity.
+ */
+class CosineDistanceMetric {
+public:
+    static constexpr ScanOrder order = ScanOrder::Ascending;
+
+    CosineDistanceMetric(const FeatureIndex& index, const float* query)
+        : query(query), dims(index.features.dims()), queryInverseLength(inverseLength(query, dims)),
+          rowInverseLengths(index.components.size() == 1 && index.components[0].dims == dims ? index.inverseLengths.data() : nullptr) {}
+
+    float operator()(const float* row, std::size_t i, float) const {
+        const float rowInverseLength = rowInverseLengths ? rowInverseLengths[i] : inverseLength(row, dims);
+        if (queryInverseLength == 0.0f || rowInverseLength == 0.0f) return 2.0f;
+        return 1.0f - dotProduct(query, row, dims) * queryInverseLength * rowInverseLength;
+    }
+
+private:
+    const float* query;
+    std::size_t dims;
+    float queryInverseLength;
+    const float* rowInverseLengths;
+};
+
+/**
+ * @brief Which rows a search leaves out.
+ */
+struct SearchOptions {
+    bool skipTargetImage = true;  // Leave out rows whose file name is the query image's
+    bool skipIdentical = false;   // Leave out rows that score exactly 0 (identical to the query under a distance)
+    bool padQuery = false;        // Zero pad (or cut) the query to the row width instead of rejecting a size mismatch
+};
+
+/**
+ * @brief Checks whether a stored image path names a file, ignoring its directory.
+ */
+inline bool hasFileName(const std::string& imagePath, const std::string& fileName) {
+    if (fileName.empty() || imagePath.size() < fileName.size()) return false;
+    const std::size_t start = imagePath.size() - fileName.size();
+    return imagePath.compare(start, std::string::npos, fileName) == 0
+        && (start == 0 || imagePath[start - 1] == '/' || imagePath[start - 1] == '\\');
+}
+
+/**
+ * @brief Scores every row of an index against a query on the scan thread pool and keeps the best.
+ *
+ * Each row is scored against the current K-th best score of its worker, so metrics that support
+ * it give up on rows that cannot make the cut; the results are those of a full scan.
+ *
+ * @param index The loaded feature file.
+ * @param query Query vector of index.features.dims() floats.
+ * @param topK Maximum number of results.
+ * @param skipFileName Rows whose image has this file name are left out (empty leaves none out).
+ * @param skipIdentical Leave out rows that score exactly 0.
+ * @return Up to topK (score, row) pairs, best first; ties go to the lower row.
+ */
+template <class Metric>
+std::vector<std::pair<float, std::size_t>> searchIndex(const FeatureIndex& index, const float* query, std::size_t topK,
+    const std::string& skipFileName = std::string(), bool skipIdentical = false) {
+    static_assert(std::is_constructible<Metric, const FeatureIndex&, const float*>::value,
+        "A Metric is constructed from the index and the query");
+    static_assert(std::is_same<typename std::invoke_result<const Metric&, const float*, std::size_t, float>::type, float>::value,
+        "A Metric scores a row with float operator()(const float* row, std::size_t i, float threshold) const");
+
+    const FeatureMatrix& features = index.features;
+    const Metric metric(index, query);
+    return streamTopK(features.rows(), topK, Metric::order, [&](std::size_t begin, std::size_t end, TopKHeap& heap) {
+        for (std::size_t i = begin; i < end; ++i) {
+            if (hasFileName(features.path(i), skipFileName)) continue;
+            const float score = metric(features.row(i), i, heap.threshold());
+            if (!(skipIdentical && score == 0.0f)) heap.offer(score, i);
+        }
+    });
+}
+
+/**
+ * @brief Best rows of one search, with the index they refer to.
+ */
+struct SearchResults {
+    FeatureIndexHandle index; // Null if the search failed
+    std::vector<std::pair<float, std::size_t>> matches;
+
+    /**
+     * @brief Image paths of the matches, best first.
+     */
+    std::vector<std::string> paths() const {
+        std::vector<std::string> imagePaths;
+        for (const auto& match : matches) {
+            imagePaths.push_back(index->features.path(match.second));
+        }
+        return imagePaths;
+    }
+};
+
+/**
+ * @brief Searches feature files for the images closest to a query image.
+ *
+ * @tparam Extractor Describes an image as one feature row (see the file comment).
+ * @tparam Metric Scores rows against the query (see the file comment).
+ */
+template <class Extractor, class Metric>
+class Searcher {
+public:
+    static_assert(std::is_same<typename std::invoke_result<const Extractor&, const cv::Mat&, std::vector<float>&>::type, bool>::value,
+        "An Extractor describes an image with bool operator()(const cv::Mat& image, std::vector<float>& features) const");
+
+    explicit Searcher(Extractor extractor = Extractor(), SearchOptions options = SearchOptions())
+        : extractor(std::move(extractor)), options(options) {}
+
+    /**
+     * @brief Decodes an image and extracts its feature row.
+     *
+     * @return False, with a message, if the image cannot be read or described.
+     */
+    bool extract(const std::string& imageFile, std::vector<float>& features) const {
+        cv::Mat image = cv::imread(imageFile, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "Could not read the image: " << imageFile << std::endl;
+            return false;
+        }
+        try {
+            if (extractor(image, features)) return true;
+            std::cerr << "Could not extract features from " << imageFile << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Could not extract features from " << imageFile << ": " << e.what() << std::endl;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Scores every row of a loaded feature file against a query row.
+     */
+    std::vector<std::pair<float, std::size_t>> scan(const FeatureIndex& index, const std::vector<float>& query, std::size_t topK,
+        const std::string& targetImageFile) const {
+        const std::string skipFileName = options.skipTargetImage ? std::filesystem::path(targetImageFile).filename().string() : std::string();
+        return searchIndex<Metric>(index, query.data(), topK, skipFileName, options.skipIdentical);
+    }
+
+    /**
+     * @brief Finds the images of a feature file closest to a query image.
+     *
+     * @param targetImageFile The query image.
+     * @param featureFile CSV or feature store file, taken from the index cache.
+     * @param topN Number of matches to return.
+     * @return The matches; results.index is null (after a message) if the image or the file cannot be used.
+     */
+    SearchResults search(const std::string& targetImageFile, const std::string& featureFile, int topN) const {
+        SearchResults results;
+        std::vector<float> query;
+        if (!extract(targetImageFile, query)) return results;
+
+        FeatureIndexHandle index;
+        try {
+            index = openFeatureIndex(featureFile);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error reading feature data: " << e.what() << std::endl;
+            return results;
+        }
+
+        if (options.padQuery) {
+            query.resize(index->features.dims(), 0.0f);
+        }
+        else if (query.size() != index->features.dims()) {
+            std::cerr << "Feature vector size mismatch for " << featureFile << std::endl;
+            return results;
+        }
+
+        results.matches = scan(*index, query, static_cast<std::size_t>(std::max(topN, 0)), targetImageFile);
+        results.index = index;
+        return results;
+    }
+
+    /**
+     * @brief Adapts the extractor to the indexing job: decodes each image file and describes it.
+     */
+    ImageFeatureExtractor imageFileExtractor() const {
+        Extractor imageExtractor = extractor;
+        return [imageExtractor](const std::string& imagePath, std::vector<float>& features) {
+            cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
+            return !image.empty() && imageExtractor(image, features);
+        };
+    }
+
+private:
+    Extractor extractor;
+    SearchOptions options;
+};
+
+#ifdef _MANAGED
+#pragma managed(pop)
+#endif
+
+#endif // SEARCH_ENGINE_H
@@ -0,0 +1,204 @@
+/*! \file sparse_histogram.h
+    \brief Declarations for sparse/dense histogram storage and intersection scoring.
+    \author Manushi
+    \date October 16, 2026
+
+    Color histograms of natural photos leave most bins empty, and the share of empty bins grows
+    quickly with the bin count (16 or 32 bins per channel give 4096 or 32768 bins). A histogram
+    set stores every row either as sorted (bin index, mass) pairs or as a dense array, whichever
+    suits the row's fill ratio, and computes histogram intersection on that representation by
+    visiting only the bins filled on the sparse side of each comparison.
+
+    Every row also keeps the mass of each block of consecutive bins. The intersection over a
+    block is at most the smaller of the query's and the row's mass in it, so the block masses
+    bound a row's score from above without reading its bins. A top-K search skips every row whose
+    bound cannot beat the current K-th best, and abandons a row halfway once the bins scored so
+    far plus the bounds of the blocks left fall short; the rows it keeps are scored exactly as by
+    a full scan, so the results are the same.
+*/
+
+#ifndef SPARSE_HISTOGRAM_H
+#define SPARSE_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Rows filled to at most this fraction of their bins are stored sparse.
+ *
+ * A sparse entry takes 8 bytes against 4 for a dense bin, so sparse rows below this ratio are
+ * at most two thirds of their dense size and are scored over at most a third of the bins.
+ */
+constexpr float SPARSE_HISTOGRAM_MAX_FILL = 1.0f / 3.0f;
+
+/**
+ * @brief Most blocks a row is split into for bounds; blocks have at least 16 bins.
+ */
+constexpr std::size_t HISTOGRAM_BOUND_BLOCKS = 64;
+
+/**
+ * @brief A collection of equally sized histograms, each stored sparse or dense.
+ */
+class HistogramSet {
+public:
+    /**
+     * @brief A query histogram in both representations.
+     */
+    struct Query {
+        std::vector<float> dense;          // Every bin
+        std::vector<std::uint32_t> bins;   // Non-empty bins, ascending
+        std::vector<float> masses;         // Mass of every non-empty bin
+        bool sparse = false;               // True if the query itself is at or below the fill threshold
+    };
+
+    /**
+     * @param binCount Number of bins of every histogram.
+     * @param maxSparseFill Rows with at most this fill ratio are stored sparse.
+     */
+    explicit HistogramSet(std::size_t binCount, float maxSparseFill = SPARSE_HISTOGRAM_MAX_FILL);
+
+    /**
+     * @brief Appends one histogram of binCount() values, choosing its representation by fill ratio.
+     */
+    void add(const float* histogram);
+
+    /**
+     * @brief Prepares a query histogram of binCount() values.
+     */
+    Query prepareQuery(const float* histogram) const;
+
+    /**
+     * @brief Histogram intersection (sum of bin-wise minima) of a query and one row over bins [begin, end).
+     *
+     * Masses are non-negative, so empty bins never contribute and the sparse and dense paths
+     * return the same value.
+     */
+    float intersection(const Query& query, std::size_t row, std::size_t begin, std::size_t end) const;
+
+    /**
+     * @brief Histogram intersection of a query and one row over all bins.
+     */
+    float intersection(const Query& query, std::size_t row) const { return intersection(query, row, 0, bins); }
+
+    std::size_t size() const { return rows.size(); }
+    std::size_t binCount() const { return bins; }
+
+    /**
+     * @brief Bins per bound block; the last block may be shorter.
+     */
+    std::size_t blockBins() const { return binsPerBlock; }
+    std::size_t blockCount() const { return blocks; }
+
+    /**
+     * @brief True if a row is stored as (bin, mass) pairs.
+     */
+    bool isSparse(std::size_t row) const { return rows[row].sparse; }
+
+    /**
+     * @brief Mass of every bound block of a row, blockCount() values.
+     */
+    const float* blockMasses(std::size_t row) const { return rowBlockMasses.data() + row * blocks; }
+
+    /**
+     * @brief Number of rows stored sparse.
+     */
+    std::size_t sparseRows() const { return sparseRowCount; }
+
+    /**
+     * @brief Bytes used by the stored rows.
+     */
+    std::size_t memoryBytes() const;
+
+private:
+    struct Row {
+        std::size_t offset = 0;   // Into denseValues, or into sparseBins/sparseMasses
+        std::uint32_t count = 0;  // Stored entries
+        bool sparse = false;
+    };
+
+    std::size_t bins;
+    std::size_t binsPerBlock;
+    std::size_t blocks;
+    float maxFill;
+    std::size_t sparseRowCount = 0;
+    std::vector<Row> rows;
+    std::vector<float> denseValues;
+    std::vector<std::uint32_t> sparseBins;
+    std::vector<float> sparseMasses;
+    std::vector<float> rowBlockMasses;
+};
+
+/**
+ * @brief Histograms of one feature file, with the image path of every row.
+ */
+struct HistogramIndex {
+    std::string filePath;
+    std::vector<std::string> imagePaths; // Image path of every row
+    HistogramSet histograms;
+
+    explicit HistogramIndex(std::size_t binCount) : histograms(binCount) {}
+
+    std::size_t size() const { return imagePaths.size(); }
+};
+
+/**
+ * @brief Shared, read-only handle to a cached histogram index.
+ */
+using HistogramIndexHandle = std::shared_ptr<const HistogramIndex>;
+
+/**
+ * @brief Rows handled by each stage of one pruned search.
+ */
+struct HistogramSearchStats {
+    std::size_t rows = 0;       // Rows in the index
+    std::size_t pruned = 0;     // Skipped on their block bounds alone
+    std::size_t abandoned = 0;  // Dropped after scoring part of their bins
+    std::size_t scored = 0;     // Scored over every bin
+};
+
+/**
+ * @brief Finds the rows with the highest histogram intersection with a query, skipping rows that cannot make the top K.
+ *
+ * A row's score is the mean of its intersections over consecutive parts of the bins, e.g. one
+ * part for a single histogram or two for the top and bottom halves of a multi-histogram, and is
+ * computed exactly like intersection() over each part. The results equal those of a full scan,
+ * ties included. Rows are searched in chunks on the scan thread pool.
+ *
+ * @param index Histograms to search.
+ * @param query Query prepared by index.histograms.prepareQuery().
+ * @param partEnds End bin of every part, ascending; the first part starts at bin 0.
+ * @param topK Maximum number of results.
+ * @param skipImagePath Rows with this image path are left out (usually the query image).
+ * @param stats Receives the rows handled by each stage, if not null.
+ * @return Up to topK (score, row) pairs, best first; ties go to the lower row.
+ */
+std::vector<std::pair<float, std::size_t>> searchIntersectionTopK(const HistogramIndex& index, const HistogramSet::Query& query,
+    const std::vector<std::size_t>& partEnds, std::size_t topK, const std::string& skipImagePath, HistogramSearchStats* stats = nullptr);
+
+/**
+ * @brief Prints how many rows a pruned search skipped without scoring them in full.
+ */
+void printHistogramSearchStats(const HistogramSearchStats& stats);
+
+/**
+ * @brief Returns the histogram index of a feature file, loading it if needed.
+ *
+ * Indexes are cached per file and reloaded when the file's size or modification time changes.
+ * The bin count is the row width of the file.
+ *
+ * @param filePath Path to the CSV feature file or binary feature store.
+ * @return Handle to the loaded index.
+ * @throws std::runtime_error If the file cannot be read.
+ */
+HistogramIndexHandle openHistogramIndex(const std::string& filePath);
+
+/**
+ * @brief Drops every cached histogram index; outstanding handles stay valid.
+ */
+void clearHistogramIndexCache();
+
+#endif // SPARSE_HISTOGRAM_H
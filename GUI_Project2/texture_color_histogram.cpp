@@ -9,7 +9,15 @@
 */
 #include <opencv2/opencv.hpp>
 #include <vector>
+#include "distance_kernels.h"
 #include "feature_utils.h"
+#include "feature_store.h"
+#include "feature_index.h"
+#include "feature_indexer.h"
+#include "histogram_pyramid.h"
+#include "parallel_scan.h"
+#include "search_engine.h"
+#include "vp_tree.h"
 #include <filesystem>
 #include <iostream>
 #include <fstream>
@@ -74,45 +82,16 @@ std::vector<float> computeTextureHistogram(const cv::Mat& image, int magnitudeBi
 }
 
 /**
- * @brief Calculate the Euclidean distance between two feature vectors.
- * 
- * @param featureVec1 The first feature vector.
- * @param featureVec2 The second feature vector.
- * @return The Euclidean distance between the two feature vectors.
+ * @brief Calculate the Euclidean distance between two feature vectors stored in place, such as feature matrix rows.
+ *
+ * @param featureVec1 Pointer to the first feature vector.
+ * @param featureVec2 Pointer to the second feature vector.
+ * @param count Number of values in each vector.
+ * @param threshold Distance the caller's K-th best match has; the computation stops once the distance is known to exceed it.
+ * @return The Euclidean distance between the two feature vectors, or a value above threshold (and not above the distance) if it was abandoned.
  */
-float calculateFeatureDistance(const std::vector<float>& featureVec1, const std::vector<float>& featureVec2) {
-    assert(featureVec1.size() == featureVec2.size());
-    float distance = 0.0f;
-    for (size_t i = 0; i < featureVec1.size(); ++i) {
-        distance += std::pow(featureVec1[i] - featureVec2[i], 2);
-    }
-    return std::sqrt(distance);
-}
-
-/**
- * @brief Load combined color and texture histograms from a CSV file.
- * 
- * @param csvFilePath The path to the CSV file.
- * @param databaseFeatures Output parameter containing the loaded histograms.
- */
-void loadCombinedDatabaseHistograms(const std::string& csvFilePath,
-    std::vector<std::pair<std::string, std::vector<float>>>& databaseFeatures) {
-    std::ifstream file(csvFilePath);
-    std::string line;
-
-    while (getline(file, line)) {
-        std::istringstream iss(line);
-        std::string filename;
-        getline(iss, filename, ','); // Extract filename
-
-        std::vector<float> features;
-        std::string value;
-        while (getline(iss, value, ',')) {
-            features.push_back(std::stof(value));
-        }
-
-        databaseFeatures.push_back(std::make_pair(filename, std::move(features)));
-    }
+float calculateFeatureDistance(const float* featureVec1, const float* featureVec2, size_t count, float threshold) {
+    return euclideanDistanceBounded(featureVec1, featureVec2, count, threshold);
 }
 
 /**
@@ -135,6 +114,124 @@ std::vector<float> combineHistograms(const cv::Mat& colorHist, const std::vector
     return combinedHistogram;
 }
 
+/**
+ * @brief Extractor for the search engine: the color histogram followed by the texture histogram of an image.
+ */
+struct TextureColorExtractor {
+    int colorBinsPerChannel;
+    int textureBins;
+
+    bool operator()(const cv::Mat& image, std::vector<float>& features) const {
+        features = combineHistograms(compute3DColorHistogramManual(image, colorBinsPerChannel), computeTextureHistogram(image, textureBins));
+        return true;
+    }
+};
+
+/**
+ * @brief Finds the closest rows of a feature file with its vantage-point tree, skipping rows of the target image.
+ *
+ * The tree cannot skip rows by name, so the search is repeated with a larger k until enough other rows are found
+ * or the evaluation budget is spent.
+ *
+ * @return True if topMatches holds the tree's results; false, with a message, if the tree cannot be used.
+ */
+static bool searchVpTree(const std::vector<float>& queryFeatures, const std::string& targetImageFile, int topN, const std::string& featureFile,
+    const VpTreeSearchOptions& options, std::vector<std::string>& topMatches) {
+    VpTreeHandle tree;
+    try {
+        tree = openVpTree(featureFile);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "VP-tree unavailable, scanning instead: " << e.what() << std::endl;
+        return false;
+    }
+    if (queryFeatures.size() != tree->dims()) {
+        std::cerr << "Histogram size mismatch for " << featureFile << std::endl;
+        return false;
+    }
+
+    const std::filesystem::path targetName = std::filesystem::path(targetImageFile).filename();
+    const size_t wanted = static_cast<size_t>(std::max(topN, 0));
+    // Evaluations add up over the retries, which share one evaluation budget
+    VpTreeSearchStats stats;
+    for (size_t k = wanted + 1;; k *= 2) {
+        const size_t budget = options.maxDistanceEvaluations > 0 ? options.maxDistanceEvaluations - stats.distanceEvaluations : 0;
+        VpTreeSearchStats attempt;
+        const std::vector<std::pair<float, size_t>> matches = tree->search(queryFeatures.data(), k, budget, &attempt);
+        stats.distanceEvaluations += attempt.distanceEvaluations;
+        stats.rows = attempt.rows;
+        stats.exhausted = attempt.exhausted;
+        topMatches.clear();
+        for (const auto& match : matches) {
+            std::string imagePath = tree->path(match.second);
+            if (std::filesystem::path(imagePath).filename() == targetName) continue;
+            if (topMatches.size() == wanted) break;
+            topMatches.push_back(std::move(imagePath));
+        }
+        if (topMatches.size() == wanted || matches.size() < k || stats.exhausted
+            || (options.maxDistanceEvaluations > 0 && stats.distanceEvaluations >= options.maxDistanceEvaluations)) break;
+    }
+
+    const double saved = stats.rows > 0 ? 100.0 * (1.0 - static_cast<double>(stats.distanceEvaluations) / stats.rows) : 0.0;
+    std::cout << "VP-tree search: " << stats.distanceEvaluations << " of " << stats.rows << " distances computed ("
+        << saved << "% saved" << (stats.exhausted ? ", evaluation budget reached" : "") << ")" << std::endl;
+    return true;
+}
+
+/**
+ * @brief Finds the closest rows with a coarse-to-fine cascade over the pyramid of the feature file.
+ *
+ * The squared distance of two color histograms is at least the squared distance of their coarse
+ * levels divided by the fine bins per coarse bin; the texture part is added exactly.
+ *
+ * @param matches Receives up to topN (distance, row) pairs, closest first.
+ * @return False, with a message, if the pyramid cannot be used; the caller then scans instead.
+ */
+static bool cascadeTextureColorSearch(const std::vector<float>& queryFeatures, const FeatureMatrix& features, int colorBinsPerChannel, size_t topN,
+    const std::string& targetImageFile, const std::string& featureFile, const HistogramCascadeOptions& options, std::vector<std::pair<float, size_t>>& matches) {
+    HistogramPyramidHandle pyramid;
+    try {
+        pyramid = openHistogramPyramid(featureFile, static_cast<std::uint32_t>(colorBinsPerChannel));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Histogram pyramid unavailable, scanning instead: " << e.what() << std::endl;
+        return false;
+    }
+    const size_t colorBins = static_cast<size_t>(colorBinsPerChannel) * colorBinsPerChannel * colorBinsPerChannel;
+    const std::uint32_t coarseBins = pyramid->pickLevel(options.coarseBinsPerChannel);
+    if (coarseBins == 0 || pyramid->size() != features.rows() || colorBins + pyramid->tailDims() != features.dims()) {
+        std::cerr << "No matching coarse level in " << histogramPyramidPath(featureFile) << ", scanning instead" << std::endl;
+        return false;
+    }
+
+    const size_t levelBins = static_cast<size_t>(coarseBins) * coarseBins * coarseBins;
+    const float binsPerCoarseBin = static_cast<float>(colorBins / levelBins);
+    std::vector<float> coarseTarget(levelBins);
+    coarsenHistogram(queryFeatures.data(), static_cast<std::uint32_t>(colorBinsPerChannel), coarseBins, coarseTarget.data());
+    const float* level = pyramid->level(coarseBins);
+    const float* tail = pyramid->tail();
+    const size_t tailDims = pyramid->tailDims();
+
+    const std::filesystem::path targetName = std::filesystem::path(targetImageFile).filename();
+    HistogramCascadeStats stats;
+    stats.coarseBins = coarseBins;
+    matches = cascadeTopK(features.rows(), topN, ScanOrder::Ascending, options.shortlist,
+        [&](size_t begin, size_t end, float* bounds) {
+            for (size_t i = begin; i < end; ++i) {
+                if (std::filesystem::path(features.path(i)).filename() == targetName) {
+                    bounds[i - begin] = SKIPPED_ROW;
+                    continue;
+                }
+                const float color = squaredL2Distance(coarseTarget.data(), level + i * levelBins, levelBins) / binsPerCoarseBin;
+                const float texture = tailDims > 0 ? squaredL2Distance(queryFeatures.data() + colorBins, tail + i * tailDims, tailDims) : 0.0f;
+                bounds[i - begin] = std::sqrt(color + texture);
+            }
+        },
+        [&](size_t row, float threshold) { return calculateFeatureDistance(queryFeatures.data(), features.row(row), features.dims(), threshold); }, &stats);
+    printHistogramCascadeStats(stats);
+    return true;
+}
+
 /**
  * @brief Perform texture and color matching task.
  * 
@@ -143,78 +240,55 @@ std::vector<float> combineHistograms(const cv::Mat& colorHist, const std::vector
  * @param colorBinsPerChannel The number of bins per channel for the color histogram.
  * @param textureBins The number of bins for the texture histogram.
  * @param outputFile The path to the CSV file containing database histograms.
+ * @param options Search through the vantage-point tree of the feature file instead of a full scan, optionally with an evaluation budget.
+ * @param cascade Bound every image from a coarse level of its color histogram before scoring at full resolution (used if options does not pick the tree).
  * @return A vector of filenames of the top matches.
  */
-std::vector<std::string>  performTextureAndColorMatchingTask(const std::string& targetImageFile, int topN, int colorBinsPerChannel, int textureBins, const std::string& outputFile) {
-    // Load image
-    cv::Mat image = cv::imread(targetImageFile, cv::IMREAD_COLOR);
-
-    // Compute color histogram
-    cv::Mat colorHist = compute3DColorHistogramManual(image, colorBinsPerChannel);
-
-    // Compute texture histogram
-    std::vector<float> textureHist = computeTextureHistogram(image, textureBins);
-
-    // Combine color and texture histograms into a single feature vector
-    std::vector<float> featureVector;
-    featureVector.insert(featureVector.end(), colorHist.begin<float>(), colorHist.end<float>());
-    featureVector.insert(featureVector.end(), textureHist.begin(), textureHist.end());
-
-    // Combine and normalize histograms
-
-    std::vector<float> queryFeatures = combineHistograms(colorHist, textureHist);
-    // Load database histograms and combine them
-    std::vector<std::pair<std::string, std::vector<float>>> databaseFeatures;
-    loadCombinedDatabaseHistograms(outputFile, databaseFeatures);
-
-    // Compare query image histogram with database histograms
-    std::vector<std::pair<float, std::string>> matches;
-    for (const auto& [imageName, features] : databaseFeatures) {
-        // Skip comparison if the current image is the target image
-        if (std::filesystem::path(imageName).filename() == std::filesystem::path(targetImageFile).filename()) {
-            continue; // Skip this image
-        }
+std::vector<std::string>  performTextureAndColorMatchingTask(const std::string& targetImageFile, int topN, int colorBinsPerChannel, int textureBins, const std::string& outputFile,
+    const VpTreeSearchOptions& options, const HistogramCascadeOptions& cascade) {
+    // Compute the color and texture histograms of the target image
+    const Searcher<TextureColorExtractor, EuclideanMetric> searcher(TextureColorExtractor{ colorBinsPerChannel, textureBins });
+    std::vector<float> queryFeatures;
+    if (!searcher.extract(targetImageFile, queryFeatures)) {
+        return {};
+    }
 
-        float distance = calculateFeatureDistance(queryFeatures, features);
-        matches.push_back({ distance, imageName });
+    // The tree prunes most of the distance evaluations; the full scan below is the fallback
+    std::vector<std::string> treeMatches;
+    if (options.useTree && searchVpTree(queryFeatures, targetImageFile, topN, outputFile, options, treeMatches)) {
+        return treeMatches;
     }
 
+    // Get the database histograms from the cached index (loaded on first use)
+    FeatureIndexHandle index;
+    try {
+        index = openFeatureIndex(outputFile);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading histogram data: " << e.what() << std::endl;
+        return {};
+    }
+    const FeatureMatrix& features = index->features;
+    if (queryFeatures.size() != features.dims()) {
+        std::cerr << "Histogram size mismatch for " << outputFile << std::endl;
+        return {};
+    }
 
-    // Sort matches based on distance
-    std::sort(matches.begin(), matches.end(), [](const auto& a, const auto& b) {
-        return a.first < b.first;
-        });
+    // Compare query image histogram with database histograms on all scan threads, closest first
+    std::vector<std::pair<float, size_t>> matches;
+    if (!cascade.useCascade || !cascadeTextureColorSearch(queryFeatures, features, colorBinsPerChannel, static_cast<size_t>(std::max(topN, 0)),
+        targetImageFile, outputFile, cascade, matches)) {
+        matches = searcher.scan(*index, queryFeatures, static_cast<size_t>(std::max(topN, 0)), targetImageFile);
+    }
 
     std::vector<std::string> topMatches;
-    for (int i = 0; i < std::min(topN, static_cast<int>(matches.size())); ++i) {
-        topMatches.push_back(matches[i].second);
+    for (const auto& match : matches) {
+        topMatches.push_back(features.path(match.second));
     }
 
     return topMatches;
 }
 
-/**
- * @brief Save the combined color and texture histograms to a CSV file.
- * 
- * @param outputPath The path to the output CSV file.
- * @param histograms The combined histograms to be saved.
- */
-void saveCombinedHistogramsToCSV(const std::string& outputPath,
-    const std::vector<std::pair<std::string, std::vector<float>>>& histograms) {
-    std::ofstream outputFile(outputPath);
-    if (!outputFile.is_open()) {
-        throw std::runtime_error("Unable to open output file.");
-    }
-
-    for (const auto& [filename, histogram] : histograms) {
-        outputFile << filename;
-        for (const auto& value : histogram) {
-            outputFile << ", " << value;
-        }
-        outputFile << "\n";
-    }
-}
-
 /**
  * @brief Perform texture and color calculation task for a directory of images.
  * 
@@ -224,36 +298,20 @@ void saveCombinedHistogramsToCSV(const std::string& outputPath,
  * @param outputPath The path to save the combined histograms CSV file.
  */
 void performTextureAndColorCalculationTask(const std::string& directoryPath, int colorBinsPerChannel, int textureBins, const std::string& outputPath) {
-    std::vector<std::pair<std::string, std::vector<float>>> combinedHistograms;
-
-    for (const auto& entry : fs::directory_iterator(directoryPath)) {
-        if (entry.is_regular_file() && entry.path().extension() == ".jpg") {
-            cv::Mat image = cv::imread(entry.path().string(), cv::IMREAD_COLOR);
-            if (image.empty()) {
-                std::cerr << "Error reading image: " << entry.path() << std::endl;
-                continue;
-            }
-
-            // Compute the color histogram
-            cv::Mat colorHist = compute3DColorHistogramManual(image, colorBinsPerChannel);
-
-            // Convert color histogram Mat to vector
-            std::vector<float> colorHistVector(colorHist.begin<float>(), colorHist.end<float>());
-
-            // Compute the texture histogram
-            std::vector<float> textureHist = computeTextureHistogram(image, textureBins);
-
-            // Combine color and texture histograms
-            std::vector<float> combinedHist(colorHistVector);
-            combinedHist.insert(combinedHist.end(), textureHist.begin(), textureHist.end());
-
-            combinedHistograms.push_back({ entry.path().string(), combinedHist });
-        }
-    }
-
-    // Save combined histograms to CSV
     try {
-        saveCombinedHistogramsToCSV(outputPath, combinedHistograms);
+        FeatureStoreInfo info;
+        info.type = FeatureType::TextureColor;
+        info.binsPerChannel = colorBinsPerChannel;
+        info.textureBins = textureBins;
+
+        // Only new or changed images are decoded; unchanged rows are copied from the previous output
+        const Searcher<TextureColorExtractor, EuclideanMetric> searcher(TextureColorExtractor{ colorBinsPerChannel, textureBins });
+        indexImageDirectory(directoryPath, outputPath, info, searcher.imageFileExtractor());
+
+        // Coarse color levels for cascade searches are summed from the stored rows now, so no search has to build them
+        if (!coarseHistogramLevels(static_cast<std::uint32_t>(colorBinsPerChannel)).empty()) {
+            buildHistogramPyramid(outputPath, static_cast<std::uint32_t>(colorBinsPerChannel), histogramPyramidPath(outputPath));
+        }
         std::cout << "Histograms saved to " << outputPath << "\n\n" << std::endl;
     }
     catch (const std::exception& e) {
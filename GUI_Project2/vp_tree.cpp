@@ -0,0 +1,499 @@
+/*! \file vp_tree.cpp
+    \brief Implements the vantage-point tree over Euclidean feature vectors.
+    \author Manushi
+    \date October 16, 2026
+
+    This file is part of a Content-Based Image Retrieval (CBIR) system. Every node covers a
+    contiguous range of vectors in tree order: the vantage point first, then the inner half (closer
+    than the median) and the outer half. Ranges of at most 16 vectors are leaves and are scanned
+    directly. The vantage point of a node is the candidate, among a few random ones, whose
+    distances to a random sample spread the most. A search visits the child whose distance range is
+    closer to the query first and skips a child when the triangle inequality puts all of it farther
+    away than the current k-th best.
+
+    File layout (all integers little endian, every section starts on a 64-byte boundary):
+      - VpTreeHeader
+      - rowCount x rowStride floats: vectors in tree order
+      - nodeCount x VpTreeNode, root first
+      - rowCount x uint32: feature file row of every vector in tree order
+      - (rowCount + 1) x uint64 offsets into the path bytes, followed by the path bytes (feature file order)
+*/
+
+#include "vp_tree.h"
+#include "distance_kernels.h"
+#include "feature_matrix.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+#pragma pack(push, 1)
+/**
+ * @brief One node of a saved tree; a leaf has no children and holds the range [begin, end).
+ */
+struct VpTreeNode {
+    std::uint32_t begin;  // Vantage point, or first vector of a leaf
+    std::uint32_t end;    // One past the last vector of the subtree
+    std::uint32_t inner;  // Child nodes; NO_NODE for a leaf
+    std::uint32_t outer;
+    float innerMin;       // Range of distances from the vantage point to the inner subtree
+    float innerMax;
+    float outerMin;       // Range of distances from the vantage point to the outer subtree
+    float outerMax;
+};
+#pragma pack(pop)
+
+namespace {
+
+const char VP_TREE_MAGIC[8] = { 'C', 'B', 'I', 'R', 'V', 'P', 'T', 'R' };
+constexpr std::uint32_t VP_TREE_VERSION = 1;
+constexpr std::uint64_t VP_TREE_ALIGNMENT = 64;
+constexpr std::uint32_t NO_NODE = std::numeric_limits<std::uint32_t>::max();
+constexpr std::size_t LEAF_ROWS = 16;
+constexpr std::size_t PARALLEL_ROWS = 16384;
+constexpr std::size_t DISTANCE_BLOCK_ROWS = 4096;
+constexpr std::size_t VANTAGE_CANDIDATES = 5;
+constexpr std::size_t VANTAGE_SAMPLE = 32;
+constexpr std::uint64_t VANTAGE_SEED = 0x5EED5EED12345678ull;
+
+#pragma pack(push, 1)
+/**
+ * @brief Fixed-size header at the start of a tree file.
+ */
+struct VpTreeHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dims;
+    std::uint32_t rowStride;
+    std::uint32_t reserved;
+    std::uint64_t rowCount;
+    std::uint64_t nodeCount;
+    std::uint64_t sourceSize;
+    std::int64_t sourceModified;
+    std::uint64_t vectorsOffset;
+    std::uint64_t nodesOffset;
+    std::uint64_t rowIdsOffset;
+    std::uint64_t stringTableOffset;
+    std::uint64_t stringTableSize;
+    std::uint64_t fileSize;
+};
+#pragma pack(pop)
+
+std::uint64_t alignOffset(std::uint64_t offset) {
+    return (offset + VP_TREE_ALIGNMENT - 1) / VP_TREE_ALIGNMENT * VP_TREE_ALIGNMENT;
+}
+
+/**
+ * @brief Size and modification time of a file, as recorded in the tree header.
+ */
+void sourceFileState(const std::string& filePath, std::uint64_t& size, std::int64_t& modified) {
+    size = static_cast<std::uint64_t>(fs::file_size(filePath));
+    modified = static_cast<std::int64_t>(fs::last_write_time(filePath).time_since_epoch().count());
+}
+
+/**
+ * @brief Splits the rows of a feature matrix into tree nodes.
+ */
+class VpTreeBuilder {
+public:
+    explicit VpTreeBuilder(const FeatureMatrix& features)
+        : features(features), order(features.rows()), distances(features.rows()), random(VANTAGE_SEED) {
+        for (std::size_t i = 0; i < order.size(); ++i) order[i] = static_cast<std::uint32_t>(i);
+        build(0, order.size());
+    }
+
+    /**
+     * @brief Feature matrix row of every vector in tree order.
+     */
+    const std::vector<std::uint32_t>& treeOrder() const { return order; }
+    const std::vector<VpTreeNode>& treeNodes() const { return nodes; }
+
+private:
+    float distance(std::uint32_t a, std::uint32_t b) const {
+        return std::sqrt(squaredL2Distance(features.row(a), features.row(b), features.dims()));
+    }
+
+    /**
+     * @brief Distances from one row to the rows at tree positions [begin, end), in parallel for large ranges.
+     */
+    void distancesFrom(std::uint32_t vantage, std::size_t begin, std::size_t end) {
+        auto fill = [&](std::size_t from, std::size_t to) {
+            for (std::size_t i = from; i < to; ++i) distances[i] = distance(vantage, order[i]);
+        };
+        if (end - begin < PARALLEL_ROWS) {
+            fill(begin, end);
+            return;
+        }
+        parallelFor((end - begin + DISTANCE_BLOCK_ROWS - 1) / DISTANCE_BLOCK_ROWS, [&](std::size_t block) {
+            fill(begin + block * DISTANCE_BLOCK_ROWS, std::min(end, begin + (block + 1) * DISTANCE_BLOCK_ROWS));
+        });
+    }
+
+    /**
+     * @brief Picks the candidate whose distances to a random sample of the range have the largest variance.
+     */
+    std::size_t pickVantage(std::size_t begin, std::size_t end) {
+        std::uniform_int_distribution<std::size_t> position(begin, end - 1);
+        std::size_t best = begin;
+        double bestSpread = -1.0;
+        for (std::size_t c = 0; c < VANTAGE_CANDIDATES; ++c) {
+            const std::size_t candidate = position(random);
+            double sum = 0.0, squares = 0.0;
+            for (std::size_t s = 0; s < VANTAGE_SAMPLE; ++s) {
+                const double d = distance(order[candidate], order[position(random)]);
+                sum += d;
+                squares += d * d;
+            }
+            const double spread = squares / VANTAGE_SAMPLE - (sum / VANTAGE_SAMPLE) * (sum / VANTAGE_SAMPLE);
+            if (spread > bestSpread) {
+                bestSpread = spread;
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    std::uint32_t build(std::size_t begin, std::size_t end) {
+        const std::uint32_t index = static_cast<std::uint32_t>(nodes.size());
+        nodes.push_back({ static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end), NO_NODE, NO_NODE, 0.0f, 0.0f, 0.0f, 0.0f });
+        if (end - begin <= LEAF_ROWS) return index;
+
+        std::swap(order[begin], order[pickVantage(begin, end)]);
+        distancesFrom(order[begin], begin + 1, end);
+
+        // Median split of the remaining rows by their distance to the vantage point
+        std::vector<std::pair<float, std::uint32_t>> items(end - begin - 1);
+        for (std::size_t i = begin + 1; i < end; ++i) items[i - begin - 1] = { distances[i], order[i] };
+        const std::size_t half = items.size() / 2;
+        std::nth_element(items.begin(), items.begin() + half, items.end());
+        for (std::size_t i = 0; i < items.size(); ++i) order[begin + 1 + i] = items[i].second;
+
+        const auto innerRange = std::minmax_element(items.begin(), items.begin() + half);
+        const auto outerRange = std::minmax_element(items.begin() + half, items.end());
+        nodes[index].innerMin = innerRange.first->first;
+        nodes[index].innerMax = innerRange.second->first;
+        nodes[index].outerMin = outerRange.first->first;
+        nodes[index].outerMax = outerRange.second->first;
+        items = std::vector<std::pair<float, std::uint32_t>>();
+
+        const std::size_t middle = begin + 1 + half;
+        const std::uint32_t inner = build(begin + 1, middle);
+        const std::uint32_t outer = build(middle, end);
+        nodes[index].inner = inner;
+        nodes[index].outer = outer;
+        return index;
+    }
+
+    const FeatureMatrix& features;
+    std::vector<std::uint32_t> order;
+    std::vector<float> distances;
+    std::vector<VpTreeNode> nodes;
+    std::mt19937_64 random;
+};
+
+/**
+ * @brief State of one k-nearest-neighbor search.
+ */
+class VpTreeSearch {
+public:
+    VpTreeSearch(const float* query, std::size_t topK, std::size_t budget, const float* vectors, std::size_t dims, std::size_t stride,
+        const VpTreeNode* nodes, const std::uint32_t* rowIds)
+        : query(query), topK(topK), budget(budget), vectors(vectors), dims(dims), stride(stride), nodes(nodes), rowIds(rowIds) {}
+
+    void visit(std::uint32_t index) {
+        const VpTreeNode& node = nodes[index];
+        if (node.inner == NO_NODE) {
+            for (std::uint32_t i = node.begin; i < node.end && !exhausted; ++i) evaluate(i);
+            return;
+        }
+
+        const float d = evaluate(node.begin);
+        if (exhausted) return;
+
+        // The child whose distance range is closer to the query is more likely to hold neighbors
+        const bool innerFirst = d < 0.5f * (node.innerMax + node.outerMin);
+        const std::uint32_t first = innerFirst ? node.inner : node.outer;
+        const std::uint32_t second = innerFirst ? node.outer : node.inner;
+        if (!prunable(d, innerFirst, node)) visit(first);
+        if (!exhausted && !prunable(d, !innerFirst, node)) visit(second);
+    }
+
+    std::vector<std::pair<float, std::size_t>> results() {
+        std::vector<std::pair<float, std::size_t>> sorted(best.size());
+        for (std::size_t i = sorted.size(); i-- > 0;) {
+            sorted[i] = best.top();
+            best.pop();
+        }
+        return sorted;
+    }
+
+    std::size_t evaluations = 0;
+    bool exhausted = false;
+
+private:
+    float evaluate(std::uint32_t position) {
+        if (budget > 0 && evaluations >= budget) {
+            exhausted = true;
+            return 0.0f;
+        }
+        ++evaluations;
+        const float d = std::sqrt(squaredL2Distance(query, vectors + static_cast<std::size_t>(position) * stride, dims));
+        const std::pair<float, std::size_t> candidate(d, rowIds[position]);
+        if (best.size() < topK) best.push(candidate);
+        else if (candidate < best.top()) {
+            best.pop();
+            best.push(candidate);
+        }
+        return d;
+    }
+
+    /**
+     * @brief True if no vector of a child can beat the current k-th best.
+     *
+     * A vector x of the child satisfies |d(q, v) - d(v, x)| <= d(q, x), so the gap between d(q, v)
+     * and the child's distance range is a lower bound. The small slack keeps float rounding from
+     * pruning a vector that ties with the k-th best.
+     */
+    bool prunable(float d, bool inner, const VpTreeNode& node) const {
+        if (best.size() < topK) return false;
+        const float low = inner ? node.innerMin : node.outerMin;
+        const float high = inner ? node.innerMax : node.outerMax;
+        const float bound = std::max(low - d, d - high);
+        const float kth = best.top().first;
+        return bound > kth + 1e-5f * (kth + d) + 1e-6f;
+    }
+
+    const float* query;
+    std::size_t topK;
+    std::size_t budget;
+    const float* vectors;
+    std::size_t dims;
+    std::size_t stride;
+    const VpTreeNode* nodes;
+    const std::uint32_t* rowIds;
+    std::priority_queue<std::pair<float, std::size_t>> best; // Worst kept pair on top
+};
+
+/**
+ * @brief Cache entry: a loaded tree and the file state it was loaded from.
+ */
+struct CachedTree {
+    std::uintmax_t fileSize = 0;
+    fs::file_time_type modifiedTime;
+    VpTreeHandle tree;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedTree> cachedTrees;
+
+} // namespace
+
+VpTree::VpTree(const std::string& treeFilePath) : mapping(treeFilePath) {
+    const unsigned char* data = mapping.data();
+    VpTreeHeader header;
+    if (mapping.size() < sizeof(header)) {
+        throw std::runtime_error("VP-tree file is truncated: " + treeFilePath);
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    const std::uint64_t rows = header.rowCount;
+    bool valid = std::memcmp(header.magic, VP_TREE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == VP_TREE_VERSION
+        && header.fileSize == mapping.size()
+        && header.rowStride >= header.dims
+        && rows > 0 && rows < NO_NODE && header.nodeCount > 0 && header.nodeCount < NO_NODE
+        && header.vectorsOffset % VP_TREE_ALIGNMENT == 0
+        && header.nodesOffset >= header.vectorsOffset + rows * header.rowStride * sizeof(float)
+        && header.rowIdsOffset >= header.nodesOffset + header.nodeCount * sizeof(VpTreeNode)
+        && header.stringTableOffset >= header.rowIdsOffset + rows * sizeof(std::uint32_t)
+        && header.stringTableOffset + header.stringTableSize <= mapping.size();
+
+    // Node ranges and children are checked once, so searches can trust them
+    const VpTreeNode* treeNodes = reinterpret_cast<const VpTreeNode*>(data + header.nodesOffset);
+    for (std::uint64_t i = 0; valid && i < header.nodeCount; ++i) {
+        const VpTreeNode& node = treeNodes[i];
+        const bool leaf = node.inner == NO_NODE && node.outer == NO_NODE;
+        valid = node.begin < node.end && node.end <= rows
+            && (leaf || (node.inner > i && node.inner < header.nodeCount && node.outer > i && node.outer < header.nodeCount));
+    }
+    if (!valid) {
+        throw std::runtime_error("Not a valid VP-tree file (or unsupported version): " + treeFilePath);
+    }
+
+    rowCount = static_cast<std::size_t>(rows);
+    rowDims = header.dims;
+    rowStride = header.rowStride;
+    nodeCount = static_cast<std::size_t>(header.nodeCount);
+    sourceSize = header.sourceSize;
+    sourceModified = header.sourceModified;
+    vectors = reinterpret_cast<const float*>(data + header.vectorsOffset);
+    nodes = treeNodes;
+    rowIds = reinterpret_cast<const std::uint32_t*>(data + header.rowIdsOffset);
+    pathOffsets = reinterpret_cast<const std::uint64_t*>(data + header.stringTableOffset);
+    pathBytes = reinterpret_cast<const char*>(pathOffsets + rowCount + 1);
+}
+
+std::string VpTree::path(std::size_t row) const {
+    return std::string(pathBytes + pathOffsets[row], static_cast<std::size_t>(pathOffsets[row + 1] - pathOffsets[row]));
+}
+
+std::vector<std::pair<float, std::size_t>> VpTree::search(const float* query, std::size_t topK, std::size_t maxDistanceEvaluations,
+    VpTreeSearchStats* stats) const {
+    VpTreeSearch search(query, topK, maxDistanceEvaluations, vectors, rowDims, rowStride, nodes, rowIds);
+    if (topK > 0) search.visit(0);
+
+    if (stats) {
+        stats->distanceEvaluations = search.evaluations;
+        stats->rows = rowCount;
+        stats->exhausted = search.exhausted;
+    }
+    return search.results();
+}
+
+bool VpTree::isBuiltFrom(const std::string& featureFilePath) const {
+    std::uint64_t size = 0;
+    std::int64_t modified = 0;
+    try {
+        sourceFileState(featureFilePath, size, modified);
+    }
+    catch (const fs::filesystem_error&) {
+        return false;
+    }
+    return size == sourceSize && modified == sourceModified;
+}
+
+std::string vpTreePath(const std::string& featureFilePath) {
+    return featureFilePath + ".vptree";
+}
+
+void buildVpTree(const std::string& featureFilePath, const std::string& treeFilePath) {
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    sourceFileState(featureFilePath, sourceSize, sourceModified);
+
+    const FeatureMatrix features = readFeatureMatrix(featureFilePath);
+    if (features.empty() || features.rows() >= NO_NODE) {
+        throw std::runtime_error("No feature vectors to index in " + featureFilePath);
+    }
+    const VpTreeBuilder builder(features);
+    const std::vector<std::uint32_t>& order = builder.treeOrder();
+    const std::vector<VpTreeNode>& nodes = builder.treeNodes();
+
+    std::uint64_t pathBytes = 0;
+    for (const std::string& imagePath : features.paths()) pathBytes += imagePath.size();
+
+    VpTreeHeader header = {};
+    std::memcpy(header.magic, VP_TREE_MAGIC, sizeof(header.magic));
+    header.version = VP_TREE_VERSION;
+    header.dims = static_cast<std::uint32_t>(features.dims());
+    header.rowStride = static_cast<std::uint32_t>(features.stride());
+    header.rowCount = features.rows();
+    header.nodeCount = nodes.size();
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+    header.vectorsOffset = alignOffset(sizeof(VpTreeHeader));
+    header.nodesOffset = alignOffset(header.vectorsOffset + features.memoryBytes());
+    header.rowIdsOffset = alignOffset(header.nodesOffset + nodes.size() * sizeof(VpTreeNode));
+    header.stringTableOffset = alignOffset(header.rowIdsOffset + order.size() * sizeof(std::uint32_t));
+    header.stringTableSize = (features.rows() + 1) * sizeof(std::uint64_t) + pathBytes;
+    header.fileSize = header.stringTableOffset + header.stringTableSize;
+
+    // Written under a temporary name so an interrupted build never leaves a half-written tree
+    const std::string partialPath = treeFilePath + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to open VP-tree file for writing: " + partialPath);
+        }
+        std::uint64_t written = 0;
+        auto put = [&](const void* data, std::uint64_t bytes) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            written += bytes;
+        };
+        auto padTo = [&](std::uint64_t offset) {
+            static const char zeros[VP_TREE_ALIGNMENT] = {};
+            put(zeros, offset - written);
+        };
+
+        put(&header, sizeof(header));
+        padTo(header.vectorsOffset);
+        for (std::uint32_t row : order) put(features.row(row), features.stride() * sizeof(float));
+        padTo(header.nodesOffset);
+        put(nodes.data(), nodes.size() * sizeof(VpTreeNode));
+        padTo(header.rowIdsOffset);
+        put(order.data(), order.size() * sizeof(std::uint32_t));
+        padTo(header.stringTableOffset);
+        std::uint64_t offset = 0;
+        for (const std::string& imagePath : features.paths()) {
+            put(&offset, sizeof(offset));
+            offset += imagePath.size();
+        }
+        put(&offset, sizeof(offset));
+        for (const std::string& imagePath : features.paths()) put(imagePath.data(), imagePath.size());
+
+        if (!out.good()) {
+            throw std::runtime_error("Error writing VP-tree file: " + partialPath);
+        }
+    }
+    std::error_code error;
+    fs::rename(partialPath, treeFilePath, error);
+    if (error) {
+        fs::remove(partialPath, error);
+        throw std::runtime_error("Unable to replace VP-tree file: " + treeFilePath);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Built VP-tree of " << features.rows() << " vectors (" << nodes.size() << " nodes) in " << seconds
+        << " s: " << treeFilePath << std::endl;
+}
+
+VpTreeHandle openVpTree(const std::string& featureFilePath) {
+    const std::string treeFilePath = vpTreePath(featureFilePath);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    std::error_code error;
+    const std::uintmax_t fileSize = fs::file_size(treeFilePath, error);
+    const fs::file_time_type modifiedTime = fs::last_write_time(treeFilePath, error);
+    auto cached = cachedTrees.find(treeFilePath);
+    if (!error && cached != cachedTrees.end() && cached->second.fileSize == fileSize && cached->second.modifiedTime == modifiedTime
+        && cached->second.tree->isBuiltFrom(featureFilePath)) {
+        return cached->second.tree;
+    }
+
+    // Drop the cached mapping first, so the file can be replaced if it has to be rebuilt
+    cachedTrees.erase(treeFilePath);
+    VpTreeHandle tree;
+    if (!error) {
+        try {
+            auto loaded = std::make_shared<const VpTree>(treeFilePath);
+            if (loaded->isBuiltFrom(featureFilePath)) tree = loaded;
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Rebuilding VP-tree: " << e.what() << std::endl;
+        }
+    }
+    if (!tree) {
+        buildVpTree(featureFilePath, treeFilePath);
+        tree = std::make_shared<const VpTree>(treeFilePath);
+    }
+
+    CachedTree entry;
+    entry.fileSize = fs::file_size(treeFilePath);
+    entry.modifiedTime = fs::last_write_time(treeFilePath);
+    entry.tree = tree;
+    cachedTrees[treeFilePath] = entry;
+    return tree;
+}
@@ -0,0 +1,136 @@
+/*! \file vp_tree.h
+    \brief Declarations for the vantage-point tree over Euclidean feature vectors.
+    \author Manushi
+    \date October 16, 2026
+
+    Euclidean distance is a metric, so the triangle inequality bounds the distance from a query
+    to every vector of a subtree once the distance to the subtree's vantage point is known. A
+    vantage-point tree splits the collection at every node by the median distance to a vantage
+    point and records the range of distances on each side; a k-nearest-neighbor search skips
+    every subtree whose range cannot hold a vector closer than the current k-th best. Exact
+    searches return the same results as a full scan; a search can also stop after a fixed number
+    of distance evaluations and return the best vectors found so far.
+
+    The tree is built from a feature file (CSV or feature store) and saved next to it as
+    "<featureFile>.vptree". The file holds the vectors in tree order, so every subtree is one
+    contiguous block, together with the nodes and the image paths, and is memory-mapped when
+    opened. It records the size and modification time of the feature file it was built from and
+    is rebuilt when they change.
+*/
+
+#ifndef VP_TREE_H
+#define VP_TREE_H
+
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Options for searches that can use a vantage-point tree.
+ */
+struct VpTreeSearchOptions {
+    bool useTree = false;                    // Search the tree of the feature file instead of scanning every row
+    std::size_t maxDistanceEvaluations = 0;  // Stop after this many distance evaluations (0 searches exactly)
+};
+
+/**
+ * @brief Work done by one tree search.
+ */
+struct VpTreeSearchStats {
+    std::size_t distanceEvaluations = 0; // Vectors the query was compared with
+    std::size_t rows = 0;                // Vectors a full scan compares with
+    bool exhausted = false;              // True if the evaluation budget stopped the search early
+};
+
+struct VpTreeNode;
+
+/**
+ * @brief A saved vantage-point tree, memory-mapped read-only.
+ *
+ * Searches only read the mapping, so one tree can be searched from several threads at once.
+ */
+class VpTree {
+public:
+    /**
+     * @brief Maps a tree file and validates its header.
+     *
+     * @param treeFilePath Path to the ".vptree" file.
+     * @throws std::runtime_error If the file cannot be mapped or is not a valid tree.
+     */
+    explicit VpTree(const std::string& treeFilePath);
+
+    std::size_t size() const { return rowCount; }
+    std::size_t dims() const { return rowDims; }
+
+    /**
+     * @brief Returns the image path stored for a row of the feature file.
+     */
+    std::string path(std::size_t row) const;
+
+    /**
+     * @brief Finds the vectors closest to a query by Euclidean distance.
+     *
+     * @param query Query vector of dims() floats.
+     * @param topK Number of neighbors to return.
+     * @param maxDistanceEvaluations Evaluation budget; 0 searches exactly.
+     * @param stats Receives the work done, if not null.
+     * @return Up to topK (distance, row) pairs, closest first; ties go to the lower row.
+     */
+    std::vector<std::pair<float, std::size_t>> search(const float* query, std::size_t topK, std::size_t maxDistanceEvaluations = 0,
+        VpTreeSearchStats* stats = nullptr) const;
+
+    /**
+     * @brief Checks whether the tree was built from the current contents of a feature file.
+     */
+    bool isBuiltFrom(const std::string& featureFilePath) const;
+
+private:
+    MappedFile mapping;
+    std::size_t rowCount = 0;
+    std::size_t rowDims = 0;
+    std::size_t rowStride = 0;
+    std::size_t nodeCount = 0;
+    std::uint64_t sourceSize = 0;
+    std::int64_t sourceModified = 0;
+    const float* vectors = nullptr;
+    const VpTreeNode* nodes = nullptr;
+    const std::uint32_t* rowIds = nullptr;
+    const std::uint64_t* pathOffsets = nullptr;
+    const char* pathBytes = nullptr;
+};
+
+/**
+ * @brief Shared, read-only handle to a cached vantage-point tree.
+ */
+using VpTreeHandle = std::shared_ptr<const VpTree>;
+
+/**
+ * @brief Returns the path of the tree file that belongs to a feature file.
+ */
+std::string vpTreePath(const std::string& featureFilePath);
+
+/**
+ * @brief Builds a vantage-point tree over the rows of a feature file and saves it.
+ *
+ * Vantage points are drawn with a fixed seed, so rebuilding the same file gives the same tree.
+ *
+ * @param featureFilePath CSV or feature store file.
+ * @param treeFilePath Path of the tree file to write.
+ * @throws std::runtime_error If the feature file cannot be read or the tree cannot be written.
+ */
+void buildVpTree(const std::string& featureFilePath, const std::string& treeFilePath);
+
+/**
+ * @brief Returns the cached tree of a feature file, building or rebuilding it if needed.
+ *
+ * @param featureFilePath CSV or feature store file.
+ * @return Handle to the tree.
+ * @throws std::runtime_error If the tree can neither be opened nor built.
+ */
+VpTreeHandle openVpTree(const std::string& featureFilePath);
+
+#endif // VP_TREE_H